@@ -19,7 +19,45 @@ public:
     double GetStreamTime() override { return 0; }
 };
 
-PCAudio::PCAudio(AudioSettings &settings) : Audio(settings) {}
+PCOfflineAudioDriver::PCOfflineAudioDriver(AudioSettings &settings)
+    : AudioDriver(settings), renderedFrames_(0), checksum_(2166136261u) {}
+
+bool PCOfflineAudioDriver::StartDriver() {
+    renderedFrames_ = 0;
+    checksum_ = 2166136261u;
+    return true;
+}
+
+double PCOfflineAudioDriver::GetStreamTime() {
+    return double(renderedFrames_) / 44100.0;
+}
+
+bool PCOfflineAudioDriver::Pump() {
+    if (!isPlaying_) {
+        return false;
+    }
+    // There is no DMA consuming the pool, so whatever was queued is considered
+    // played by the time the mixer is asked for the next buffer
+    for (int i = 0; i < SOUND_BUFFER_COUNT; i++) {
+        pool_[i].empty_ = true;
+    }
+    int queued = poolQueuePosition_;
+
+    onAudioBufferTick();
+    OnNewBufferNeeded();
+
+    if (!pool_[queued].empty_) {
+        AudioBufferData &data = pool_[queued];
+        renderedFrames_ += data.size_ / (2 * sizeof(short));
+        for (int i = 0; i < data.size_; i++) {
+            checksum_ = (checksum_ ^ (unsigned char)data.buffer_[i]) * 16777619u;
+        }
+    }
+    return true;
+}
+
+PCAudio::PCAudio(AudioSettings &settings, bool offline)
+    : Audio(settings), offline_(offline), offlineDriver_(nullptr) {}
 
 PCAudio::~PCAudio() {}
 
@@ -28,7 +66,13 @@ void PCAudio::Init() {
     // Create Driver
     // Use heap allocation to avoid destruction issues or static init issues
     // Note: This leaks memory but for this singleton it's acceptable for now
-    SDLAudioDriver *driver = new SDLAudioDriver(settings_);
+    AudioDriver *driver;
+    if (offline_) {
+        offlineDriver_ = new PCOfflineAudioDriver(settings_);
+        driver = offlineDriver_;
+    } else {
+        driver = new SDLAudioDriver(settings_);
+    }
     AudioOutDriver *out = new AudioOutDriver(*driver);
     AddOutput(*out);
 }
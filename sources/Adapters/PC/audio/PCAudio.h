@@ -2,14 +2,49 @@
 #define _PC_AUDIO_H_
 
 #include "Services/Audio/Audio.h"
+#include "Services/Audio/AudioDriver.h"
+#include <cstdint>
+
+// Driver used for headless rendering: nothing consumes the pool, instead the
+// caller pumps buffers out of the mixer as fast as the CPU allows
+class PCOfflineAudioDriver : public AudioDriver {
+public:
+    PCOfflineAudioDriver(AudioSettings &settings);
+    virtual ~PCOfflineAudioDriver() {}
+
+    bool InitDriver() override { return true; }
+    void CloseDriver() override {}
+    bool StartDriver() override;
+    void StopDriver() override {}
+    bool Interlaced() override { return true; }
+    int GetPlayedBufferPercentage() override { return 0; }
+    double GetStreamTime() override;
+
+    // Renders one buffer through the mixer, returns false if not started
+    bool Pump();
+    uint64_t GetRenderedFrames() { return renderedFrames_; }
+    // FNV-1a hash of everything rendered so far, to compare renders bit for bit
+    uint32_t GetChecksum() { return checksum_; }
+
+private:
+    uint64_t renderedFrames_;
+    uint32_t checksum_;
+};
 
 class PCAudio : public Audio {
 public:
-    PCAudio(AudioSettings &settings);
+    PCAudio(AudioSettings &settings, bool offline = false);
     virtual ~PCAudio();
     
     virtual void Init() override;
     virtual void Close() override;
     virtual int GetSampleRate() override;
+
+    // Only set when created in offline mode
+    PCOfflineAudioDriver *GetOfflineDriver() { return offlineDriver_; }
+
+private:
+    bool offline_;
+    PCOfflineAudioDriver *offlineDriver_;
 };
 #endif
@@ -11,6 +11,8 @@
 
 extern "C" {
     uint16_t *GetPCDisplayBuffer(); 
+    bool TakePCDisplayDirtyRect(uint16_t *x, uint16_t *y, uint16_t *w,
+                                uint16_t *h);
 }
 
 // Global SDL resources
@@ -24,10 +26,13 @@ static uint16_t to_rgb565(GUIColor &c) {
 }
 
 PCGUIWindowImp *PCGUIWindowImp::instance_ = nullptr;
+Uint32 PCGUIWindowImp::flushEventType_ = (Uint32)-1;
+std::atomic<bool> PCGUIWindowImp::flushPending_(false);
 
 PCGUIWindowImp::PCGUIWindowImp(GUICreateWindowParams &p) {
     instance_ = this;
     chargfx_init(); // Initialize mock display driver
+    flushEventType_ = SDL_RegisterEvents(1);
 
     // Create SDL Window
     g_window = SDL_CreateWindow(p.title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 
@@ -93,9 +98,29 @@ GUIRect PCGUIWindowImp::GetRect() {
     return GUIRect(0, 0, 320, 240);
 }
 
+// Called from the player as well, so it only wakes the main loop up with an
+// event. One pending flush event is enough however often it gets called
 void PCGUIWindowImp::Invalidate() {
-    // Request flush?
-    // Use SDL_UserEvent to trigger main loop update or just flag it.
+    if (flushEventType_ == (Uint32)-1 || flushPending_.exchange(true)) {
+        return;
+    }
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = flushEventType_;
+    if (SDL_PushEvent(&event) != 1) {
+        flushPending_ = false;
+    }
+}
+
+bool PCGUIWindowImp::IsFlushEvent(const SDL_Event &event) {
+    return flushEventType_ != (Uint32)-1 && event.type == flushEventType_;
+}
+
+void PCGUIWindowImp::ProcessFlush() {
+    flushPending_ = false;
+    if (instance_ && instance_->_window) {
+        instance_->_window->Update(false);
+    }
 }
 
 void PCGUIWindowImp::Lock() {}
@@ -104,33 +129,31 @@ void PCGUIWindowImp::Unlock() {}
 void PCGUIWindowImp::Flush() {
     chargfx_draw_changed(); // Update the mock framebuffer
 
-    // Now copy mock framebuffer to SDL texture
+    // Only what chargfx drew since the last flush goes to the texture, and
+    // nothing gets presented when it didn't draw anything
+    uint16_t x, y, w, h;
+    if (!TakePCDisplayDirtyRect(&x, &y, &w, &h)) {
+        return;
+    }
+    if (!g_texture) {
+        std::cerr << "g_texture is null in Flush" << std::endl;
+        return;
+    }
     uint16_t *buffer = GetPCDisplayBuffer();
-    
+    SDL_Rect rect = {x, y, w, h};
+    if (SDL_UpdateTexture(g_texture, &rect, buffer + y * 320 + x,
+                          320 * sizeof(uint16_t)) != 0) {
+        std::cerr << "SDL Update Texture failed: " << SDL_GetError()
+                  << std::endl;
+    }
+    Present();
+}
+
+void PCGUIWindowImp::Present() {
     if (g_texture) {
-        // Update texture
-        // Lock texture? or UpdateTexture?
-        // SDL_UpdateTexture(g_texture, NULL, buffer, 320 * sizeof(uint16_t));
-        // Use lock for streaming
-        void *pixels;
-        int pitch;
-        if (SDL_LockTexture(g_texture, NULL, &pixels, &pitch) == 0) {
-            // Copy rows?
-            // Assuming direct mapping 320x240
-            // buffer is 320*240 uint16_t
-            // pitch should be 320*2
-            memcpy(pixels, buffer, 320 * 240 * 2);
-            SDL_UnlockTexture(g_texture);
-        } else {
-             std::cerr << "SDL Lock Texture failed: " << SDL_GetError() << std::endl;
-        }
-        
-        // Render
         SDL_RenderClear(g_renderer);
         SDL_RenderCopy(g_renderer, g_texture, NULL, NULL);
         SDL_RenderPresent(g_renderer);
-    } else {
-        std::cerr << "g_texture is null in Flush" << std::endl;
     }
 }
 
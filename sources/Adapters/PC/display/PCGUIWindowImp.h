@@ -7,6 +7,7 @@
 #include "Services/Midi/MidiService.h"
 #include "chargfx.h"
 #include <SDL.h>
+#include <atomic>
 
 class PCGUIWindowImp : public I_GUIWindowImp, public I_Observer {
 public:
@@ -48,8 +49,17 @@ public:
 
     void ProcessEvent(SDL_Event &event); // To handle input mapping if needed here, or just helper
 
+    // Invalidate wakes the main loop with an SDL user event, which it hands
+    // back to ProcessFlush
+    static bool IsFlushEvent(const SDL_Event &event);
+    static void ProcessFlush();
+    // Shows the texture again, eg. when the window got uncovered
+    static void Present();
+
 private:
    static PCGUIWindowImp *instance_;
+   static Uint32 flushEventType_;
+   static std::atomic<bool> flushPending_;
    chargfx_color_t GetColor(GUIColor &c);
    bool remoteUIEnabled_ = false;
 };
@@ -8,6 +8,8 @@ static uint16_t frameBuffer[320 * 240];
 static uint16_t window_x0 = 0, window_x1 = 0, window_y0 = 0, window_y1 = 0;
 static uint16_t cursor_x = 0, cursor_y = 0;
 static uint8_t rotation = 0;
+// Bounds of the pixels written since the last TakePCDisplayDirtyRect
+static uint16_t dirty_x0 = 320, dirty_y0 = 240, dirty_x1 = 0, dirty_y1 = 0;
 
 uint16_t *GetPCDisplayBuffer() {
     return frameBuffer;
@@ -71,6 +73,10 @@ void ili9341_write_data_continuous(void *data, size_t len) {
     for (size_t i = 0; i < count; i++) {
         if (cursor_x < 320 && cursor_y < 240) {
             frameBuffer[cursor_y * 320 + cursor_x] = pixels[i];
+            if (cursor_x < dirty_x0) dirty_x0 = cursor_x;
+            if (cursor_x > dirty_x1) dirty_x1 = cursor_x;
+            if (cursor_y < dirty_y0) dirty_y0 = cursor_y;
+            if (cursor_y > dirty_y1) dirty_y1 = cursor_y;
         }
         
         cursor_x++;
@@ -80,3 +86,18 @@ void ili9341_write_data_continuous(void *data, size_t len) {
         }
     }
 }
+
+bool TakePCDisplayDirtyRect(uint16_t *x, uint16_t *y, uint16_t *w, uint16_t *h) {
+    if (dirty_x0 > dirty_x1) {
+        return false;
+    }
+    *x = dirty_x0;
+    *y = dirty_y0;
+    *w = dirty_x1 - dirty_x0 + 1;
+    *h = dirty_y1 - dirty_y0 + 1;
+    dirty_x0 = 320;
+    dirty_y0 = 240;
+    dirty_x1 = 0;
+    dirty_y1 = 0;
+    return true;
+}
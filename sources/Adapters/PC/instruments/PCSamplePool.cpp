@@ -1,13 +1,14 @@
 #include "PCSamplePool.h"
 #include "System/Console/Trace.h"
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
 #define PC_SAMPLE_MEMORY_SIZE (16 * 1024 * 1024) // 16MB
 
-PCSamplePool::PCSamplePool() : SamplePool() {
+PCSamplePool::PCSamplePool()
+    : SamplePool(), store_(PC_SAMPLE_MEMORY_SIZE, 4) {
     sampleMemory_.resize(PC_SAMPLE_MEMORY_SIZE);
-    currentOffset_ = 0;
 }
 
 PCSamplePool::~PCSamplePool() {}
@@ -18,23 +19,33 @@ void PCSamplePool::Reset() {
         wav_[i].Close();
         nameStore_[i][0] = '\0';
     }
-    currentOffset_ = 0; // Reset memory pointer
+    store_.Reset(); // Free the whole store
     std::fill(sampleMemory_.begin(), sampleMemory_.end(), 0);
 }
 
 bool PCSamplePool::CheckSampleFits(int sampleSize) {
-    return (currentOffset_ + sampleSize) <= PC_SAMPLE_MEMORY_SIZE;
+    // Samples bigger than the free space are streamed past their preload
+    sampleSize = std::min(sampleSize, SAMPLE_STREAM_PRELOAD_BYTES);
+    return uint32_t(sampleSize) <= store_.Available();
 }
 
 uint32_t PCSamplePool::GetAvailableSampleStorageSpace() {
-    return PC_SAMPLE_MEMORY_SIZE - currentOffset_;
+    return store_.Available();
 }
 
 bool PCSamplePool::unloadSample(uint32_t i) {
-    // Implementing unload is complex with linear allocation, 
-    // but for now return false or implement simple logic if needed.
-    // Pico version returns false.
-    return false;
+    if (i >= count_) {
+        return false;
+    }
+    uint8_t *buffer = static_cast<uint8_t *>(wav_[i].GetSampleBuffer(0));
+    if (buffer == nullptr) {
+        Trace::Error("Invalid sample buffer while deleting");
+        return false;
+    }
+    // The space goes back to the free list, other samples stay in place
+    store_.Release(buffer - sampleMemory_.data(), residentBytes(wav_[i]));
+    removeEntry(i);
+    return true;
 }
 
 bool PCSamplePool::loadSample(const char *name) {
@@ -54,20 +65,29 @@ bool PCSamplePool::loadSample(const char *name) {
     strncpy(nameStore_[count_], name, MAX_INSTRUMENT_FILENAME_LENGTH);
     nameStore_[count_][MAX_INSTRUMENT_FILENAME_LENGTH] = '\0';
     
-    // Load data into memory
-    uint32_t size = wav_[count_].GetDiskSize(-1);
+    // Load data into memory, samples that don't fit only get their head
+    // loaded and stream the rest. The free space is compacted into one
+    // block if the sample doesn't fit in any, while nothing plays
+    bool stopped = canCompact();
+    uint32_t size = prepareResident(
+        wav_[count_], stopped ? store_.Available() : store_.Largest());
     
-    if (!CheckSampleFits(size)) {
-         Trace::Error("Not enough memory for sample: %s", name);
-         wav_[count_].Close();
-         return false;
+    uint32_t offset = 0;
+    if (!store_.Allocate(size, offset) &&
+        !(compactStore(store_, sampleMemory_.data()) &&
+          store_.Allocate(size, offset))) {
+        // Something started playing meanwhile so the store couldn't be
+        // compacted, stream the sample from what fits in one block instead
+        size = prepareResident(wav_[count_], store_.Largest());
+        if (!store_.Allocate(size, offset)) {
+            Trace::Error("Not enough memory for sample: %s", name);
+            wav_[count_].Close();
+            return false;
+        }
     }
     
-    // Align?
-    // WAV uses shorts usually?
-    
     // Set buffer pointer in WavFile
-    uint8_t *dest = &sampleMemory_[currentOffset_];
+    uint8_t *dest = &sampleMemory_[offset];
     wav_[count_].SetSampleBuffer((short*)dest);
     
     // Read data
@@ -86,9 +106,5 @@ bool PCSamplePool::loadSample(const char *name) {
     }
     
     count_++;
-    currentOffset_ += size;
-    // Align offset?
-    if (currentOffset_ % 2 != 0) currentOffset_++; 
-    
     return true;
 }
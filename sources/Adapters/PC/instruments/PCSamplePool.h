@@ -19,7 +19,7 @@ protected:
     
 private:
     std::vector<uint8_t> sampleMemory_; 
-    size_t currentOffset_;
+    SampleStore store_;
 };
 
 #endif
@@ -1,18 +1,90 @@
 
 #include <SDL.h>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include "Adapters/PC/platform/platform.h"
 #include "Adapters/PC/system/picoTrackerSystem.h"
 
+// picoTracker --render <project> [--stems] [--seconds N]
+static bool parseRenderOptions(int argc, char *argv[],
+                               OfflineRenderOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--render") && i + 1 < argc) {
+            options.projectName = argv[++i];
+        } else if (!strcmp(argv[i], "--stems")) {
+            options.stems = true;
+        } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            options.maxSeconds = atoi(argv[++i]);
+        }
+    }
+    return options.projectName != nullptr;
+}
+
+// picoTracker --convert <project>
+static const char *parseConvertOption(int argc, char *argv[]) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (!strcmp(argv[i], "--convert")) {
+            return argv[i + 1];
+        }
+    }
+    return nullptr;
+}
+
+// picoTracker --bench-load [--repeat N], returns the number of loads to time
+// or 0 if not asked for
+static int parseBenchLoadOptions(int argc, char *argv[]) {
+    bool bench = false;
+    int repeat = 10;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--bench-load")) {
+            bench = true;
+        } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        }
+    }
+    if (!bench) {
+        return 0;
+    }
+    return repeat > 0 ? repeat : 1;
+}
+
 int main(int argc, char* argv[]) {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) < 0) {
+    OfflineRenderOptions renderOptions;
+    const char *convertProject = parseConvertOption(argc, argv);
+    int benchLoads = parseBenchLoadOptions(argc, argv);
+    bool offline = parseRenderOptions(argc, argv, renderOptions) ||
+                   convertProject != nullptr || benchLoads > 0;
+    if (offline) {
+        // No window or audio device needed, the display still renders into
+        // SDL's dummy video driver
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    }
+
+    Uint32 sdlFlags = offline ? (SDL_INIT_VIDEO | SDL_INIT_TIMER)
+                              : (SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER);
+    if (SDL_Init(sdlFlags) < 0) {
         std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
         return 1;
     }
 
     platform_init();
     
-    picoTrackerSystem::Boot(argc, argv);
+    picoTrackerSystem::Boot(argc, argv, offline);
+
+    if (offline) {
+        int result;
+        if (benchLoads > 0) {
+            result = picoTrackerSystem::BenchmarkLoad(benchLoads);
+        } else if (convertProject) {
+            result = picoTrackerSystem::ConvertProject(convertProject);
+        } else {
+            result = picoTrackerSystem::RenderOffline(renderOptions);
+        }
+        picoTrackerSystem::Shutdown();
+        SDL_Quit();
+        return result;
+    }
     
     // Main loop will be inside picoTrackerSystem::MainLoop or handled here depending on design
     // For now, let's assume we call picoTrackerSystem::MainLoop()
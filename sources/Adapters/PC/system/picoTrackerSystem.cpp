@@ -2,7 +2,13 @@
 #include "picoTrackerSystem.h"
 #include <SDL.h>
 #include <iostream>
+#include <string>
+#include "Application/AppWindow.h"
 #include "Application/Application.h"
+#include "Application/Persistency/PersistencyDocument.h"
+#include "Application/Persistency/PersistencyService.h"
+#include "Application/Model/Table.h"
+#include "Application/Player/Player.h"
 #include "System/Process/SysMutex.h"
 #include "UIFramework/BasicDatas/GUIEvent.h"
 #include "UIFramework/SimpleBaseClasses/GUIWindow.h"
@@ -10,16 +16,18 @@
 bool picoTrackerSystem::invert_ = false;
 unsigned int picoTrackerSystem::lastBeatCount_ = 0;
 EventManager *picoTrackerSystem::eventManager_ = nullptr;
+MainLoopStats picoTrackerSystem::loopStats_;
 
 #include "../filesystem/PCFileSystem.h"
 #include "../display/PCGUIFactory.h"
+#include "../display/PCGUIWindowImp.h"
 #include "../audio/PCAudio.h"
 #include "Services/Midi/MidiService.h"
 
 #include "../timer/PCTimer.h"
 #include "../instruments/PCSamplePool.h"
 
-void picoTrackerSystem::Boot(int argc, char **argv) {
+void picoTrackerSystem::Boot(int argc, char **argv, bool offline) {
     std::cout << "picoTrackerSystem Boot" << std::endl;
     
     // Install System
@@ -39,7 +47,7 @@ void picoTrackerSystem::Boot(int argc, char **argv) {
     AudioSettings hint;
     hint.bufferSize_ = 1024;
     hint.preBufferCount_ = 8;
-    Audio::Install(new PCAudio(hint));
+    Audio::Install(new PCAudio(hint, offline));
     
     // Install SamplePool
     SamplePool::Install(new PCSamplePool());
@@ -56,6 +64,42 @@ void picoTrackerSystem::Shutdown() {
     std::cout << "picoTrackerSystem Shutdown" << std::endl;
 }
 
+// An input event brings the next frame forward so its result shows without
+// waiting for the clock, but no closer than this to the previous frame
+#define MIN_FRAME_INTERVAL 8
+
+static double elapsedMs(Uint64 start, Uint64 end) {
+    return double(end - start) * 1000.0 / double(SDL_GetPerformanceFrequency());
+}
+
+static void dispatchKey(const SDL_Event &e) {
+    GUIEventType type = (e.type == SDL_KEYDOWN) ? ET_PADBUTTONDOWN : ET_PADBUTTONUP;
+    int button = EPBT_INVALID;
+
+    switch(e.key.keysym.sym) {
+        case SDLK_LEFT: button = EPBT_LEFT; break;
+        case SDLK_RIGHT: button = EPBT_RIGHT; break;
+        case SDLK_UP: button = EPBT_UP; break;
+        case SDLK_DOWN: button = EPBT_DOWN; break;
+        case SDLK_z: button = EPBT_A; break;
+        case SDLK_x: button = EPBT_B; break;
+        case SDLK_RETURN: button = EPBT_START; break;
+        case SDLK_LSHIFT: button = EPBT_SELECT; break;
+        case SDLK_a: button = EPBT_L; break;
+        case SDLK_s: button = EPBT_R; break;
+    }
+
+    if (button != EPBT_INVALID) {
+         GUIEvent event(button, type, SDL_GetTicks(), false, false, false);
+         Application::GetInstance()->GetWindow()->PushEvent(event);
+    }
+}
+
+// The loop sleeps in SDL_WaitEventTimeout until the next frame is due or an
+// event arrives: input, the flush requests the player sends through
+// PCGUIWindowImp::Invalidate, or the window needing to be shown again. Frames
+// run the window clock at the PICO_CLOCK_HZ rate of the device, and only
+// upload what they drew
 int picoTrackerSystem::MainLoop() {
     std::cout << "picoTrackerSystem MainLoop Start" << std::endl;
     bool quit = false;
@@ -67,64 +111,360 @@ int picoTrackerSystem::MainLoop() {
         return 1;
     }
     
-    // Check window once
-    if (!app->GetWindow()) {
+    GUIWindow *window = app->GetWindow();
+    if (!window) {
          std::cout << "Application Window is NULL!" << std::endl;
+         return 1;
     }
 
+    loopStats_ = MainLoopStats();
+    Uint64 loopStart = SDL_GetPerformanceCounter();
+    Uint32 lastFrame = SDL_GetTicks();
+    Uint32 nextFrame = lastFrame;
+
     while (!quit) {
-        while (SDL_PollEvent(&e) != 0) {
+        Sint32 timeout = (Sint32)(nextFrame - SDL_GetTicks());
+        Uint64 waitStart = SDL_GetPerformanceCounter();
+        int gotEvent = SDL_WaitEventTimeout(&e, timeout > 0 ? timeout : 0);
+        loopStats_.idleMs += elapsedMs(waitStart, SDL_GetPerformanceCounter());
+
+        // Handle everything that queued up before drawing
+        while (gotEvent) {
             if (e.type == SDL_QUIT) {
                 quit = true;
             } else if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
-                GUIEventType type = (e.type == SDL_KEYDOWN) ? ET_PADBUTTONDOWN : ET_PADBUTTONUP;
-                int button = EPBT_INVALID;
-                
-                switch(e.key.keysym.sym) {
-                    case SDLK_LEFT: button = EPBT_LEFT; break;
-                    case SDLK_RIGHT: button = EPBT_RIGHT; break;
-                    case SDLK_UP: button = EPBT_UP; break;
-                    case SDLK_DOWN: button = EPBT_DOWN; break;
-                    case SDLK_z: button = EPBT_A; break;
-                    case SDLK_x: button = EPBT_B; break;
-                    case SDLK_RETURN: button = EPBT_START; break;
-                    case SDLK_LSHIFT: button = EPBT_SELECT; break;
-                    case SDLK_a: button = EPBT_L; break;
-                    case SDLK_s: button = EPBT_R; break;
-                }
-                
-                if (button != EPBT_INVALID) {
-                     GUIEvent event(button, type, SDL_GetTicks(), false, false, false);
-                     Application::GetInstance()->GetWindow()->PushEvent(event);
-                }
-                
-                // Also handle special keys like Escape for quit?
-                if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) {
-                     // Maybe bring up menu or quit?
+                dispatchKey(e);
+                Uint32 early = lastFrame + MIN_FRAME_INTERVAL;
+                if ((Sint32)(early - nextFrame) < 0) {
+                    nextFrame = early;
                 }
+            } else if (PCGUIWindowImp::IsFlushEvent(e)) {
+                PCGUIWindowImp::ProcessFlush();
+            } else if (e.type == SDL_WINDOWEVENT &&
+                       e.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                PCGUIWindowImp::Present();
+            }
+            gotEvent = SDL_PollEvent(&e);
+        }
+
+        Uint32 now = SDL_GetTicks();
+        if (quit || (Sint32)(now - nextFrame) < 0) {
+            continue;
+        }
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        window->ClockTick(); // animation update and flush of what changed
+        double frameMs = elapsedMs(frameStart, SDL_GetPerformanceCounter());
+
+        loopStats_.frames++;
+        loopStats_.lastFrameMs = frameMs;
+        loopStats_.totalFrameMs += frameMs;
+        if (frameMs > loopStats_.maxFrameMs) {
+            loopStats_.maxFrameMs = frameMs;
+        }
+
+        // Frames that fall behind are dropped rather than run back to back
+        lastFrame = now;
+        nextFrame += PICO_CLOCK_INTERVAL;
+        if ((Sint32)(nextFrame - now) <= 0) {
+            nextFrame = now + PICO_CLOCK_INTERVAL;
+        }
+    }
+    loopStats_.runMs = elapsedMs(loopStart, SDL_GetPerformanceCounter());
+
+    std::cout << "Main loop: " << loopStats_.frames << " frames, "
+              << loopStats_.AverageFrameMs() << "ms average, "
+              << loopStats_.maxFrameMs << "ms max, "
+              << loopStats_.IdlePercent() << "% idle" << std::endl;
+    return 0;
+}
+
+const MainLoopStats &picoTrackerSystem::GetMainLoopStats() {
+    return loopStats_;
+}
+
+static bool readWholeFile(const std::string &path, std::string &content) {
+    auto fp = FileSystem::GetInstance()->Open(path.c_str(), "r");
+    if (!fp) {
+        return false;
+    }
+    char buffer[4096];
+    int len;
+    content.clear();
+    while ((len = fp->Read(buffer, sizeof(buffer))) > 0) {
+        content.append(buffer, len);
+    }
+    return true;
+}
+
+int picoTrackerSystem::ConvertProject(const char *projectName) {
+    Application *app = Application::GetInstance();
+    AppWindow *window = (AppWindow *)app->GetWindow();
+    PersistencyService *persist = PersistencyService::GetInstance();
+    if (!window) {
+        std::cerr << "Convert: application not booted offline" << std::endl;
+        return 1;
+    }
+
+    if (window->LoadProject(projectName) != AppWindow::LOAD_OK) {
+        std::cerr << "Convert: failed to load project '" << projectName << "'"
+                  << std::endl;
+        return 1;
+    }
+    std::cout << "Loaded '" << projectName << "' from "
+              << (persist->LoadedBinary() ? "binary" : "XML") << std::endl;
+
+    // Saving writes both formats
+    if (persist->Save(projectName, "", false) != PERSIST_SAVED) {
+        std::cerr << "Convert: failed to save project" << std::endl;
+        return 1;
+    }
+    window->CloseProject();
+
+    if (window->LoadProject(projectName) != AppWindow::LOAD_OK ||
+        !persist->LoadedBinary()) {
+        std::cerr << "Convert: binary project didn't load back" << std::endl;
+        return 1;
+    }
+
+    // The project loaded from the binary file must save to the same XML as
+    // the one the binary file was saved with
+    std::string dir = std::string(PROJECTS_DIR) + "/" + projectName + "/";
+    std::string roundTripPath = dir + "roundtrip.xml";
+    if (persist->ExportXml(roundTripPath.c_str()) != PERSIST_SAVED) {
+        std::cerr << "Convert: failed to export XML" << std::endl;
+        return 1;
+    }
+    std::string xml, roundTrip, binary;
+    bool read = readWholeFile(dir + PROJECT_DATA_FILE, xml) &&
+                readWholeFile(roundTripPath, roundTrip) &&
+                readWholeFile(dir + PROJECT_BINARY_FILE, binary);
+    FileSystem::GetInstance()->DeleteFile(roundTripPath.c_str());
+    if (!read) {
+        std::cerr << "Convert: failed to read back project files" << std::endl;
+        return 1;
+    }
+
+    std::cout << "XML " << xml.size() << " bytes, binary " << binary.size()
+              << " bytes" << std::endl;
+    if (xml != roundTrip) {
+        std::cerr << "Convert: binary round trip differs from XML" << std::endl;
+        return 1;
+    }
+    std::cout << "Binary round trip matches XML" << std::endl;
+    return 0;
+}
+
+// The reference project's XML goes to a scratch file at the root, not to a
+// project of its own, and is deleted once timed
+#define BENCH_XML_PATH "/.bench-load.xml"
+
+// Fills the whole song with chains, phrases and tables from a fixed sequence,
+// so that every run benchmarks the same project
+static void fillBenchmarkProject(Project *project) {
+    static const FourCC::enum_type commands[] = {
+        FourCC::InstrumentCommandVolume, FourCC::InstrumentCommandPan,
+        FourCC::InstrumentCommandFilterCut,
+        FourCC::InstrumentCommandPitchFineTune,
+        FourCC::InstrumentCommandArpeggiator};
+    const int commandCount = sizeof(commands) / sizeof(commands[0]);
+    uint32_t seed = 1;
+    auto next = [&seed](uint32_t range) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % range;
+    };
+
+    Song &song = project->song_;
+    for (int i = 0; i < SONG_CHANNEL_COUNT * SONG_ROW_COUNT; i++) {
+        song.data_[i] = i % CHAIN_COUNT;
+    }
+    for (int chain = 0; chain < CHAIN_COUNT; chain++) {
+        song.chain_.SetUsed(chain);
+        for (int i = 0; i < PHRASES_PER_CHAIN; i++) {
+            int pos = chain * PHRASES_PER_CHAIN + i;
+            song.chain_.data_[pos] = pos % PHRASE_COUNT;
+            song.chain_.transpose_[pos] = next(12);
+        }
+    }
+    for (int phrase = 0; phrase < PHRASE_COUNT; phrase++) {
+        song.phrase_.SetUsed(phrase);
+        for (int i = 0; i < STEPS_PER_PHRASE; i++) {
+            int pos = phrase * STEPS_PER_PHRASE + i;
+            song.phrase_.note_[pos] = 36 + next(48);
+            song.phrase_.instr_[pos] = next(MAX_SAMPLEINSTRUMENT_COUNT);
+            song.phrase_.cmd1_[pos] = commands[next(commandCount)];
+            song.phrase_.param1_[pos] = next(0x100);
+            song.phrase_.cmd2_[pos] = commands[next(commandCount)];
+            song.phrase_.param2_[pos] = next(0x100);
+        }
+    }
+    TableHolder *tables = TableHolder::GetInstance();
+    for (int t = 0; t < TABLE_COUNT; t++) {
+        tables->SetUsed(t);
+        Table &table = tables->GetTable(t);
+        for (int i = 0; i < TABLE_STEPS; i++) {
+            table.cmd1_[i] = commands[next(commandCount)];
+            table.param1_[i] = next(0x100);
+            table.cmd2_[i] = commands[next(commandCount)];
+            table.param2_[i] = next(0x100);
+            table.cmd3_[i] = commands[next(commandCount)];
+            table.param3_[i] = next(0x100);
+        }
+    }
+}
+
+// Feeds the XML file char by char to yxml, the way PersistencyDocument
+// parses it, and counts its elements. Returns -1 on a parse error
+template <typename NextChar> static int parseXml(NextChar nextChar) {
+    static yxml_t state;
+    static char stack[1024];
+    yxml_init(&state, stack, sizeof(stack));
+    int elements = 0;
+    int c;
+    while ((c = nextChar()) != EOF) {
+        yxml_ret_t r = yxml_parse(&state, c);
+        if (r < 0) {
+            return -1;
+        }
+        elements += (r == YXML_ELEMSTART);
+    }
+    return yxml_eof(&state) == YXML_OK ? elements : -1;
+}
+
+// Reads in PERSISTENCY_READ_BUFFER_SIZE blocks, as PersistencyDocument does
+static int parseBlocks(const char *path) {
+    static char buffer[PERSISTENCY_READ_BUFFER_SIZE];
+    auto fp = FileSystem::GetInstance()->Open(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    int len = 0, pos = 0;
+    return parseXml([&]() {
+        if (pos == len) {
+            len = fp->Read(buffer, sizeof(buffer));
+            pos = 0;
+            if (len <= 0) {
+                len = 0;
+                return EOF;
             }
         }
-        
-        // Trigger Redraw/Update if needed? 
-        // Application::GetInstance()->GetWindow()->Invalidate(); // Only invalidates if needed
-        // But for PC, Flush() draws to screen. 
-        // We should call Flush() periodically or when invalidated.
-        // SDL-based Flush() is in PCGUIWindowImp::Flush().
-        // Does the framework call Flush()?
-        // Usually EventManager loop calls Flush() on dirty.
-        // Here we don't have EventManager loop.
-        
-        // Update Application/Window logic
-        if (Application::GetInstance() && Application::GetInstance()->GetWindow()) {
-            Application::GetInstance()->GetWindow()->AnimationUpdate();
-            Application::GetInstance()->GetWindow()->Update(false); // Update logic, redraw if dirty
-             
-             // Then Flush to screen
-            Application::GetInstance()->GetWindow()->Flush();
+        return (int)(unsigned char)buffer[pos++];
+    });
+}
+
+// Reads one char per call to the file, as the reader did before blocks
+static int parseChars(const char *path) {
+    auto fp = FileSystem::GetInstance()->Open(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    return parseXml([&]() { return fp->GetC(); });
+}
+
+// Parses the XML file repeat times with one of the readers, false if a parse
+// fails or doesn't see the expected number of elements
+static bool timeParses(int repeat, int (*parse)(const char *), int elements,
+                       const char *label) {
+    double total = 0, min = 0, max = 0;
+    for (int i = 0; i < repeat; i++) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        int parsed = parse(BENCH_XML_PATH);
+        double ms = elapsedMs(start, SDL_GetPerformanceCounter());
+        if (parsed != elements) {
+            std::cerr << "Load benchmark: " << label << " parse failed"
+                      << std::endl;
+            return false;
         }
-        
-        SDL_Delay(10); // Prevent 100% CPU
+        total += ms;
+        min = (i == 0 || ms < min) ? ms : min;
+        max = (ms > max) ? ms : max;
     }
+    std::cout << label << ": " << total / repeat << " ms average, " << min
+              << " min, " << max << " max (" << repeat << " parses)"
+              << std::endl;
+    return true;
+}
+
+int picoTrackerSystem::BenchmarkLoad(int repeat) {
+    Application *app = Application::GetInstance();
+    AppWindow *window = (AppWindow *)app->GetWindow();
+    PersistencyService *persist = PersistencyService::GetInstance();
+    FileSystem *fs = FileSystem::GetInstance();
+    if (!window) {
+        std::cerr << "Load benchmark: application not booted offline"
+                  << std::endl;
+        return 1;
+    }
+
+    // The reference project starts out as a new one and only its XML is
+    // written out
+    if (persist->CreateProject() != PERSIST_SAVED ||
+        window->LoadProject(UNNAMED_PROJECT_NAME) != AppWindow::LOAD_OK) {
+        std::cerr << "Load benchmark: failed to create project" << std::endl;
+        return 1;
+    }
+    fillBenchmarkProject(Player::GetInstance()->GetProject());
+    PersistencyResult exported = persist->ExportXml(BENCH_XML_PATH);
+    window->CloseProject();
+    std::string xml;
+    if (exported != PERSIST_SAVED || !readWholeFile(BENCH_XML_PATH, xml)) {
+        std::cerr << "Load benchmark: failed to write project XML"
+                  << std::endl;
+        fs->DeleteFile(BENCH_XML_PATH);
+        return 1;
+    }
+
+    // Both readers must see the same document
+    int elements = parseBlocks(BENCH_XML_PATH);
+    std::cout << "Project XML: " << xml.size() << " bytes, " << elements
+              << " elements" << std::endl;
+    bool timed = elements > 0 &&
+                 timeParses(repeat, parseBlocks, elements, "Block reads") &&
+                 timeParses(repeat, parseChars, elements, "GetC reads");
+    fs->DeleteFile(BENCH_XML_PATH);
+    return timed ? 0 : 1;
+}
+
+int picoTrackerSystem::RenderOffline(const OfflineRenderOptions &options) {
+    Application *app = Application::GetInstance();
+    AppWindow *window = (AppWindow *)app->GetWindow();
+    PCAudio *audio = (PCAudio *)Audio::GetInstance();
+    PCOfflineAudioDriver *driver = audio->GetOfflineDriver();
+    if (!window || !driver) {
+        std::cerr << "Offline render: application not booted offline" << std::endl;
+        return 1;
+    }
+
+    // The window defers loading to its first AnimationUpdate(), which never
+    // runs headless so we load the requested project directly
+    if (window->LoadProject(options.projectName) != AppWindow::LOAD_OK) {
+        std::cerr << "Offline render: failed to load project '"
+                  << options.projectName << "'" << std::endl;
+        return 1;
+    }
+
+    Player *player = Player::GetInstance();
+    player->Start(PM_SONG, false, options.stems ? MSM_FILESPLIT : MSM_FILE,
+                  true);
+
+    uint64_t maxFrames = uint64_t(options.maxSeconds) * audio->GetSampleRate();
+    Uint64 start = SDL_GetPerformanceCounter();
+    while (player->IsRunning() && driver->GetRenderedFrames() < maxFrames) {
+        driver->Pump();
+    }
+    // Stopping closes the render files when we hit the time limit
+    if (player->IsRunning()) {
+        player->Stop();
+    }
+    double wallTime = double(SDL_GetPerformanceCounter() - start) /
+                      double(SDL_GetPerformanceFrequency());
+
+    double audioTime =
+        double(driver->GetRenderedFrames()) / audio->GetSampleRate();
+    std::cout << "Rendered " << audioTime << "s of audio in " << wallTime
+              << "s (" << (wallTime > 0 ? audioTime / wallTime : 0)
+              << "x real time)" << std::endl;
+    std::cout << "Mix checksum " << std::hex << driver->GetChecksum()
+              << std::dec << std::endl;
     return 0;
 }
 
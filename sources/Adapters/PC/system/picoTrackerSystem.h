@@ -6,11 +6,40 @@
 #include "System/System/System.h"
 #include "UIFramework/SimpleBaseClasses/EventManager.h"
 
+// Options for headless rendering of a project (--render on the command line)
+struct OfflineRenderOptions {
+  const char *projectName = nullptr;
+  bool stems = false;    // per channel bus files instead of the mixdown
+  int maxSeconds = 600;  // safety net for songs that never reach their end
+};
+
+// Counters of the desktop main loop. Frames are the window clock ticks, idle
+// is the time spent waiting for events
+struct MainLoopStats {
+  uint32_t frames = 0;
+  double lastFrameMs = 0;
+  double maxFrameMs = 0;
+  double totalFrameMs = 0;
+  double idleMs = 0;
+  double runMs = 0; // set when the loop ends
+  double AverageFrameMs() const { return frames ? totalFrameMs / frames : 0; }
+  double IdlePercent() const { return runMs > 0 ? 100 * idleMs / runMs : 0; }
+};
+
 class picoTrackerSystem : public System {
 public:
-  static void Boot(int argc, char **argv);
+  static void Boot(int argc, char **argv, bool offline = false);
   static void Shutdown();
   static int MainLoop();
+  static const MainLoopStats &GetMainLoopStats();
+  static int RenderOffline(const OfflineRenderOptions &options);
+  // Saves a project in both formats and checks the binary one loads back to
+  // the same project (--convert on the command line)
+  static int ConvertProject(const char *projectName);
+  // Times parsing the XML of a reference project with every song row, chain,
+  // phrase and table in use, read in blocks and read char by char
+  // (--bench-load on the command line)
+  static int BenchmarkLoad(int repeat);
 
 public: // System implementation
   virtual unsigned long GetClock();
@@ -31,5 +60,6 @@ private:
   static bool invert_;
   static unsigned int lastBeatCount_;
   static EventManager *eventManager_;
+  static MainLoopStats loopStats_;
 };
 #endif
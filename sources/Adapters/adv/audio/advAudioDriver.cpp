@@ -155,22 +155,17 @@ void advAudioDriver::StopDriver() {
 void advAudioDriver::OnChunkDone() {
   if (isPlaying_) {
 
-    // We got an IRQ so we know we finished playing from poolPlayPosition_
-    // We mark it as empty and inspect the next buffer, if the buffer is not
-    // empty, it means thread 2 finished processing that buffer and there are no
-    // underruns Otherwise, we send a small blank buffer and wait for the other
-    // thread to finish
-    pool_[poolPlayPosition_].empty_ = true;
-
-    int next = (poolPlayPosition_ + 1) % SOUND_BUFFER_COUNT;
-    if (pool_[next].empty_) {
+    // We got an IRQ so we know we finished playing the current buffer. If
+    // thread 2 finished processing the next one there are no underruns,
+    // otherwise we send a small blank buffer and wait for the other thread to
+    // finish
+    AudioBufferData *next = nextPlayBuffer();
+    if (!next) {
       HAL_SAI_Transmit_DMA(&hsai_BlockA1, (uint8_t *)miniBlank_,
                            MINI_BLANK_SIZE);
     } else {
-      poolPlayPosition_ = next;
-      HAL_SAI_Transmit_DMA(&hsai_BlockA1,
-                           (uint8_t *)pool_[poolPlayPosition_].buffer_,
-                           pool_[poolPlayPosition_].size_ / 2);
+      HAL_SAI_Transmit_DMA(&hsai_BlockA1, (uint8_t *)next->buffer_,
+                           next->size_ / 2);
     }
 
     // Finally we allow core1 to calculate an additional buffer
@@ -65,7 +65,158 @@ static inline uint16_t abgr8888_to_bgr565(uint32_t color) {
   uint16_t r = (uint16_t)((color >> 3) & 0x1F);
   return (uint16_t)((b << 11) | (g << 5) | r);
 }
-void display_set_font_index(uint8_t idx) { ui_font_index = idx; }
+
+// Cache of glyphs already blended with the colors of a cell, so drawing one
+// is a plain DMA2D copy to the framebuffer. A cell is keyed by its character
+// and colors byte, and can go in any of the GLYPH_CACHE_WAYS slots of its set,
+// replacing the least recently used one
+#define GLYPH_CACHE_SETS 64
+#define GLYPH_CACHE_WAYS 4
+#define GLYPH_CACHE_SIZE (GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS)
+#define GLYPH_NONE 0xFFFF
+
+__attribute__((section(".FRAMEBUFFER"))) __attribute__((aligned(32)))
+static uint16_t glyph_tiles[GLYPH_CACHE_SIZE][CHAR_HEIGHT * CHAR_WIDTH];
+static uint16_t glyph_keys[GLYPH_CACHE_SIZE];
+static uint32_t glyph_used[GLYPH_CACHE_SIZE];
+static uint32_t glyph_clock = 0;
+static uint32_t glyph_hits = 0;
+static uint32_t glyph_misses = 0;
+static bool glyphs_valid = false;
+
+static void invalidate_glyphs() {
+  for (int i = 0; i < GLYPH_CACHE_SIZE; i++) {
+    glyph_keys[i] = GLYPH_NONE;
+  }
+  glyphs_valid = true;
+}
+
+// Drops the glyphs drawn with a palette entry
+static void invalidate_glyph_color(int color_index) {
+  for (int i = 0; i < GLYPH_CACHE_SIZE; i++) {
+    uint8_t cell_colors = glyph_keys[i] & 0xff;
+    if (glyph_keys[i] != GLYPH_NONE && ((cell_colors >> 4) == color_index ||
+                                        (cell_colors & 0xf) == color_index)) {
+      glyph_keys[i] = GLYPH_NONE;
+    }
+  }
+}
+
+// The DMA2D either blends a glyph into a tile of the cache or copies a tile to
+// the framebuffer, it gets switched between the two as needed
+enum { DMA2D_UNKNOWN, DMA2D_BLENDING, DMA2D_COPYING };
+static int dma2d_mode = DMA2D_UNKNOWN;
+static uint32_t dma2d_fg_color = 0;
+
+static void use_blending(uint32_t fg_color) {
+  if (dma2d_mode != DMA2D_BLENDING) {
+    hdma2d.Init.Mode = DMA2D_M2M_BLEND_BG;
+    hdma2d.Init.OutputOffset = 0;
+    HAL_DMA2D_Init(&hdma2d);
+    hdma2d.LayerCfg[1].InputColorMode = DMA2D_INPUT_A8;
+    dma2d_mode = DMA2D_BLENDING;
+  } else if (fg_color == dma2d_fg_color) {
+    return;
+  }
+  // The FG color is taken from the layer config
+  hdma2d.LayerCfg[1].InputAlpha = fg_color;
+  HAL_DMA2D_ConfigLayer(&hdma2d, 1);
+  dma2d_fg_color = fg_color;
+}
+
+static void use_copying() {
+  if (dma2d_mode == DMA2D_COPYING) {
+    return;
+  }
+  // Tiles are contiguous, the framebuffer needs a stride of
+  // DISPLAY_WIDTH - CHAR_WIDTH for each line
+  hdma2d.Init.Mode = DMA2D_M2M;
+  hdma2d.Init.OutputOffset = DISPLAY_WIDTH - CHAR_WIDTH;
+  HAL_DMA2D_Init(&hdma2d);
+  hdma2d.LayerCfg[1].InputColorMode = DMA2D_INPUT_RGB565;
+  HAL_DMA2D_ConfigLayer(&hdma2d, 1);
+  dma2d_mode = DMA2D_COPYING;
+}
+
+// Copies of a row waiting for its missing glyphs to be blended, tiles used
+// since pending_clock must stay in the cache until they're done
+static const uint16_t *pending_tiles[TEXT_WIDTH];
+static uint16_t *pending_dests[TEXT_WIDTH];
+static int pending_count = 0;
+static uint32_t pending_clock = 0;
+
+static void copy_pending() {
+  if (pending_count > 0) {
+    use_copying();
+    for (int i = 0; i < pending_count; i++) {
+      HAL_DMA2D_Start(&hdma2d, (uint32_t)pending_tiles[i],
+                      (uint32_t)pending_dests[i], CHAR_WIDTH, CHAR_HEIGHT);
+      HAL_DMA2D_PollForTransfer(&hdma2d, HAL_MAX_DELAY);
+    }
+    pending_count = 0;
+  }
+  pending_clock = glyph_clock;
+}
+
+static const uint16_t *glyph_tile(uint8_t character, uint8_t cell_colors) {
+  if (!glyphs_valid) {
+    invalidate_glyphs();
+  }
+  uint16_t key = (character << 8) | cell_colors;
+  int set = ((character * 31) ^ cell_colors) % GLYPH_CACHE_SETS;
+  uint16_t *keys = glyph_keys + set * GLYPH_CACHE_WAYS;
+  uint32_t *used = glyph_used + set * GLYPH_CACHE_WAYS;
+  glyph_clock++;
+
+  int victim = 0;
+  for (int way = 0; way < GLYPH_CACHE_WAYS; way++) {
+    if (keys[way] == key) {
+      glyph_hits++;
+      used[way] = glyph_clock;
+      return glyph_tiles[set * GLYPH_CACHE_WAYS + way];
+    }
+    if (keys[way] == GLYPH_NONE) {
+      victim = way;
+      used[way] = 0;
+    } else if (used[way] < used[victim]) {
+      victim = way;
+    }
+  }
+  glyph_misses++;
+  if (used[victim] > pending_clock) {
+    // every way of the set is waiting to be copied
+    copy_pending();
+  }
+
+  /* Perpheral is configured in memory to memory mode with blending and fixed
+   * background color. We take the FG color from the layer config, BG color is
+   * defined as a static address with the color in it, so this works as a
+   * register to memory DMA2D mode.
+   */
+  uint16_t *tile = glyph_tiles[set * GLYPH_CACHE_WAYS + victim];
+  use_blending(palette[cell_colors >> 4]);
+  HAL_DMA2D_BlendingStart(&hdma2d, (uint32_t)&FONT[character][0][0],
+                          palette[cell_colors & 0xf], (uint32_t)tile,
+                          CHAR_WIDTH, CHAR_HEIGHT);
+  // We could check for return status here, but if it's not returning HAL_OK
+  // here we have big problems
+  HAL_DMA2D_PollForTransfer(&hdma2d, HAL_MAX_DELAY);
+  keys[victim] = key;
+  used[victim] = glyph_clock;
+  return tile;
+}
+
+void display_glyph_cache_stats(uint32_t *hits, uint32_t *misses) {
+  *hits = glyph_hits;
+  *misses = glyph_misses;
+}
+
+void display_set_font_index(uint8_t idx) {
+  if (idx != ui_font_index) {
+    ui_font_index = idx;
+    invalidate_glyphs();
+  }
+}
 
 void display_set_cursor(uint8_t x, uint8_t y) {
   cursor_x = x;
@@ -105,20 +256,18 @@ void display_clear(color_t color) {
 }
 
 void display_set_palette_color(int idx, uint16_t rgb565_color) {
-  palette[idx] = rgb565_to_abgr8888(rgb565_color);
+  uint32_t color = rgb565_to_abgr8888(rgb565_color);
+  if (palette[idx] != color) {
+    palette[idx] = color;
+    invalidate_glyph_color(idx);
+  }
 }
 
-// Draw changed detects subregions of the display that changed and that are of
-// same parameters (BG and FG colors)
+// Draw changed detects subregions of the display that changed, cells of a
+// region can have any colors as each is drawn from its cached glyph
 void display_draw_changed() {
-  uint32_t bg_color;
-  uint32_t fg_color;
   for (int idx = 0; idx < TEXT_HEIGHT * TEXT_WIDTH; idx++) {
     if (TestBit(changed, idx)) {
-      // get foreground and background colors of the area
-      fg_color = palette[colors[idx] >> 4];
-      bg_color = palette[colors[idx] & 0xf];
-
       ClearBit(changed, idx);
       // check adjacent in order to find bigger rectangle
       uint16_t y = idx / TEXT_WIDTH;
@@ -128,9 +277,7 @@ void display_draw_changed() {
       // first pass tests the height
       for (int probe_y = y + 1; probe_y < TEXT_HEIGHT; probe_y++) {
         int probe_idx = probe_y * TEXT_WIDTH + x;
-        if (TestBit(changed, probe_idx) &&
-            fg_color == palette[colors[probe_idx] >> 4] &&
-            bg_color == palette[colors[probe_idx] & 0xf]) {
+        if (TestBit(changed, probe_idx)) {
           ClearBit(changed, probe_idx);
           height++;
           continue;
@@ -144,9 +291,7 @@ void display_draw_changed() {
         for (int probe_y = y; probe_y < y + height; probe_y++) {
           // if we don't get to max height, then abort
           int probe_idx = probe_y * TEXT_WIDTH + probe_x;
-          if (!TestBit(changed, probe_idx) ||
-              fg_color != palette[colors[probe_idx] >> 4] ||
-              bg_color != palette[colors[probe_idx] & 0xf]) {
+          if (!TestBit(changed, probe_idx)) {
             // undo last column
             for (int undo_y = y; undo_y < probe_y; undo_y++) {
               SetBit(changed, undo_y * TEXT_WIDTH + probe_x);
@@ -169,41 +314,19 @@ void display_draw_screen() {
 }
 
 void display_draw_region(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
-  // Each region share the same FG and BG color, so we defined at the start and
-  // reconfigure the FG layer for the given text color
-  uint32_t idx = y * TEXT_WIDTH + x;
-  uint32_t bg_color = palette[colors[idx] & 0xF];
-  uint32_t fg_color = palette[colors[idx] >> 4];
-
-  hdma2d.LayerCfg[1].InputAlpha = fg_color;
-  HAL_DMA2D_ConfigLayer(&hdma2d, 1);
-
-  // Draw each character
   for (uint8_t h = y; h < y + height; h++) {
+    // Tiles of a row are gathered first so the DMA2D switches between blending
+    // the missing ones and copying them all once
     for (uint8_t w = x; w < x + width; w++) {
-
-      uint8_t char_index = screen[h * TEXT_WIDTH + w];
-      const uint8_t *glyph = &FONT[char_index][0][0];
-
-      uint16_t *dest = (uint16_t *)framebuffer +
-                       (h * CHAR_HEIGHT * DISPLAY_WIDTH) +
-                       (w * CHAR_WIDTH + OFFSET);
-
-      /* Most of what happens here is defined on the peripheral configuration.
-       * Perpheral is configured in memory to memory mode with blending and
-       * fixed background color. We take the FG color from the layer config,
-       * which we have to update to each region. BG color is defined as a static
-       * address with the color in it, so this works as a register to memory
-       * DMA2D mode. Char array is contiguous in memory for a single char, but
-       * frame buffer needs to have a stride if DISPLAY_WIDTH - CHAR_WIDTH
-       * for each line rendered, this is also configured in the peripheral.
-       */
-      HAL_DMA2D_BlendingStart(&hdma2d, (uint32_t)glyph, bg_color,
-                              (uint32_t)dest, CHAR_WIDTH, CHAR_HEIGHT);
-      // We could check for return status here, but if it's not returning HAL_OK
-      // here we have big problems
-      HAL_DMA2D_PollForTransfer(&hdma2d, HAL_MAX_DELAY);
+      uint32_t idx = h * TEXT_WIDTH + w;
+      const uint16_t *tile = glyph_tile(screen[idx], colors[idx]);
+      pending_tiles[pending_count] = tile;
+      pending_dests[pending_count] = (uint16_t *)framebuffer +
+                                     (h * CHAR_HEIGHT * DISPLAY_WIDTH) +
+                                     (w * CHAR_WIDTH + OFFSET);
+      pending_count++;
     }
+    copy_pending();
   }
 }
 
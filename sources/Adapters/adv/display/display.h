@@ -59,6 +59,9 @@ void display_draw_sub_region(uint8_t x, uint8_t y, uint8_t width,
                              uint8_t height);
 
 uint32_t rgb565_to_abgr8888(uint16_t rgb565);
+// Lookups of the glyph cache that found the glyph already blended, and that
+// had to blend it
+void display_glyph_cache_stats(uint32_t *hits, uint32_t *misses);
 
 #ifdef __cplusplus
 }
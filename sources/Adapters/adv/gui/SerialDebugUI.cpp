@@ -8,10 +8,12 @@
 
 #include "SerialDebugUI.h"
 #include "../system/advSystem.h"
+#include "Adapters/adv/display/display.h"
 #include "Adapters/adv/audio/record.h"
 #include "Application/Model/Config.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/I_File.h"
+#include "System/Profiler/AudioStageProfiler.h"
 #include "System/System/System.h"
 #include "main.h"
 #include <etl/string.h>
@@ -149,8 +151,13 @@ void SerialDebugUI::dispatchCmd(char *input) {
     StartRecording(filename, 1, 0);
   } else if (strcmp(cmd, "stoprec") == 0) {
     StopRecording();
+  } else if (strcmp(cmd, "perf") == 0) {
+    audioPerf(arg);
+  } else if (strcmp(cmd, "glyphs") == 0) {
+    glyphCacheStats();
   } else if (strcmp(cmd, "help") == 0) {
-    Trace::Log("SERIALDEBUG", "cat, ls, rm, mkdir, rmdir, save, battery, help");
+    Trace::Log("SERIALDEBUG",
+               "cat, ls, rm, mkdir, rmdir, save, battery, perf, glyphs, help");
   } else {
     Trace::Log("SERIALDEBUG", "unknown command");
   }
@@ -269,3 +276,25 @@ void SerialDebugUI::readBattery() {
     HAL_UART_Transmit(&huart1, (uint8_t *)buf, len, 1 * 1000);
   }
 }
+
+void SerialDebugUI::audioPerf(const char *arg) {
+#ifdef AUDIO_STAGE_PROFILING
+  if (arg && strcmp(arg, "reset") == 0) {
+    AudioStageProfiler::RequestReset();
+    return;
+  }
+  AudioStageProfiler::Dump();
+#else
+  Trace::Log("SERIALDEBUG", "build with AUDIO_STAGE_PROFILING to use perf");
+#endif
+}
+
+void SerialDebugUI::glyphCacheStats() {
+  uint32_t hits;
+  uint32_t misses;
+  display_glyph_cache_stats(&hits, &misses);
+  uint32_t total = hits + misses;
+  Trace::Log("SERIALDEBUG", "glyph cache hits:%lu misses:%lu rate:%lu%%",
+             (unsigned long)hits, (unsigned long)misses,
+             (unsigned long)(total ? (uint64_t)hits * 100 / total : 0));
+}
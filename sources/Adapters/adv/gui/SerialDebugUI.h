@@ -21,6 +21,8 @@ public:
   void rmdir(const char *path);
   void shutdown();
   void readBattery();
+  void audioPerf(const char *arg);
+  void glyphCacheStats();
 
 private:
   int lp_ = 0;
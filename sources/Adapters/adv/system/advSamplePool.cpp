@@ -7,6 +7,7 @@
  */
 
 #include "advSamplePool.h"
+#include <algorithm>
 #include <cstring>
 #include <utility>
 
@@ -15,10 +16,9 @@ uint8_t sampleStore1[STORE1_SIZE];
 __attribute__((section(".SDRAM1"))) __attribute__((aligned(32)))
 uint8_t sampleStore2[STORE2_SIZE];
 
-uint32_t advSamplePool::writeOffset1_ = 0;
-uint32_t advSamplePool::writeOffset2_ = 0;
-uint32_t advSamplePool::storeLimit1_ = STORE1_SIZE;
-uint32_t advSamplePool::storeLimit2_ = STORE2_SIZE;
+// Sample buffers are kept 4-byte aligned for SDRAM access
+SampleStore advSamplePool::store1_(STORE1_SIZE, 4);
+SampleStore advSamplePool::store2_(STORE2_SIZE, 4);
 
 advSamplePool::advSamplePool() : SamplePool() {}
 
@@ -30,18 +30,21 @@ void advSamplePool::Reset() {
   };
 
   volatile void *dummy = &sampleStore2;
-  // Reset flash erase and write pointers when we close project
-  writeOffset1_ = 0;
-  writeOffset2_ = 0;
+  // Free the stores when we close project
+  store1_.Reset();
+  store2_.Reset();
 };
 
 bool advSamplePool::CheckSampleFits(int sampleSize) {
-  return ((writeOffset1_ + sampleSize) <= storeLimit1_) ||
-         ((writeOffset2_ + sampleSize) <= storeLimit2_);
+  // Samples bigger than the free space are streamed past their preload. The
+  // free space of a store can always be compacted into a single block
+  sampleSize = std::min(sampleSize, SAMPLE_STREAM_PRELOAD_BYTES);
+  return (uint32_t(sampleSize) <= store1_.Available()) ||
+         (uint32_t(sampleSize) <= store2_.Available());
 }
 
 uint32_t advSamplePool::GetAvailableSampleStorageSpace() {
-  return storeLimit1_ - writeOffset1_ + storeLimit2_ - writeOffset2_;
+  return store1_.Available() + store2_.Available();
 }
 
 bool advSamplePool::loadSample(const char *name) {
@@ -59,7 +62,12 @@ bool advSamplePool::loadSample(const char *name) {
   strncpy(nameStore_[count_], name, MAX_INSTRUMENT_FILENAME_LENGTH);
   nameStore_[count_][MAX_INSTRUMENT_FILENAME_LENGTH] = '\0';
   count_++;
-  Load(wav_[count_ - 1]);
+  if (!Load(wav_[count_ - 1])) {
+    count_--;
+    nameStore_[count_][0] = '\0';
+    wav_[count_].Close();
+    return false;
+  }
   wav_[count_ - 1].Close();
 
   return true;
@@ -67,165 +75,105 @@ bool advSamplePool::loadSample(const char *name) {
 
 bool advSamplePool::Load(WavFile &wave) {
 
-  uint32_t fileSize = wave.GetDiskSize(-1);
+  // Samples that don't fit only get their head loaded and stream the rest.
+  // While nothing plays the free space of a store can be compacted
+  bool stopped = canCompact();
+  uint32_t available =
+      stopped ? std::max(store1_.Available(), store2_.Available())
+              : std::max(store1_.Largest(), store2_.Largest());
+  uint32_t fileSize = prepareResident(wave, available);
   Trace::Debug("File size: %i", fileSize);
 
   // Select the sample pool with the least space where it will fit in order to
   // leave the biggest free space for any potential bigger future samples
-  uint32_t *writeOffset = 0;
-  uint8_t *sampleStore;
-
-  if ((writeOffset1_ + fileSize < storeLimit1_) &&
-      (writeOffset2_ + fileSize < storeLimit2_)) {
-    // fits both
-    if ((storeLimit1_ - writeOffset1_) < (storeLimit2_ - writeOffset2_)) {
-      writeOffset = &writeOffset1_;
+  SampleStore *store = nullptr;
+  uint8_t *sampleStore = nullptr;
+  bool fits1 = fileSize <= store1_.Largest();
+  bool fits2 = fileSize <= store2_.Largest();
+  if (fits1 && (!fits2 || store1_.Largest() < store2_.Largest())) {
+    store = &store1_;
+    sampleStore = sampleStore1;
+  } else if (fits2) {
+    store = &store2_;
+    sampleStore = sampleStore2;
+  } else if (fileSize <= store1_.Available() &&
+             compactStore(store1_, sampleStore1)) {
+    store = &store1_;
+    sampleStore = sampleStore1;
+  } else if (fileSize <= store2_.Available() &&
+             compactStore(store2_, sampleStore2)) {
+    store = &store2_;
+    sampleStore = sampleStore2;
+  } else {
+    // Something started playing meanwhile so the stores couldn't be
+    // compacted, stream the sample from what fits in one block instead
+    fileSize =
+        prepareResident(wave, std::max(store1_.Largest(), store2_.Largest()));
+    if (fileSize <= store1_.Largest()) {
+      store = &store1_;
       sampleStore = sampleStore1;
-    } else {
-      writeOffset = &writeOffset2_;
+    } else if (fileSize <= store2_.Largest()) {
+      store = &store2_;
       sampleStore = sampleStore2;
     }
   }
-  // Only one of them can potentially fit the sample
-  else if (writeOffset1_ + fileSize < storeLimit1_) {
-    writeOffset = &writeOffset1_;
-    sampleStore = sampleStore1;
-  } else if (writeOffset2_ + fileSize < storeLimit2_) {
-    writeOffset = &writeOffset2_;
-    sampleStore = sampleStore2;
-  } else {
+
+  uint32_t writeOffset = 0;
+  if (store == nullptr || !store->Allocate(fileSize, writeOffset)) {
     Trace::Error("Sample doesn't fit in available sample storage (need: %i - "
                  "avail: %i) ",
-                 fileSize, storeLimit1_ - writeOffset1_);
+                 fileSize, GetAvailableSampleStorageSpace());
     return false;
   }
 
-  // Ensure 4-byte alignment for SDRAM access at start of each file
-  *writeOffset = (*writeOffset + 3) & ~3;
-
   // Set wave base
-  wave.SetSampleBuffer((short *)(sampleStore + *writeOffset));
+  wave.SetSampleBuffer((short *)(sampleStore + writeOffset));
 
   uint32_t offset = 0;
   uint32_t br = 0;
 
   wave.Rewind();
-  wave.Read(sampleStore + *writeOffset, BUFFER_SIZE, &br);
+  wave.Read(sampleStore + writeOffset,
+            std::min<uint32_t>(BUFFER_SIZE, fileSize), &br);
   while (br > 0) {
     // Trace::Debug("Wrote %i bytes", br);
-    *writeOffset += br;
-    wave.Read(sampleStore + *writeOffset, BUFFER_SIZE, &br);
+    writeOffset += br;
+    offset += br;
+    wave.Read(sampleStore + writeOffset,
+              std::min<uint32_t>(BUFFER_SIZE, fileSize - offset), &br);
   }
   return true;
 };
 
+SampleStore *advSamplePool::storeOf(void *buffer, uint8_t *&base) {
+  auto *address = static_cast<uint8_t *>(buffer);
+  if (address >= sampleStore1 && address < sampleStore1 + STORE1_SIZE) {
+    base = sampleStore1;
+    return &store1_;
+  }
+  if (address >= sampleStore2 && address < sampleStore2 + STORE2_SIZE) {
+    base = sampleStore2;
+    return &store2_;
+  }
+  return nullptr;
+}
+
 bool advSamplePool::unloadSample(uint32_t index) {
-  // Will only optimize samples within the sample pool where the sample resides
-  // TODO (democloid): potentially optimize across sample pools
   if (index >= count_)
     return false;
 
-  // Gather memory layout info for the sample being removed
-  auto *moveDst = static_cast<uint8_t *>(wav_[index].GetSampleBuffer(0));
-  if (moveDst == nullptr) {
-    Trace::Error("Invalid sample buffer while deleting");
-    return false;
-  }
-
-  auto *poolBase = static_cast<uint8_t *>(nullptr);
-  uint32_t poolLimit = 0;
-  uint32_t *poolWriteOffset = nullptr;
-  if (moveDst >= sampleStore1 && moveDst < sampleStore1 + storeLimit1_) {
-    poolBase = sampleStore1;
-    poolLimit = storeLimit1_;
-    poolWriteOffset = &writeOffset1_;
-  } else if (moveDst >= sampleStore2 && moveDst < sampleStore2 + storeLimit2_) {
-    poolBase = sampleStore2;
-    poolLimit = storeLimit2_;
-    poolWriteOffset = &writeOffset2_;
-  } else {
+  // Its space goes back to the free list of its store, the samples around it
+  // stay where they are
+  void *buffer = wav_[index].GetSampleBuffer(0);
+  uint8_t *base = nullptr;
+  SampleStore *store = storeOf(buffer, base);
+  if (store == nullptr) {
     Trace::Error("Invalid sample address while deleting");
     return false;
   }
+  store->Release(static_cast<uint8_t *>(buffer) - base,
+                 residentBytes(wav_[index]));
 
-  const uint32_t moveDstOffset = static_cast<uint32_t>(moveDst - poolBase);
-  if (moveDstOffset >= *poolWriteOffset) {
-    Trace::Error("Invalid sample address while deleting (outside pool usage)");
-    return false;
-  }
-
-  // Find the next sample in memory (not by index order) that resides in the
-  // same pool so we only compact that pool.
-  uint8_t *moveSrc = nullptr;
-  for (uint32_t j = 0; j < count_; ++j) {
-    if (j == index) {
-      continue;
-    }
-    auto *candidate = static_cast<uint8_t *>(wav_[j].GetSampleBuffer(0));
-    if (candidate == nullptr) {
-      continue;
-    }
-    if (candidate >= poolBase && candidate < poolBase + poolLimit &&
-        candidate > moveDst) {
-      if (moveSrc == nullptr || candidate < moveSrc) {
-        moveSrc = candidate;
-      }
-    }
-  }
-
-  uint32_t shift = 0;
-  uint32_t bytesToMove = 0;
-  if (moveSrc != nullptr) {
-    shift = static_cast<uint32_t>(moveSrc - moveDst);
-    bytesToMove = *poolWriteOffset - static_cast<uint32_t>(moveSrc - poolBase);
-  } else {
-    // Removing the last sample in this pool: reclaim the tail of the pool
-    shift = *poolWriteOffset - moveDstOffset;
-  }
-
-  // If there was anything to move (i.e: there's a later sample in the same
-  // pool) shift the pool data in one chunk
-  if (bytesToMove > 0) {
-    std::memmove(moveDst, moveSrc, bytesToMove);
-  }
-
-  // Update pool write offset by the bytes we freed
-  *poolWriteOffset -= shift;
-
-  // Update each SoundSource in this pool to point at the new buffer location
-  if (shift > 0 && moveSrc != nullptr) {
-    for (uint32_t j = 0; j < count_; ++j) {
-      if (j == index) {
-        continue;
-      }
-      auto *buf = static_cast<uint8_t *>(wav_[j].GetSampleBuffer(0));
-      if (buf && buf >= poolBase && buf < poolBase + poolLimit &&
-          buf >= moveSrc) {
-        wav_[j].SetSampleBuffer(reinterpret_cast<short *>(buf - shift));
-      }
-    }
-  }
-
-  // Shift wav/name entries down in the arrays
-  for (uint32_t j = index; j < count_ - 1; ++j) {
-    wav_[j] = std::move(wav_[j + 1]);
-    memcpy(nameStore_[j], nameStore_[j + 1],
-           MAX_INSTRUMENT_FILENAME_LENGTH + 1);
-  }
-
-  // clear the last slot (now unused)
-  wav_[count_ - 1].Close();
-  nameStore_[count_ - 1][0] = '\0';
-
-  // decrement sample count
-  --count_;
-
-  // notify observers so sample variables can adjust their indexes
-  SetChanged();
-  SamplePoolEvent ev;
-  ev.index_ = index;
-  ev.type_ = SPET_DELETE;
-  NotifyObservers(&ev);
-
+  removeEntry(index);
   return true;
 }
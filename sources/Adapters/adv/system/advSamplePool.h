@@ -31,11 +31,11 @@ protected:
 
 private:
   bool Load(WavFile &wave);
+  // store holding the sample buffer, its base in base
+  SampleStore *storeOf(void *buffer, uint8_t *&base);
 
-  static uint32_t writeOffset1_;
-  static uint32_t storeLimit1_;
-  static uint32_t writeOffset2_;
-  static uint32_t storeLimit2_;
+  static SampleStore store1_;
+  static SampleStore store2_;
 };
 
 #endif
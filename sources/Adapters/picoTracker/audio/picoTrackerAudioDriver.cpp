@@ -229,22 +229,17 @@ void picoTrackerAudioDriver::OnChunkDone() {
     // Process MIDI
     MidiService::GetInstance()->Flush();
 
-    // We got an IRQ so we know we finished playing from poolPlayPosition_
-    // We mark it as empty and inspect the next buffer, if the buffer is not
-    // empty, it means thread 2 finished processing that buffer and there are no
-    // underruns Otherwise, we send a small blank buffer and wait for the other
-    // thread to finish
-    pool_[poolPlayPosition_].empty_ = true;
-
-    int next = (poolPlayPosition_ + 1) % SOUND_BUFFER_COUNT;
-    if (pool_[next].empty_) {
+    // We got an IRQ so we know we finished playing the current buffer. If
+    // thread 2 finished processing the next one there are no underruns,
+    // otherwise we send a small blank buffer and wait for the other thread to
+    // finish
+    AudioBufferData *next = nextPlayBuffer();
+    if (!next) {
       dma_channel_transfer_from_buffer_now(AUDIO_DMA, miniBlank_,
                                            MINI_BLANK_SIZE);
     } else {
-      poolPlayPosition_ = next;
-      dma_channel_transfer_from_buffer_now(AUDIO_DMA,
-                                           pool_[poolPlayPosition_].buffer_,
-                                           pool_[poolPlayPosition_].size_ / 4);
+      dma_channel_transfer_from_buffer_now(AUDIO_DMA, next->buffer_,
+                                           next->size_ / 4);
     }
 
     // Finally we allow core1 to calculate an additional buffer
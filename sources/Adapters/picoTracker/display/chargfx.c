@@ -7,6 +7,7 @@
  */
 
 #include "chargfx.h"
+#include "dirty_rects.h"
 #include "font.h"
 #include "hardware/spi.h"
 #include "ili9341.h"
@@ -24,13 +25,17 @@ static int cursor_x = 0;
 static int cursor_y = 0;
 static uint8_t screen[TEXT_HEIGHT * TEXT_WIDTH] = {0};
 static uint8_t colors[TEXT_HEIGHT * TEXT_WIDTH] = {0};
-static uint16_t buffer[CHAR_HEIGHT * CHAR_WIDTH * BUFFER_CHARS] = {0};
+// Strips get rendered into one buffer while the other is sent to the display
+static uint16_t buffers[2][CHAR_HEIGHT * CHAR_WIDTH * BUFFER_CHARS] = {0};
+static int back_buffer = 0;
 
 static uint8_t ui_font_index = 0;
 
 // Using a bit array in order to save memory, there is a slight performance
 // hit in doing so vs a bool array
 static uint8_t changed[TEXT_HEIGHT * TEXT_WIDTH / 8] = {0};
+_Static_assert(TEXT_HEIGHT <= DIRTY_RECTS_MAX_HEIGHT,
+               "changed cells are drawn by dirty_rects_draw");
 #define SetBit(A, k) (A[(k) / 8] |= (1 << ((k) % 8)))
 #define ClearBit(A, k) (A[(k) / 8] &= ~(1 << ((k) % 8)))
 #define TestBit(A, k) (A[(k) / 8] & (1 << ((k) % 8)))
@@ -44,10 +49,89 @@ static uint16_t palette[16] = {
     SWAP_BYTES(0xA664), SWAP_BYTES(0x02B0), SWAP_BYTES(0x351E),
     SWAP_BYTES(0xB6FD)};
 
+// Cache of glyphs already expanded to the colors of a cell, in the order the
+// display takes them while mounted rotated: CHAR_WIDTH pixel columns of
+// CHAR_HEIGHT pixels. A cell is keyed by its character and colors byte, and
+// can go in any of the GLYPH_CACHE_WAYS slots of its set, replacing the least
+// recently used one
+#define GLYPH_CACHE_SETS 8
+#define GLYPH_CACHE_WAYS 4
+#define GLYPH_CACHE_SIZE (GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS)
+#define GLYPH_NONE 0xFFFF
+
+static uint16_t glyph_tiles[GLYPH_CACHE_SIZE][CHAR_WIDTH * CHAR_HEIGHT];
+static uint16_t glyph_keys[GLYPH_CACHE_SIZE];
+static uint32_t glyph_used[GLYPH_CACHE_SIZE];
+static uint32_t glyph_clock = 0;
+static uint32_t glyph_hits = 0;
+static uint32_t glyph_misses = 0;
+
+static void invalidate_glyphs() {
+  for (int i = 0; i < GLYPH_CACHE_SIZE; i++) {
+    glyph_keys[i] = GLYPH_NONE;
+  }
+}
+
+// Drops the glyphs drawn with a palette entry
+static void invalidate_glyph_color(int color_index) {
+  for (int i = 0; i < GLYPH_CACHE_SIZE; i++) {
+    uint8_t cell_colors = glyph_keys[i] & 0xff;
+    if (glyph_keys[i] != GLYPH_NONE && ((cell_colors >> 4) == color_index ||
+                                        (cell_colors & 0xf) == color_index)) {
+      glyph_keys[i] = GLYPH_NONE;
+    }
+  }
+}
+
+static const uint16_t *glyph_tile(uint8_t character, uint8_t cell_colors) {
+  uint16_t key = (character << 8) | cell_colors;
+  int set = ((character * 31) ^ cell_colors) % GLYPH_CACHE_SETS;
+  uint16_t *keys = glyph_keys + set * GLYPH_CACHE_WAYS;
+  uint32_t *used = glyph_used + set * GLYPH_CACHE_WAYS;
+  glyph_clock++;
+
+  int victim = 0;
+  for (int way = 0; way < GLYPH_CACHE_WAYS; way++) {
+    if (keys[way] == key) {
+      glyph_hits++;
+      used[way] = glyph_clock;
+      return glyph_tiles[set * GLYPH_CACHE_WAYS + way];
+    }
+    if (keys[way] == GLYPH_NONE) {
+      victim = way;
+      used[way] = 0;
+    } else if (used[way] < used[victim]) {
+      victim = way;
+    }
+  }
+  glyph_misses++;
+
+  const uint16_t *pixel_data = (*fonts[ui_font_index])[character];
+  uint16_t fg_color = palette[cell_colors >> 4];
+  uint16_t bg_color = palette[cell_colors & 0xf];
+  uint16_t *tile = glyph_tiles[set * GLYPH_CACHE_WAYS + victim];
+  uint16_t *tile_idx = tile;
+  for (int bit = 0; bit < CHAR_WIDTH; bit++) {
+    uint16_t mask = 1 << bit;
+    for (int j = CHAR_HEIGHT - 1; j >= 0; j--) {
+      *tile_idx++ = (pixel_data[j] & mask) ? fg_color : bg_color;
+    }
+  }
+  keys[victim] = key;
+  used[victim] = glyph_clock;
+  return tile;
+}
+
+void chargfx_glyph_cache_stats(uint32_t *hits, uint32_t *misses) {
+  *hits = glyph_hits;
+  *misses = glyph_misses;
+}
+
 void chargfx_clear(chargfx_color_t color) {
   int size = TEXT_WIDTH * TEXT_HEIGHT;
   memset(screen, 0, size);
   memset(colors, color, size);
+  memset(changed, 0, sizeof(changed));
   chargfx_set_cursor(0, 0);
   chargfx_draw_screen();
 }
@@ -56,7 +140,12 @@ void chargfx_set_foreground(chargfx_color_t color) { screen_fg_color = color; }
 
 void chargfx_set_background(chargfx_color_t color) { screen_bg_color = color; }
 
-void chargfx_set_font_index(uint8_t idx) { ui_font_index = idx; }
+void chargfx_set_font_index(uint8_t idx) {
+  if (idx != ui_font_index) {
+    ui_font_index = idx;
+    invalidate_glyphs();
+  }
+}
 
 void chargfx_set_cursor(uint8_t x, uint8_t y) {
   cursor_x = x;
@@ -93,17 +182,6 @@ void chargfx_write(const char *str, int len, bool invert) {
   }
 }
 
-void chargfx_draw_region(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
-
-  int remainder = height;
-  while (remainder) {
-    int sub_height = (remainder > BUFFER_CHARS) ? BUFFER_CHARS : remainder;
-    int sub_y = y + height - remainder;
-    remainder -= sub_height;
-    chargfx_draw_sub_region(x, sub_y, width, sub_height);
-  }
-}
-
 // NOTE: we make life easier for ourselves by using the LCD controllers
 // orientation command to let us treat the x,y coords passed into this function
 // as the visual x & y instead of trying to transform them to the LCDs physical
@@ -151,8 +229,9 @@ void chargfx_fill_rect(uint8_t color_index, uint16_t x, uint16_t y,
   ili9341_set_command(ILI9341_RAMWR);
   ili9341_start_writing();
 
-  // just use the char cell buffer for our line buffer as its more than big
-  // enough
+  // just use a char cell buffer for our line buffer as its more than big
+  // enough, nothing is being sent from it as drawing always finishes
+  uint16_t *buffer = buffers[0];
   for (uint16_t i = 0; i < display_w; i++) {
     buffer[i] = color;
   }
@@ -169,8 +248,26 @@ void chargfx_fill_rect(uint8_t color_index, uint16_t x, uint16_t y,
   ili9341_command_param(0xC0);
 }
 
-inline void chargfx_draw_sub_region(uint8_t x, uint8_t y, uint8_t width,
-                                    uint8_t height) {
+// Copies the glyphs of one text column into buffer the way the display takes
+// them, one pixel column of all rows at a time
+static void render_strip(uint16_t *buffer, int page, int y, int height) {
+  for (int row = 0; row < height; row++) {
+    int idx = (y + height - 1 - row) * TEXT_WIDTH + page;
+    const uint16_t *tile = glyph_tile(screen[idx], colors[idx]);
+    uint16_t *buffer_idx = buffer + row * CHAR_HEIGHT;
+    for (int column = 0; column < CHAR_WIDTH; column++) {
+      memcpy(buffer_idx, tile, CHAR_HEIGHT * sizeof(uint16_t));
+      tile += CHAR_HEIGHT;
+      buffer_idx += height * CHAR_HEIGHT;
+    }
+  }
+}
+
+// Each text column of the region goes out as one strip by DMA while the next
+// one gets rendered into the other buffer. Returns with the last strip still
+// being sent, finish_drawing waits for it
+static void draw_sub_region(uint8_t x, uint8_t y, uint8_t width,
+                            uint8_t height) {
   assert(height <= BUFFER_CHARS);
 
   uint16_t screen_x = x * CHAR_WIDTH;
@@ -178,90 +275,71 @@ inline void chargfx_draw_sub_region(uint8_t x, uint8_t y, uint8_t width,
   uint16_t screen_width = width * CHAR_WIDTH;
   uint16_t screen_height = height * CHAR_HEIGHT;
 
-  // column address set
-  ili9341_set_command(ILI9341_CASET);
-  ili9341_command_param16(screen_y);
-  ili9341_command_param16(screen_y + screen_height - 1);
-
-  // page address set
-  ili9341_set_command(ILI9341_PASET);
-  ili9341_command_param16(screen_x);
-  ili9341_command_param16(screen_x + screen_width - 1);
-  // start writing
-  ili9341_set_command(ILI9341_RAMWR);
-
-  ili9341_start_writing();
-
-  const font_t *font = fonts[ui_font_index];
-
   for (int page = x; page < x + width; page++) {
-    // create one column of screen information
-    uint16_t *buffer_idx = buffer;
-
-    for (int bit = CHAR_WIDTH - 1; bit >= 0; bit--) {
-      uint16_t mask = 1 << (CHAR_WIDTH - 1 - bit);
-      for (int col = y + height - 1; col >= y; col--) {
-        int16_t idx = col * TEXT_WIDTH + page;
-        uint8_t character = screen[idx];
-        uint16_t fg_color = palette[colors[idx] >> 4];
-        uint16_t bg_color = palette[colors[idx] & 0xf];
-
-        const uint16_t *pixel_data = (*font)[character];
-
-        // draw the character into the buffer
-        for (int j = CHAR_HEIGHT - 1; j >= 0; j--) {
-          uint16_t pix = pixel_data[j];
-          *buffer_idx++ = (pix & mask) ? fg_color : bg_color;
-        }
-      }
+    uint16_t *buffer = buffers[back_buffer];
+    render_strip(buffer, page, y, height);
+
+    // the previous strip, possibly of another region, has to be out before
+    // the window can move
+    ili9341_wait_data();
+    if (page == x) {
+      ili9341_stop_writing();
+
+      // column address set
+      ili9341_set_command(ILI9341_CASET);
+      ili9341_command_param16(screen_y);
+      ili9341_command_param16(screen_y + screen_height - 1);
+
+      // page address set
+      ili9341_set_command(ILI9341_PASET);
+      ili9341_command_param16(screen_x);
+      ili9341_command_param16(screen_x + screen_width - 1);
+      // start writing
+      ili9341_set_command(ILI9341_RAMWR);
+
+      ili9341_start_writing();
     }
-    ili9341_write_data_continuous(buffer,
-                                  CHAR_WIDTH * screen_height * sizeof(int16_t));
+    ili9341_write_data_async(buffer,
+                             CHAR_WIDTH * screen_height * sizeof(int16_t));
+    back_buffer ^= 1;
+  }
+}
+
+static void queue_region(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+  int remainder = height;
+  while (remainder) {
+    int sub_height = (remainder > BUFFER_CHARS) ? BUFFER_CHARS : remainder;
+    int sub_y = y + height - remainder;
+    remainder -= sub_height;
+    draw_sub_region(x, sub_y, width, sub_height);
   }
+}
+
+static void finish_drawing() {
+  ili9341_wait_data();
   ili9341_stop_writing();
 }
 
-void chargfx_draw_changed() {
-  for (int idx = 0; idx < TEXT_HEIGHT * TEXT_WIDTH; idx++) {
-    if (TestBit(changed, idx)) {
-      ClearBit(changed, idx);
-      // check adjacent in order to find bigger rectangle
-      uint16_t y = idx / TEXT_WIDTH;
-      uint16_t x = idx - (TEXT_WIDTH * y);
+void chargfx_draw_region(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+  queue_region(x, y, width, height);
+  finish_drawing();
+}
 
-      int height = 1;
-      // first pass tests the height
-      for (int probe_y = y + 1; probe_y < TEXT_HEIGHT; probe_y++) {
-        int probe_idx = probe_y * TEXT_WIDTH + x;
-        if (TestBit(changed, probe_idx)) {
-          ClearBit(changed, probe_idx);
-          height++;
-          continue;
-        }
-        break;
-      }
-
-      int16_t width = 1;
-      // having the height, we can test every subsequent column
-      for (int probe_x = x + 1; probe_x < TEXT_WIDTH; probe_x++) {
-        for (int probe_y = y; probe_y < y + height; probe_y++) {
-          // if we don't get to max height, then abort
-          int probe_idx = probe_y * TEXT_WIDTH + probe_x;
-          if (!TestBit(changed, probe_idx)) {
-            // undo last column
-            for (int undo_y = y; undo_y < probe_y; undo_y++) {
-              SetBit(changed, undo_y * TEXT_WIDTH + probe_x);
-            }
-            goto end;
-          }
-          ClearBit(changed, probe_idx);
-        }
-        width++;
-      }
-    end:
-      chargfx_draw_region(x, y, width, height);
+void chargfx_draw_changed() {
+  bool any = false;
+  for (unsigned i = 0; i < sizeof(changed); i++) {
+    if (changed[i]) {
+      any = true;
+      break;
     }
   }
+  if (!any) {
+    return;
+  }
+
+  dirty_rects_draw(changed, TEXT_WIDTH, TEXT_HEIGHT, queue_region);
+  memset(changed, 0, sizeof(changed));
+  finish_drawing();
 }
 
 void chargfx_draw_changed_simple() {
@@ -271,9 +349,10 @@ void chargfx_draw_changed_simple() {
       ClearBit(changed, idx);
       uint16_t y = idx / TEXT_WIDTH;
       uint16_t x = idx - (TEXT_WIDTH * y);
-      chargfx_draw_region(x, y, 1, 1);
+      queue_region(x, y, 1, 1);
     }
   }
+  finish_drawing();
 }
 
 void chargfx_draw_screen() {
@@ -282,7 +361,14 @@ void chargfx_draw_screen() {
 }
 
 void chargfx_set_palette_color(int idx, uint16_t rgb565_color) {
-  palette[idx] = SWAP_BYTES(rgb565_color);
+  uint16_t color = SWAP_BYTES(rgb565_color);
+  if (palette[idx] != color) {
+    palette[idx] = color;
+    invalidate_glyph_color(idx);
+  }
 }
 
-void chargfx_init() { ili9341_init(); }
+void chargfx_init() {
+  invalidate_glyphs();
+  ili9341_init();
+}
@@ -47,8 +47,6 @@ void chargfx_clear(chargfx_color_t color);
 void chargfx_draw_screen();
 void chargfx_draw_changed();
 void chargfx_draw_changed_simple();
-void chargfx_draw_sub_region(uint8_t x, uint8_t y, uint8_t width,
-                             uint8_t height);
 void chargfx_draw_region(uint8_t x, uint8_t y, uint8_t width, uint8_t height);
 void chargfx_fill_rect(uint8_t color_index, uint16_t x, uint16_t y,
                        uint16_t width, uint16_t height);
@@ -62,6 +60,9 @@ void chargfx_write(const char *s, int len, bool invert);
 void chargfx_putc(char c, bool invert);
 void chargfx_set_palette_color(int idx, uint16_t rgb565_color);
 void chargfx_set_font_index(uint8_t idx);
+// Lookups of the glyph cache that found the glyph already drawn, and that had
+// to draw it
+void chargfx_glyph_cache_stats(uint32_t *hits, uint32_t *misses);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,68 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#include "dirty_rects.h"
+#include <stddef.h>
+#include <string.h>
+
+#define TestBit(A, k) (A[(k) / 8] & (1 << ((k) % 8)))
+
+typedef struct {
+  uint8_t x;
+  uint8_t y;
+  uint8_t width;
+  uint8_t height;
+} rect_t;
+
+// Most runs of changed cells a column can have
+#define MAX_RUNS ((DIRTY_RECTS_MAX_HEIGHT + 1) / 2)
+
+void dirty_rects_draw(const uint8_t *changed, int width, int height,
+                      dirty_rect_fn draw) {
+  // Changed cells get gathered in vertical runs a column at a time, as that's
+  // how the display is fed. A run spanning the same rows as one of the
+  // previous column widens its rectangle, the others are complete and get
+  // drawn
+  rect_t open[MAX_RUNS];
+  int open_count = 0;
+  for (int x = 0; x <= width; x++) {
+    rect_t runs[MAX_RUNS];
+    int run_count = 0;
+    for (int y = 0; x < width && y < height; y++) {
+      if (!TestBit(changed, y * width + x)) {
+        continue;
+      }
+      rect_t *last = run_count ? &runs[run_count - 1] : NULL;
+      if (last && last->y + last->height == y) {
+        last->height++;
+      } else {
+        rect_t run = {x, y, 1, 1};
+        runs[run_count++] = run;
+      }
+    }
+
+    // both are sorted by row
+    int o = 0;
+    for (int r = 0; r < run_count; r++) {
+      while (o < open_count && open[o].y < runs[r].y) {
+        draw(open[o].x, open[o].y, open[o].width, open[o].height);
+        o++;
+      }
+      if (o < open_count && open[o].y == runs[r].y &&
+          open[o].height == runs[r].height) {
+        runs[r] = open[o++];
+        runs[r].width++;
+      }
+    }
+    for (; o < open_count; o++) {
+      draw(open[o].x, open[o].y, open[o].width, open[o].height);
+    }
+    memcpy(open, runs, run_count * sizeof(rect_t));
+    open_count = run_count;
+  }
+}
@@ -0,0 +1,34 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _DIRTY_RECTS_H
+#define _DIRTY_RECTS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Tallest grid the changed cells can be gathered from
+#define DIRTY_RECTS_MAX_HEIGHT 32
+
+typedef void (*dirty_rect_fn)(uint8_t x, uint8_t y, uint8_t width,
+                              uint8_t height);
+
+// Calls draw with rectangles that cover every changed cell of a width x height
+// grid exactly once, and no other cell. changed holds a bit per cell, row
+// after row, cell k in bit k % 8 of byte k / 8
+void dirty_rects_draw(const uint8_t *changed, int width, int height,
+                      dirty_rect_fn draw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "ili9341.h"
 #include "Adapters/picoTracker/platform/gpio.h"
+#include "hardware/dma.h"
 #include "pico/stdlib.h"
 #include <stdint.h>
 #include <stdio.h>
@@ -48,10 +49,41 @@ void ili9341_write_data_continuous(void *buffer, int bytes) {
   spi_write_blocking(DISPLAY_SPI, buffer, bytes);
 }
 
+void ili9341_write_data_async(void *buffer, int bytes) {
+  dma_channel_transfer_from_buffer_now(DISPLAY_DMA, buffer, bytes);
+}
+
+void ili9341_wait_data() {
+  dma_channel_wait_for_finish_blocking(DISPLAY_DMA);
+  // The last bytes are still shifting out when the DMA is done, and what got
+  // clocked in meanwhile has to go before the next blocking write
+  while (spi_is_busy(DISPLAY_SPI)) {
+    tight_loop_contents();
+  }
+  while (spi_is_readable(DISPLAY_SPI)) {
+    (void)spi_get_hw(DISPLAY_SPI)->dr;
+  }
+  spi_get_hw(DISPLAY_SPI)->icr = SPI_SSPICR_RORIC_BITS;
+}
+
 inline void ili9341_stop_writing() { cs_deselect(); }
 
 void ili9341_init() {
 
+  // init runs again to show a critical error
+  if (!dma_channel_is_claimed(DISPLAY_DMA)) {
+    dma_channel_claim(DISPLAY_DMA);
+    dma_channel_config config = dma_channel_get_default_config(DISPLAY_DMA);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, spi_get_dreq(DISPLAY_SPI, true));
+    dma_channel_configure(DISPLAY_DMA, &config, &spi_get_hw(DISPLAY_SPI)->dr,
+                          NULL, 0, false);
+  } else {
+    ili9341_wait_data();
+  }
+
   sleep_ms(10);
   gpio_put(DISPLAY_RESET, 0);
   sleep_ms(10);
@@ -118,4 +118,8 @@ void ili9341_write_data(void *buffer, int bytes);
 void ili9341_start_writing();
 void ili9341_stop_writing();
 void ili9341_write_data_continuous(void *biffer, int bytes);
+// Sends the buffer by DMA while writing, it has to stay untouched until
+// ili9341_wait_data returns
+void ili9341_write_data_async(void *buffer, int bytes);
+void ili9341_wait_data();
 #endif
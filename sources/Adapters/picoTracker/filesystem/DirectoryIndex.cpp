@@ -0,0 +1,198 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#include "DirectoryIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+DirectoryIndex::DirectoryIndex() { Clear(0); }
+
+void DirectoryIndex::Clear(uint32_t key) {
+  entries_.clear();
+  sorted_.clear();
+  filtered_.clear();
+  namesSize_ = 0;
+  key_ = key;
+  valid_ = false;
+  truncated_ = false;
+  resume_ = 0;
+  filterValid_ = false;
+}
+
+bool DirectoryIndex::Add(uint32_t index, const char *name, PicoFileType type,
+                         bool hidden, uint32_t size) {
+  uint32_t length = strlen(name);
+  if (entries_.full() || namesSize_ + length > DIRECTORY_INDEX_NAMES_SIZE) {
+    truncated_ = true;
+    resume_ = index;
+    return false;
+  }
+  Entry entry;
+  entry.index = index;
+  entry.size = size;
+  entry.name = namesSize_;
+  entry.length = length;
+  entry.flags = 0;
+  if (type == PFT_DIR) {
+    entry.flags |= ENTRY_DIR;
+    if (strcmp(name, "..") == 0) {
+      entry.flags |= ENTRY_PARENT;
+    }
+  }
+  if (hidden) {
+    entry.flags |= ENTRY_HIDDEN;
+  }
+  memcpy(names_ + namesSize_, name, length);
+  namesSize_ += length;
+  entries_.push_back(entry);
+  return true;
+}
+
+void DirectoryIndex::Sort() {
+  sorted_.clear();
+  for (uint16_t i = 0; i < entries_.size(); i++) {
+    sorted_.push_back(i);
+  }
+  std::sort(sorted_.begin(), sorted_.end(),
+            [this](uint16_t a, uint16_t b) { return less(a, b); });
+  valid_ = true;
+}
+
+bool DirectoryIndex::less(uint16_t a, uint16_t b) const {
+  const Entry &ea = entries_[a];
+  const Entry &eb = entries_[b];
+  if ((ea.flags & ENTRY_PARENT) != (eb.flags & ENTRY_PARENT)) {
+    return ea.flags & ENTRY_PARENT;
+  }
+  if ((ea.flags & ENTRY_DIR) != (eb.flags & ENTRY_DIR)) {
+    return ea.flags & ENTRY_DIR;
+  }
+  const char *na = names_ + ea.name;
+  const char *nb = names_ + eb.name;
+  uint32_t length = std::min(ea.length, eb.length);
+  for (uint32_t i = 0; i < length; i++) {
+    int ca = tolower((unsigned char)na[i]);
+    int cb = tolower((unsigned char)nb[i]);
+    if (ca != cb) {
+      return ca < cb;
+    }
+  }
+  if (ea.length != eb.length) {
+    return ea.length < eb.length;
+  }
+  return ea.index < eb.index;
+}
+
+bool DirectoryIndex::matches(const Entry &entry, const char *filter,
+                             bool subDirOnly) const {
+  return Matches(names_ + entry.name, entry.length, entry.flags & ENTRY_DIR,
+                 entry.flags & ENTRY_HIDDEN, filter, subDirOnly);
+}
+
+bool DirectoryIndex::Matches(const char *name, uint32_t length, bool dir,
+                             bool hidden, const char *filter,
+                             bool subDirOnly) {
+  if (dir) {
+    return true;
+  }
+  if (subDirOnly || hidden) {
+    return false;
+  }
+  // Case insensitive search of the filter, which is in lower case
+  uint32_t filterLength = strlen(filter);
+  if (filterLength > length) {
+    return false;
+  }
+  for (uint32_t i = 0; i + filterLength <= length; i++) {
+    uint32_t j = 0;
+    while (j < filterLength &&
+           tolower((unsigned char)name[i + j]) == (unsigned char)filter[j]) {
+      j++;
+    }
+    if (j == filterLength) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DirectoryIndex::Filter(const char *filter, bool subDirOnly) {
+  bool refine = filterValid_ && subDirOnly == subDirOnly_ &&
+                strstr(filter, filter_) != nullptr;
+  if (refine && strcmp(filter, filter_) == 0) {
+    return;
+  }
+  if (refine) {
+    // Entries dropped by the previous filter can't match this one
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < filtered_.size(); i++) {
+      if (matches(entries_[filtered_[i]], filter, subDirOnly)) {
+        filtered_[kept++] = filtered_[i];
+      }
+    }
+    filtered_.resize(kept);
+  } else {
+    filtered_.clear();
+    for (uint16_t position : sorted_) {
+      if (matches(entries_[position], filter, subDirOnly)) {
+        filtered_.push_back(position);
+      }
+    }
+  }
+  strncpy(filter_, filter, PFILENAME_SIZE - 1);
+  filter_[PFILENAME_SIZE - 1] = '\0';
+  subDirOnly_ = subDirOnly;
+  filterValid_ = true;
+}
+
+int DirectoryIndex::At(uint32_t position) const {
+  return entries_[filtered_[position]].index;
+}
+
+const DirectoryIndex::Entry *DirectoryIndex::find(uint32_t index) const {
+  if (!valid_) {
+    return nullptr;
+  }
+  auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), index,
+      [](const Entry &entry, uint32_t index) { return entry.index < index; });
+  if (it == entries_.end() || it->index != index) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+bool DirectoryIndex::GetName(uint32_t index, char *name, int length) const {
+  const Entry *entry = find(index);
+  if (entry == nullptr || length <= 0) {
+    return false;
+  }
+  uint32_t size = std::min<uint32_t>(entry->length, length - 1);
+  memcpy(name, names_ + entry->name, size);
+  name[size] = '\0';
+  return true;
+}
+
+bool DirectoryIndex::GetType(uint32_t index, PicoFileType &type) const {
+  const Entry *entry = find(index);
+  if (entry == nullptr) {
+    return false;
+  }
+  type = (entry->flags & ENTRY_DIR) ? PFT_DIR : PFT_FILE;
+  return true;
+}
+
+bool DirectoryIndex::GetSize(uint32_t index, uint32_t &size) const {
+  const Entry *entry = find(index);
+  if (entry == nullptr) {
+    return false;
+  }
+  size = entry->size;
+  return true;
+}
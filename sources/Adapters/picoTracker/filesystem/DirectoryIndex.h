@@ -0,0 +1,90 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _DIRECTORY_INDEX_H_
+#define _DIRECTORY_INDEX_H_
+
+#include "Externals/etl/include/etl/vector.h"
+#include "System/FileSystem/FileSystem.h"
+#include <stdint.h>
+
+// Entries and bytes of names a directory index holds. The entries of bigger
+// directories past there are listed from the card after the indexed ones
+#define DIRECTORY_INDEX_SIZE 1024
+#define DIRECTORY_INDEX_NAMES_SIZE 16384
+
+// Cache of the entries of one directory, so that browsing it doesn't walk
+// the card on every move. Entries are added in directory order, which keeps
+// them sorted by their index in the directory for lookups. Listings are
+// sorted with directories first, ".." ahead of them, then by name ignoring
+// case
+class DirectoryIndex {
+public:
+  DirectoryIndex();
+
+  // Starts over for another directory or another state of this one. The key
+  // identifies them, Matches tells whether the index holds that one
+  void Clear(uint32_t key);
+  bool Matches(uint32_t key) const { return valid_ && key_ == key; }
+  // Entries get added while the directory is read, Sort ends it
+  bool Add(uint32_t index, const char *name, PicoFileType type, bool hidden,
+           uint32_t size);
+  void Sort();
+  // Directory had more entries than the index holds, Resume is the index in
+  // the directory of the first one left out
+  bool Truncated() const { return truncated_; }
+  uint32_t Resume() const { return resume_; }
+
+  // Narrows the sorted entries down to the directories and the files whose
+  // name contains filter, in lower case, or only to directories. A filter
+  // that extends the previous one only goes through what that one kept
+  void Filter(const char *filter, bool subDirOnly);
+  uint32_t Count() const { return filtered_.size(); }
+  // Index in the directory of the n-th filtered entry
+  int At(uint32_t position) const;
+
+  // Cached data of an entry by its index in the directory, false if it isn't
+  // in the index
+  bool GetName(uint32_t index, char *name, int length) const;
+  bool GetType(uint32_t index, PicoFileType &type) const;
+  bool GetSize(uint32_t index, uint32_t &size) const;
+
+  // Whether Filter keeps an entry, for the ones that aren't in the index
+  static bool Matches(const char *name, uint32_t length, bool dir, bool hidden,
+                      const char *filter, bool subDirOnly);
+
+private:
+  struct Entry {
+    uint32_t index;
+    uint32_t size;
+    uint16_t name; // offset in names_
+    uint8_t length;
+    uint8_t flags;
+  };
+  enum { ENTRY_DIR = 1, ENTRY_HIDDEN = 2, ENTRY_PARENT = 4 };
+
+  const Entry *find(uint32_t index) const;
+  bool matches(const Entry &entry, const char *filter, bool subDirOnly) const;
+  bool less(uint16_t a, uint16_t b) const;
+
+  etl::vector<Entry, DIRECTORY_INDEX_SIZE> entries_;
+  // positions in entries_, sorted then filtered
+  etl::vector<uint16_t, DIRECTORY_INDEX_SIZE> sorted_;
+  etl::vector<uint16_t, DIRECTORY_INDEX_SIZE> filtered_;
+  char names_[DIRECTORY_INDEX_NAMES_SIZE];
+  uint32_t namesSize_;
+  uint32_t key_;
+  bool valid_;
+  bool truncated_;
+  uint32_t resume_;
+  char filter_[PFILENAME_SIZE];
+  bool subDirOnly_;
+  bool filterValid_;
+};
+
+#endif
@@ -7,8 +7,11 @@
  */
 
 #include "picoTrackerFileSystem.h"
+#include "DirectoryIndex.h"
+#include "Externals/etl/include/etl/crc32.h"
 #include "Externals/etl/include/etl/pool.h"
 #include "pico/multicore.h"
+#include <algorithm>
 #include <cstring>
 
 // Global mutex for thread safety
@@ -18,6 +21,51 @@ constexpr uint32_t MAX_OPEN_FILES = 10;
 
 static etl::pool<picoTrackerFile, MAX_OPEN_FILES> filePool;
 
+// Entries of the last directory listed, kept until it changes. The index only
+// answers for the current directory
+static DirectoryIndex directoryIndex;
+static uint32_t indexedSector = 0;
+static bool indexIsCwd = false;
+
+// A directory is known by where it starts, its modification time and its
+// size, which changes as entries get added on exFAT
+static uint32_t directoryKey(FsBaseFile &dir) {
+  uint16_t date = 0;
+  uint16_t time = 0;
+  dir.getModifyDateTime(&date, &time);
+  uint32_t fields[] = {dir.firstSector(), (uint32_t(date) << 16) | time,
+                       uint32_t(dir.fileSize())};
+  etl::crc32 crc((const uint8_t *)fields,
+                 (const uint8_t *)fields + sizeof(fields));
+  return crc.value();
+}
+
+// FAT doesn't update the time of a directory when its entries change, so our
+// own writes drop the index when they go to the indexed directory. Returns
+// whether path is in it
+static bool touchDirectory(const char *path) {
+  const char *slash = strrchr(path, '/');
+  FsBaseFile dir;
+  bool opened;
+  if (slash == nullptr) {
+    opened = dir.openCwd();
+  } else if (slash == path) {
+    opened = dir.open("/");
+  } else {
+    char parent[PFILENAME_SIZE];
+    size_t length = std::min<size_t>(slash - path, PFILENAME_SIZE - 1);
+    memcpy(parent, path, length);
+    parent[length] = '\0';
+    opened = dir.open(parent);
+  }
+  bool indexed = !opened || dir.firstSector() == indexedSector;
+  dir.close();
+  if (indexed) {
+    directoryIndex.Clear(0);
+  }
+  return indexed;
+}
+
 picoTrackerFileSystem::picoTrackerFileSystem() {
   // init out access mutex
   std::lock_guard<Mutex> lock(mutex);
@@ -72,12 +120,16 @@ FileHandle picoTrackerFileSystem::Open(const char *name, const char *mode) {
     Trace::Error("FILESYSTEM: Cannot open file:%s", name, mode);
     return FileHandle();
   }
-  wFile = filePool.create(cwd);
-  if (wFile == nullptr) {
+  picoTrackerFile *file = filePool.create(cwd);
+  if (file == nullptr) {
     Trace::Error("FILESYSTEM: No file slots available (max %d)",
                  static_cast<int>(MAX_OPEN_FILES));
     return FileHandle();
   }
+  if (rmode != O_RDONLY && touchDirectory(name)) {
+    file->SetIndexed();
+  }
+  wFile = file;
   return MakeFileHandle(wFile);
 }
 
@@ -87,6 +139,7 @@ bool picoTrackerFileSystem::chdir(const char *name) {
 
   sd.chvol();
   auto res = sd.vol()->chdir(name);
+  indexIsCwd = false;
   File cwd;
   char buf[PFILENAME_SIZE];
   cwd.openCwd();
@@ -99,6 +152,11 @@ bool picoTrackerFileSystem::chdir(const char *name) {
 PicoFileType picoTrackerFileSystem::getFileType(int index) {
   std::lock_guard<Mutex> lock(mutex);
 
+  PicoFileType type;
+  if (indexIsCwd && directoryIndex.GetType(index, type)) {
+    return type;
+  }
+
   FsBaseFile cwd;
   if (!cwd.openCwd()) {
     char name[PFILENAME_SIZE];
@@ -116,65 +174,120 @@ PicoFileType picoTrackerFileSystem::getFileType(int index) {
 
 void picoTrackerFileSystem::list(etl::ivector<int> *fileIndexes,
                                  const char *filter, bool subDirOnly) {
+  listPage(fileIndexes, filter, subDirOnly, 0);
+}
+
+uint32_t picoTrackerFileSystem::listPage(etl::ivector<int> *fileIndexes,
+                                         const char *filter, bool subDirOnly,
+                                         uint32_t first) {
   std::lock_guard<Mutex> lock(mutex);
 
   fileIndexes->clear();
+  if (!indexDirectory()) {
+    return 0;
+  }
+
+  directoryIndex.Filter(filter, subDirOnly);
+  uint32_t count = directoryIndex.Count();
+  for (uint32_t i = first; i < count && !fileIndexes->full(); i++) {
+    fileIndexes->push_back(directoryIndex.At(i));
+  }
+  if (directoryIndex.Truncated()) {
+    count += listPastIndex(fileIndexes, filter, subDirOnly,
+                           first > count ? first - count : 0);
+  }
+  return count;
+}
 
+// The entries of a directory that the index couldn't hold come after the
+// indexed ones, in directory order. They're read from the card on every call,
+// the ones before skip are counted but not listed. Returns how many match
+uint32_t picoTrackerFileSystem::listPastIndex(etl::ivector<int> *fileIndexes,
+                                              const char *filter,
+                                              bool subDirOnly, uint32_t skip) {
   File cwd;
   if (!cwd.openCwd()) {
-    char name[PFILENAME_SIZE];
-    cwd.getName(name, PFILENAME_SIZE);
     Trace::Error("Failed to open cwd");
-    return;
+    return 0;
   }
-  char buffer[PFILENAME_SIZE];
-  cwd.getName(buffer, PFILENAME_SIZE);
-  Trace::Log("FILESYSTEM", "LIST DIR:%s", buffer);
+  uint32_t count = 0;
+  char name[PFILENAME_SIZE];
+  File entry;
+  while (entry.openNext(&cwd, O_READ)) {
+    uint32_t index = entry.dirIndex();
+    if (index >= directoryIndex.Resume()) {
+      entry.getName(name, PFILENAME_SIZE);
+      if (DirectoryIndex::Matches(name, strlen(name), entry.isDirectory(),
+                                  entry.isHidden(), filter, subDirOnly)) {
+        if (count >= skip && !fileIndexes->full()) {
+          fileIndexes->push_back(index);
+        }
+        count++;
+      }
+    }
+    entry.close();
+  }
+  cwd.close();
+  return count;
+}
 
+bool picoTrackerFileSystem::indexDirectory() {
+  File cwd;
+  if (!cwd.openCwd()) {
+    Trace::Error("Failed to open cwd");
+    return false;
+  }
   if (!cwd.isDir()) {
     Trace::Error("Path is not a directory");
-    return;
+    return false;
   }
 
-  File entry;
-  uint16_t count = 0;
+  uint32_t key = directoryKey(cwd);
+  indexedSector = cwd.firstSector();
+  indexIsCwd = true;
+  if (directoryIndex.Matches(key)) {
+    cwd.close();
+    return true;
+  }
+
+  char buffer[PFILENAME_SIZE];
+  cwd.getName(buffer, PFILENAME_SIZE);
+  Trace::Log("FILESYSTEM", "INDEX DIR:%s", buffer);
+  directoryIndex.Clear(key);
 
   // ref: https://github.com/greiman/SdFat/issues/353#issuecomment-1003422848
-  while (entry.openNext(&cwd, O_READ) && (count < fileIndexes->capacity())) {
+  File entry;
+  while (entry.openNext(&cwd, O_READ)) {
     uint32_t index = entry.dirIndex();
-    entry.getName(buffer, PFILENAME_SIZE);
-
-    bool matchesFilter = true;
-    if (strlen(filter) > 0) {
-      tolowercase(buffer);
-      matchesFilter = (strstr(buffer, filter) != nullptr);
-      // Trace::Log("FILESYSTEM", "FILTER: %s=%s [%d]", buffer, filter,
-      //            matchesFilter);
-    }
-    // filter out "." and files that dont match filter if a filter is given
-    if ((entry.isDirectory() && entry.dirIndex() != 0) ||
-        (!entry.isHidden() && matchesFilter)) {
-      if (subDirOnly) {
-        if (entry.isDirectory()) {
-          fileIndexes->push_back(index);
-        }
-      } else {
-        fileIndexes->push_back(index);
+    bool isDir = entry.isDirectory();
+    // "." isn't listed
+    if (!(isDir && index == 0)) {
+      entry.getName(buffer, PFILENAME_SIZE);
+      uint32_t size = isDir ? 0 : uint32_t(entry.fileSize());
+      if (!directoryIndex.Add(index, buffer, isDir ? PFT_DIR : PFT_FILE,
+                              entry.isHidden(), size)) {
+        entry.close();
+        break;
       }
-      // Trace::Log("FILESYSTEM", "[%d] got file: %s", index, buffer);
-      count++;
-    } else {
-      // Trace::Log("FILESYSTEM", "skipped hidden: %s", buffer);
     }
     entry.close();
   }
   cwd.close();
-  Trace::Log("FILESYSTEM", "scanned: %d, added file indexes:%d", count,
-             fileIndexes->size());
+  directoryIndex.Sort();
+
+  if (directoryIndex.Truncated()) {
+    Trace::Log("FILESYSTEM",
+               "Directory index full, entries from %d on listed from the card",
+               directoryIndex.Resume());
+  }
+  return true;
 }
 
 void picoTrackerFileSystem::getFileName(int index, char *name, int length) {
   std::lock_guard<Mutex> lock(mutex);
+  if (indexIsCwd && directoryIndex.GetName(index, name, length)) {
+    return;
+  }
   FsBaseFile cwd;
   if (!cwd.openCwd()) {
     char dirname[PFILENAME_SIZE];
@@ -229,11 +342,13 @@ bool picoTrackerFileSystem::isCurrentRoot() {
 
 bool picoTrackerFileSystem::DeleteFile(const char *path) {
   std::lock_guard<Mutex> lock(mutex);
+  touchDirectory(path);
   return sd.remove(path);
 }
 
 bool picoTrackerFileSystem::DeleteDir(const char *path) {
   std::lock_guard<Mutex> lock(mutex);
+  touchDirectory(path);
   auto delDir = sd.open(path, O_READ);
   return delDir.rmdir();
 }
@@ -245,11 +360,16 @@ bool picoTrackerFileSystem::exists(const char *path) {
 
 bool picoTrackerFileSystem::makeDir(const char *path, bool pFlag) {
   std::lock_guard<Mutex> lock(mutex);
+  touchDirectory(path);
   return sd.mkdir(path, pFlag);
 }
 
 uint64_t picoTrackerFileSystem::getFileSize(const int index) {
   std::lock_guard<Mutex> lock(mutex);
+  uint32_t cached;
+  if (indexIsCwd && directoryIndex.GetSize(index, cached)) {
+    return cached;
+  }
   FsBaseFile cwd;
   FsBaseFile entry;
   if (!entry.open(index)) {
@@ -269,6 +389,7 @@ uint64_t picoTrackerFileSystem::getFileSize(const int index) {
 bool picoTrackerFileSystem::CopyFile(const char *srcPath,
                                      const char *destPath) {
   std::lock_guard<Mutex> lock(mutex);
+  touchDirectory(destPath);
   auto fSrc = sd.open(srcPath, O_READ);
   auto fDest = sd.open(destPath, O_WRITE | O_CREAT);
 
@@ -292,19 +413,10 @@ bool picoTrackerFileSystem::CopyFile(const char *srcPath,
   return true;
 }
 
-void picoTrackerFileSystem::tolowercase(char *temp) {
-  // Convert to lower case
-  char *s = temp;
-  while (*s != '\0') {
-    *s = tolower((unsigned char)*s);
-    s++;
-  }
-}
-
 // picoTrackerFile implementation
 
 picoTrackerFile::picoTrackerFile(FsBaseFile file)
-    : file_(file), isOpen_(true) {}
+    : file_(file), isOpen_(true), indexed_(false), written_(false) {}
 
 picoTrackerFile::~picoTrackerFile() { Close(); }
 
@@ -337,6 +449,7 @@ int picoTrackerFile::GetC() {
 
 int picoTrackerFile::Write(const void *ptr, int size, int nmemb) {
   std::lock_guard<Mutex> lock(mutex);
+  written_ = true;
   return file_.write(ptr, size * nmemb);
 }
 
@@ -360,6 +473,10 @@ bool picoTrackerFile::Close() {
   if (closed) {
     isOpen_ = false;
   }
+  // The size in the index is the one it had when it was listed
+  if (indexed_ && written_) {
+    directoryIndex.Clear(0);
+  }
   return closed;
 }
 
@@ -368,4 +485,14 @@ bool picoTrackerFile::Sync() {
   return file_.sync();
 }
 
+uint32_t picoTrackerFile::GetModifyTime() {
+  std::lock_guard<Mutex> lock(mutex);
+  uint16_t date = 0;
+  uint16_t time = 0;
+  if (!file_.getModifyDateTime(&date, &time)) {
+    return 0;
+  }
+  return (uint32_t(date) << 16) | time;
+}
+
 void picoTrackerFile::Dispose() { filePool.destroy(this); }
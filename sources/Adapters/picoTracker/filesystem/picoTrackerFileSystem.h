@@ -32,6 +32,8 @@ public:
   virtual bool chdir(const char *path) override;
   virtual void list(etl::ivector<int> *fileIndexes, const char *filter,
                     bool subDirOnly) override;
+  virtual uint32_t listPage(etl::ivector<int> *fileIndexes, const char *filter,
+                            bool subDirOnly, uint32_t first) override;
   virtual void getFileName(int index, char *name, int length) override;
   virtual PicoFileType getFileType(int index) override;
   virtual bool isParentRoot() override;
@@ -45,7 +47,10 @@ public:
 
 private:
   SdFs sd;
-  void tolowercase(char *temp);
+  // Makes sure the directory index holds the current directory
+  bool indexDirectory();
+  uint32_t listPastIndex(etl::ivector<int> *fileIndexes, const char *filter,
+                         bool subDirOnly, uint32_t skip);
   // buffer needs to be allocated here as too big for allocation as local
   // variable on the stack
   uint8_t fileBuffer_[512];
@@ -67,10 +72,16 @@ public:
   virtual int Error() override;
   virtual bool Sync() override;
   void Dispose() override;
+  virtual uint32_t GetModifyTime() override;
+
+  // Written files in the indexed directory drop its index when closed
+  void SetIndexed() { indexed_ = true; }
 
 private:
   FsBaseFile file_;
   bool isOpen_;
+  bool indexed_;
+  bool written_;
 };
 
 // Mutex implementation for thread safety
@@ -7,9 +7,11 @@
  */
 
 #include "SerialDebugUI.h"
+#include "Adapters/picoTracker/display/chargfx.h"
 #include "Application/Model/Config.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/I_File.h"
+#include "System/Profiler/AudioStageProfiler.h"
 #include "hardware/uart.h"
 #include <Adapters/picoTracker/platform/gpio.h>
 #include <Trace.h>
@@ -84,8 +86,13 @@ void SerialDebugUI::dispatchCmd(char *input) {
     mkdir(arg);
   } else if (strcmp(cmd, "rmdir") == 0) {
     rmdir(arg);
+  } else if (strcmp(cmd, "perf") == 0) {
+    audioPerf(arg);
+  } else if (strcmp(cmd, "glyphs") == 0) {
+    glyphCacheStats();
   } else if (strcmp(cmd, "help") == 0) {
-    Trace::Log("SERIALDEBUG", "cat, ls, rm, mkdir, rmdir, save, help");
+    Trace::Log("SERIALDEBUG",
+               "cat, ls, rm, mkdir, rmdir, save, perf, glyphs, help");
   } else {
     Trace::Log("SERIALDEBUG", "unknown command");
   }
@@ -178,3 +185,25 @@ void SerialDebugUI::rmdir(const char *path) {
     Trace::Error("failed to remove dir:%s", path);
   }
 }
+
+void SerialDebugUI::audioPerf(const char *arg) {
+#ifdef AUDIO_STAGE_PROFILING
+  if (arg && strcmp(arg, "reset") == 0) {
+    AudioStageProfiler::RequestReset();
+    return;
+  }
+  AudioStageProfiler::Dump();
+#else
+  Trace::Log("SERIALDEBUG", "build with AUDIO_STAGE_PROFILING to use perf");
+#endif
+}
+
+void SerialDebugUI::glyphCacheStats() {
+  uint32_t hits;
+  uint32_t misses;
+  chargfx_glyph_cache_stats(&hits, &misses);
+  uint32_t total = hits + misses;
+  Trace::Log("SERIALDEBUG", "glyph cache hits:%lu misses:%lu rate:%lu%%",
+             (unsigned long)hits, (unsigned long)misses,
+             (unsigned long)(total ? (uint64_t)hits * 100 / total : 0));
+}
@@ -22,6 +22,8 @@ public:
   void saveConfig();
   void mkdir(const char *path);
   void rmdir(const char *path);
+  void audioPerf(const char *arg);
+  void glyphCacheStats();
 
 private:
   int lp_ = 0;
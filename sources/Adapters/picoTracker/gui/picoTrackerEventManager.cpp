@@ -184,6 +184,14 @@ void picoTrackerEventManager::ProcessInputEvent() {
 #ifdef SERIAL_REPL
   serialDebugUI_.readSerialIn(inBuffer, INPUT_BUFFER_SIZE);
 #endif
+  // A new remote UI client starts again from protocol version 1
+  static bool remoteConnected = false;
+  bool connected = tud_cdc_connected();
+  if (remoteConnected && !connected) {
+    picoTrackerGUIWindowImp::ResetRemoteUI();
+  }
+  remoteConnected = connected;
+
   char inBuffer[16];
   auto readbytes = readFromUSBCDC(inBuffer, 16);
   if (readbytes > 0) {
@@ -199,6 +207,16 @@ void picoTrackerEventManager::ProcessInputEvent() {
       queue->push(picoTrackerEvent(PICO_REDRAW));
       break;
 
+    case PROTOCOL_VERSION_CMD:
+      if (readbytes < 3) {
+        break;
+      }
+      picoTrackerGUIWindowImp::NegotiateRemoteUI(inBuffer[2]);
+      // the client draws the whole screen again with the new version
+      queue = picoTrackerEventQueue::GetInstance();
+      queue->push(picoTrackerEvent(PICO_REDRAW));
+      break;
+
     default:
       break;
     }
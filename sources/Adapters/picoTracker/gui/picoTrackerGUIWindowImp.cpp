@@ -29,6 +29,24 @@ static uint8_t lastRemoteColorIdx = 255;
 
 static GUIEventPadButtonType *eventMapping = eventMappingPico;
 
+// Remote UI version 2 state. Commands wait in the frame buffer until Flush,
+// or until it fills up. Characters drawn next to each other with the same
+// colour and invert make up a run, sent as a single command
+#define REMOTE_UI_FRAME_BUFFER_SIZE 1024
+static char remoteFrame[REMOTE_UI_FRAME_BUFFER_SIZE];
+static uint16_t remoteFrameSize = 0;
+static bool remoteFrameOpen = false;
+static char runChars[REMOTE_UI_MAX_RUN_LENGTH];
+static uint8_t runLength = 0;
+static uint8_t runX = 0;
+static uint8_t runY = 0;
+static bool runInvert = false;
+static GUIColor runColor(0, 0, 0);
+// colour of the last SetColor, the remote one is only sent for rectangles
+static GUIColor currentColor(0, 0, 0);
+static bool remoteColorValid = false;
+static GUIColor remoteColor(0, 0, 0);
+
 // Initialize static members
 picoTrackerGUIWindowImp *picoTrackerGUIWindowImp::instance_ = NULL;
 
@@ -59,11 +77,83 @@ picoTrackerGUIWindowImp::picoTrackerGUIWindowImp(GUICreateWindowParams &p) {
 picoTrackerGUIWindowImp::~picoTrackerGUIWindowImp() {}
 
 void picoTrackerGUIWindowImp::SendFont(uint8_t uifontIndex) {
+  // Whatever is pending gets drawn with the previous font
+  flushRemote();
   char remoteUIBuffer[3];
   remoteUIFontCommand(uifontIndex, remoteUIBuffer);
   sendToUSBCDC(remoteUIBuffer, 3);
 }
 
+void picoTrackerGUIWindowImp::sendRemote(const char *buffer, uint16_t length) {
+  if (remoteUIVersion_ < 2) {
+    sendToUSBCDC((char *)buffer, length);
+    return;
+  }
+  if (!remoteFrameOpen) {
+    remoteFrameSize = remoteUIFrameBeginCommand(remoteFrame);
+    remoteFrameOpen = true;
+  }
+  // A frame bigger than the buffer goes out in several transfers
+  if (remoteFrameSize + length > REMOTE_UI_FRAME_BUFFER_SIZE) {
+    sendToUSBCDC(remoteFrame, remoteFrameSize);
+    remoteFrameSize = 0;
+  }
+  memcpy(remoteFrame + remoteFrameSize, buffer, length);
+  remoteFrameSize += length;
+}
+
+void picoTrackerGUIWindowImp::closeRun() {
+  if (runLength == 0) {
+    return;
+  }
+  char remoteUIBuffer[REMOTE_UI_MAX_RUN_COMMAND_SIZE];
+  auto bufferIndex = remoteUITextRunCommand(
+      runX, runY, runInvert, runColor._r, runColor._g, runColor._b, runChars,
+      runLength, remoteUIBuffer);
+  runLength = 0;
+  sendRemote(remoteUIBuffer, bufferIndex);
+}
+
+void picoTrackerGUIWindowImp::flushRemote() {
+  if (remoteUIVersion_ < 2) {
+    return;
+  }
+  closeRun();
+  if (!remoteFrameOpen) {
+    return;
+  }
+  char remoteUIBuffer[2];
+  auto bufferIndex = remoteUIFrameEndCommand(remoteUIBuffer);
+  sendRemote(remoteUIBuffer, bufferIndex);
+  sendToUSBCDC(remoteFrame, remoteFrameSize);
+  remoteFrameSize = 0;
+  remoteFrameOpen = false;
+}
+
+void picoTrackerGUIWindowImp::NegotiateRemoteUI(uint8_t version) {
+  ResetRemoteUI();
+  if (version > REMOTE_UI_PROTOCOL_VERSION) {
+    version = REMOTE_UI_PROTOCOL_VERSION;
+  }
+  if (version > 1) {
+    instance_->remoteUIVersion_ = version;
+  }
+  Trace::Log("REMOTEUI", "Remote UI protocol version %d",
+             instance_->remoteUIVersion_);
+  char remoteUIBuffer[3];
+  auto bufferIndex =
+      remoteUIVersionCommand(instance_->remoteUIVersion_, remoteUIBuffer);
+  sendToUSBCDC(remoteUIBuffer, bufferIndex);
+}
+
+void picoTrackerGUIWindowImp::ResetRemoteUI() {
+  instance_->remoteUIVersion_ = 1;
+  remoteFrameSize = 0;
+  remoteFrameOpen = false;
+  runLength = 0;
+  remoteColorValid = false;
+}
+
 void picoTrackerGUIWindowImp::DrawChar(const char c, GUIPoint &pos,
                                        GUITextProperties &p) {
   //  Trace::Debug("Draw char \"%c\" at pos x:%ld (%ld), y:%ld (%ld) - invert:
@@ -73,7 +163,21 @@ void picoTrackerGUIWindowImp::DrawChar(const char c, GUIPoint &pos,
   uint8_t y = pos._y / 8;
   chargfx_set_cursor(x, y);
   chargfx_putc(c, p.invert_);
-  if (remoteUIEnabled_) {
+  if (remoteUIEnabled_ && remoteUIVersion_ >= 2) {
+    if (runLength > 0 &&
+        (y != runY || x != runX + runLength || p.invert_ != runInvert ||
+         !(currentColor == runColor) ||
+         runLength == REMOTE_UI_MAX_RUN_LENGTH)) {
+      closeRun();
+    }
+    if (runLength == 0) {
+      runX = x;
+      runY = y;
+      runInvert = p.invert_;
+      runColor = currentColor;
+    }
+    runChars[runLength++] = c;
+  } else if (remoteUIEnabled_) {
     char remoteUIBuffer[6];
     remoteUIDrawCharCommand(c, x, y, p.invert_, remoteUIBuffer);
     sendToUSBCDC(remoteUIBuffer, 6);
@@ -85,13 +189,24 @@ void picoTrackerGUIWindowImp::DrawRect(GUIRect &r) {
   chargfx_fill_rect(lastRemoteColorIdx, r.Left(), r.Top(), r.Width(),
                     r.Height());
   if (remoteUIEnabled_) {
+    // Version 2 only sends the colour when a rectangle needs it
+    closeRun();
+    if (remoteUIVersion_ >= 2 &&
+        (!remoteColorValid || !(currentColor == remoteColor))) {
+      char colorBuffer[8];
+      auto colorIndex = remoteUISetColorCommand(
+          currentColor._r, currentColor._g, currentColor._b, colorBuffer);
+      sendRemote(colorBuffer, colorIndex);
+      remoteColor = currentColor;
+      remoteColorValid = true;
+    }
     // Now, send the DrawRect command with full byte-escaping.
     // Worst-case buffer: 2 (header) + 9 payload bytes * 2 (if all are escaped)
     // = 20  bytes.
     char remoteUIBuffer[20];
     auto bufferIndex = remoteUIDrawRectCommand(r.Left(), r.Top(), r.Width(),
                                                r.Height(), remoteUIBuffer);
-    sendToUSBCDC(remoteUIBuffer, bufferIndex);
+    sendRemote(remoteUIBuffer, bufferIndex);
   }
 };
 
@@ -100,11 +215,12 @@ void picoTrackerGUIWindowImp::Clear(GUIColor &c, bool overlay) {
   chargfx_set_background(backgroundColor);
   chargfx_clear(backgroundColor);
   if (remoteUIEnabled_) {
+    closeRun();
     char remoteUIBuffer[5];
     remoteUIClearCommand(c._r, c._g, c._b, remoteUIBuffer);
     // log sent buffer values
     Trace::Debug("sent clear command: %d,%d,%d", c._r, c._g, c._b);
-    sendToUSBCDC(remoteUIBuffer, 5);
+    sendRemote(remoteUIBuffer, 5);
   }
 };
 
@@ -138,7 +254,8 @@ void picoTrackerGUIWindowImp::SetColor(GUIColor &c) {
   NAssert(c._g < 255);
   NAssert(c._b < 255);
   chargfx_set_foreground(color);
-  if (remoteUIEnabled_) {
+  currentColor = c;
+  if (remoteUIEnabled_ && remoteUIVersion_ < 2) {
     // Buffer must be large enough for the worst case where all 3 color bytes
     // are escaped. Header (2) + 3 color components * 2 bytes/escaped_component
     // = 8 bytes.
@@ -154,7 +271,12 @@ void picoTrackerGUIWindowImp::Lock(){};
 
 void picoTrackerGUIWindowImp::Unlock(){};
 
-void picoTrackerGUIWindowImp::Flush() { chargfx_draw_changed(); };
+void picoTrackerGUIWindowImp::Flush() {
+  chargfx_draw_changed();
+  if (remoteUIEnabled_) {
+    flushRemote();
+  }
+};
 
 void picoTrackerGUIWindowImp::Invalidate() {
   picoTrackerEventQueue::GetInstance()->push(picoTrackerEvent(PICO_FLUSH));
@@ -214,6 +336,9 @@ void picoTrackerGUIWindowImp::Update(Observable &o, I_ObservableData *d) {
   case FourCC::VarRemoteUI: {
     auto remoteui = v.GetInt();
     remoteUIEnabled_ = remoteui != 0;
+    if (!remoteUIEnabled_) {
+      ResetRemoteUI();
+    }
   } break;
   case FourCC::VarUIFont: {
     auto uifont = v.GetInt();
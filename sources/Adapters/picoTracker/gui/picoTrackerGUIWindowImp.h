@@ -39,6 +39,10 @@ public: // I_GUIWindowImp implementation
 
   static void ProcessEvent(picoTrackerEvent &event);
   static void ProcessButtonChange(uint16_t changeMask, uint16_t buttonMask);
+  // Remote UI clients ask for a protocol version, the answer goes back right
+  // away. Back to version 1 when the client goes away
+  static void NegotiateRemoteUI(uint8_t version);
+  static void ResetRemoteUI();
 
   static picoTrackerGUIWindowImp *instance_;
 
@@ -49,6 +53,11 @@ protected:
 
 private:
   void SendFont(uint8_t uifontIndex);
+  // Version 2 collects the commands of a frame and sends them on Flush
+  void sendRemote(const char *buffer, uint16_t length);
+  void closeRun();
+  void flushRemote();
   bool remoteUIEnabled_ = 0;
+  uint8_t remoteUIVersion_ = 1;
 };
 #endif
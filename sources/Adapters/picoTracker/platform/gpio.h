@@ -25,6 +25,7 @@
 #define DISPLAY_MOSI 27
 #define DISPLAY_MISO 28
 #define DISPLAY_PWM 23
+#define DISPLAY_DMA 1
 
 // MIDI
 #define MIDI_BAUD_RATE 31250
@@ -17,6 +17,11 @@
 #include <stdint.h>
 
 typedef void (*sd_callback_t)(uint32_t bytes_complete);
+
+// Calls func while the card transfers into or out of buffer, with the number
+// of bytes of it done so far. Consecutive transfers continue where the
+// previous one ended. A null func stops it
+void azplatform_set_sd_callback(sd_callback_t func, const uint8_t *buffer);
 uint32_t millis(void);
 
 enum sdio_status_t {
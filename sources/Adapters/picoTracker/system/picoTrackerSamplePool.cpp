@@ -7,18 +7,20 @@
  */
 
 #include "picoTrackerSamplePool.h"
+#include "Adapters/picoTracker/sdcard/sdio.h"
+#include "Externals/etl/include/etl/crc32.h"
 #include "hardware/flash.h"
 #include "hardware/sync.h"
 #include "pico/multicore.h"
+#ifdef SDIO_BENCH
+#include "hardware/timer.h"
+#endif
+#include <algorithm>
+#include <cstddef>
 #include <cstring>
 
-#define MB 1024 * 1024
-
 #define VERBOSE_FLASH_DEBUG 0
 
-// Maximum sample storage per project (8MB limit for now)
-#define SAMPLE_STORAGE_START_MB 8
-
 // Define where sample storage begins in flash
 // Use all flash available after binary for samples
 extern char __flash_binary_end;
@@ -27,16 +29,30 @@ extern char __flash_binary_end;
    1) *                                                                        \
       FLASH_SECTOR_SIZE
 
+// The sample directory takes the first sector, samples follow it
+#define FLASH_SAMPLE_DIRECTORY_OFFSET FLASH_TARGET_OFFSET
+#define FLASH_SAMPLE_DIRECTORY_SLOTS                                           \
+  (FLASH_SECTOR_SIZE / sizeof(FlashSampleEntry))
+#define FLASH_SAMPLE_STORE_OFFSET (FLASH_TARGET_OFFSET + FLASH_SECTOR_SIZE)
+
 // Total flash size depends on hardware:
 // - Raspberry Pi Pico: 2MB
 // - picoTracker custom hardware: up to 16MB
 // We'll detect actual size at runtime if needed
 
-uint32_t picoTrackerSamplePool::flashEraseOffset_ = FLASH_TARGET_OFFSET;
-uint32_t picoTrackerSamplePool::flashWriteOffset_ = FLASH_TARGET_OFFSET;
+// Samples take whole sectors so that each of them can be erased on its own
+SampleStore picoTrackerSamplePool::store_(0, FLASH_SECTOR_SIZE);
+uint32_t picoTrackerSamplePool::flashWriteOffset_ = FLASH_SAMPLE_STORE_OFFSET;
+uint32_t picoTrackerSamplePool::erasedStart_ = 0;
+uint32_t picoTrackerSamplePool::erasedEnd_ = 0;
 // Initial default value - will be properly set in the constructor based on
 // actual flash size
 uint32_t picoTrackerSamplePool::flashLimit_ = 0;
+uint32_t picoTrackerSamplePool::directoryCount_ = 0;
+alignas(4) uint8_t
+    picoTrackerSamplePool::importBuffer_[2][FLASH_IMPORT_BUFFER_SIZE];
+const uint8_t *picoTrackerSamplePool::pending_ = nullptr;
+uint32_t picoTrackerSamplePool::pendingSize_ = 0;
 // From the SDK, values are not defined in the header file
 #define FLASH_RUID_DUMMY_BYTES 4
 #define FLASH_RUID_DATA_BYTES 8
@@ -55,46 +71,41 @@ picoTrackerSamplePool::picoTrackerSamplePool() : SamplePool() {
   // Detect the actual flash size at runtime
   uint32_t totalFlashSize = storage_get_flash_capacity();
 
-  // Calculate the maximum usable flash for samples
-  // This is either the 8MB limit or the actual available flash, whichever is
-  // smaller
-  uint32_t maxUsableFlash = SAMPLE_STORAGE_START_MB * MB;
-
   flashLimit_ = totalFlashSize;
+  store_ = SampleStore(flashLimit_ - FLASH_SAMPLE_STORE_OFFSET,
+                       FLASH_SECTOR_SIZE);
 
-  // Set the flash offset to maximum usable flash back from the top of the flash
-  // or immediately after the firmware
-  flashWriteOffset_ = flashEraseOffset_ =
-      flashLimit_ < SAMPLE_STORAGE_START_MB * MB ? FLASH_TARGET_OFFSET
-                                                 : SAMPLE_STORAGE_START_MB * MB;
+  // Samples go immediately after the firmware, around those left in flash by
+  // the previous session
+  openDirectory();
 
   Trace::Debug("Total flash size: %u bytes", totalFlashSize);
   Trace::Debug("Flash target offset: %u bytes", FLASH_TARGET_OFFSET);
-  Trace::Debug("Max usable flash: %u bytes", maxUsableFlash);
   Trace::Debug("Flash limit set to: %u bytes", flashLimit_);
-  Trace::Debug("Flash write offset set to: %u bytes", flashWriteOffset_);
+  Trace::Debug("Samples in flash: %u", directoryCount_ - 1);
+  Trace::Debug("Flash available: %u bytes", store_.Available());
 }
 
 void picoTrackerSamplePool::Reset() {
+  // Samples in the directory stay in flash for the projects loaded next, the
+  // space of the others (streamed or without a directory entry) is free again
+  for (uint32_t i = 0; i < count_; i++) {
+    uint32_t offset = (uintptr_t)wav_[i].GetSampleBuffer(0) - XIP_BASE;
+    if (offset >= FLASH_SAMPLE_STORE_OFFSET && findEntry(offset) == 0) {
+      store_.Release(offset - FLASH_SAMPLE_STORE_OFFSET,
+                     residentBytes(wav_[i]));
+    }
+  }
+
   count_ = 0;
   for (int i = 0; i < MAX_SAMPLES; i++) {
     wav_[i].Close();
     nameStore_[i][0] = '\0';
   };
-
-  // Reset flash erase and write pointers when we close project
-  flashEraseOffset_ = FLASH_TARGET_OFFSET;
-  flashWriteOffset_ = FLASH_TARGET_OFFSET;
 };
 
 bool picoTrackerSamplePool::loadSample(const char *name) {
   Trace::Log("SAMPLEPOOL", "Loading sample into flash: %s", name);
-  // Pause core1 in order to be able to write to flash and ensure core1 is
-  // not reading from it, it also disables IRQs on it
-  // https://www.raspberrypi.com/documentation/pico-sdk/high_level.html#multicore_lockout
-  if (multicore_lockout_victim_is_initialized(1)) {
-    multicore_lockout_start_blocking();
-  }
 
   if (count_ == MAX_SAMPLES)
     return false;
@@ -102,37 +113,171 @@ bool picoTrackerSamplePool::loadSample(const char *name) {
   auto res = wav_[count_].Open(name);
   if (!res) {
     Trace::Error("Failed to load sample:%s", name);
-    if (multicore_lockout_victim_is_initialized(1)) {
-      multicore_lockout_end_blocking();
-    }
     return false;
   }
   strncpy(nameStore_[count_], name, MAX_INSTRUMENT_FILENAME_LENGTH);
   nameStore_[count_][MAX_INSTRUMENT_FILENAME_LENGTH] = '\0';
   count_++;
 
-  if (!LoadInFlash(&wav_[count_ - 1])) {
+  if (!LoadInFlash(&wav_[count_ - 1], name)) {
     Trace::Error("Failed to load sample into flash: %s", name);
     count_--;
     nameStore_[count_][0] = '\0';
     wav_[count_].Close();
-    if (multicore_lockout_victim_is_initialized(1)) {
-      multicore_lockout_end_blocking();
-    }
     return false;
   }
 
   wav_[count_ - 1].Close();
+  return true;
+};
+
+// Any operation on the flash needs to ensure that nothing else reads from it
+// meanwhile. Core1 is paused and IRQs are disabled for a single page or erase
+// at a time, so audio and the card transfers keep going in between
+// https://www.raspberrypi.com/documentation/pico-sdk/high_level.html#multicore_lockout
+
+static uint32_t beginFlashWrite() {
+  if (multicore_lockout_victim_is_initialized(1)) {
+    multicore_lockout_start_blocking();
+  }
+  return save_and_disable_interrupts();
+}
 
+static void endFlashWrite(uint32_t irqs) {
+  restore_interrupts(irqs);
   if (multicore_lockout_victim_is_initialized(1)) {
     multicore_lockout_end_blocking();
   }
-  return true;
-};
+}
+
+// Erases the sectors of [start, end) that aren't known to be erased yet.
+// Erasing goes ahead to the next 64KB block boundary when the rest of the
+// block is free, as a block erases much faster than its sectors one by one,
+// and the following samples are likely to get written there
+
+void picoTrackerSamplePool::eraseFlash(uint32_t start, uint32_t end) {
+  uint32_t blockEnd = (end + FLASH_BLOCK_SIZE - 1) & ~(FLASH_BLOCK_SIZE - 1);
+  if (blockEnd <= flashLimit_ &&
+      store_.IsFree(end - FLASH_SAMPLE_STORE_OFFSET, blockEnd - end)) {
+    end = blockEnd;
+  }
+  uint32_t offset = start;
+  while (offset < end) {
+    if (offset >= erasedStart_ && offset < erasedEnd_) {
+      offset = std::min(erasedEnd_, end);
+      continue;
+    }
+    uint32_t size = FLASH_SECTOR_SIZE;
+    if ((offset % FLASH_BLOCK_SIZE) == 0 && offset + FLASH_BLOCK_SIZE <= end &&
+        (offset + FLASH_BLOCK_SIZE <= erasedStart_ || offset >= erasedEnd_)) {
+      size = FLASH_BLOCK_SIZE;
+    }
+    // Trace::Debug("About to erase flash region 0x%X - 0x%X",
+    //              offset, offset + size);
+    uint32_t irqs = beginFlashWrite();
+    flash_range_erase(offset, size);
+    endFlashWrite(irqs);
+    offset += size;
+  }
+
+  // Keep the erased range in one piece
+  if (start <= erasedEnd_ && end >= erasedStart_ && erasedEnd_ > 0) {
+    erasedStart_ = std::min(start, erasedStart_);
+    erasedEnd_ = std::max(end, erasedEnd_);
+  } else {
+    erasedStart_ = start;
+    erasedEnd_ = end;
+  }
+}
 
-bool picoTrackerSamplePool::LoadInFlash(WavFile *wave) {
+void picoTrackerSamplePool::programPage(const uint8_t *data) {
+  uint32_t irqs = beginFlashWrite();
+  flash_range_program(flashWriteOffset_, data, FLASH_PAGE_SIZE);
+  endFlashWrite(irqs);
+  flashWriteOffset_ += FLASH_PAGE_SIZE;
+}
+
+// Called by the card driver while it polls a transfer into the other buffer,
+// programs a page each time
+
+void picoTrackerSamplePool::programPending(uint32_t bytesComplete) {
+  if (pendingSize_ > 0) {
+    programPage(pending_);
+    pending_ += FLASH_PAGE_SIZE;
+    pendingSize_ -= FLASH_PAGE_SIZE;
+  }
+}
+
+// The first read of a sample brings the file to a sector boundary so that all
+// the following ones are multi-sector transfers straight into the buffers.
+// Reads come in 16 bit, 8 bit samples take half the bytes on the card
+
+static uint32_t firstReadSize(WavFile *wave) {
+  uint32_t frameSize = wave->GetFileFrameSize();
+  uint32_t align = (512 - wave->GetDataPosition() % 512) % 512;
+  if (align > 0 && (align % frameSize) == 0) {
+    return align / frameSize * wave->GetChannelCount(-1) * 2;
+  }
+  return FLASH_IMPORT_BUFFER_SIZE;
+}
+
+// The directory entry of a sample file, without its flash offset and crc.
+// Files the device writes all get the same default date, so the date alone
+// doesn't tell two samples of the same name and size apart. The project they
+// belong to and a crc of the first import buffer of the file, its header and
+// the start of its data, do
+
+FlashSampleEntry picoTrackerSamplePool::sampleKey(WavFile *wave,
+                                                  const char *name) {
+  FlashSampleEntry key = {};
+  const char *slash = strrchr(name, '/');
+  const char *file = slash ? slash + 1 : name;
+  etl::crc32 nameCrc((const uint8_t *)projectName_,
+                     (const uint8_t *)projectName_ + strlen(projectName_));
+  nameCrc.add('/');
+  nameCrc.add((const uint8_t *)file, (const uint8_t *)file + strlen(file));
+  key.name = nameCrc.value();
+  key.size = wave->GetDiskSize(-1);
+  key.modified = wave->GetModifyTime();
+
+  auto fp = FileSystem::GetInstance()->Open(name, "r");
+  if (fp) {
+    int read = fp->Read(importBuffer_[0], FLASH_IMPORT_BUFFER_SIZE);
+    if (read > 0) {
+      etl::crc32 head(importBuffer_[0], importBuffer_[0] + read);
+      key.head = head.value();
+    }
+  }
+  return key;
+}
+
+bool picoTrackerSamplePool::LoadInFlash(WavFile *wave, const char *name) {
+
+  // Samples already in flash only get their start read from the card. Those
+  // that can't be fully loaded even in an empty store don't go in the
+  // directory, nor do files whose start can't be read
+  FlashSampleEntry key = sampleKey(wave, name);
+  uint32_t size = key.size;
+  bool cacheable = size > 0 && size <= store_.Size() && key.head != 0;
+  if (cacheable) {
+    uint32_t offset;
+    if (findInDirectory(key, offset)) {
+      Trace::Log("SAMPLEPOOL", "Sample already in flash at 0x%X", offset);
+      wave->SetSampleBuffer((short *)(XIP_BASE + offset));
+      return true;
+    }
+  }
+
+  // The samples of other projects make room for the whole sample if they
+  // can, for its preload otherwise
+  uint32_t needed = size;
+  if (!cacheable || size > store_.Available() + evictable()) {
+    needed = std::min<uint32_t>(size, SAMPLE_STREAM_PRELOAD_BYTES);
+  }
+  evict(needed);
 
-  uint32_t FlashBaseBufferSize = wave->GetDiskSize(-1);
+  // Samples that don't fit only get their head loaded and stream the rest
+  uint32_t FlashBaseBufferSize = prepareResident(*wave, store_.Largest());
 
   // Size actually occupied in flash
   uint32_t FlashPageBufferSize =
@@ -142,73 +287,366 @@ bool picoTrackerSamplePool::LoadInFlash(WavFile *wave) {
   // Trace::Debug("Size in flash: %i (%i 256 byte pages)", FlashPageBufferSize,
   //              FlashPageBufferSize / FLASH_PAGE_SIZE);
 
-  if (flashWriteOffset_ + FlashPageBufferSize > flashLimit_) {
+  uint32_t allocation;
+  if (!store_.Allocate(FlashPageBufferSize, allocation)) {
     return false;
   }
 
   // Set wave base
-  wave->SetSampleBuffer((short *)(XIP_BASE + flashWriteOffset_));
-
-  // Any operation on the flash need to ensure that nothing else reads or writes
-  // on it We disable IRQs and ensure that we don't have multiprocessing on
-  // at this time
-  uint32_t irqs = save_and_disable_interrupts();
+  uint32_t sampleOffset = FLASH_SAMPLE_STORE_OFFSET + allocation;
+  uint32_t sampleEnd = sampleOffset + store_.Align(FlashPageBufferSize);
+  wave->SetSampleBuffer((short *)(XIP_BASE + sampleOffset));
 
-  // If data doesn't fit in previously erased page, we'll have to erase
+  // If data doesn't fit in previously erased sectors, we'll have to erase
   // additional ones
-  if (FlashPageBufferSize > (flashEraseOffset_ - flashWriteOffset_)) {
-    uint32_t additionalData =
-        FlashPageBufferSize - flashEraseOffset_ + flashWriteOffset_;
-    uint32_t sectorsToErase = ((additionalData / FLASH_SECTOR_SIZE) +
-                               ((additionalData % FLASH_SECTOR_SIZE) != 0)) *
-                              FLASH_SECTOR_SIZE;
-    // Trace::Debug("About to erase %i sectors in flash region 0x%X - 0x%X",
-    //              sectorsToErase, flashEraseOffset_,
-    //              flashEraseOffset_ + sectorsToErase);
-    // Erase required number of sectors
-    flash_range_erase(flashEraseOffset_, sectorsToErase);
-    // Move erase pointer to new position
-    flashEraseOffset_ += sectorsToErase;
-    // Trace::Debug("new erase offset: %p", flashEraseOffset_);
-  }
+  eraseFlash(sampleOffset, sampleEnd);
+  flashWriteOffset_ = sampleOffset;
 
-  uint32_t offset = 0;
-  uint32_t br = 0;
-  uint8_t readBuffer[BUFFER_SIZE];
+#ifdef SDIO_BENCH
+  uint32_t startTime = time_us_32();
+  uint32_t overlapped = 0;
+#endif
 
   wave->Rewind();
-  wave->Read(&readBuffer, BUFFER_SIZE, &br);
+  uint32_t readSize = firstReadSize(wave);
+
+  // Reads don't always end on a page, what's left over is completed with the
+  // start of the next read
+  uint8_t page[FLASH_PAGE_SIZE];
+  uint32_t paged = 0;
+
+  // The directory keeps the crc of what got programmed, summed as it's read
+  etl::crc32 crc;
+  uint32_t offset = 0;
+  uint32_t br = 0;
+  int current = 0;
+  wave->Read(importBuffer_[current],
+             std::min<uint32_t>(readSize, FlashBaseBufferSize), &br);
   while (br > 0) {
-    // We need to write double the bytes if we needed to expand to 16 bit
-    // Write size will be either 256 (which is the flash page size) or 512
-    uint32_t writeSize = br;
-    // Adjust to page size
-    writeSize =
-        ((writeSize / FLASH_PAGE_SIZE) + ((writeSize % FLASH_PAGE_SIZE) != 0)) *
-        FLASH_PAGE_SIZE;
-
-    // There will be trash at the end, but sampleBufferSize_ gives me the
-    // bounds
-    flash_range_program(flashWriteOffset_, (uint8_t *)readBuffer, writeSize);
-    flashWriteOffset_ += writeSize;
-    wave->Read(&readBuffer, BUFFER_SIZE, &br);
-  }
-
-  // Lastly we restore the IRQs
-  restore_interrupts(irqs);
+    offset += br;
+    const uint8_t *data = importBuffer_[current];
+    crc.add(data, data + br);
+    if (paged > 0) {
+      uint32_t fill = std::min<uint32_t>(FLASH_PAGE_SIZE - paged, br);
+      memcpy(page + paged, data, fill);
+      paged += fill;
+      data += fill;
+      br -= fill;
+      if (paged == FLASH_PAGE_SIZE) {
+        programPage(page);
+        paged = 0;
+      }
+    }
+    uint32_t whole = br - (br % FLASH_PAGE_SIZE);
+    memcpy(page + paged, data + whole, br - whole);
+    paged += br - whole;
+    pending_ = data;
+    pendingSize_ = whole;
+
+    // Read the next chunk into the other buffer while the pages of this one
+    // are programmed
+    current ^= 1;
+    br = 0;
+    if (offset < FlashBaseBufferSize) {
+      azplatform_set_sd_callback(programPending, importBuffer_[current]);
+      wave->Read(importBuffer_[current],
+                 std::min<uint32_t>(FLASH_IMPORT_BUFFER_SIZE,
+                                    FlashBaseBufferSize - offset),
+                 &br);
+      azplatform_set_sd_callback(nullptr, nullptr);
+    }
+#ifdef SDIO_BENCH
+    overlapped += whole - pendingSize_;
+#endif
+    while (pendingSize_ > 0) {
+      programPending(0);
+    }
+  }
+
+  // There will be trash at the end, but sampleBufferSize_ gives me the
+  // bounds
+  if (paged > 0) {
+    programPage(page);
+  }
+
+  // What's left erased starts after the sectors of the sample
+  if (erasedStart_ < sampleEnd && erasedEnd_ > sampleOffset) {
+    erasedStart_ = sampleEnd;
+    if (erasedStart_ >= erasedEnd_) {
+      erasedStart_ = erasedEnd_ = 0;
+    }
+  }
+
+#ifdef SDIO_BENCH
+  uint32_t elapsed = std::max<uint32_t>(time_us_32() - startTime, 1);
+  Trace::Debug("Flash import: %i bytes in %i us, %i KB/s, %i%% overlapped",
+               offset, elapsed, uint32_t(uint64_t(offset) * 1000 / elapsed),
+               offset ? uint32_t(uint64_t(overlapped) * 100 / offset) : 0);
+#endif
+
+  if (cacheable && FlashBaseBufferSize == size && offset == size) {
+    key.offset = sampleOffset;
+    key.crc = crc.value();
+    addToDirectory(key);
+  }
   return true;
 };
 
-bool picoTrackerSamplePool::unloadSample(uint32_t index) { return false; };
+static uint32_t entryCheck(const FlashSampleEntry &entry) {
+  const uint8_t *bytes = (const uint8_t *)&entry;
+  etl::crc32 crc(bytes, bytes + offsetof(FlashSampleEntry, check));
+  return crc.value();
+}
+
+static bool entryErased(const FlashSampleEntry &entry) {
+  const uint8_t *bytes = (const uint8_t *)&entry;
+  return std::all_of(bytes, bytes + sizeof(entry),
+                     [](uint8_t byte) { return byte == 0xFF; });
+}
+
+// Removed entries are programmed to zero
+static bool entryValid(const FlashSampleEntry &entry) {
+  return entry.offset != 0 && entry.check == entryCheck(entry);
+}
+
+static const FlashSampleEntry *directorySlots() {
+  return (const FlashSampleEntry *)(XIP_BASE + FLASH_SAMPLE_DIRECTORY_OFFSET);
+}
+
+// Finds the samples left in flash and takes their space out of the store.
+// Whatever got programmed without making it into the directory is free space
+// that gets erased before it's used again
+
+void picoTrackerSamplePool::openDirectory() {
+  const FlashSampleEntry *slots = directorySlots();
+  const FlashSampleEntry &header = slots[0];
+  if (header.name != FLASH_SAMPLE_DIRECTORY_MAGIC ||
+      header.size != FLASH_SAMPLE_DIRECTORY_VERSION ||
+      header.offset != FLASH_SAMPLE_DIRECTORY_OFFSET ||
+      header.crc != FLASH_SECTOR_SIZE ||
+      header.check != entryCheck(header)) {
+    Trace::Log("SAMPLEPOOL", "No sample directory in flash");
+    clearDirectory();
+    return;
+  }
+
+  store_.Reset();
+  directoryCount_ = 1;
+  while (directoryCount_ < FLASH_SAMPLE_DIRECTORY_SLOTS &&
+         !entryErased(slots[directoryCount_])) {
+    uint32_t slot = directoryCount_++;
+    const FlashSampleEntry &entry = slots[slot];
+    if (!entryValid(entry)) {
+      continue;
+    }
+    // Entries that don't match the store (another flash size, overlaps) are
+    // dropped
+    if (entry.offset < FLASH_SAMPLE_STORE_OFFSET ||
+        !store_.Reserve(entry.offset - FLASH_SAMPLE_STORE_OFFSET, entry.size)) {
+      invalidateEntry(slot);
+    }
+  }
+}
+
+void picoTrackerSamplePool::clearDirectory() {
+  uint32_t irqs = beginFlashWrite();
+  flash_range_erase(FLASH_SAMPLE_DIRECTORY_OFFSET, FLASH_SECTOR_SIZE);
+  endFlashWrite(irqs);
+
+  FlashSampleEntry header = {};
+  header.name = FLASH_SAMPLE_DIRECTORY_MAGIC;
+  header.size = FLASH_SAMPLE_DIRECTORY_VERSION;
+  header.offset = FLASH_SAMPLE_DIRECTORY_OFFSET;
+  header.crc = FLASH_SECTOR_SIZE;
+  header.check = entryCheck(header);
+  uint8_t page[FLASH_PAGE_SIZE];
+  memset(page, 0xFF, sizeof(page));
+  memcpy(page, &header, sizeof(header));
+  irqs = beginFlashWrite();
+  flash_range_program(FLASH_SAMPLE_DIRECTORY_OFFSET, page, FLASH_PAGE_SIZE);
+  endFlashWrite(irqs);
+
+  directoryCount_ = 1;
+  store_.Reset();
+}
+
+// Packs the valid entries at the start of the directory once all its slots
+// got used. A reset in between loses the directory, not the samples of the
+// current project
+
+void picoTrackerSamplePool::rewriteDirectory() {
+  static_assert(FLASH_IMPORT_BUFFER_SIZE >= FLASH_SECTOR_SIZE,
+                "directory gets rewritten from the import buffer");
+  const FlashSampleEntry *slots = directorySlots();
+  auto *packed = (FlashSampleEntry *)importBuffer_[0];
+  memset(packed, 0xFF, FLASH_SECTOR_SIZE);
+  uint32_t count = 0;
+  packed[count++] = slots[0];
+  for (uint32_t i = 1; i < directoryCount_; i++) {
+    if (entryValid(slots[i])) {
+      packed[count++] = slots[i];
+    }
+  }
+  Trace::Log("SAMPLEPOOL", "Rewriting sample directory, %u of %u entries",
+             count - 1, directoryCount_ - 1);
+
+  uint32_t irqs = beginFlashWrite();
+  flash_range_erase(FLASH_SAMPLE_DIRECTORY_OFFSET, FLASH_SECTOR_SIZE);
+  endFlashWrite(irqs);
+  uint32_t size = count * sizeof(FlashSampleEntry);
+  for (uint32_t page = 0; page < size; page += FLASH_PAGE_SIZE) {
+    irqs = beginFlashWrite();
+    flash_range_program(FLASH_SAMPLE_DIRECTORY_OFFSET + page,
+                        importBuffer_[0] + page, FLASH_PAGE_SIZE);
+    endFlashWrite(irqs);
+  }
+  directoryCount_ = count;
+}
+
+bool picoTrackerSamplePool::findInDirectory(const FlashSampleEntry &key,
+                                            uint32_t &offset) {
+  const FlashSampleEntry *slots = directorySlots();
+  for (uint32_t i = directoryCount_ - 1; i > 0; i--) {
+    const FlashSampleEntry &entry = slots[i];
+    if (entry.name == key.name && entry.size == key.size &&
+        entry.modified == key.modified && entry.head == key.head &&
+        entryValid(entry)) {
+#if VERBOSE_FLASH_DEBUG
+      const uint8_t *flash = (const uint8_t *)(XIP_BASE + entry.offset);
+      etl::crc32 crc(flash, flash + entry.size);
+      if (crc.value() != entry.crc) {
+        Trace::Error("Sample at 0x%X doesn't match its crc", entry.offset);
+      }
+#endif
+      offset = entry.offset;
+      return true;
+    }
+  }
+  return false;
+}
+
+// The directory slot of the sample at offset, 0 if it isn't in it
+
+uint32_t picoTrackerSamplePool::findEntry(uint32_t offset) {
+  const FlashSampleEntry *slots = directorySlots();
+  for (uint32_t i = directoryCount_ - 1; i > 0; i--) {
+    if (slots[i].offset == offset && entryValid(slots[i])) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+// Entries are programmed over the erased slots of their page, which leaves
+// the ones already there as they are. Programming only clears bits, so
+// removing an entry zeroes it in place
+
+static void programSlot(uint32_t slot, const FlashSampleEntry &entry) {
+  uint32_t position = slot * sizeof(FlashSampleEntry);
+  uint32_t pageStart = position & ~(FLASH_PAGE_SIZE - 1);
+  uint8_t page[FLASH_PAGE_SIZE];
+  memset(page, 0xFF, sizeof(page));
+  memcpy(page + position - pageStart, &entry, sizeof(entry));
+  uint32_t irqs = beginFlashWrite();
+  flash_range_program(FLASH_SAMPLE_DIRECTORY_OFFSET + pageStart, page,
+                      FLASH_PAGE_SIZE);
+  endFlashWrite(irqs);
+}
+
+void picoTrackerSamplePool::addToDirectory(const FlashSampleEntry &entry) {
+  if (directoryCount_ == FLASH_SAMPLE_DIRECTORY_SLOTS) {
+    rewriteDirectory();
+  }
+  // Still full, the sample's space gets freed with the project
+  if (directoryCount_ == FLASH_SAMPLE_DIRECTORY_SLOTS) {
+    return;
+  }
+  FlashSampleEntry checked = entry;
+  checked.check = entryCheck(checked);
+  programSlot(directoryCount_++, checked);
+}
+
+void picoTrackerSamplePool::invalidateEntry(uint32_t slot) {
+  FlashSampleEntry entry = {};
+  programSlot(slot, entry);
+}
+
+bool picoTrackerSamplePool::inUse(uint32_t offset, int except) {
+  for (uint32_t i = 0; i < count_; i++) {
+    if (int(i) != except &&
+        (uintptr_t)wav_[i].GetSampleBuffer(0) == XIP_BASE + offset) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t picoTrackerSamplePool::evictable() {
+  const FlashSampleEntry *slots = directorySlots();
+  uint32_t size = 0;
+  for (uint32_t i = 1; i < directoryCount_; i++) {
+    if (entryValid(slots[i]) && !inUse(slots[i].offset)) {
+      size += store_.Align(slots[i].size);
+    }
+  }
+  return size;
+}
+
+// Removes unused samples until a free block can take size bytes, false if
+// there's nothing left to remove
+
+bool picoTrackerSamplePool::evict(uint32_t size) {
+  const FlashSampleEntry *slots = directorySlots();
+  uint32_t slot = 1;
+  while (store_.Largest() < store_.Align(size)) {
+    while (slot < directoryCount_ &&
+           (!entryValid(slots[slot]) || inUse(slots[slot].offset))) {
+      slot++;
+    }
+    if (slot == directoryCount_) {
+      return false;
+    }
+    Trace::Log("SAMPLEPOOL", "Removing sample at 0x%X from flash",
+               slots[slot].offset);
+    store_.Release(slots[slot].offset - FLASH_SAMPLE_STORE_OFFSET,
+                   slots[slot].size);
+    invalidateEntry(slot);
+  }
+  return true;
+}
+
+bool picoTrackerSamplePool::unloadSample(uint32_t index) {
+  if (index >= count_)
+    return false;
+
+  // Samples loaded twice share their flash, it stays until the last one goes
+  uint32_t offset = (uintptr_t)wav_[index].GetSampleBuffer(0) - XIP_BASE;
+  if (offset >= FLASH_SAMPLE_STORE_OFFSET && !inUse(offset, index)) {
+    uint32_t slot = findEntry(offset);
+    if (slot != 0) {
+      invalidateEntry(slot);
+    }
+    store_.Release(offset - FLASH_SAMPLE_STORE_OFFSET,
+                   residentBytes(wav_[index]));
+  }
+
+  removeEntry(index);
+  return true;
+};
 
 bool picoTrackerSamplePool::CheckSampleFits(int sampleSize) {
-  // Calculate flash storage needed (round up to flash page size)
-  uint32_t flashNeeded =
-      ((sampleSize / FLASH_PAGE_SIZE) + ((sampleSize % FLASH_PAGE_SIZE) != 0)) *
-      FLASH_PAGE_SIZE;
+  // Samples bigger than the free space are streamed past their preload
+  sampleSize = std::min(sampleSize, SAMPLE_STREAM_PRELOAD_BYTES);
 
-  // Check if there's enough space available
-  uint32_t availableFlash = flashLimit_ - flashWriteOffset_;
+  // Calculate flash storage needed (round up to a whole sector)
+  uint32_t flashNeeded = store_.Align(sampleSize);
+
+  // Check if there's enough space available, unused samples of other projects
+  // make room
+  uint32_t availableFlash = store_.Largest();
+  if (availableFlash < flashNeeded) {
+    availableFlash = store_.Available() + evictable();
+  }
 
   return flashNeeded <= availableFlash;
 }
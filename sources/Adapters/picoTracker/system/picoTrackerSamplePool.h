@@ -12,6 +12,34 @@
 #include "Application/Instruments/WavFile.h"
 #include "System/Console/Trace.h"
 
+// Samples are read from the card in multi-sector chunks into one half of a
+// double buffer while the other half gets programmed into flash
+#define FLASH_IMPORT_BUFFER_SIZE 4096
+
+// Samples stay in flash from one project load to the next. The first sector
+// of the sample store holds a directory of them, by project and file name,
+// size, modification time and a crc of the start of the file, so that a load
+// only programs the samples that aren't there yet without reading more than
+// the start of the others from the card. Slot 0 is the header,
+// entries get appended to the following ones and are zeroed when their sample
+// is removed. Samples start on a sector so that they can be erased on their
+// own. The version changes with the layout of the directory or of the samples,
+// the header also records their alignment
+#define FLASH_SAMPLE_DIRECTORY_MAGIC 0x53465450 // "PTFS"
+#define FLASH_SAMPLE_DIRECTORY_VERSION 4
+
+// Entries take a power of two so that none straddles a flash page
+struct FlashSampleEntry {
+  uint32_t name;     // crc32 of project/file, magic for the header
+  uint32_t size;     // in bytes, version for the header
+  uint32_t modified; // date and time of the file on the card
+  uint32_t offset;   // in flash, of the directory itself for the header
+  uint32_t crc;      // of the sample as programmed, alignment for the header
+  uint32_t head;     // crc32 of the header and first data of the file
+  uint32_t reserved;
+  uint32_t check; // crc32 of the fields above, a torn write doesn't match
+};
+
 class picoTrackerSamplePool : public SamplePool {
 public:
   picoTrackerSamplePool();
@@ -19,8 +47,9 @@ public:
   ~picoTrackerSamplePool() {}
   virtual bool CheckSampleFits(int sampleSize);
 
+  // Includes samples of other projects that make room when needed
   virtual uint32_t GetAvailableSampleStorageSpace() override {
-    return (flashLimit_ - flashWriteOffset_);
+    return store_.Available() + evictable();
   }
 
 protected:
@@ -28,11 +57,38 @@ protected:
   virtual bool unloadSample(uint32_t index);
 
 private:
-  bool LoadInFlash(WavFile *wave);
+  bool LoadInFlash(WavFile *wave, const char *name);
+  FlashSampleEntry sampleKey(WavFile *wave, const char *name);
+  static void eraseFlash(uint32_t start, uint32_t end);
+  static void programPage(const uint8_t *data);
+  static void programPending(uint32_t bytesComplete);
 
-  static uint32_t flashEraseOffset_;
-  static uint32_t flashWriteOffset_;
+  static void openDirectory();
+  static void clearDirectory();
+  static void rewriteDirectory();
+  static bool findInDirectory(const FlashSampleEntry &key, uint32_t &offset);
+  static void addToDirectory(const FlashSampleEntry &entry);
+  static uint32_t findEntry(uint32_t offset);
+  static void invalidateEntry(uint32_t slot);
+
+  // Whether a loaded sample other than except plays from that flash offset
+  bool inUse(uint32_t offset, int except = -1);
+  // Samples of the directory that no loaded sample uses make room for new
+  // ones, oldest first
+  uint32_t evictable();
+  bool evict(uint32_t size);
+
+  static SampleStore store_; // offsets from the end of the directory
+  static uint32_t flashWriteOffset_; // where the next page gets programmed
+  static uint32_t erasedStart_;      // known to be erased, up to erasedEnd_
+  static uint32_t erasedEnd_;
   static uint32_t flashLimit_;
+  static uint32_t directoryCount_; // slots used, header included
+
+  alignas(4) static uint8_t importBuffer_[2][FLASH_IMPORT_BUFFER_SIZE];
+  // whole pages of the previous read still to be programmed
+  static const uint8_t *pending_;
+  static uint32_t pendingSize_;
 };
 
 #endif
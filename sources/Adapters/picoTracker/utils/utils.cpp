@@ -8,6 +8,7 @@
 
 #include "utils.h"
 #ifdef SDIO_BENCH
+#include "Adapters/picoTracker/system/picoTrackerSamplePool.h"
 #include "Externals/SdFat/src/SdFat.h"
 #endif
 #include "System/System/System.h"
@@ -80,6 +81,10 @@ void sd_bench() {
 
   // Read pass count.
   const uint8_t READ_COUNT = 2;
+
+  // Size of the multi-sector reads of the sample import, read passes are
+  // repeated with it
+  const size_t IMPORT_BUF_SIZE = FLASH_IMPORT_BUFFER_SIZE;
   //==============================================================================
   // End of configuration constants.
   //------------------------------------------------------------------------------
@@ -87,7 +92,7 @@ void sd_bench() {
   const uint32_t FILE_SIZE = 1000000UL * FILE_SIZE_MB;
 
   // Insure 4-byte alignment.
-  uint32_t buf32[(BUF_SIZE + 3) / 4];
+  static uint32_t buf32[(IMPORT_BUF_SIZE + 3) / 4];
   uint8_t *buf = (uint8_t *)buf32;
 
   SdFs sd;
@@ -185,45 +190,49 @@ void sd_bench() {
   }
   Trace::Debug("Starting read test, please wait.");
   Trace::Debug("read speed and latency");
-  Trace::Debug("speed,max,min,avg");
-  Trace::Debug("KB/Sec,usec,usec,usec");
-
-  // do read test
-  for (uint8_t nTest = 0; nTest < READ_COUNT; nTest++) {
-    file.rewind();
-    maxLatency = 0;
-    minLatency = 9999999;
-    totalLatency = 0;
-    skipLatency = SKIP_FIRST_LATENCY;
-    t = millis();
-    for (uint32_t i = 0; i < n; i++) {
-      buf[BUF_SIZE - 1] = 0;
-      uint32_t m = micros();
-      int32_t nr = file.read(buf, BUF_SIZE);
-      if (nr != BUF_SIZE) {
-        Trace::Debug("E: read failed");
-      }
-      m = micros() - m;
-      totalLatency += m;
-      if (buf[BUF_SIZE - 1] != '') {
+  Trace::Debug("size,speed,max,min,avg");
+  Trace::Debug("bytes,KB/Sec,usec,usec,usec");
+
+  // do read test, with single sectors and then as the sample import reads
+  const size_t readSizes[] = {BUF_SIZE, IMPORT_BUF_SIZE};
+  for (size_t readSize : readSizes) {
+    uint32_t reads = FILE_SIZE / readSize;
+    for (uint8_t nTest = 0; nTest < READ_COUNT; nTest++) {
+      file.rewind();
+      maxLatency = 0;
+      minLatency = 9999999;
+      totalLatency = 0;
+      skipLatency = SKIP_FIRST_LATENCY;
+      t = millis();
+      for (uint32_t i = 0; i < reads; i++) {
+        buf[readSize - 1] = 0;
+        uint32_t m = micros();
+        int32_t nr = file.read(buf, readSize);
+        if (nr != int32_t(readSize)) {
+          Trace::Debug("E: read failed");
+        }
+        m = micros() - m;
+        totalLatency += m;
+        if (buf[readSize - 1] != '\n') {
 
-        Trace::Debug("E: data check error");
-      }
-      if (skipLatency) {
-        skipLatency = false;
-      } else {
-        if (maxLatency < m) {
-          maxLatency = m;
+          Trace::Debug("E: data check error");
         }
-        if (minLatency > m) {
-          minLatency = m;
+        if (skipLatency) {
+          skipLatency = false;
+        } else {
+          if (maxLatency < m) {
+            maxLatency = m;
+          }
+          if (minLatency > m) {
+            minLatency = m;
+          }
         }
       }
+      s = reads * readSize;
+      t = millis() - t;
+      Trace::Debug("%i,%i,%i,%i,%i", readSize, s / t, maxLatency, minLatency,
+                   totalLatency / reads);
     }
-    s = file.fileSize();
-    t = millis() - t;
-    Trace::Debug("%i,%i,%i,%i", s / t, maxLatency, minLatency,
-                 totalLatency / n);
   }
   Trace::Debug("Done");
   file.close();
@@ -702,6 +702,11 @@ void AppWindow::onUpdate(bool redraw) {
 void AppWindow::AnimationUpdate() {
   // Increment the animation frame counter
   animationFrameCounter_++;
+
+  // Keep the file streamer ahead of the audio thread, before and after the
+  // (potentially long) redraw
+  Player *player = Player::GetInstance();
+  player->FillStreamingBuffer();
   char failedProjectName_[MAX_PROJECT_NAME_LENGTH] = {0};
 
   if (awaitingProjectLoadAck_) {
@@ -794,6 +799,7 @@ void AppWindow::AnimationUpdate() {
 
   // Always flush after AnimationUpdate to ensure consistent state
   Flush();
+  player->FillStreamingBuffer();
 
   // *attempt* to auto save every AUTOSAVE_INTERVAL_IN_SECONDS
   // will return false if auto save was unsuccessful because eg. the sequencer
@@ -1007,22 +1013,25 @@ void AppWindow::SetColor(ColorDefinition cd) {
 
 bool AppWindow::autoSave() {
   Player *player = Player::GetInstance();
-  // only auto save when sequencer is not running and not recording
-  bool recording = IsRecordingActive();
-  if (!player->IsRunning() && !recording) {
-    Trace::Log("APPWINDOW", "AutoSaving Project Data");
-    // get persistence service and call autosave
-    PersistencyService *ps = PersistencyService::GetInstance();
-    auto result = ps->AutoSaveProjectData(projectName_);
-    if (result != PERSIST_SAVED) {
-      Trace::Error("APPWINDOW", "Failed to auto-save project data");
-      // we dont return false here as we dont want to go into a bombardment of
-      // auto save attempts and instead just attempt to auto save again after
-      // the next interval
-    }
-    return true;
+  // never auto save while recording. While the sequencer runs only the
+  // changes since the last auto save get journaled, which is a small write
+  if (IsRecordingActive()) {
+    return false;
   }
-  return false;
+  // get persistence service and call autosave
+  PersistencyService *ps = PersistencyService::GetInstance();
+  auto result = ps->AutoSaveProjectData(projectName_, player->IsRunning());
+  if (result == PERSIST_DEFERRED) {
+    // needs a full save, which waits for the sequencer to stop
+    return false;
+  }
+  if (result != PERSIST_SAVED) {
+    Trace::Error("APPWINDOW", "Failed to auto-save project data");
+    // we dont return false here as we dont want to go into a bombardment of
+    // auto save attempts and instead just attempt to auto save again after
+    // the next interval
+  }
+  return true;
 }
 
 // Maps the ColorDefinition used in View classes to a GUIColor that is needed by
@@ -15,23 +15,34 @@
 #include "System/FileSystem/FileSystem.h"
 #include "System/System/System.h"
 #include "System/io/Status.h"
+#include <algorithm>
 #include <string.h>
 #include <vector>
 
 // Initialize the static buffer for single cycle waveforms
 short AudioFileStreamer::singleCycleBuffer_[SINGLE_CYCLE_MAX_SAMPLE_SIZE] = {0};
+short AudioFileStreamer::ring_[STREAM_RING_SAMPLES];
 
 AudioFileStreamer::AudioFileStreamer() {
   mode_ = AFSM_STOPPED;
   position_ = 0;
+  startPosition_ = 0;
+  startFrame_ = 0;
+  generation_ = 0;
+  played_ = 0;
+  ended_ = 0;
+  frameCount_ = 0;
+  channelCount_ = 1;
   fileSampleRate_ = 44100;   // Default
   systemSampleRate_ = 44100; // Default
   fpSpeed_ = FP_ONE;         // Default 1.0 in fixed point
   project_ = NULL;
   singleCycleData_ = NULL;
-#ifndef ADV
-  stopRequested_ = false;
-#endif
+  ringFrames_ = STREAM_RING_SAMPLES;
+  writeFrame_ = 0;
+  readFrame_ = 0;
+  endOfFile_ = true;
+  underruns_ = 0;
   referencePitch_ = 261.63f; // C4 = 261.63 Hz (using C4 to compensate for how
                              // its actually what we call C3 in pT)
 };
@@ -40,11 +51,11 @@ AudioFileStreamer::~AudioFileStreamer() { wav_.Close(); };
 
 bool AudioFileStreamer::Start(const char *name, int startSample, bool looping) {
   Trace::Debug("Starting to stream:%s from sample %d", name, startSample);
+  // Make sure the audio thread leaves the ring and file alone while we set up
+  mode_ = AFSM_STOPPED;
+  endOfFile_.store(true, std::memory_order_release);
   strcpy(name_, name);
-  position_ = (startSample > 0) ? float(startSample) : 0.0f;
-#ifndef ADV
-  stopRequested_ = false;
-#endif
+  startPosition_ = (startSample > 0) ? float(startSample) : 0.0f;
 
   wav_.Close();
   Trace::Log("", "wave open:%s", name_);
@@ -60,6 +71,8 @@ bool AudioFileStreamer::Start(const char *name, int startSample, bool looping) {
   systemSampleRate_ = Audio::GetInstance()->GetSampleRate();
   int channels = wav_.GetChannelCount(-1);
   long size = wav_.GetSize(-1);
+  channelCount_ = channels;
+  frameCount_ = size;
 
   // Calculate the speed factor for sample rate conversion
   float ratio;
@@ -96,9 +109,6 @@ bool AudioFileStreamer::Start(const char *name, int startSample, bool looping) {
   if (looping) {
     Trace::Log("FileStreamer", "mode: looping");
 
-    // Get channel count before using it
-    int channels = wav_.GetChannelCount(-1);
-
     // For safety, load the waveform in smaller chunks to avoid buffer
     // overflow FLASH_PAGE_SIZE  and the assertion in  WavFile::GetBuffer
     // requires size < FLASH_PAGE_SIZE/2, so we use 64 as a safe chunk size
@@ -152,58 +162,103 @@ bool AudioFileStreamer::Start(const char *name, int startSample, bool looping) {
       // We didn't load the entire waveform
       Trace::Error("Failed to load entire single cycle waveform");
     }
+  } else {
+    // Prime the ring so playback starts without waiting on the main loop.
+    // Until Render() picks up the new generation, its read position is the
+    // start frame
+    startFrame_ = (uint32_t)startPosition_;
+    ringFrames_ = STREAM_RING_SAMPLES / channels;
+    writeFrame_.store(startFrame_, std::memory_order_relaxed);
+    endOfFile_.store(!wav_.Rewind(startFrame_), std::memory_order_release);
+    generation_.fetch_add(1, std::memory_order_release);
+    Fill();
   }
 
-  // Once we were able to open the file, set the mode. This is to avoid a race
-  // condition of render potentially running before start finishes
+  // Once we were able to open the file, set the mode and publish the new
+  // start to the audio thread. This is to avoid a race condition of render
+  // potentially running before start finishes
   mode_ = looping ? AFSM_LOOPING : AFSM_PLAYING;
+  generation_.fetch_add(1, std::memory_order_release);
 
   return true;
 };
 
 void AudioFileStreamer::Stop() {
-#ifndef ADV
-  // Because Stop() is called from the "ui thread"" (Core0 on pico) while
-  // rendering is on "audio thread" (Core1 on pico), can get a race if the wav
-  // file is closed in Stop() while rendering is still reading from the file to
-  // stream the audio data so instead just set flag to request the stop happen
-  // in Render()
-  stopRequested_ = true;
-  mode_ = AFSM_STOPPED;
-  Trace::Debug("Streaming stopped");
-#else
+  // Render() only reads from the ring, so the file can be closed right away
+  // from the main thread
   mode_ = AFSM_STOPPED;
   wav_.Close();
+  endOfFile_.store(true, std::memory_order_release);
+  if (underruns_ > 0) {
+    Trace::Log("FileStreamer", "%d underruns", (int)underruns_);
+  }
   Trace::Debug("Streaming stopped");
-#endif
 };
 
+uint32_t AudioFileStreamer::readPosition() {
+  if (played_.load(std::memory_order_acquire) !=
+      generation_.load(std::memory_order_relaxed)) {
+    return startFrame_;
+  }
+  return readFrame_.load(std::memory_order_acquire);
+}
+
+void AudioFileStreamer::Fill() {
+  if (mode_ == AFSM_LOOPING || endOfFile_.load(std::memory_order_relaxed) ||
+      !wav_.IsOpen()) {
+    return;
+  }
+  int channels = channelCount_;
+
+  // Large sequential reads straight into the ring, at most up to its wrap
+  // point at a time
+  for (;;) {
+    uint32_t write = writeFrame_.load(std::memory_order_relaxed);
+    uint32_t read = readPosition();
+    uint32_t free = ringFrames_ - (write - read);
+    uint32_t index = write & (ringFrames_ - 1);
+    uint32_t frames = std::min(free, ringFrames_ - index);
+    if (frames == 0) {
+      return;
+    }
+    uint32_t bytesRead = 0;
+    if (!wav_.Read(ring_ + index * channels, frames * channels * sizeof(short),
+                   &bytesRead) ||
+        bytesRead == 0) {
+      endOfFile_.store(true, std::memory_order_release);
+      return;
+    }
+    writeFrame_.store(write + bytesRead / (channels * sizeof(short)),
+                      std::memory_order_release);
+  }
+}
+
 bool AudioFileStreamer::IsPlaying() {
-  return (mode_ == AFSM_PLAYING || mode_ == AFSM_LOOPING);
+  return (mode_ == AFSM_PLAYING || mode_ == AFSM_LOOPING) &&
+         ended_.load(std::memory_order_acquire) !=
+             generation_.load(std::memory_order_relaxed);
 }
 
 bool AudioFileStreamer::Render(fixed *buffer, int samplecount) {
-#ifndef ADV
-  if (stopRequested_) {
-    wav_.Close();
-    stopRequested_ = false;
-    mode_ = AFSM_STOPPED;
-    return false;
+  // Pick up a new start before anything else, the previous play head is
+  // stale
+  uint32_t generation = generation_.load(std::memory_order_acquire);
+  if (played_.load(std::memory_order_relaxed) != generation) {
+    position_ = startPosition_;
+    readFrame_.store(startFrame_, std::memory_order_relaxed);
+    underruns_ = 0;
+    played_.store(generation, std::memory_order_release);
   }
-#endif
+
   // See if we're playing
-  if (mode_ == AFSM_STOPPED) {
-    return false;
-  }
-  // look if we have the file loaded
-  if (!wav_.IsOpen()) {
-    Trace::Error("Failed to open streaming of file:%s", name_);
-    mode_ = AFSM_STOPPED;
+  if (mode_ == AFSM_STOPPED ||
+      ended_.load(std::memory_order_relaxed) == generation) {
     return false;
   }
-  // We are playing a valid file
-  long size = wav_.GetSize(-1);
-  int channelCount = wav_.GetChannelCount(-1);
+  // We are playing a valid file, as Start() described it before publishing
+  // the generation
+  long size = frameCount_;
+  int channelCount = channelCount_;
 
   // Clear the output buffer
   memset(buffer, 0, samplecount * 2 * sizeof(fixed));
@@ -228,7 +283,7 @@ bool AudioFileStreamer::Render(fixed *buffer, int samplecount) {
     // Use our static buffer that we've already loaded with the entire waveform
     if (!singleCycleData_) {
       Trace::Error("AudioFileStreamer: Single cycle buffer is null");
-      mode_ = AFSM_STOPPED;
+      ended_.store(generation, std::memory_order_release);
       return false;
     }
 
@@ -299,77 +354,32 @@ bool AudioFileStreamer::Render(fixed *buffer, int samplecount) {
     return true;
   }
 
-  // Standard playback for normal samples
-  int bufferSize = 64; // Small, safe buffer size
-
-  // Check if we're near the end of the file
-  if (position_ + (samplecount * fp2fl(fpSpeed_)) >= size) {
-    // We'll reach the end during this render call
-    int remainingSamples = size - position_;
-    if (remainingSamples <= 0) {
-      mode_ = AFSM_STOPPED;
-      return false;
-    }
-  }
-
-  // Read the samples from the file - just once at the current position
-  if (!wav_.GetBuffer((int)position_, bufferSize)) {
-    Trace::Error("AudioFileStreamer: Failed to get buffer at position %d",
-                 (int)position_);
-    mode_ = AFSM_STOPPED;
-    return false;
-  }
-
-  // Get the sample buffer
-  short *src = (short *)wav_.GetSampleBuffer(-1);
-  if (!src) {
-    Trace::Error("AudioFileStreamer: GetSampleBuffer returned null");
-    mode_ = AFSM_STOPPED;
-    return false;
-  }
-
-  // Process each output sample
+  // Standard playback for normal samples, straight from the ring
+  // The end of the file first: once it's set, writeFrame_ has its last value
+  bool endOfFile = endOfFile_.load(std::memory_order_acquire);
+  uint32_t available = writeFrame_.load(std::memory_order_acquire);
+  uint32_t mask = ringFrames_ - 1;
   float pos = position_;
 
   for (int i = 0; i < samplecount; i++) {
-    // Check if we need to read more samples
-    if ((int)pos >= (int)position_ + bufferSize - 1) {
-      // We've moved past our buffer, need to read more
-      position_ = (int)pos;
-
-      // Check if we've reached the end of the file
-      if (position_ >= size - 1) {
-        mode_ = AFSM_STOPPED;
-        return false;
-      }
-
-      // Read the next buffer
-      if (!wav_.GetBuffer((int)position_, bufferSize)) {
-        Trace::Error("AudioFileStreamer: Failed to get buffer at position %d",
-                     (int)position_);
-        mode_ = AFSM_STOPPED;
-        return false;
-      }
-
-      // Update the source pointer
-      src = (short *)wav_.GetSampleBuffer(-1);
-      if (!src) {
-        Trace::Error("AudioFileStreamer: GetSampleBuffer returned null");
-        mode_ = AFSM_STOPPED;
-        return false;
+    uint32_t frame = (uint32_t)pos;
+    // interpolation needs the next frame too
+    if (frame + 1 >= available) {
+      if (endOfFile || frame + 1 >= (uint32_t)size) {
+        ended_.store(generation, std::memory_order_release);
+      } else {
+        // the main thread fell behind, leave silence and resume from here
+        underruns_++;
       }
-
-      // Adjust position to be relative to the new buffer
-      pos = position_;
+      break;
     }
 
-    // Calculate the source position and fractional part
-    int sourcePos = (int)(pos - position_);
-    float frac = pos - (position_ + sourcePos);
+    // Calculate the fractional part
+    float frac = pos - (float)frame;
 
     // Get the current and next sample for interpolation
-    short *currentSample = src + (sourcePos * channelCount);
-    short *nextSample = currentSample + channelCount;
+    short *currentSample = ring_ + (frame & mask) * channelCount;
+    short *nextSample = ring_ + ((frame + 1) & mask) * channelCount;
 
     // Linear interpolation between samples
     fixed fpFrac = fl2fp(frac);
@@ -393,12 +403,14 @@ bool AudioFileStreamer::Render(fixed *buffer, int samplecount) {
     pos += fp2fl(fpSpeed_);
   }
 
-  // Update the position for the next render call
+  // Update the position for the next render call and hand the frames we are
+  // done with back to the main thread
   position_ = pos;
+  readFrame_.store((uint32_t)pos, std::memory_order_release);
 
   // If we've reached the end of the file, stop playback
   if (position_ >= size) {
-    mode_ = AFSM_STOPPED;
+    ended_.store(generation, std::memory_order_release);
   }
 
   return true;
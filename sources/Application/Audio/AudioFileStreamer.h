@@ -13,9 +13,14 @@
 #include "Application/Instruments/WavFile.h"
 #include "Application/Model/Project.h"
 #include "Services/Audio/AudioModule.h"
+#include <atomic>
 
 #define SINGLE_CYCLE_MAX_SAMPLE_SIZE 600
 
+// Streaming ring buffer, in 16 bit samples (power of two). Holds ~93ms of
+// 44.1kHz stereo, about three UI frames worth of card latency
+#define STREAM_RING_SAMPLES 8192
+
 enum AudioFileStreamerMode { AFSM_STOPPED, AFSM_PLAYING, AFSM_LOOPING };
 
 class AudioFileStreamer : public AudioModule {
@@ -27,14 +32,36 @@ public:
   bool Start(const char *name, int startSample = 0, bool looping = false);
   void Stop();
   bool IsPlaying();
+  // Tops up the ring buffer from the file. Main thread only, the audio thread
+  // never touches the card
+  void Fill();
+  uint32_t GetUnderrunCount() { return underruns_; }
 
 protected:
-  AudioFileStreamerMode mode_;
+  // Oldest frame of the current generation still needed by Render()
+  uint32_t readPosition();
+
+  // Set by the main thread, Render() ends a stream through ended_ instead
+  std::atomic<AudioFileStreamerMode> mode_;
   char name_[256];
   WavFile wav_;
-  float position_;
+  float position_;      // audio thread, from startPosition_ on
+  float startPosition_; // where Start() wants playback to begin
+  uint32_t startFrame_;
   Project *project_;
 
+  // Each Start() publishes a new generation of the stream, which Render()
+  // picks up on its next call by resetting its play head. A Render() still
+  // running on the previous generation meanwhile can't overwrite the new
+  // position with a stale one
+  std::atomic<uint32_t> generation_; // main thread
+  std::atomic<uint32_t> played_;     // generation Render() plays
+  std::atomic<uint32_t> ended_;      // generation that reached its end
+  // Of the file, set by Start() before it publishes a generation. Render()
+  // reads these rather than wav_, which Start() may be reopening
+  long frameCount_;
+  int channelCount_;
+
   // Sample rate conversion
   int fileSampleRate_;
   int systemSampleRate_;
@@ -47,9 +74,18 @@ protected:
 
   // For matching oscillator mode in SampleInstrument
   float referencePitch_; // Reference pitch in Hz (C3 = 130.81 Hz)
-#ifndef ADV
-  volatile bool stopRequested_;
-#endif
+
+  // Ring of interleaved file frames. Positions are absolute file frames,
+  // written by Fill() (main thread) and read by Render() (audio thread)
+  static short ring_[STREAM_RING_SAMPLES];
+  uint32_t ringFrames_; // capacity in frames for the file's channel count
+  std::atomic<uint32_t> writeFrame_; // next frame to be filled
+  std::atomic<uint32_t> readFrame_;  // oldest frame still needed by Render,
+                                     // only valid once played_ is current
+  // Set after the last writeFrame_ of the file, so that a Render() that sees
+  // it also sees every frame there is
+  std::atomic<bool> endOfFile_;
+  std::atomic<uint32_t> underruns_;
 
 public:
   void SetProject(Project *project) { project_ = project; }
@@ -23,13 +23,78 @@ bool filters_inited = false;
 
 fixed fp_inv_255;
 
+// Bassy cutoff mapping: 10^(0.6 + 3.1 * cutoff) / 22050. pow() is soft float
+// on the RP2040 so the mapping is tabulated at compile time over the 0..1
+// cutoff range (256 steps) and interpolated linearly in between
+
+#define BASSY_TABLE_SHIFT 7
+#define BASSY_TABLE_SIZE ((FP_ONE >> BASSY_TABLE_SHIFT) + 1)
+
+static constexpr fixed fpFreqDivider = fixed((1 / 22050.0f) * FIXED_SCALE);
+static constexpr fixed fpZeroSix = fixed(0.6f * FIXED_SCALE);
+static constexpr fixed fpThreeOne = fixed(3.1f * FIXED_SCALE);
+
+static constexpr double constexprPow10(double y) {
+  // 10^y = 10^int(y) * e^(frac(y) * ln(10))
+  double result = 1.0;
+  while (y >= 1.0) {
+    result *= 10.0;
+    y -= 1.0;
+  }
+  double x = y * 2.302585092994045684;
+  double term = 1.0;
+  double sum = 1.0;
+  for (int n = 1; n < 40; n++) {
+    term *= x / n;
+    sum += term;
+  }
+  return result * sum;
+}
+
+static constexpr fixed bassyFrequency(fixed param1) {
+  fixed power = fp_add(fpZeroSix, fp_mul(param1, fpThreeOne));
+  fixed frequency =
+      fixed(constexprPow10(double(power) / FIXED_SCALE) * FIXED_SCALE);
+  return fp_mul(frequency, fpFreqDivider);
+}
+
+struct BassyTable {
+  fixed freq[BASSY_TABLE_SIZE];
+};
+
+static constexpr BassyTable makeBassyTable() {
+  BassyTable table{};
+  for (int i = 0; i < BASSY_TABLE_SIZE; i++) {
+    table.freq[i] = bassyFrequency(i << BASSY_TABLE_SHIFT);
+  }
+  return table;
+}
+
+static constexpr BassyTable bassyTable = makeBassyTable();
+
+static fixed bassyMap(fixed param1) {
+  if (param1 < 0 || param1 > FP_ONE) {
+    // ramps can push the cutoff out of range, compute those directly
+    fixed power = fp_add(fpZeroSix, fp_mul(param1, fpThreeOne));
+    fixed frequency = fl2fp(pow(10.0f, fp2fl(power)));
+    return fp_mul(frequency, fpFreqDivider);
+  }
+  int index = param1 >> BASSY_TABLE_SHIFT;
+  fixed frac = param1 & ((1 << BASSY_TABLE_SHIFT) - 1);
+  fixed freq = bassyTable.freq[index];
+  if (frac != 0) {
+    freq += ((bassyTable.freq[index + 1] - freq) * frac) >> BASSY_TABLE_SHIFT;
+  }
+  return freq;
+}
+
 void init_filters(void) {
 
+  fp_inv_255 = fl2fp(1.0f / 255);
   for (int i = 0; i < 8; i++) { // set sensible default values
     // lowpass filter where everything passes with no resonance
     set_filter(i, FLT_LOWPASS, i2fp(1), i2fp(0), i2fp(0), false);
   }
-  fp_inv_255 = fl2fp(1.0f / 255);
   filters_inited = true;
 }
 
@@ -37,6 +102,13 @@ void set_filter(int channel, filterType_t type, fixed param1, fixed param2,
                 int mix, bool bassyMapping) {
   filter_t *flt = &filter[channel];
 
+  // Called for every buffer of every voice, most of the time with the same
+  // settings
+  if (flt->type == type && flt->parm1 == param1 && flt->parm2 == param2 &&
+      flt->mixParm == mix && flt->bassy == bassyMapping) {
+    return;
+  }
+
   if (flt->type != type) // reset only on filter type change   (maybe no reset
                          // would make interresting bugs)
   {
@@ -49,22 +121,20 @@ void set_filter(int channel, filterType_t type, fixed param1, fixed param2,
     flt->type = type;
   }
 
-  flt->dirt = fp_mul(i2fp(100), i2fp(1) - param1) + fp_mul(i2fp(5000), param1);
-  flt->mix = fp_mul(i2fp(mix), fp_inv_255);
+  if (mix != flt->mixParm) {
+    flt->mixParm = mix;
+    flt->mix = fp_mul(i2fp(mix), fp_inv_255);
+  }
 
-  if (param1 != flt->parm1) {
+  if (param1 != flt->parm1 || bassyMapping != flt->bassy) {
     flt->parm1 = param1;
+    flt->bassy = bassyMapping;
+    flt->dirt =
+        fp_mul(i2fp(100), i2fp(1) - param1) + fp_mul(i2fp(5000), param1);
     // adjust parm to get the most of the parameters, as the fx are more useful
     // with near-limit parameters.
     if (bassyMapping) {
-      static const fixed fpFreqDivider = fl2fp(1 / 22050.0f);
-      static const fixed fpZeroSix = fl2fp(0.6f);
-      static const fixed fpThreeOne = fl2fp(3.1f);
-
-      fixed power = fp_add(fpZeroSix, fp_mul(param1, fpThreeOne));
-      fixed frequency = fl2fp(pow(10.0f, fp2fl(power)));
-      frequency = fp_mul(frequency, fpFreqDivider);
-      flt->freq = frequency;
+      flt->freq = bassyMap(param1);
     } else {
       flt->freq = fp_mul(param1, param1); // 0 - .5 - 1   =>   0 - .25 - 1
     }
@@ -40,6 +40,8 @@ typedef struct {
   fixed freq, reso;
   fixed dirt;
   fixed mix;
+  int mixParm; // mix setting & mapping the coefficients were computed for
+  bool bassy;
 } filter_t;
 
 void set_filter(int channel, filterType_t type, fixed parm1, fixed parm2,
@@ -113,6 +113,53 @@ void I_Instrument::RestoreContent(PersistencyDocument *doc) {
   }
 }
 
+void I_Instrument::SaveBinaryContent(BinaryPrinter *printer) {
+  SaveBinaryParams(printer);
+  printer->WriteString("");
+}
+
+void I_Instrument::RestoreBinaryContent(BinaryDocument *doc) {
+  char name[MAX_VARIABLE_STRING_LENGTH + 1];
+  char value[MAX_VARIABLE_STRING_LENGTH + 1];
+  while (doc->ReadString(name, sizeof(name)) && name[0] != '\0' &&
+         doc->ReadString(value, sizeof(value))) {
+    if (value[0] != '\0' && !RestoreParam(name, value)) {
+      Trace::Error("Parameter '%s' not found in instrument", name);
+    }
+  }
+
+  Variable *nameVar = FindVariable(FourCC::InstrumentName);
+  if (nameVar && !name_.empty()) {
+    nameVar->SetString(name_.c_str());
+  }
+}
+
+void I_Instrument::SaveBinaryParams(BinaryPrinter *printer) {
+  // the name isn't stored in the Variables, as in the XML format
+  if (!name_.empty()) {
+    printer->WriteString("InstrumentName");
+    printer->WriteString(name_.c_str());
+  }
+  for (auto it = Variables()->begin(); it != Variables()->end(); it++) {
+    printer->WriteString((*it)->GetName());
+    printer->WriteString((*it)->GetString().c_str());
+  }
+}
+
+bool I_Instrument::RestoreParam(const char *name, const char *value) {
+  if (!strcasecmp(name, "InstrumentName")) {
+    SetName(value);
+    return true;
+  }
+  for (auto it = Variables()->begin(); it != Variables()->end(); it++) {
+    if (!strcasecmp((*it)->GetName(), name)) {
+      (*it)->SetString(value);
+      return true;
+    }
+  }
+  return false;
+}
+
 void I_Instrument::Purge() {
   for (auto it = Variables()->begin(); it != Variables()->end(); it++) {
     (*it)->Reset();
@@ -63,6 +63,12 @@ public:
   virtual bool Render(int channel, fixed *buffer, int size,
                       bool updateTick) = 0;
 
+  // advances the instrument as Render would, for channels nobody listens to.
+  // Instruments that can't do it any cheaper just render into the buffer
+  virtual void Skip(int channel, fixed *buffer, int size, bool updateTick) {
+    Render(channel, buffer, size, updateTick);
+  };
+
   virtual bool IsInitialized() = 0;
 
   virtual bool IsEmpty() = 0;
@@ -118,5 +124,13 @@ public:
   // Persistent implementation
   virtual void SaveContent(tinyxml2::XMLPrinter *printer) override;
   virtual void RestoreContent(PersistencyDocument *doc) override;
+  virtual void SaveBinaryContent(BinaryPrinter *printer) override;
+  virtual void RestoreBinaryContent(BinaryDocument *doc) override;
+
+protected:
+  // Binary parameters are name/value pairs ended by an empty name
+  virtual void SaveBinaryParams(BinaryPrinter *printer);
+  // Applies a restored parameter, false if the instrument doesn't have it
+  virtual bool RestoreParam(const char *name, const char *value);
 };
 #endif
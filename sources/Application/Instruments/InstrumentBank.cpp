@@ -123,6 +123,66 @@ void InstrumentBank::RestoreContent(PersistencyDocument *doc) {
   };
 };
 
+// Instruments are stored as their id and type followed by their parameters,
+// up to the end of the section
+
+void InstrumentBank::SaveBinaryContent(BinaryPrinter *printer) {
+  int i = 0;
+  for (auto &instr : instruments_) {
+    if (!instr->IsEmpty()) {
+      printer->WriteU8(i);
+      printer->WriteU8(instr->GetType());
+      instr->SaveBinaryContent(printer);
+    }
+    i++;
+  }
+};
+
+void InstrumentBank::RestoreBinaryContent(BinaryDocument *doc) {
+  uint8_t id, type;
+  while (doc->Remaining() > 0 && doc->ReadU8(id) && doc->ReadU8(type)) {
+    if (id >= MAX_INSTRUMENT_COUNT || type == IT_NONE || type >= IT_LAST) {
+      Trace::Error("Invalid instrument %d of type %d in binary project", id,
+                   type);
+      return;
+    }
+    if (GetNextAndAssignID((InstrumentType)type, id) == NO_MORE_INSTRUMENT) {
+      Trace::Error("Failed to allocate instrument type:%d", type);
+      return;
+    }
+    instruments_[id]->RestoreBinaryContent(doc);
+  }
+};
+
+// One journal region per instrument slot, empty slots only have their type
+
+void InstrumentBank::SaveJournalRegion(BinaryPrinter *printer,
+                                       uint16_t region) {
+  I_Instrument *instr = instruments_[region];
+  printer->WriteU8(instr->GetType());
+  if (instr->GetType() != IT_NONE) {
+    instr->SaveBinaryContent(printer);
+  }
+};
+
+void InstrumentBank::RestoreJournalRegion(BinaryDocument *doc,
+                                          uint16_t region) {
+  uint8_t type;
+  if (!doc->ReadU8(type) || type >= IT_LAST) {
+    return;
+  }
+  // the instrument is restored from scratch, whatever its type was
+  releaseInstrument(region);
+  if (type == IT_NONE) {
+    return;
+  }
+  if (GetNextAndAssignID((InstrumentType)type, region) == NO_MORE_INSTRUMENT) {
+    Trace::Error("Failed to allocate instrument type:%d", type);
+    return;
+  }
+  instruments_[region]->RestoreBinaryContent(doc);
+};
+
 void InstrumentBank::Init() {}
 
 // Get the next available instance of the given Instrument type from the pool of
@@ -30,6 +30,11 @@ public:
   I_Instrument *GetInstrument(int i);
   virtual void SaveContent(tinyxml2::XMLPrinter *printer);
   virtual void RestoreContent(PersistencyDocument *doc);
+  virtual void SaveBinaryContent(BinaryPrinter *printer);
+  virtual void RestoreBinaryContent(BinaryDocument *doc);
+  virtual uint16_t JournalRegionCount() { return MAX_INSTRUMENT_COUNT; };
+  virtual void SaveJournalRegion(BinaryPrinter *printer, uint16_t region);
+  virtual void RestoreJournalRegion(BinaryDocument *doc, uint16_t region);
   void Init();
   void OnStart();
   unsigned short GetNextAndAssignID(InstrumentType type, unsigned char id);
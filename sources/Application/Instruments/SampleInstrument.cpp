@@ -15,6 +15,7 @@
 #include "Application/Utils/fixed.h"
 #include "CommandList.h"
 #include "SamplePool.h"
+#include "SampleStreamer.h"
 #include "SampleVariable.h"
 #include "Services/Audio/Audio.h"
 #include "System/Console/Trace.h"
@@ -30,6 +31,7 @@
 
 #include "Application/Player/SyncMaster.h"
 #include "SampleInstrumentDatas.h"
+#include "SampleRenderKernels.h"
 
 bool SampleInstrument::useDirtyDownsampling_ = false;
 
@@ -39,8 +41,6 @@ renderParams SampleInstrument::renderParams_[SONG_CHANNEL_COUNT];
 
 signed char SampleInstrument::lastMidiNote_[SONG_CHANNEL_COUNT];
 
-#define KRATE_SAMPLE_COUNT 100
-
 SampleInstrument::SampleInstrument()
     : I_Instrument(&variables_), sample_(FourCC::SampleInstrumentSample),
       volume_(FourCC::SampleInstrumentVolume, 0x80),
@@ -66,6 +66,8 @@ SampleInstrument::SampleInstrument()
   // Initialize MIDI notes
   for (int i = 0; i < SONG_CHANNEL_COUNT; i++) {
     SampleInstrument::lastMidiNote_[i] = -1;
+    renderParams_[i].streamVoice_ = -1;
+    renderParams_[i].finished_ = true;
   }
 
   // Initialize instruments settings
@@ -107,6 +109,15 @@ SampleInstrument::SampleInstrument()
 
 SampleInstrument::~SampleInstrument() {}
 
+bool SampleInstrument::HasActiveVoices() {
+  for (int i = 0; i < SONG_CHANNEL_COUNT; i++) {
+    if (!renderParams_[i].finished_) {
+      return true;
+    }
+  }
+  return false;
+}
+
 uint32_t SampleInstrument::GetSlicePoint(size_t index) const {
   if (index >= MaxSlices) {
     return 0;
@@ -357,6 +368,15 @@ bool SampleInstrument::Init() {
 
 void SampleInstrument::OnStart() { tableState_.Reset(); };
 
+// Gives the stream of a voice back to the streamer
+
+static void closeStream(renderParams *rp) {
+  if (rp->streamVoice_ >= 0) {
+    SampleStreamer::GetInstance()->Close(rp->streamVoice_);
+    rp->streamVoice_ = -1;
+  }
+}
+
 bool SampleInstrument::Start(int channel, unsigned char midinote,
                              bool cleanstart) {
   // Look if we're dirty & need to update this instrument's data
@@ -536,9 +556,10 @@ bool SampleInstrument::Start(int channel, unsigned char midinote,
   rp->baseSpeed_ = fp_mul(rp->baseSpeed_, freqFactor);
   rp->speed_ = rp->baseSpeed_;
 
-  // Init k rate counter
+  // Init k rate counter, the first block picks up the parameters directly
 
   rp->krateCount_ = 0;
+  rp->krateJump_ = true;
 
   // We allow processing
 
@@ -579,12 +600,70 @@ bool SampleInstrument::Start(int channel, unsigned char midinote,
     }
     rp->activeUpdaters_.clear();
   }
+
+  // Long samples stream what isn't resident
+
+  rp->streamed_ = source_->IsStreamed();
+  if (rp->streamed_) {
+    return prepareStream(channel);
+  }
+  closeStream(rp);
   return true;
 }
 
 void SampleInstrument::Stop(int channel) {
   renderParams *rp = renderParams_ + channel;
   rp->finished_ = true; // Mark this channel as finished
+  closeStream(rp);
+}
+
+// Sets up a voice of a streamed source. Voices staying within the resident
+// head play as usual, forward one shots and loops reaching past it stream the
+// rest from the card and anything else is cut to the head. Returns false if
+// that leaves nothing to play.
+
+bool SampleInstrument::prepareStream(int channel) {
+  renderParams *rp = renderParams_ + channel;
+  int resident = source_->GetResidentSize(rp->midiNote_);
+  int end = std::min(rp->rendLoopEnd_, source_->GetSize(rp->midiNote_));
+  int from = int(rp->position_);
+  SampleInstrumentLoopMode loopmode =
+      (SampleInstrumentLoopMode)rp->loopModeValue_;
+  bool loop = (loopmode == SILM_LOOP);
+  bool playable = true;
+
+  int reach = std::max({from + 2, rp->rendLoopStart_ + 1, rp->rendLoopEnd_});
+  if (reach > resident) {
+    int voice = -1;
+    if (!rp->reverse_ && end > resident &&
+        (loopmode == SILM_ONESHOT || (loop && rp->rendLoopStart_ < end - 1))) {
+      uint32_t skip = (from < resident - 1) ? resident - 1 - from : 0;
+      voice = SampleStreamer::GetInstance()->Open(
+          channel, source_, from, rp->rendLoopStart_, end, loop, skip);
+      if (voice >= 0) {
+        rp->streamVoice_ = voice;
+        rp->streamSeq_ = 0;
+        rp->streamFpPos_ = fl2fp(rp->position_ - from);
+        rp->streamFrom_ = from;
+        rp->streamSkip_ = skip;
+      }
+    }
+    if (voice < 0) {
+      Trace::Log("SAMPLEINSTRUMENT",
+                 "Can't stream on channel %d, playing resident part", channel);
+      closeStream(rp);
+      rp->loopModeValue_ = SILM_ONESHOT;
+      rp->rendLoopEnd_ = resident;
+      playable = !rp->reverse_ && (from < resident - 1);
+    }
+  } else {
+    closeStream(rp);
+  }
+
+  rp->streamPosition_ = rp->position_;
+  rp->streamLoopStart_ = rp->rendLoopStart_;
+  rp->streamLoopEnd_ = rp->rendLoopEnd_;
+  return playable;
 }
 
 void SampleInstrument::doTickUpdate(int channel) {
@@ -608,10 +687,59 @@ void SampleInstrument::doKRateUpdate(int channel) {
   }
 };
 
+// Points the play head of a streamed voice at frame seq of its stream, in the
+// resident head or in the stream ring, with lastSample bounding what can be
+// rendered from there. Returns false if there is nothing to play: the stream
+// ended (the voice is finished) or the read ahead didn't make it in time.
+
+static bool streamSegment(SampleRenderState &s, int voice, uint32_t seq,
+                          short *&segment, uint32_t &loopEnd) {
+  renderParams *rp = s.rp;
+  SampleStreamer *streamer = SampleStreamer::GetInstance();
+  loopEnd = streamer->GetLoopEnd(voice, seq);
+  if (seq < rp->streamSkip_) {
+    short *head = (short *)rp->sampleBuffer_;
+    segment = head + (rp->streamFrom_ + seq) * s.channelCount;
+    s.lastSample =
+        head + (rp->streamFrom_ + rp->streamSkip_) * s.channelCount;
+  } else {
+    uint32_t frames;
+    segment = streamer->Peek(voice, seq, frames);
+    if (frames < 2) {
+      if (streamer->Ended(voice, seq)) {
+        rp->finished_ = true;
+      } else {
+        streamer->ReportUnderrun(voice);
+      }
+      return false;
+    }
+    if (loopEnd - seq < frames - 1) {
+      frames = loopEnd - seq + 1;
+    }
+    s.lastSample = segment + (frames - 1) * s.channelCount;
+  }
+  s.input = segment;
+  return true;
+}
+
 // Size in samples
 
 bool SampleInstrument::Render(int channel, fixed *buffer, int size,
                               bool updateTick) {
+  return renderVoice(channel, buffer, size, updateTick, false);
+}
+
+void SampleInstrument::Skip(int channel, fixed *buffer, int size,
+                            bool updateTick) {
+  renderVoice(channel, buffer, size, updateTick, true);
+}
+
+// Renders (or with skip set, only advances) a voice. The buffer is only
+// written to if the voice has anything audible in it, the return value tells
+// if it did.
+
+bool SampleInstrument::renderVoice(int channel, fixed *buffer, int size,
+                                   bool updateTick, bool skip) {
 
   bool somethingToMix = false;
 
@@ -625,10 +753,6 @@ bool SampleInstrument::Render(int channel, fixed *buffer, int size,
     if (*rpFinished)
       return false;
 
-    // clear the fixed point buffer
-
-    memset(buffer, 0, size * 2 * sizeof(fixed));
-
     bool hasUpdaters = !(rp->activeUpdaters_.empty());
 
     int filterMix = filterMix_.GetInt();
@@ -685,8 +809,22 @@ bool SampleInstrument::Render(int channel, fixed *buffer, int size,
       };
     }
 
+    // Commands moved the play head or the loop of a streamed voice
+
+    if (rp->streamed_ &&
+        (rp->position_ != rp->streamPosition_ ||
+         rp->rendLoopStart_ != rp->streamLoopStart_ ||
+         rp->rendLoopEnd_ != rp->streamLoopEnd_) &&
+        !prepareStream(channel)) {
+      *rpFinished = true;
+      return false;
+    }
+
     // Get additional parameters from variables
 
+    SampleRenderState state;
+    state.rp = rp;
+
     // Crush
 
     int shift = 16 - rp->crush_;
@@ -694,25 +832,30 @@ bool SampleInstrument::Render(int channel, fixed *buffer, int size,
     if (shift != 0) {
       mask <<= FIXED_SHIFT + shift;
     }
+    state.mask = mask;
 
     // Crush vol
 
     int crushvol = rp->drive_;
-    fixed fpcrushvol = fl2fp(crushvol / 255.0F);
+    state.crushvol = fl2fp(crushvol / 255.0F);
+
+    // A full drive without bit reduction leaves samples untouched
+    bool crushing = (mask != fixed(0xFFFFFFFF)) || (state.crushvol != FP_ONE);
 
     // downsample
 
     int downsmpl = rp->downsample_;
-    unsigned int dsMask = 0xFFFFFFFF << downsmpl;
+    state.dsMask = 0xFFFFFFFF << downsmpl;
+    state.dirtyDownsampling = useDirtyDownsampling_;
+    bool downsampling = (state.dsMask != 0xFFFFFFFF);
 
     // Loop mode
 
-    SampleInstrumentLoopMode loopMode =
-        (SampleInstrumentLoopMode)rp->loopModeValue_;
+    state.loopMode = (SampleInstrumentLoopMode)rp->loopModeValue_;
 
     // Interpolation
 
-    int interpol = interpolation_.GetInt();
+    bool linear = (interpolation_.GetInt() == 0);
 
     // Get sound characteristics
 
@@ -720,357 +863,170 @@ bool SampleInstrument::Render(int channel, fixed *buffer, int size,
 
     int channelCount = rp->channelCount_;
 
-    int count = size; // number of samples to treat
-
-    fixed *result = buffer;
-
-    // Get volume factor and pan
+    // Volume factor, pan and cutoff glide across k-rate blocks
 
     fixed volscale = fl2fp(0.003921568627450980392156862745098f);
-    fixed volfactor = fp_mul(rp->volume_, volscale);
-    int pan = fp2i(rp->pan_);
-    fixed fixedpanl = panlaw[pan];
-    fixed fixedpanr = panlaw[254 - pan];
-
-    // filter constants
+    state.volfactor = rp->krateVolume_;
+    state.panl = rp->kratePanL_;
+    state.panr = rp->kratePanR_;
+    state.fltParm1 = rp->krateFreq_;
 
-    fixed f_k = fl2fp(1.0F / 3.0F);
-    fixed f_s = FP_ONE - f_k;
-
-    // Get pan multiplicators, and take volume into account
+    // input is the current sample to the left of position
 
     int n = int(rp->position_);
-    short *input = (short *)(wavbuf + 2 * channelCount *
-                                          n); // input is the current
-                                              // sample to the left of position
+    state.channelCount = channelCount;
+    state.input = (short *)(wavbuf + 2 * channelCount * n);
 
-    fixed fpPos = fl2fp(rp->position_ - n); // fpPos is current pos from input
-    fixed fpSpeed = rp->speed_;             // speed in fixed
+    state.fpPos = fl2fp(rp->position_ - n); // fpPos is current pos from input
+    state.fpSpeed = rp->speed_;             // speed in fixed
     if (rp->reverse_) {
-      fpSpeed = -rp->speed_;
+      state.fpSpeed = -rp->speed_;
     }
+    state.reverse = rp->reverse_;
 
-    fixed s1, s2, t2, eta, inveta;
-    s2 = 0;
-    t2 = 0;
-
-    short *loopPosition =
+    state.loopPosition =
         (short *)(wavbuf + rp->rendLoopStart_ * 2 * channelCount);
-    short *lastSample =
+    state.lastSample =
         (short *)(wavbuf + (rp->rendLoopEnd_ - 1) * 2 * channelCount);
 
-    if (/*(loopMode==SILM_OSCFINE)||*/ (rp->reverse_)) {
-      lastSample = (short *)(wavbuf + rp->rendLoopEnd_ * 2 * channelCount);
+    if (rp->reverse_) {
+      state.lastSample =
+          (short *)(wavbuf + rp->rendLoopEnd_ * 2 * channelCount);
     }
 
-    fixed zerofive = fl2fp(0.5f);
+    state.dsBasePtr = ((short *)wavbuf) + rp->rendFirst_ * channelCount;
+
+    state.flt = flt;
+    state.fltMix = flt->mix;
+    state.fltParm2 = flt->reso;
+    state.fltDirt = flt->dirt;
+    state.filterBoost = filterBoost;
+
+    // Streaming voices follow their stream rather than the loop points, and
+    // don't downsample
+
+    int streamVoice = rp->streamVoice_;
+    uint32_t streamSeq = rp->streamSeq_;
+    short *segment = nullptr; // frame streamSeq at the start of a segment
+    uint32_t loopEnd = 0;
+    if (streamVoice >= 0) {
+      state.loopMode = SILM_ONESHOT;
+      state.fpPos = rp->streamFpPos_;
+      downsampling = false;
+    }
 
-    // try to speed up access using pointers rather than structure access
+    SampleRenderKernel kernel = selectSampleRenderKernel(
+        state, skip, linear, filtering, crushing, downsampling);
 
-    bool rpReverse = rp->reverse_;
     int rpKrateCount = rp->krateCount_;
 
-    fixed *fltSpeed = flt->speed;
-    fixed *fltHeight = flt->height;
-    fixed fltMix = flt->mix;
-    fixed fltMixInv = FP_ONE - fltMix;
-    fixed *fltDelay = flt->hipdelay;
-    fixed fltParm1 = flt->freq;
-    fixed fltParm2 = flt->reso;
-    fixed fltDirt = flt->dirt;
-
-    fixed *fltSpeedPtr = 0;
-    fixed *fltDelayPtr = 0;
-    fixed *fltHeightPtr = 0;
-
-    short *dsBasePtr = ((short *)wavbuf) + rp->rendFirst_ * channelCount;
-
-    while (count > 0) {
-
+    auto advance = [&]() {
       // look where we are, if we need to
+      if (streamVoice >= 0) {
+        return streamSegment(state, streamVoice, streamSeq, segment, loopEnd);
+      }
+      return !wrapPlayHead(state, state.input, state.reverse, state.fpSpeed);
+    };
 
-      if (!rpReverse) {
-        if (input >= lastSample /*-((loopMode==SILM_OSCFINE)?1:0)*/) {
-          switch (loopMode) {
-          case SILM_ONESHOT:
-            *rpFinished = true;
-            break;
-          case SILM_LOOP:
-          case SILM_OSC:
-          case SILM_LOOPSYNC:
-            input = loopPosition;
-            rpReverse = (loopPosition > lastSample);
-            if (rpReverse) {
-              fpSpeed = -rp->speed_;
-            } else {
-              fpSpeed = rp->speed_;
-            }
-            break;
-          case SILM_LOOP_PINGPONG:
-            if ((loopPosition > lastSample)) {
-              if (input <= lastSample || input >= loopPosition) {
-                rpReverse = !rpReverse;
-                fpSpeed = -fpSpeed;
-              }
-            } else {
-              if (input >= lastSample || input <= loopPosition) {
-                rpReverse = !rpReverse;
-                fpSpeed = -fpSpeed;
-              }
-            }
-            break;
-            /*						case
-               SILM_OSCFINE:
-                                                            {
-                                                                    int
-               offset=(input-lastSample)/channelCount ;
-                                                                    rpReverse=(loopPosition>lastSample)
-               ; if (rpReverse) { fpSpeed=-rp->speed_ ;
-                                                                            input=loopPosition-offset
-               ; } else { fpSpeed=rp->speed_ ; input=loopPosition+offset ;
-                                                                    }
-                                                                    break ;
-                                                            }*/
-          case SILM_LAST:
-            NAssert(0);
-            break;
-          };
-        }
-      } else {
-        if (input < lastSample) {
-          switch (loopMode) {
-          case SILM_ONESHOT:
-            *rpFinished = true;
-            break;
-          case SILM_LOOP:
-          case SILM_OSC:
-          case SILM_LOOPSYNC:
-            input = loopPosition;
-            rpReverse = (loopPosition > lastSample);
-            if (rpReverse) {
-              fpSpeed = -rp->speed_;
-            } else {
-              fpSpeed = rp->speed_;
-            }
-            break;
-          case SILM_LOOP_PINGPONG:
-            if ((loopPosition > lastSample)) {
-              if (input <= lastSample || input >= loopPosition) {
-                rpReverse = !rpReverse;
-                fpSpeed = -fpSpeed;
-              }
-            } else {
-              if (input >= lastSample || input <= loopPosition) {
-                rpReverse = !rpReverse;
-                fpSpeed = -fpSpeed;
-              }
-            }
-            break;
-            /*						case
-               SILM_OSCFINE:
-                                                            {
-                                                                    int
-               offset=(lastSample-input)/channelCount ;
-                                                                    rpReverse=(loopPosition>lastSample)
-               ; if (rpReverse) { fpSpeed=-rp->speed_ ;
-                                                                            input=loopPosition-offset
-               ; } else { fpSpeed=rp->speed_ ; input=loopPosition+offset ;
-                                                                    }
-                                                                    break ;
-                                                            }*/
-          case SILM_LAST:
-            NAssert(0);
-            break;
-          };
-        }
-      };
-
-      if (*rpFinished) {
-        count = -1;
-      } else {
+    // A new k-rate block: updaters are evaluated once and volume, pan and
+    // cutoff glide to their new value across the block
 
-        // See if time to process k-rate change
-
-        if (rpKrateCount-- == 0) {
-          rpKrateCount = KRATE_SAMPLE_COUNT;
-
-          if (hasUpdaters) {
-            doKRateUpdate(channel);
-            struct RUParams rup;
-            rup.cutOffset_ = rup.resOffset_ = rup.volumeOffset_ =
-                rup.panOffset_ = rup.fbMixOffset_ = rup.fbTunOffset_ = 0;
-            rup.speedOffset_ = FP_ONE;
-
-            for (auto it = rp->activeUpdaters_.begin();
-                 it != rp->activeUpdaters_.end(); it++) {
-              I_SRPUpdater *current = *it;
-              current->UpdateSRP(rup);
-            }
-
-            rp->volume_ = rp->baseVolume_ + rup.volumeOffset_;
-            rp->pan_ = rp->basePan_ + rup.panOffset_;
-            rp->speed_ = fp_mul(rp->baseSpeed_, rup.speedOffset_);
-            rp->cutoff_ = rp->baseFCut_ + rup.cutOffset_;
-            rp->reso_ = rp->baseFRes_ + rup.resOffset_;
-            rp->fbMix_ = rp->baseFbMix_ + rup.fbMixOffset_;
-            rp->fbTun_ = rp->baseFbTun_ + rup.fbTunOffset_;
-
-            set_filter(channel, FLT_LOWPASS, rp->cutoff_, rp->reso_, filterMix,
-                       bassyFilter);
-            filtering = (rp->cutoff_ < i2fp(1)) || (rp->reso_ > i2fp(0));
-
-            volfactor = fp_mul(rp->volume_, volscale);
-            pan = fp2i(rp->pan_);
-
-            if (rpReverse) {
-              fpSpeed = -rp->speed_;
-            } else {
-              fpSpeed = rp->speed_;
-            }
-          }
-        }
+    auto startBlock = [&]() {
+      if (hasUpdaters) {
+        doKRateUpdate(channel);
+        struct RUParams rup;
+        rup.cutOffset_ = rup.resOffset_ = rup.volumeOffset_ = rup.panOffset_ =
+            rup.fbMixOffset_ = rup.fbTunOffset_ = 0;
+        rup.speedOffset_ = FP_ONE;
 
-        // get input sample to interpolate from
-        // s= left channel
-        // t= right channel
-        short *i1 = input;
-        if (dsMask != 0xFFFFFFFF) {
-          if (useDirtyDownsampling_) {
-            i1 = (short *)(((uintptr_t)input) & dsMask);
-          } else {
-            // prevent input ever being lower mem address then dsBasePtr (sample
-            // start point) this can occur eg. if doing reverse playback and
-            // using RTG cmds
-            if (input < dsBasePtr) {
-              i1 = dsBasePtr;
-            } else {
-              unsigned int distance =
-                  (unsigned int)(input - dsBasePtr) / channelCount;
-              i1 = dsBasePtr + (distance & dsMask) * channelCount;
-            }
-          }
+        for (auto it = rp->activeUpdaters_.begin();
+             it != rp->activeUpdaters_.end(); it++) {
+          I_SRPUpdater *current = *it;
+          current->UpdateSRP(rup);
         }
 
-        short *i2 = i1 + channelCount;
-
-        if (filtering) {
-          fltSpeedPtr = fltSpeed;
-          fltHeightPtr = fltHeight;
-          fltDelayPtr = fltDelay;
+        rp->volume_ = rp->baseVolume_ + rup.volumeOffset_;
+        rp->pan_ = rp->basePan_ + rup.panOffset_;
+        rp->speed_ = fp_mul(rp->baseSpeed_, rup.speedOffset_);
+        rp->cutoff_ = rp->baseFCut_ + rup.cutOffset_;
+        rp->reso_ = rp->baseFRes_ + rup.resOffset_;
+        rp->fbMix_ = rp->baseFbMix_ + rup.fbMixOffset_;
+        rp->fbTun_ = rp->baseFbTun_ + rup.fbTunOffset_;
+
+        set_filter(channel, FLT_LOWPASS, rp->cutoff_, rp->reso_, filterMix,
+                   bassyFilter);
+        filtering = (rp->cutoff_ < i2fp(1)) || (rp->reso_ > i2fp(0));
+        state.fltParm2 = flt->reso;
+        state.fltDirt = flt->dirt;
+
+        if (state.reverse) {
+          state.fpSpeed = -rp->speed_;
+        } else {
+          state.fpSpeed = rp->speed_;
         }
+      }
 
-        for (int i = 0; i < channelCount; i++) {
-          t2 = s2; // move L to R if necessary
-          s1 = i2fp(*i1++);
-          s2 = i2fp(*i2++);
-
-          switch (interpol) {
-
-          case 0: // Linear interpolation
-
-            eta = fpPos;
-            inveta = fp_sub(FP_ONE, eta);
-
-            // interpolate
-
-            s1 = fp_mul(s1, inveta);
-            s2 = fp_mul(s2, eta);
-
-            // Compute interpolated sample
-
-            s1 += s2;
-            break;
-
-          case 1: // Nearest neighbor
-
-            if (fpPos > zerofive) {
-              s1 = s2;
-            };
-            break;
-          }
-
-          // crush predrive
-
-          s2 = fp_mul(s1, fpcrushvol);
-
-          // store result, applying crush
-
-          s2 = (s2 & mask);
-
-          // apply volume
-
-          s2 = fp_mul(s2, volfactor);
-
-          // apply filtering if needed
-
-          if (filtering) {
-
-            fixed lpin = fp_mul(s2, fltMixInv);
-            fixed hpin = -fp_mul(s2, fltMix);
-
-            fixed difr = fp_sub(lpin, *fltHeightPtr);
-
-            // Introduce non-linearity if screamin'
-
-            if (filterBoost) {
-              if (*fltSpeedPtr < -FP_ONE) {
-                *fltSpeedPtr = -f_s;
-              } else if (fltSpeed[i] > FP_ONE) {
-                *fltSpeedPtr = f_s;
-              };
-              *fltSpeedPtr = fp_mul(*fltSpeedPtr, fltDirt);
-            }
-
-            *fltSpeedPtr =
-                fp_mul(*fltSpeedPtr, fltParm2); // mul by res, it's some kind
-                                                // of inertia.
-            /*HOG:5*/ *fltSpeedPtr = fp_add(
-                *fltSpeedPtr,
-                fp_mul(difr, fltParm1)); // mul by cutoff, less cutoff = no
-                                         // sound, so it's better not be 0.
-
-            *fltHeightPtr += *fltSpeedPtr;
-            *fltHeightPtr += *fltDelayPtr - hpin;
-            s2 = *fltHeightPtr;
-
-            *fltDelayPtr = hpin;
-            fltDelayPtr++;
-            fltHeightPtr++;
-            fltSpeedPtr++;
-          }
-        }
+      fixed volfactor = fp_mul(rp->volume_, volscale);
+      int pan = fp2i(rp->pan_);
+      if (rp->krateJump_) {
+        rp->krateJump_ = false;
+        state.volfactor.Jump(volfactor);
+        state.panl.Jump(panlaw[pan]);
+        state.panr.Jump(panlaw[254 - pan]);
+        state.fltParm1.Jump(flt->freq);
+      } else {
+        state.volfactor.Glide(volfactor, KRATE_SAMPLE_COUNT);
+        state.panl.Glide(panlaw[pan], KRATE_SAMPLE_COUNT);
+        state.panr.Glide(panlaw[254 - pan], KRATE_SAMPLE_COUNT);
+        state.fltParm1.Glide(flt->freq, KRATE_SAMPLE_COUNT);
+      }
 
-        if (channelCount == 1) {
-          t2 = s2;
-        }
+      return selectSampleRenderKernel(state, skip, linear, filtering,
+                                      crushing, downsampling);
+    };
 
-        // introduce panning & vol - store result
+    auto rendered = [&](SampleRenderKernel, int) {
+      if (streamVoice >= 0) {
+        streamSeq += (state.input - segment) / channelCount;
+        streamSeq = std::min(streamSeq, loopEnd);
+      }
+    };
 
-        s2 = fp_mul(s2, fixedpanl);
-        t2 = fp_mul(t2, fixedpanr);
+    somethingToMix =
+        renderSampleSegments(state, kernel, rpKrateCount, buffer, size,
+                             advance, startBlock, rendered);
 
-        *result++ = s2;
-        *result++ = t2;
+    // Keep k-rate block state for the next buffer
 
-        // Computes new pos for next input sample
-        // fpPos is always relative to 'input' pointer
+    rp->krateCount_ = rpKrateCount;
+    rp->krateVolume_ = state.volfactor;
+    rp->kratePanL_ = state.panl;
+    rp->kratePanR_ = state.panr;
+    rp->krateFreq_ = state.fltParm1;
 
-        fpPos = fp_add(fpPos, fpSpeed);
-        int delta = fp2i(fpPos);
-        input += channelCount * delta;
-        fpPos = fp_sub(fpPos, i2fp(delta));
-        count--;
-      }
-    }
     // Update 'reverse' mode if changed
 
-    rp->reverse_ = rpReverse;
+    rp->reverse_ = state.reverse;
 
     // Update final sample position
-    rp->position_ =
-        (((char *)input) - wavbuf) / (2 * channelCount) + fp2fl(fpPos);
 
-    somethingToMix = true;
+    if (streamVoice >= 0) {
+      SampleStreamer *streamer = SampleStreamer::GetInstance();
+      rp->streamSeq_ = streamSeq;
+      rp->streamFpPos_ = state.fpPos;
+      rp->position_ =
+          streamer->GetFileFrame(streamVoice, streamSeq) + fp2fl(state.fpPos);
+      if (*rpFinished) {
+        closeStream(rp);
+      } else {
+        streamer->Consume(streamVoice, streamSeq);
+      }
+    } else {
+      rp->position_ =
+          (((char *)state.input) - wavbuf) / (2 * channelCount) +
+          fp2fl(state.fpPos);
+    }
+    rp->streamPosition_ = rp->position_;
   }
 
   return somethingToMix;
@@ -1563,6 +1519,36 @@ void SampleInstrument::RestoreContent(PersistencyDocument *doc) {
   }
 }
 
+void SampleInstrument::SaveBinaryParams(BinaryPrinter *printer) {
+  I_Instrument::SaveBinaryParams(printer);
+
+  for (size_t i = 0; i < slicePoints_.size(); ++i) {
+    if (slicePoints_[i] == 0) {
+      continue;
+    }
+    char sliceName[6];
+    char sliceValue[12];
+    npf_snprintf(sliceName, sizeof(sliceName), "SL%02u",
+                 static_cast<unsigned>(i));
+    npf_snprintf(sliceValue, sizeof(sliceValue), "%u",
+                 static_cast<unsigned>(slicePoints_[i]));
+    printer->WriteString(sliceName);
+    printer->WriteString(sliceValue);
+  }
+}
+
+bool SampleInstrument::RestoreParam(const char *name, const char *value) {
+  if (!strncasecmp(name, "SL", 2)) {
+    int idx = atoi(name + 2);
+    if (idx >= 0 && idx < static_cast<int>(MaxSlices)) {
+      slicePoints_[static_cast<size_t>(idx)] =
+          static_cast<uint32_t>(strtoul(value, nullptr, 10));
+    }
+    return true;
+  }
+  return I_Instrument::RestoreParam(name, value);
+}
+
 void SampleInstrument::Purge() {
   auto it = variables_.begin();
   for (size_t i = 0; i < variables_.size(); i++) {
@@ -22,16 +22,6 @@
 #include "SampleVariable.h"
 #include "SoundSource.h"
 
-enum SampleInstrumentLoopMode {
-  SILM_ONESHOT = 0,
-  SILM_LOOP,
-  SILM_LOOP_PINGPONG,
-  SILM_OSC,
-  //	SILM_OSCFINE,
-  SILM_LOOPSYNC,
-  SILM_LAST
-};
-
 #define NO_SAMPLE (-1)
 
 class SampleInstrument : public I_Instrument, I_Observer {
@@ -44,6 +34,7 @@ public:
   virtual bool Start(int channel, unsigned char note, bool trigger = true);
   virtual void Stop(int channel);
   virtual bool Render(int channel, fixed *buffer, int size, bool updateTick);
+  virtual void Skip(int channel, fixed *buffer, int size, bool updateTick);
   virtual bool IsInitialized();
   virtual bool IsEmpty();
 
@@ -87,14 +78,22 @@ public:
   virtual etl::string<MAX_INSTRUMENT_NAME_LENGTH> GetSampleFileName();
 
   static void EnableDownsamplingLegacy();
+  // Whether a sample plays on any channel, voices keep a pointer to its
+  // buffer
+  static bool HasActiveVoices();
   virtual void SaveContent(tinyxml2::XMLPrinter *printer) override;
   virtual void RestoreContent(PersistencyDocument *doc) override;
   void Purge();
 
 protected:
+  virtual void SaveBinaryParams(BinaryPrinter *printer) override;
+  virtual bool RestoreParam(const char *name, const char *value) override;
   void updateInstrumentData(bool search);
   void doTickUpdate(int channel);
   void doKRateUpdate(int channel);
+  bool renderVoice(int channel, fixed *buffer, int size, bool updateTick,
+                   bool skip);
+  bool prepareStream(int channel);
 
 private:
   etl::list<Variable *, 21> variables_;
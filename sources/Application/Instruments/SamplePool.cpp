@@ -8,8 +8,11 @@
  */
 
 #include "SamplePool.h"
+#include "Application/Mixer/MixerService.h"
 #include "Application/Model/Config.h"
+#include "Application/Instruments/SampleInstrument.h"
 #include "Application/Persistency/PersistencyService.h"
+#include "Application/Player/Player.h"
 #include "Externals/SRC/common.h"
 #include "Externals/etl/include/etl/string.h"
 #include "Externals/etl/include/etl/string_stream.h"
@@ -18,6 +21,8 @@
 #include "System/FileSystem/I_File.h"
 #include "System/io/Status.h"
 #include "WavHeader.h"
+#include "WavPeaks.h"
+#include <algorithm>
 #include <cstdint>
 #include <stdlib.h>
 #include <string.h>
@@ -29,6 +34,7 @@ SamplePool::SamplePool() : Observable(&observers_) {
     names_[i] = nameStore_[i];
     nameStore_[i][0] = '\0';
   };
+  projectName_[0] = '\0';
 };
 
 SamplePool::~SamplePool() {
@@ -38,6 +44,8 @@ SamplePool::~SamplePool() {
 };
 
 void SamplePool::Load(const char *projectName) {
+  strncpy(projectName_, projectName, MAX_PROJECT_NAME_LENGTH);
+  projectName_[MAX_PROJECT_NAME_LENGTH] = '\0';
   auto fs = FileSystem::GetInstance();
   if (!fs->chdir(PROJECTS_DIR) || !fs->chdir(projectName) ||
       !fs->chdir(PROJECT_SAMPLES_DIR)) {
@@ -123,6 +131,8 @@ int SamplePool::ImportSample(const char *name, const char *projectName) {
   if (count_ == MAX_SAMPLES) {
     return -1;
   }
+  strncpy(projectName_, projectName, MAX_PROJECT_NAME_LENGTH);
+  projectName_[MAX_PROJECT_NAME_LENGTH] = '\0';
 
   WavFile wav;
   auto wavRes = wav.Open(name);
@@ -167,8 +177,13 @@ int SamplePool::ImportSample(const char *name, const char *projectName) {
     return -1;
   }
 
+  // the waveform peaks are saved along with the copy, returning before they
+  // are closed removes them
+  WavPeaksBuilder peaks;
+  peaks.Open(projectSamplePath.c_str());
+
   // copy file to current project as 16-bit PCM
-  uint8_t buffer[IMPORT_CHUNK_SIZE];
+  alignas(int16_t) uint8_t buffer[IMPORT_CHUNK_SIZE];
   uint32_t bytesRead = 0;
   uint32_t samplesRead = 0;
   uint32_t totalRead = 0;
@@ -212,8 +227,11 @@ int SamplePool::ImportSample(const char *name, const char *projectName) {
         Trace::Error("Failed writing sample data to:%s", projectSamplePath.c_str());
         return -1;
       }
-      totalWrittenFrames +=
+      const uint32_t frames =
           bytesRead / (static_cast<uint32_t>(channelCount) * 2);
+      peaks.AddFrames(reinterpret_cast<int16_t *>(buffer), frames,
+                      channelCount);
+      totalWrittenFrames += frames;
     } else {
       if (!wav.ReadFloat(importResampleIn_, kImportInputSamples,
                          &samplesRead)) {
@@ -258,6 +276,8 @@ int SamplePool::ImportSample(const char *name, const char *projectName) {
             Trace::Error("Failed writing sample data to:%s", projectSamplePath.c_str());
             return -1;
           }
+          peaks.AddFrames(importResampleOutInt16_, data.output_frames_gen,
+                          channelCount);
           totalWrittenFrames += data.output_frames_gen;
         }
 
@@ -307,6 +327,8 @@ int SamplePool::ImportSample(const char *name, const char *projectName) {
         Trace::Error("Failed writing sample data to:%s", projectSamplePath.c_str());
         return -1;
       }
+      peaks.AddFrames(importResampleOutInt16_, data.output_frames_gen,
+                      channelCount);
       totalWrittenFrames += data.output_frames_gen;
     }
     src_delete(resampler);
@@ -322,7 +344,10 @@ int SamplePool::ImportSample(const char *name, const char *projectName) {
   }
 
   // Close the output file before re-opening it for import.
+  // the sample editor builds the peaks when it first opens the sample if
+  // they couldn't be saved
   fout.reset();
+  peaks.Close();
 
   // now load the sample into memory/flash from the project pool path
   bool status = loadSample(projectSamplePath.c_str());
@@ -354,35 +379,113 @@ void SamplePool::PurgeSample(int i, const char *projectName) {
   delPath << "/" << PROJECTS_DIR << "/" << projectName << "/"
           << PROJECT_SAMPLES_DIR << "/" << names_[i];
 
-  // delete file
+  // give its storage back first so that nothing is left loaded from a file
+  // that's gone, then delete the file
+  unloadSample(i);
   FileSystem::GetInstance()->DeleteFile(delPath.str().c_str());
-  // shift all entries from deleted to end
-  for (uint32_t j = i; j < count_ - 1; j++) {
+  WavPeaks::Remove(delPath.str().c_str());
+};
+
+// returns the new samples index or -1 on error
+int8_t SamplePool::ReloadSample(uint8_t index, const char *name) {
+  if (unloadSample(index)) {
+    if (loadSample(name)) {
+      return count_ - 1;
+    }
+  }
+  return -1;
+}
+
+bool SamplePool::OpenStream(SoundSource *source, WavFile &wav) {
+  for (uint32_t i = 0; i < count_; i++) {
+    if (source != &wav_[i]) {
+      continue;
+    }
+    etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> buffer;
+    etl::string_stream path(buffer);
+    path << PROJECTS_DIR << "/" << projectName_ << "/" << PROJECT_SAMPLES_DIR
+         << "/" << names_[i];
+    auto res = wav.Open(path.str().c_str());
+    if (!res) {
+      Trace::Error("Failed to open sample stream:%s", path.str().c_str());
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+uint32_t SamplePool::residentBytes(WavFile &wav) {
+  return wav.GetResidentSize(-1) * wav.GetChannelCount(-1) * 2;
+}
+
+void SamplePool::removeEntry(uint32_t index) {
+  // shift all entries from removed to end
+  for (uint32_t j = index; j < count_ - 1; ++j) {
     wav_[j] = std::move(wav_[j + 1]);
     memcpy(nameStore_[j], nameStore_[j + 1],
            MAX_INSTRUMENT_FILENAME_LENGTH + 1);
-  };
+  }
   // decrease sample count
-  count_--;
+  --count_;
   wav_[count_].Close();
   nameStore_[count_][0] = '\0';
 
-  // now notify observers
+  // notify observers so sample variables can adjust their indexes
   SetChanged();
   SamplePoolEvent ev;
-  ev.index_ = i;
+  ev.index_ = index;
   ev.type_ = SPET_DELETE;
   NotifyObservers(&ev);
-};
+}
 
-// returns the new samples index or -1 on error
-int8_t SamplePool::ReloadSample(uint8_t index, const char *name) {
-  if (unloadSample(index)) {
-    if (loadSample(name)) {
-      return count_ - 1;
+bool SamplePool::canCompact() {
+  return !Player::GetInstance()->IsRunning() &&
+         !SampleInstrument::HasActiveVoices();
+}
+
+bool SamplePool::compactStore(SampleStore &store, uint8_t *base) {
+  // Checked under the lock so that no voice starts meanwhile
+  MixerService::GetInstance()->Lock();
+  if (!canCompact()) {
+    MixerService::GetInstance()->Unlock();
+    return false;
+  }
+  Trace::Log("SAMPLEPOOL", "Compacting sample store, %u bytes free",
+             store.Available());
+
+  // the samples of this store, in pool order
+  static uint32_t offsets[MAX_SAMPLES];
+  static uint32_t sizes[MAX_SAMPLES];
+  static uint8_t indexes[MAX_SAMPLES];
+  uint32_t resident = 0;
+  for (uint32_t i = 0; i < count_; i++) {
+    auto *buffer = static_cast<uint8_t *>(wav_[i].GetSampleBuffer(0));
+    if (buffer == nullptr || buffer < base || buffer >= base + store.Size()) {
+      continue;
     }
+    offsets[resident] = buffer - base;
+    sizes[resident] = residentBytes(wav_[i]);
+    indexes[resident++] = i;
   }
-  return -1;
+  store.Compact(offsets, sizes, resident, [&](uint32_t i, uint32_t to) {
+    memmove(base + to, base + offsets[i], sizes[i]);
+    wav_[indexes[i]].SetSampleBuffer(reinterpret_cast<short *>(base + to));
+  });
+  MixerService::GetInstance()->Unlock();
+  return true;
+}
+
+uint32_t SamplePool::prepareResident(WavFile &wav, uint32_t available) {
+  uint32_t size = wav.GetDiskSize(-1);
+  if (size <= available) {
+    return size;
+  }
+  int frames = std::min(wav.GetSize(-1), SAMPLE_STREAM_PRELOAD_FRAMES);
+  wav.SetResidentSize(frames);
+  Trace::Log("SAMPLEPOOL", "Streaming sample, %d of %d frames resident",
+             frames, wav.GetSize(-1));
+  return frames * wav.GetChannelCount(-1) * 2;
 }
 
 void SamplePool::swapEntries(int src, int dst) {
@@ -14,10 +14,19 @@
 #include "Application/Persistency/PersistencyService.h"
 #include "Foundation/Observable.h"
 #include "Foundation/T_Singleton.h"
+#include "SampleStore.h"
 #include "WavFile.h"
 
 #define MAX_SAMPLES MAX_SAMPLEINSTRUMENT_COUNT * 4
 
+// Samples too big for the sample store only get their first frames loaded,
+// the rest is streamed from the card while playing (see SampleStreamer)
+#ifndef SAMPLE_STREAM_PRELOAD_FRAMES
+#define SAMPLE_STREAM_PRELOAD_FRAMES 32768
+#endif
+// Largest preload, for a stereo sample
+#define SAMPLE_STREAM_PRELOAD_BYTES (SAMPLE_STREAM_PRELOAD_FRAMES * 4)
+
 enum SamplePoolEventType { SPET_INSERT, SPET_DELETE };
 
 struct SamplePoolEvent : public I_ObservableData {
@@ -40,8 +49,11 @@ public:
   void PurgeSample(int i, const char *projectName);
   virtual bool CheckSampleFits(int sampleSize) = 0;
   virtual uint32_t GetAvailableSampleStorageSpace() = 0;
+  // Removes a sample from the pool and gives its storage back
   virtual bool unloadSample(uint32_t i) = 0;
   int8_t ReloadSample(uint8_t index, const char *name);
+  // Opens the project file of a loaded sample for streaming
+  bool OpenStream(SoundSource *source, WavFile &wav);
 
 protected:
   virtual bool loadSample(const char *name) = 0;
@@ -51,6 +63,22 @@ protected:
   char *names_[MAX_SAMPLES];
   WavFile wav_[MAX_SAMPLES];
   void swapEntries(int src, int dst);
+  // Sizes the part of a sample loaded in the sample store: all of it if it
+  // fits in the available bytes, otherwise only the streaming preload.
+  // Returns its size in bytes
+  static uint32_t prepareResident(WavFile &wav, uint32_t available);
+  // Bytes of a sample in the sample store
+  static uint32_t residentBytes(WavFile &wav);
+  // Takes an unloaded sample out of the lists and notifies observers
+  void removeEntry(uint32_t index);
+  // Whether samples can move in memory: the player is stopped and no voice
+  // plays, notes from MIDI or previews included
+  static bool canCompact();
+  // Moves the samples of a store in memory down to its start so that its free
+  // space is in one block. Only when canCompact(), as voices keep pointers to
+  // the samples they play. False if something plays
+  bool compactStore(SampleStore &store, uint8_t *base);
+  char projectName_[MAX_PROJECT_NAME_LENGTH + 1];
 
 private:
   etl::vector<I_Observer *, MAX_SAMPLEINSTRUMENT_COUNT> observers_;
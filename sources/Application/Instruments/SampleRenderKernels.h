@@ -0,0 +1,469 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2018 Discodirt
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _SAMPLE_RENDER_KERNELS_H_
+#define _SAMPLE_RENDER_KERNELS_H_
+
+#include "Application/Instruments/Filters.h"
+#include "Application/Utils/fixed.h"
+#include "Externals/etl/include/etl/array.h"
+#include "SampleRenderingParams.h"
+#include "System/Console/n_assert.h"
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+
+// Sample voice rendering kernels of SampleInstrument. They only depend on
+// the render state of the voice so they can be exercised on their own.
+
+// Frames of a k-rate block, volume, pan and cutoff glide across it
+#define KRATE_SAMPLE_COUNT 100
+
+// Rendering state of a voice for the current buffer. Everything the kernels
+// need is resolved once per buffer (and once per k-rate block) so the per
+// sample loop only carries the work the voice actually needs.
+
+struct SampleRenderState {
+  renderParams *rp;
+  int channelCount;
+
+  // loop points
+  SampleInstrumentLoopMode loopMode;
+  short *loopPosition;
+  short *lastSample;
+
+  // play head, updated by the kernels
+  short *input;
+  fixed fpPos;
+  fixed fpSpeed;
+  bool reverse;
+
+  // crush & downsampling
+  fixed mask;
+  fixed crushvol;
+  short *dsBasePtr;
+  unsigned int dsMask;
+  bool dirtyDownsampling;
+
+  // volume & pan, gliding across the k-rate block
+  KRateLerp volfactor;
+  KRateLerp panl;
+  KRateLerp panr;
+
+  // filter
+  filter_t *flt;
+  fixed fltMix;
+  KRateLerp fltParm1;
+  fixed fltParm2;
+  fixed fltDirt;
+  bool filterBoost;
+};
+
+// Moves the play head according to the loop mode once it went past the last
+// sample. Returns true when a one shot sample reached its end.
+
+inline bool wrapPlayHead(const SampleRenderState &s, short *&input,
+                         bool &reverse, fixed &fpSpeed) {
+  if (!reverse) {
+    if (input < s.lastSample) {
+      return false;
+    }
+  } else {
+    if (input >= s.lastSample) {
+      return false;
+    }
+  }
+
+  switch (s.loopMode) {
+  case SILM_ONESHOT:
+    s.rp->finished_ = true;
+    return true;
+  case SILM_LOOP:
+  case SILM_OSC:
+  case SILM_LOOPSYNC:
+    input = s.loopPosition;
+    reverse = (s.loopPosition > s.lastSample);
+    if (reverse) {
+      fpSpeed = -s.rp->speed_;
+    } else {
+      fpSpeed = s.rp->speed_;
+    }
+    break;
+  case SILM_LOOP_PINGPONG:
+    if ((s.loopPosition > s.lastSample)) {
+      if (input <= s.lastSample || input >= s.loopPosition) {
+        reverse = !reverse;
+        fpSpeed = -fpSpeed;
+      }
+    } else {
+      if (input >= s.lastSample || input <= s.loopPosition) {
+        reverse = !reverse;
+        fpSpeed = -fpSpeed;
+      }
+    }
+    break;
+  case SILM_LAST:
+    NAssert(0);
+    break;
+  };
+  return false;
+}
+
+// Number of frames following the current one that can be rendered at the
+// current speed before wrapPlayHead() would have anything to do, up to limit.
+// The current frame must already have gone through wrapPlayHead().
+//
+// The frame offset from 'input' after m frames is fp2i(fpPos + m * fpSpeed)
+// since the fractional part is carried exactly from frame to frame, so the
+// run length follows from the distance to the loop points. Positions where
+// the check is a no-op although the head is past lastSample (ping pong going
+// back through the loop) count as inside the run.
+
+inline int framesBeforeWrap(const SampleRenderState &s, int limit) {
+
+  const int64_t unbounded = INT64_MAX;
+
+  // Bounds of the no-op region around the play head, exclusive, in frames
+  // relative to the head
+
+  int64_t last = (s.lastSample - s.input) / s.channelCount;
+  int64_t loop = (s.loopPosition - s.input) / s.channelCount;
+  bool pingpong = (s.loopMode == SILM_LOOP_PINGPONG);
+  int64_t lo, hi;
+
+  if (!s.reverse) {
+    if (last > 0) {
+      lo = -unbounded;
+      hi = last;
+    } else if (pingpong && last < 0 && loop > 0) {
+      lo = last;
+      hi = loop;
+    } else {
+      return 0;
+    }
+  } else {
+    if (last <= 0) {
+      lo = last - 1;
+      hi = unbounded;
+    } else if (pingpong && loop < 0) {
+      lo = loop;
+      hi = last;
+    } else {
+      return 0;
+    }
+  }
+
+  int64_t frames = limit;
+  int64_t fpPos = s.fpPos;
+  int64_t fpSpeed = s.fpSpeed;
+
+  if (fpSpeed > 0 && hi != unbounded) {
+    // fp2i(fpPos + m * fpSpeed) < hi
+    frames = std::min(frames, (hi * FP_ONE - fpPos - 1) / fpSpeed);
+  } else if (fpSpeed < 0 && lo != -unbounded) {
+    // fp2i(fpPos + m * fpSpeed) > lo
+    frames = std::min(frames, (fpPos - (lo + 1) * FP_ONE) / -fpSpeed);
+  }
+  return int(std::max(frames, int64_t(0)));
+}
+
+// Renders count frames for one voice configuration. The caller makes sure
+// no loop point is crossed on the way (see framesBeforeWrap()).
+
+template <int Channels, bool Linear, bool Filter, bool Crush, bool Downsample>
+void renderSampleKernel(SampleRenderState &s, fixed *result, int count) {
+
+  const fixed zerofive = fl2fp(0.5f);
+
+  const fixed mask = s.mask;
+  const fixed crushvol = s.crushvol;
+
+  fixed volfactor = s.volfactor.value_;
+  fixed panl = s.panl.value_;
+  fixed panr = s.panr.value_;
+  const fixed volStep = s.volfactor.step_;
+  const fixed panlStep = s.panl.step_;
+  const fixed panrStep = s.panr.step_;
+
+  // filter constants & state, kept local while rendering
+
+  const fixed f_k = fl2fp(1.0F / 3.0F);
+  const fixed f_s = FP_ONE - f_k;
+  const fixed fltMix = s.fltMix;
+  const fixed fltMixInv = FP_ONE - fltMix;
+  fixed fltParm1 = s.fltParm1.value_;
+  const fixed fltParm1Step = s.fltParm1.step_;
+  const fixed fltParm2 = s.fltParm2;
+  const fixed fltDirt = s.fltDirt;
+  const bool filterBoost = s.filterBoost;
+
+  fixed fltSpeed[Channels];
+  fixed fltHeight[Channels];
+  fixed fltDelay[Channels];
+  if (Filter) {
+    for (int i = 0; i < Channels; i++) {
+      fltSpeed[i] = s.flt->speed[i];
+      fltHeight[i] = s.flt->height[i];
+      fltDelay[i] = s.flt->hipdelay[i];
+    }
+  }
+
+  short *input = s.input;
+  fixed fpPos = s.fpPos;
+  const fixed fpSpeed = s.fpSpeed;
+
+  for (int frame = 0; frame < count; frame++) {
+
+    // get input sample to interpolate from
+
+    short *i1 = input;
+    if (Downsample) {
+      if (s.dirtyDownsampling) {
+        i1 = (short *)(((uintptr_t)input) & s.dsMask);
+      } else {
+        // prevent input ever being lower mem address then dsBasePtr (sample
+        // start point) this can occur eg. if doing reverse playback and
+        // using RTG cmds
+        if (input < s.dsBasePtr) {
+          i1 = s.dsBasePtr;
+        } else {
+          unsigned int distance =
+              (unsigned int)(input - s.dsBasePtr) / Channels;
+          i1 = s.dsBasePtr + (distance & s.dsMask) * Channels;
+        }
+      }
+    }
+    short *i2 = i1 + Channels;
+
+    fixed out[Channels];
+    for (int i = 0; i < Channels; i++) {
+      fixed s1 = i2fp(i1[i]);
+      fixed s2 = i2fp(i2[i]);
+
+      if (Linear) {
+        s1 = fp_mul(s1, fp_sub(FP_ONE, fpPos));
+        s2 = fp_mul(s2, fpPos);
+        s1 += s2;
+      } else {
+        if (fpPos > zerofive) {
+          s1 = s2;
+        };
+      }
+
+      // crush predrive & crush
+
+      if (Crush) {
+        s1 = fp_mul(s1, crushvol);
+        s1 = (s1 & mask);
+      }
+
+      // apply volume
+
+      s1 = fp_mul(s1, volfactor);
+
+      // apply filtering
+
+      if (Filter) {
+        fixed lpin = fp_mul(s1, fltMixInv);
+        fixed hpin = -fp_mul(s1, fltMix);
+
+        fixed difr = fp_sub(lpin, fltHeight[i]);
+
+        // Introduce non-linearity if screamin'
+
+        if (filterBoost) {
+          if (fltSpeed[i] < -FP_ONE) {
+            fltSpeed[i] = -f_s;
+          } else if (fltSpeed[i] > FP_ONE) {
+            fltSpeed[i] = f_s;
+          };
+          fltSpeed[i] = fp_mul(fltSpeed[i], fltDirt);
+        }
+
+        // mul by res, it's some kind of inertia.
+        fltSpeed[i] = fp_mul(fltSpeed[i], fltParm2);
+        // mul by cutoff, less cutoff = no sound, so it's better not be 0.
+        fltSpeed[i] = fp_add(fltSpeed[i], fp_mul(difr, fltParm1));
+
+        fltHeight[i] += fltSpeed[i];
+        fltHeight[i] += fltDelay[i] - hpin;
+        s1 = fltHeight[i];
+
+        fltDelay[i] = hpin;
+      }
+      out[i] = s1;
+    }
+
+    // introduce panning & vol - store result. Stereo sources come out with
+    // the last channel first, as they always did.
+
+    *result++ = fp_mul(out[Channels - 1], panl);
+    *result++ = fp_mul(out[0], panr);
+
+    volfactor += volStep;
+    panl += panlStep;
+    panr += panrStep;
+    if (Filter) {
+      fltParm1 += fltParm1Step;
+    }
+
+    // Computes new pos for next input sample
+    // fpPos is always relative to 'input' pointer
+
+    fpPos = fp_add(fpPos, fpSpeed);
+    int delta = fp2i(fpPos);
+    input += Channels * delta;
+    fpPos = fp_sub(fpPos, i2fp(delta));
+  }
+
+  s.input = input;
+  s.fpPos = fpPos;
+  s.volfactor.value_ = volfactor;
+  s.panl.value_ = panl;
+  s.panr.value_ = panr;
+
+  if (Filter) {
+    s.fltParm1.value_ = fltParm1;
+    for (int i = 0; i < Channels; i++) {
+      s.flt->speed[i] = fltSpeed[i];
+      s.flt->height[i] = fltHeight[i];
+      s.flt->hipdelay[i] = fltDelay[i];
+    }
+  } else {
+    s.fltParm1.value_ += count * fltParm1Step;
+  }
+}
+
+// Advances the voice by count frames without producing any output, for muted
+// or silent voices. Ends up in the exact same state as a rendering kernel.
+
+inline void skipSampleFrames(SampleRenderState &s, fixed *result, int count) {
+  int64_t fpPos = int64_t(s.fpPos) + int64_t(count) * s.fpSpeed;
+  int64_t delta = fpPos >> FIXED_SHIFT;
+  s.input += s.channelCount * delta;
+  s.fpPos = fixed(fpPos - (delta << FIXED_SHIFT));
+  s.volfactor.value_ += count * s.volfactor.step_;
+  s.panl.value_ += count * s.panl.step_;
+  s.panr.value_ += count * s.panr.step_;
+  s.fltParm1.value_ += count * s.fltParm1.step_;
+}
+
+typedef void (*SampleRenderKernel)(SampleRenderState &s, fixed *result,
+                                   int count);
+
+// Kernel table, indexed by voice configuration
+
+#define SRK_STEREO 0x01
+#define SRK_LINEAR 0x02
+#define SRK_FILTER 0x04
+#define SRK_CRUSH 0x08
+#define SRK_DOWNSAMPLE 0x10
+#define SRK_COUNT 0x20
+
+template <size_t Config> constexpr SampleRenderKernel sampleRenderKernel() {
+  return &renderSampleKernel<(Config & SRK_STEREO) ? 2 : 1,
+                             (Config & SRK_LINEAR) != 0,
+                             (Config & SRK_FILTER) != 0,
+                             (Config & SRK_CRUSH) != 0,
+                             (Config & SRK_DOWNSAMPLE) != 0>;
+}
+
+template <size_t... Config>
+constexpr etl::array<SampleRenderKernel, sizeof...(Config)>
+makeSampleRenderKernels(std::index_sequence<Config...>) {
+  return {{sampleRenderKernel<Config>()...}};
+}
+
+static constexpr etl::array<SampleRenderKernel, SRK_COUNT> sampleRenderKernels =
+    makeSampleRenderKernels(std::make_index_sequence<SRK_COUNT>());
+
+inline SampleRenderKernel
+selectSampleRenderKernel(const SampleRenderState &s, bool skip, bool linear,
+                         bool filtering, bool crushing, bool downsampling) {
+  // keep the filter running while the cutoff glides
+  filtering = filtering || (s.fltParm1.step_ != 0);
+
+  // Without volume and without a filter ringing out there is nothing to hear
+  if (skip || (!filtering && s.volfactor.value_ == 0 &&
+               s.volfactor.step_ == 0)) {
+    return skipSampleFrames;
+  }
+
+  size_t config = 0;
+  if (s.channelCount == 2)
+    config |= SRK_STEREO;
+  if (linear)
+    config |= SRK_LINEAR;
+  if (filtering)
+    config |= SRK_FILTER;
+  if (crushing)
+    config |= SRK_CRUSH;
+  if (downsampling)
+    config |= SRK_DOWNSAMPLE;
+  return sampleRenderKernels[config];
+}
+
+// Renders count frames of a voice in segments that end at the k-rate block
+// boundaries and at the loop points. The voice provides
+//   advance(): moves the play head to the next segment, false once the voice
+//              has nothing left to play
+//   startBlock(): updates volume, pan and filter for a new k-rate block and
+//                 returns the kernel to render it with
+//   rendered(kernel, frames): called after each segment
+// krateCount holds the frames left in the current k-rate block. The buffer
+// is only written to if something audible was rendered, the return value
+// tells if it was.
+
+template <typename Advance, typename StartBlock, typename Rendered>
+inline bool renderSampleSegments(SampleRenderState &state,
+                                 SampleRenderKernel kernel, int &krateCount,
+                                 fixed *buffer, int count, Advance advance,
+                                 StartBlock startBlock, Rendered rendered) {
+  bool somethingToMix = false;
+  fixed *result = buffer;
+
+  while (count > 0) {
+    if (!advance()) {
+      break;
+    }
+    if (krateCount == 0) {
+      krateCount = KRATE_SAMPLE_COUNT;
+      kernel = startBlock();
+    }
+
+    // Render this frame and all following ones up to the end of the k-rate
+    // block or the next loop point in one go. The kernels overwrite the
+    // buffer so silence only needs clearing once something was audible.
+
+    int frames = 1 + framesBeforeWrap(state, std::min(count, krateCount) - 1);
+    if (kernel == skipSampleFrames) {
+      if (somethingToMix) {
+        memset(result, 0, frames * 2 * sizeof(fixed));
+      }
+    } else if (!somethingToMix) {
+      memset(buffer, 0, (result - buffer) * sizeof(fixed));
+      somethingToMix = true;
+    }
+    kernel(state, result, frames);
+    rendered(kernel, frames);
+    result += 2 * frames;
+    count -= frames;
+    krateCount -= frames;
+  }
+
+  // clear what's left if the voice ended in this buffer
+
+  if (somethingToMix && count > 0) {
+    memset(result, 0, count * 2 * sizeof(fixed));
+  }
+  return somethingToMix;
+}
+
+#endif
@@ -14,12 +14,42 @@
 #include "Foundation/Types/Types.h"
 #include "SRPUpdaters.h"
 
+enum SampleInstrumentLoopMode {
+  SILM_ONESHOT = 0,
+  SILM_LOOP,
+  SILM_LOOP_PINGPONG,
+  SILM_OSC,
+  //	SILM_OSCFINE,
+  SILM_LOOPSYNC,
+  SILM_LAST
+};
+
+// Parameter interpolated linearly across a k-rate block. The step is
+// truncated, so a glide starts from the target of the previous one rather
+// than from where its steps stopped short of it
+
+struct KRateLerp {
+  fixed value_;
+  fixed step_;
+  fixed target_;
+
+  void Jump(fixed target) {
+    value_ = target_ = target;
+    step_ = 0;
+  }
+  void Glide(fixed target, int frames) {
+    value_ = target_;
+    target_ = target;
+    step_ = (target - value_) / frames;
+  }
+};
+
 struct renderParams {
 
   void *sampleBuffer_; // wavdata
   int channelCount_;
 
-  int krateCount_; // K-rate counter
+  int krateCount_; // frames left in the current k-rate block
   float position_; // Position in the sample stream
   int rendFirst_;  // position of the first sample (can be either start or loop
                    // depending on the mode)
@@ -71,8 +101,27 @@ struct renderParams {
   LogSpeedRamp pfin_;
   Arp arp_;
 
+  // Mix parameters of the current k-rate block
+  KRateLerp krateVolume_; // volume factor
+  KRateLerp kratePanL_;
+  KRateLerp kratePanR_;
+  KRateLerp krateFreq_; // filter cutoff coefficient
+  bool krateJump_;      // next block starts without gliding (new note)
+
   bool couldClick_;
 
+  // Voices of streamed sources (see SampleStreamer)
+  bool streamed_;       // the source only has its head resident
+  int streamVoice_;     // streamer voice, -1 when playing from the head
+  uint32_t streamSeq_;  // play head, in frames of the stream
+  fixed streamFpPos_;   // fractional part of the play head
+  int streamFrom_;      // first sample frame of the stream
+  uint32_t streamSkip_; // stream frames played from the head
+  // position and loop the voice was set up for, to catch commands moving them
+  float streamPosition_;
+  int streamLoopStart_;
+  int streamLoopEnd_;
+
   char midiNote_; // Current midi note
   bool sliceActive_;
   uint8_t activeSliceIndex_;
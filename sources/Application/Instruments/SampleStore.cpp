@@ -0,0 +1,133 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#include "SampleStore.h"
+#include "System/Console/Trace.h"
+
+SampleStore::SampleStore(uint32_t size, uint32_t alignment)
+    : size_(size), alignment_(alignment) {
+  Reset();
+}
+
+void SampleStore::Reset() {
+  free_.clear();
+  if (size_ > 0) {
+    free_.push_back({0, size_});
+  }
+}
+
+bool SampleStore::Allocate(uint32_t size, uint32_t &offset) {
+  size = Align(size);
+  int best = -1;
+  for (uint32_t i = 0; i < free_.size(); i++) {
+    if (free_[i].size >= size &&
+        (best < 0 || free_[i].size < free_[best].size)) {
+      best = i;
+    }
+  }
+  if (best < 0) {
+    return false;
+  }
+  Block &block = free_[best];
+  offset = block.offset;
+  block.offset += size;
+  block.size -= size;
+  if (block.size == 0) {
+    free_.erase(free_.begin() + best);
+  }
+  return true;
+}
+
+bool SampleStore::Reserve(uint32_t offset, uint32_t size) {
+  size = Align(size);
+  for (uint32_t i = 0; i < free_.size(); i++) {
+    Block &block = free_[i];
+    if (offset < block.offset || offset + size > block.offset + block.size) {
+      continue;
+    }
+    uint32_t end = block.offset + block.size;
+    block.size = offset - block.offset;
+    if (block.size == 0) {
+      free_.erase(free_.begin() + i);
+      i--;
+    }
+    if (end > offset + size) {
+      insert(i + 1, offset + size, end - offset - size);
+    }
+    return true;
+  }
+  return false;
+}
+
+void SampleStore::Release(uint32_t offset, uint32_t size) {
+  size = Align(size);
+  if (size == 0) {
+    return;
+  }
+  uint32_t next = 0;
+  while (next < free_.size() && free_[next].offset < offset) {
+    next++;
+  }
+  bool overlapsPrevious =
+      next > 0 && free_[next - 1].offset + free_[next - 1].size > offset;
+  bool overlapsNext =
+      next < free_.size() && offset + size > free_[next].offset;
+  if (overlapsPrevious || overlapsNext || offset + size > size_) {
+    Trace::Error("SampleStore: releasing %u bytes at %u twice", size, offset);
+    return;
+  }
+
+  bool mergePrevious =
+      next > 0 && free_[next - 1].offset + free_[next - 1].size == offset;
+  bool mergeNext = next < free_.size() && offset + size == free_[next].offset;
+  if (mergePrevious && mergeNext) {
+    free_[next - 1].size += size + free_[next].size;
+    free_.erase(free_.begin() + next);
+  } else if (mergePrevious) {
+    free_[next - 1].size += size;
+  } else if (mergeNext) {
+    free_[next].offset = offset;
+    free_[next].size += size;
+  } else {
+    insert(next, offset, size);
+  }
+}
+
+bool SampleStore::IsFree(uint32_t offset, uint32_t size) const {
+  for (const Block &block : free_) {
+    if (offset >= block.offset &&
+        offset + size <= block.offset + block.size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t SampleStore::Available() const {
+  uint32_t available = 0;
+  for (const Block &block : free_) {
+    available += block.size;
+  }
+  return available;
+}
+
+uint32_t SampleStore::Largest() const {
+  uint32_t largest = 0;
+  for (const Block &block : free_) {
+    largest = (block.size > largest) ? block.size : largest;
+  }
+  return largest;
+}
+
+void SampleStore::insert(uint32_t position, uint32_t offset, uint32_t size) {
+  if (free_.full()) {
+    Trace::Error("SampleStore: too many free blocks, losing %u bytes", size);
+    return;
+  }
+  free_.insert(free_.begin() + position, {offset, size});
+}
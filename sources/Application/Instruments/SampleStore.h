@@ -0,0 +1,101 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _SAMPLE_STORE_H_
+#define _SAMPLE_STORE_H_
+
+#include "Application/Model/Song.h"
+#include "Externals/etl/include/etl/vector.h"
+#include <cstdint>
+
+// Free blocks left between the samples of a store, there can't be more than
+// one per sample plus the end of the store. Blocks that don't fit in the list
+// any more are lost until the store is reset
+#define SAMPLE_STORE_MAX_FREE_BLOCKS (MAX_SAMPLEINSTRUMENT_COUNT * 4 + 1)
+
+// Keeps track of the free space of a sample store, the memory itself belongs
+// to the SamplePool of the platform. Offsets and sizes are rounded up to the
+// alignment of the store. Free blocks are sorted by offset and merged with
+// their neighbours when released
+class SampleStore {
+public:
+  SampleStore(uint32_t size, uint32_t alignment);
+
+  // Frees the whole store
+  void Reset();
+
+  // Best fit, false if no free block is big enough
+  bool Allocate(uint32_t size, uint32_t &offset);
+  // Takes a given range out of the free blocks, for stores that keep their
+  // content from one session to the next
+  bool Reserve(uint32_t offset, uint32_t size);
+  void Release(uint32_t offset, uint32_t size);
+  // Whether the range is entirely free
+  bool IsFree(uint32_t offset, uint32_t size) const;
+
+  uint32_t Align(uint32_t size) const {
+    return (size + alignment_ - 1) & ~(alignment_ - 1);
+  }
+  uint32_t Size() const { return size_; }
+  // Free bytes in total and in the biggest block
+  uint32_t Available() const;
+  uint32_t Largest() const;
+
+  // Moves the count allocations at offsets (of sizes bytes each) down to the
+  // start of the store, in address order, so that its free space ends up in
+  // one block. move(i, to) has to copy allocation i down to offset to, each
+  // allocation only ever goes down and the ones below it are already in
+  // place. offsets are updated to where the allocations end up
+  template <typename Move>
+  void Compact(uint32_t *offsets, const uint32_t *sizes, uint32_t count,
+               Move move);
+
+private:
+  struct Block {
+    uint32_t offset;
+    uint32_t size;
+  };
+  void insert(uint32_t position, uint32_t offset, uint32_t size);
+
+  etl::vector<Block, SAMPLE_STORE_MAX_FREE_BLOCKS> free_;
+  uint32_t size_;
+  uint32_t alignment_;
+};
+
+template <typename Move>
+void SampleStore::Compact(uint32_t *offsets, const uint32_t *sizes,
+                          uint32_t count, Move move) {
+  Reset();
+  uint32_t end = 0;
+  uint32_t moved = 0; // original offset of the last allocation moved
+  bool first = true;
+  while (true) {
+    // lowest allocation not moved yet. Those that were are below moved now
+    int next = -1;
+    for (uint32_t i = 0; i < count; i++) {
+      if ((!first && offsets[i] <= moved) ||
+          (next >= 0 && offsets[i] >= offsets[next])) {
+        continue;
+      }
+      next = i;
+    }
+    if (next < 0) {
+      break;
+    }
+    first = false;
+    moved = offsets[next];
+    if (offsets[next] != end) {
+      move(next, end);
+      offsets[next] = end;
+    }
+    Reserve(end, sizes[next]);
+    end += Align(sizes[next]);
+  }
+}
+
+#endif
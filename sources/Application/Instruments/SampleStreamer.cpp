@@ -0,0 +1,308 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#include "SampleStreamer.h"
+#include "SamplePool.h"
+#include "System/Console/Trace.h"
+#include <algorithm>
+#include <string.h>
+
+uint32_t SampleStreamer::Params::fileFrame(uint32_t seq) const {
+  if (seq < firstLength_ || loopLength_ == 0) {
+    return from_ + seq;
+  }
+  return loopStart_ + (seq - firstLength_) % loopLength_;
+}
+
+SampleStreamer::SampleStreamer() {
+  for (Voice &v : voices_) {
+    v.params_ = Params();
+    v.generation_ = 0;
+    v.consumed_ = 0;
+    v.underruns_ = 0;
+    v.ready_ = 0;
+    v.written_ = 0;
+    v.lowWater_ = 0;
+    v.job_ = Params();
+    v.jobGeneration_ = 0;
+    v.openSource_ = nullptr;
+    v.filePosition_ = -1;
+    v.failed_ = false;
+  }
+}
+
+int SampleStreamer::Open(int channel, SoundSource *source, int from,
+                         int loopStart, int end, bool loop, uint32_t skip) {
+
+  // Keep the voice the channel already streams on, otherwise take a free
+  // one, preferably one that still has the file open
+
+  int found = -1;
+  for (int i = 0; i < SAMPLE_STREAM_VOICES; i++) {
+    Params &p = voices_[i].params_;
+    if (p.active_ && p.channel_ == channel) {
+      found = i;
+      break;
+    }
+    if (!p.active_ && (found < 0 || p.source_ == source)) {
+      found = i;
+    }
+  }
+  if (found < 0) {
+    return -1;
+  }
+
+  Voice &v = voices_[found];
+  uint32_t generation = v.generation_.load(std::memory_order_relaxed);
+  v.generation_.store(generation + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  Params &p = v.params_;
+  p.active_ = true;
+  p.channel_ = channel;
+  p.source_ = source;
+  p.from_ = from;
+  p.loopStart_ = loopStart;
+  if (loop) {
+    // the last frame is only ever interpolated with before jumping back
+    p.firstLength_ = std::max(end - 1 - from, 0);
+    p.loopLength_ = end - 1 - loopStart;
+    p.endSeq_ = UINT32_MAX;
+  } else {
+    p.firstLength_ = std::max(end - from, 0);
+    p.loopLength_ = 0;
+    p.endSeq_ = p.firstLength_;
+  }
+  p.skip_ = skip;
+  p.channelCount_ = source->GetChannelCount(0);
+  p.ringFrames_ = SAMPLE_STREAM_RING_SAMPLES / p.channelCount_;
+
+  v.consumed_.store(skip, std::memory_order_relaxed);
+  v.underruns_.store(0, std::memory_order_relaxed);
+  v.generation_.store(generation + 2, std::memory_order_release);
+  return found;
+}
+
+void SampleStreamer::Close(int voice) {
+  Voice &v = voices_[voice];
+  uint32_t generation = v.generation_.load(std::memory_order_relaxed);
+  v.generation_.store(generation + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  v.params_.active_ = false;
+  v.generation_.store(generation + 2, std::memory_order_release);
+}
+
+short *SampleStreamer::Peek(int voice, uint32_t seq, uint32_t &frames) {
+  Voice &v = voices_[voice];
+  frames = 0;
+
+  // Nothing to read until the main thread restarted the ring for us
+  if (v.ready_.load(std::memory_order_acquire) !=
+      v.generation_.load(std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  uint32_t written = v.written_.load(std::memory_order_acquire);
+  if (written <= seq + 1) {
+    return nullptr;
+  }
+
+  // Up to the guard frame at the end of the ring
+  const Params &p = v.params_;
+  uint32_t index = seq & (p.ringFrames_ - 1);
+  frames = std::min(written - seq, p.ringFrames_ + 1 - index);
+  return v.ring_ + index * p.channelCount_;
+}
+
+bool SampleStreamer::Ended(int voice, uint32_t seq) {
+  const Params &p = voices_[voice].params_;
+  return (p.loopLength_ == 0) && (seq + 1 >= p.endSeq_);
+}
+
+void SampleStreamer::Consume(int voice, uint32_t seq) {
+  voices_[voice].consumed_.store(seq, std::memory_order_release);
+}
+
+void SampleStreamer::ReportUnderrun(int voice) {
+  voices_[voice].underruns_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t SampleStreamer::GetFileFrame(int voice, uint32_t seq) {
+  return voices_[voice].params_.fileFrame(seq);
+}
+
+uint32_t SampleStreamer::GetLoopEnd(int voice, uint32_t seq) {
+  const Params &p = voices_[voice].params_;
+  if (p.loopLength_ == 0) {
+    return UINT32_MAX;
+  }
+  if (seq < p.firstLength_) {
+    return p.firstLength_;
+  }
+  return seq + p.loopLength_ - (seq - p.firstLength_) % p.loopLength_;
+}
+
+void SampleStreamer::Service() {
+
+  for (Voice &v : voices_) {
+    sync(v);
+  }
+
+  for (int reads = 0; reads < SAMPLE_STREAM_SERVICE_READS; reads++) {
+
+    // Earliest deadline first: top up the voice with the least read ahead
+
+    Voice *next = nullptr;
+    uint32_t nextBuffered = 0;
+    for (Voice &v : voices_) {
+      if (!v.job_.active_ || v.failed_ ||
+          v.generation_.load(std::memory_order_relaxed) != v.jobGeneration_) {
+        continue;
+      }
+      uint32_t written = v.written_.load(std::memory_order_relaxed);
+      uint32_t consumed = v.consumed_.load(std::memory_order_acquire);
+      // fast play heads can get past what was read
+      if (int32_t(consumed - written) > 0) {
+        written = consumed;
+      }
+      uint32_t buffered = written - consumed;
+      // only counts once the voice plays from the ring
+      if (reads == 0 && consumed > v.job_.skip_ && written < v.job_.endSeq_) {
+        v.lowWater_ = std::min(v.lowWater_, buffered);
+      }
+      if (buffered >= v.job_.ringFrames_ || written >= v.job_.endSeq_) {
+        continue;
+      }
+      if (next == nullptr || buffered < nextBuffered) {
+        next = &v;
+        nextBuffered = buffered;
+      }
+    }
+    if (next == nullptr) {
+      break;
+    }
+    if (!fill(*next)) {
+      Trace::Error("SampleStreamer: read failed on channel %d",
+                   next->job_.channel_);
+      next->failed_ = true;
+    }
+  }
+}
+
+bool SampleStreamer::GetHealth(int channel, SampleStreamHealth &health) {
+  for (Voice &v : voices_) {
+    if (!v.job_.active_ || v.job_.channel_ != channel) {
+      continue;
+    }
+    health.active_ = true;
+    health.capacity_ = v.job_.ringFrames_;
+    health.buffered_ =
+        std::min(v.written_.load(std::memory_order_relaxed) -
+                     v.consumed_.load(std::memory_order_relaxed),
+                 health.capacity_);
+    health.lowWater_ = v.lowWater_;
+    health.underruns_ = v.underruns_.load(std::memory_order_relaxed);
+    return true;
+  }
+  health = SampleStreamHealth();
+  return false;
+}
+
+// Picks up what the audio thread asked for last. Restarts the ring if the
+// voice was (re)opened and takes care of the file.
+
+bool SampleStreamer::sync(Voice &v) {
+  uint32_t generation = v.generation_.load(std::memory_order_acquire);
+  if (generation == v.jobGeneration_ || (generation & 1)) {
+    return false;
+  }
+  Params job = v.params_;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (v.generation_.load(std::memory_order_relaxed) != generation) {
+    return false;
+  }
+
+  if (v.job_.active_) {
+    uint32_t underruns = v.underruns_.load(std::memory_order_relaxed);
+    if (underruns > 0) {
+      Trace::Log("SampleStreamer", "Channel %d: %d underruns",
+                 v.job_.channel_, (int)underruns);
+    }
+  }
+
+  if (!job.active_) {
+    v.wav_.Close();
+    v.openSource_ = nullptr;
+  } else if (job.source_ != v.openSource_) {
+    v.wav_.Close();
+    v.failed_ = !SamplePool::GetInstance()->OpenStream(job.source_, v.wav_);
+    v.openSource_ = v.failed_ ? nullptr : job.source_;
+    v.filePosition_ = -1;
+  } else {
+    v.failed_ = false;
+  }
+
+  v.job_ = job;
+  v.jobGeneration_ = generation;
+  v.lowWater_ = job.ringFrames_;
+  v.written_.store(job.skip_, std::memory_order_relaxed);
+  v.ready_.store(generation, std::memory_order_release);
+  return true;
+}
+
+// Reads the next run of frames of a voice, at most up to the ring wrap and to
+// where the stream jumps in the file.
+
+bool SampleStreamer::fill(Voice &v) {
+  const Params &p = v.job_;
+  uint32_t written = v.written_.load(std::memory_order_relaxed);
+  uint32_t consumed = v.consumed_.load(std::memory_order_acquire);
+  // frames the play head jumped over are never read
+  if (int32_t(consumed - written) > 0) {
+    written = consumed;
+  }
+  uint32_t index = written & (p.ringFrames_ - 1);
+  uint32_t frames = p.ringFrames_ - (written - consumed);
+  frames = std::min(frames, p.ringFrames_ - index);
+  frames = std::min<uint32_t>(frames, SAMPLE_STREAM_READ_FRAMES);
+
+  uint32_t frame = p.fileFrame(written);
+  if (p.loopLength_ == 0) {
+    frames = std::min(frames, p.endSeq_ - written);
+  } else if (written < p.firstLength_) {
+    frames = std::min(frames, p.firstLength_ - written);
+  } else {
+    frames = std::min(frames, p.loopStart_ + p.loopLength_ - frame);
+  }
+
+  if (int32_t(frame) != v.filePosition_) {
+    v.filePosition_ = -1;
+    if (!v.wav_.Rewind(frame)) {
+      return false;
+    }
+  }
+  short *dst = v.ring_ + index * p.channelCount_;
+  uint32_t bytesRead = 0;
+  if (!v.wav_.Read(dst, frames * p.channelCount_ * sizeof(short),
+                   &bytesRead) ||
+      bytesRead == 0) {
+    return false;
+  }
+  uint32_t framesRead = bytesRead / (p.channelCount_ * sizeof(short));
+  v.filePosition_ = frame + framesRead;
+
+  if (index == 0) {
+    memcpy(v.ring_ + p.ringFrames_ * p.channelCount_, v.ring_,
+           p.channelCount_ * sizeof(short));
+  }
+
+  // If the voice got restarted meanwhile, it waits for the next sync
+  if (v.generation_.load(std::memory_order_acquire) == v.jobGeneration_) {
+    v.written_.store(written + framesRead, std::memory_order_release);
+  }
+  return true;
+}
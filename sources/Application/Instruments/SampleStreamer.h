@@ -0,0 +1,128 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _SAMPLE_STREAMER_H_
+#define _SAMPLE_STREAMER_H_
+
+#include "Foundation/T_Singleton.h"
+#include "SoundSource.h"
+#include "WavFile.h"
+#include <atomic>
+#include <stdint.h>
+
+// Number of sample voices that can stream at the same time and size of their
+// ring, in 16 bit samples (power of two)
+#ifdef ADV
+#define SAMPLE_STREAM_VOICES 8
+#else
+#define SAMPLE_STREAM_VOICES 2
+#endif
+#define SAMPLE_STREAM_RING_SAMPLES 8192
+
+// Frames read from the card in one go, and reads per Service() call
+#define SAMPLE_STREAM_READ_FRAMES 1024
+#define SAMPLE_STREAM_SERVICE_READS 8
+
+struct SampleStreamHealth {
+  bool active_;
+  uint32_t buffered_;  // frames read ahead of the play head
+  uint32_t capacity_;  // ring size in frames
+  uint32_t lowWater_;  // fewest frames buffered seen since the voice started
+  uint32_t underruns_; // buffers the voice had to wait on the card
+};
+
+// Streams the part of long samples that is not resident in the sample store.
+//
+// A stream is the sequence of frames a voice plays, in play order: frame
+// 'from' onwards up to the end, then the loop over and over for looping
+// voices. The voice plays its first 'skip' frames from the resident head
+// and the rest from a ring the main thread keeps filled ahead of it.
+// Open(), Close() and the ring accessors are for the audio thread only,
+// Service() and GetHealth() for the main thread.
+
+class SampleStreamer : public T_Singleton<SampleStreamer> {
+public:
+  SampleStreamer();
+
+  // Starts streaming for a channel, returns the stream voice or -1 if all of
+  // them are busy. end is exclusive.
+  int Open(int channel, SoundSource *source, int from, int loopStart,
+           int end, bool loop, uint32_t skip);
+  void Close(int voice);
+
+  // Ring frames from frame seq of the stream on, frames is set to the number
+  // that can be read in one go. The last of them is only there to
+  // interpolate with.
+  short *Peek(int voice, uint32_t seq, uint32_t &frames);
+  // All frames of a one shot stream were played
+  bool Ended(int voice, uint32_t seq);
+  // The play head moved to frame seq, everything before can be reused
+  void Consume(int voice, uint32_t seq);
+  void ReportUnderrun(int voice);
+  // Sample frame of frame seq of the stream
+  uint32_t GetFileFrame(int voice, uint32_t seq);
+  // Frame where the loop pass containing frame seq ends. Play heads going
+  // past it restart there, like they restart at the loop start of resident
+  // samples
+  uint32_t GetLoopEnd(int voice, uint32_t seq);
+
+  // Reads ahead for all streaming voices, the emptiest one first
+  void Service();
+  bool GetHealth(int channel, SampleStreamHealth &health);
+
+private:
+  struct Params {
+    bool active_;
+    int channel_;
+    SoundSource *source_;
+    uint32_t from_;
+    uint32_t loopStart_;
+    uint32_t firstLength_; // frames played before looping
+    uint32_t loopLength_;  // 0 for one shots
+    uint32_t endSeq_;      // length of one shot streams
+    uint32_t skip_;        // frames played from the resident head
+    uint32_t channelCount_;
+    uint32_t ringFrames_;
+
+    uint32_t fileFrame(uint32_t seq) const;
+  };
+
+  struct Voice {
+    // Written by the audio thread, between two increments of generation_.
+    // Odd while being written.
+    Params params_;
+    std::atomic<uint32_t> generation_;
+    std::atomic<uint32_t> consumed_;
+    std::atomic<uint32_t> underruns_;
+
+    // Written by the main thread. ready_ is the generation the ring was
+    // restarted for
+    std::atomic<uint32_t> ready_;
+    std::atomic<uint32_t> written_;
+    uint32_t lowWater_;
+
+    // Main thread only
+    Params job_;
+    uint32_t jobGeneration_;
+    SoundSource *openSource_;
+    WavFile wav_;
+    int32_t filePosition_; // frame the next read gets, -1 if unknown
+    bool failed_;
+
+    // plus one guard frame mirroring the first for interpolation across the
+    // wrap
+    short ring_[SAMPLE_STREAM_RING_SAMPLES + 2];
+  };
+
+  bool sync(Voice &v);
+  bool fill(Voice &v);
+
+  Voice voices_[SAMPLE_STREAM_VOICES];
+};
+
+#endif
@@ -23,6 +23,10 @@ public:
   virtual bool IsMulti() = 0;
   virtual int GetRootNote(int note) = 0;
   virtual float GetLengthInSec() = 0;
+  // Streamed sources only keep the first GetResidentSize() frames in the
+  // sample buffer, the rest is read from the card while playing
+  virtual bool IsStreamed() { return false; };
+  virtual int GetResidentSize(int note) { return GetSize(note); };
 };
 
 #endif
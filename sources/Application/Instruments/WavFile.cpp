@@ -125,8 +125,8 @@ float ConvertSampleToFloat(const uint8_t *samplePtr, uint16_t audioFormat,
 
 WavFile::WavFile()
     : file_(), readBufferSize_(0), samples_(nullptr), sampleBufferSize_(0),
-      size_(0), sampleRate_(0), channelCount_(0), bytePerSample_(0),
-      audioFormat_(0), dataPosition_(0), readCount_(0) {}
+      size_(0), residentSize_(0), sampleRate_(0), channelCount_(0),
+      bytePerSample_(0), audioFormat_(0), dataPosition_(0), readCount_(0) {}
 
 etl::expected<void, WAVEFILE_ERROR> WavFile::Open(const char *name) {
   // open file
@@ -153,6 +153,7 @@ etl::expected<void, WAVEFILE_ERROR> WavFile::Open(const char *name) {
   size_ =
       header->dataChunkSize / (header->numChannels * header->bytesPerSample);
   Trace::Debug("File sample count: %i", size_);
+  residentSize_ = size_;
 
   // All samples are saved as 16bit/sample in memory
   sampleBufferSize_ = size_ * header->numChannels * 2;
@@ -180,6 +181,14 @@ int WavFile::GetSampleRate(int note) { return sampleRate_; };
 
 float WavFile::GetLengthInSec() { return (float)size_ / sampleRate_; };
 
+bool WavFile::IsStreamed() { return residentSize_ < size_; };
+
+int WavFile::GetResidentSize(int note) { return residentSize_; };
+
+void WavFile::SetResidentSize(int size) {
+  residentSize_ = std::min(size, size_);
+}
+
 long WavFile::readBlock(long start, long size) {
   if (size > readBufferSize_) {
     readBufferSize_ = size;
@@ -233,10 +242,14 @@ bool WavFile::GetBuffer(long start, long size) {
 
 uint32_t WavFile::GetDiskSize(int note) { return sampleBufferSize_; }
 
-// rewind to start of data (no header)
-bool WavFile::Rewind() {
-  file_->Seek(dataPosition_, SEEK_SET);
-  readCount_ = size_ * channelCount_ * bytePerSample_;
+// rewind to start of data (no header), or to the given sample
+bool WavFile::Rewind(long start) {
+  if (start < 0 || start > size_) {
+    return false;
+  }
+  const int32_t bytesPerFrame = channelCount_ * bytePerSample_;
+  file_->Seek(dataPosition_ + start * bytesPerFrame, SEEK_SET);
+  readCount_ = (size_ - start) * bytesPerFrame;
   return true;
 };
 
@@ -38,9 +38,17 @@ public:
   virtual int GetRootNote(int note);
   bool GetBuffer(long start, long sampleCount); // values in samples
   virtual float GetLengthInSec();
+  virtual bool IsStreamed();
+  virtual int GetResidentSize(int note);
+  void SetResidentSize(int size); // frames loaded in the sample buffer
 
   uint32_t GetDiskSize(int note);
-  bool Rewind();
+  // of the open file, 0 when unknown
+  uint32_t GetModifyTime() { return file_ ? file_->GetModifyTime() : 0; }
+  // where the frames start in the file and their size there
+  uint32_t GetDataPosition() const { return dataPosition_; }
+  uint32_t GetFileFrameSize() const { return channelCount_ * bytePerSample_; }
+  bool Rewind(long start = 0); // start in samples
   bool Read(void *buff, uint32_t btr, uint32_t *bytesRead);
   bool ReadFloat(float *buff, uint32_t maxSamples, uint32_t *samplesRead);
   void Close();
@@ -56,6 +64,7 @@ private:
   short *samples_;     // sample buffer size (16 bits)
   int sampleBufferSize_;
   int size_;             // number of samples
+  int residentSize_;     // number of samples in the sample buffer
   int sampleRate_;       // sample rate
   int channelCount_;     // mono / stereo
   int bytePerSample_;    // original file depth (8/16/24/32bit or float)
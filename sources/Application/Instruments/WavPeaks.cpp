@@ -0,0 +1,280 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#include "WavPeaks.h"
+#include "System/Console/Trace.h"
+#include "WavHeader.h"
+#include <string.h>
+
+#define WAV_PEAKS_HEADER_SIZE 16
+
+static const WavPeak emptyPeak = {127, -128};
+
+WavPeaksBuilder::WavPeaksBuilder()
+    : current_(emptyPeak), blockFrames_(0), frames_(0), peaks_(0),
+      buffered_(0), error_(false) {}
+
+WavPeaksBuilder::~WavPeaksBuilder() { Discard(); }
+
+bool WavPeaksBuilder::Open(const char *wavPath) {
+  Discard();
+  WavPeaks::GetPath(wavPath, path_);
+  file_ = FileSystem::GetInstance()->Open(path_.c_str(), "w+");
+  if (!file_) {
+    Trace::Error("WavPeaks: Could not create %s", path_.c_str());
+    return false;
+  }
+  current_ = emptyPeak;
+  blockFrames_ = 0;
+  frames_ = 0;
+  peaks_ = 0;
+  buffered_ = 0;
+  error_ = false;
+
+  // the header goes in last, a file left half written is never used
+  char header[WAV_PEAKS_HEADER_SIZE] = {};
+  error_ = file_->Write(header, 1, sizeof(header)) != sizeof(header);
+  return !error_;
+}
+
+void WavPeaksBuilder::AddFrames(const int16_t *samples, uint32_t frames,
+                                uint16_t channels) {
+  if (!file_) {
+    return;
+  }
+  for (uint32_t i = 0; i < frames; i++) {
+    Add(samples[i * channels]);
+  }
+}
+
+void WavPeaksBuilder::flushBlock() {
+  frames_ += blockFrames_;
+  buffer_[buffered_++] = current_;
+  current_ = emptyPeak;
+  blockFrames_ = 0;
+  peaks_++;
+  if (buffered_ == WAV_PEAKS_BUFFER_SIZE) {
+    writePeaks(buffer_, buffered_);
+    buffered_ = 0;
+  }
+}
+
+bool WavPeaksBuilder::writePeaks(const WavPeak *peaks, uint32_t count) {
+  uint32_t size = count * sizeof(WavPeak);
+  if (!file_ || file_->Write(peaks, 1, size) != int(size)) {
+    error_ = true;
+  }
+  return !error_;
+}
+
+bool WavPeaksBuilder::Close() {
+  if (!file_) {
+    return false;
+  }
+  if (blockFrames_ > 0) {
+    flushBlock();
+  }
+  writePeaks(buffer_, buffered_);
+  buffered_ = 0;
+
+  // Each level is folded out of the one before, read back from the file
+  uint32_t levels = 1;
+  uint32_t count = peaks_;
+  long offset = WAV_PEAKS_HEADER_SIZE;
+  WavPeak folded[WAV_PEAKS_BUFFER_SIZE / 2];
+  while (count > 1 && !error_) {
+    for (uint32_t i = 0; i < count; i += WAV_PEAKS_BUFFER_SIZE) {
+      uint32_t chunk = count - i;
+      chunk = (chunk < WAV_PEAKS_BUFFER_SIZE) ? chunk : WAV_PEAKS_BUFFER_SIZE;
+      file_->Seek(offset + i * sizeof(WavPeak), SEEK_SET);
+      uint32_t size = chunk * sizeof(WavPeak);
+      if (file_->Read(buffer_, size) != int(size)) {
+        error_ = true;
+        break;
+      }
+      for (uint32_t j = 0; j < chunk; j += 2) {
+        WavPeak peak = buffer_[j];
+        if (j + 1 < chunk) {
+          const WavPeak &next = buffer_[j + 1];
+          peak.min = (next.min < peak.min) ? next.min : peak.min;
+          peak.max = (next.max > peak.max) ? next.max : peak.max;
+        }
+        folded[j / 2] = peak;
+      }
+      file_->Seek(0, SEEK_END);
+      if (!writePeaks(folded, (chunk + 1) / 2)) {
+        break;
+      }
+    }
+    offset += count * sizeof(WavPeak);
+    count = (count + 1) / 2;
+    levels++;
+  }
+
+  uint16_t version = WAV_PEAKS_VERSION;
+  uint16_t block = WAV_PEAKS_BLOCK_FRAMES;
+  file_->Seek(0, SEEK_SET);
+  error_ = error_ || file_->Write("PTPK", 1, 4) != 4 ||
+           file_->Write(&version, 1, 2) != 2 ||
+           file_->Write(&block, 1, 2) != 2 ||
+           file_->Write(&frames_, 1, 4) != 4 ||
+           file_->Write(&levels, 1, 4) != 4;
+  if (error_) {
+    Discard();
+    return false;
+  }
+  file_.reset();
+  return true;
+}
+
+void WavPeaksBuilder::Discard() {
+  if (!file_) {
+    return;
+  }
+  file_.reset();
+  FileSystem::GetInstance()->DeleteFile(path_.c_str());
+}
+
+void WavPeaks::GetPath(const char *wavPath,
+                       etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> &path) {
+  path = wavPath;
+  size_t dot = path.find_last_of('.');
+  if (dot != path.npos) {
+    path.erase(dot);
+  }
+  path.append(WAV_PEAKS_EXTENSION);
+}
+
+void WavPeaks::Remove(const char *wavPath) {
+  etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> path;
+  GetPath(wavPath, path);
+  FileSystem::GetInstance()->DeleteFile(path.c_str());
+}
+
+bool WavPeaks::Build(const char *wavPath, void *scratchBuffer,
+                     uint32_t scratchBufferSize) {
+  auto file = FileSystem::GetInstance()->Open(wavPath, "r");
+  if (!file) {
+    return false;
+  }
+  auto header = WavHeaderWriter::ReadHeader(file.get());
+  if (!header.has_value()) {
+    return false;
+  }
+  const WavHeaderInfo &info = header.value();
+  if (info.numChannels == 0 || info.numChannels > 2 ||
+      (info.bitsPerSample != 8 && info.bitsPerSample != 16)) {
+    return false;
+  }
+
+  WavPeaksBuilder builder;
+  if (!builder.Open(wavPath)) {
+    return false;
+  }
+  file->Seek(info.dataOffset, SEEK_SET);
+
+  int16_t *chunk = (int16_t *)scratchBuffer;
+  uint32_t bytesPerFrame = info.numChannels * (info.bitsPerSample / 8);
+  uint32_t left = info.dataChunkSize - info.dataChunkSize % bytesPerFrame;
+  while (left > 0) {
+    uint32_t size = scratchBufferSize - scratchBufferSize % bytesPerFrame;
+    size = (size < left) ? size : left;
+    int read = file->Read(chunk, size);
+    if (read <= 0) {
+      break;
+    }
+    uint32_t frames = read / bytesPerFrame;
+    if (info.bitsPerSample == 16) {
+      builder.AddFrames(chunk, frames, info.numChannels);
+    } else {
+      // 8 bit samples are unsigned
+      const uint8_t *bytes = (const uint8_t *)chunk;
+      for (uint32_t i = 0; i < frames; i++) {
+        builder.Add(int16_t((bytes[i * info.numChannels] - 128) * 256));
+      }
+    }
+    left -= read;
+  }
+  return builder.Close();
+}
+
+bool WavPeaks::Read(const char *wavPath, uint32_t frames, uint32_t start,
+                    uint32_t end, uint8_t *columns, uint32_t count,
+                    uint8_t height) {
+  if (end <= start || count == 0 || end > frames) {
+    return false;
+  }
+  uint32_t span = end - start;
+  if (span / count < WAV_PEAKS_BLOCK_FRAMES) {
+    return false;
+  }
+
+  etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> path;
+  GetPath(wavPath, path);
+  auto file = FileSystem::GetInstance()->Open(path.c_str(), "r");
+  if (!file) {
+    return false;
+  }
+  char magic[4];
+  uint16_t version, block;
+  uint32_t savedFrames, levels;
+  if (file->Read(magic, 4) != 4 || file->Read(&version, 2) != 2 ||
+      file->Read(&block, 2) != 2 || file->Read(&savedFrames, 4) != 4 ||
+      file->Read(&levels, 4) != 4 || memcmp(magic, "PTPK", 4) ||
+      version != WAV_PEAKS_VERSION || block != WAV_PEAKS_BLOCK_FRAMES) {
+    return false;
+  }
+  if (savedFrames != frames) {
+    Trace::Log("WAVPEAKS", "%s is out of date", path.c_str());
+    return false;
+  }
+
+  // Coarsest level that still has a peak per column
+  uint32_t level = 0;
+  uint32_t blockFrames = WAV_PEAKS_BLOCK_FRAMES;
+  uint32_t peaks =
+      (frames + WAV_PEAKS_BLOCK_FRAMES - 1) / WAV_PEAKS_BLOCK_FRAMES;
+  long offset = WAV_PEAKS_HEADER_SIZE;
+  while (level + 1 < levels && blockFrames * 2 <= span / count) {
+    offset += peaks * sizeof(WavPeak);
+    peaks = (peaks + 1) / 2;
+    blockFrames *= 2;
+    level++;
+  }
+
+  memset(columns, 0, count);
+  uint32_t first = start / blockFrames;
+  uint32_t last = (end + blockFrames - 1) / blockFrames;
+  last = (last < peaks) ? last : peaks;
+  file->Seek(offset + first * sizeof(WavPeak), SEEK_SET);
+
+  WavPeak buffer[WAV_PEAKS_BUFFER_SIZE];
+  for (uint32_t i = first; i < last; i += WAV_PEAKS_BUFFER_SIZE) {
+    uint32_t chunk = last - i;
+    chunk = (chunk < WAV_PEAKS_BUFFER_SIZE) ? chunk : WAV_PEAKS_BUFFER_SIZE;
+    uint32_t size = chunk * sizeof(WavPeak);
+    if (file->Read(buffer, size) != int(size)) {
+      return false;
+    }
+    for (uint32_t j = 0; j < chunk; j++) {
+      uint32_t frame = (i + j) * blockFrames;
+      uint32_t column =
+          (frame <= start) ? 0 : uint64_t(frame - start) * count / span;
+      column = (column < count) ? column : count - 1;
+      int magnitude = -buffer[j].min;
+      magnitude = (buffer[j].max > magnitude) ? buffer[j].max : magnitude;
+      // rounded like the waveform of the sample editor
+      uint32_t scaled = (magnitude * height + 63) / 128;
+      scaled = (scaled < height) ? scaled : height;
+      if (scaled > columns[column]) {
+        columns[column] = scaled;
+      }
+    }
+  }
+  return true;
+}
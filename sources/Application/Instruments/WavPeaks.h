@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _WAV_PEAKS_H_
+#define _WAV_PEAKS_H_
+
+#include "Application/Persistency/PersistenceConstants.h"
+#include "Externals/etl/include/etl/string.h"
+#include "System/FileSystem/FileSystem.h"
+#include <cstdint>
+
+// Min/max peaks of the first channel of a sample at several resolutions,
+// saved next to it so the waveform views never have to read the audio.
+//
+// header: "PTPK", u16 version, u16 frames per peak of level 0, u32 frames,
+//         u32 number of levels
+// levels: int8 min/max pairs. Level 0 has a peak per block of frames, each
+//         following level halves the one before, down to a single peak.
+
+#define WAV_PEAKS_EXTENSION ".pks"
+#define WAV_PEAKS_VERSION 1
+#define WAV_PEAKS_BLOCK_FRAMES 64
+#define WAV_PEAKS_BUFFER_SIZE 128
+
+struct WavPeak {
+  int8_t min;
+  int8_t max;
+};
+
+// Writes the peak file of a sample while its frames go by
+class WavPeaksBuilder {
+public:
+  WavPeaksBuilder();
+  // A peak file that was opened but not closed gets removed, so that an
+  // import bailing out half way doesn't leave it behind
+  ~WavPeaksBuilder();
+  bool Open(const char *wavPath);
+  // one frame of the first channel
+  inline void Add(int16_t value) {
+    int8_t v = int8_t(value >> 8);
+    current_.min = (v < current_.min) ? v : current_.min;
+    current_.max = (v > current_.max) ? v : current_.max;
+    if (++blockFrames_ == WAV_PEAKS_BLOCK_FRAMES) {
+      flushBlock();
+    }
+  };
+  void AddFrames(const int16_t *samples, uint32_t frames, uint16_t channels);
+  // Builds the coarser levels and writes the header. On any error the file
+  // is removed and false returned
+  bool Close();
+  void Discard();
+
+private:
+  void flushBlock();
+  bool writePeaks(const WavPeak *peaks, uint32_t count);
+
+  FileHandle file_;
+  etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> path_;
+  WavPeak current_;
+  uint32_t blockFrames_;
+  uint32_t frames_;
+  uint32_t peaks_; // level 0 peaks written so far
+  WavPeak buffer_[WAV_PEAKS_BUFFER_SIZE];
+  uint32_t buffered_;
+  bool error_;
+};
+
+class WavPeaks {
+public:
+  static void GetPath(const char *wavPath,
+                      etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> &path);
+  // Builds the peak file of a sample from the sample itself, reading it
+  // through the scratch buffer
+  static bool Build(const char *wavPath, void *scratchBuffer,
+                    uint32_t scratchBufferSize);
+  static void Remove(const char *wavPath);
+
+  // Fills columns with the peak magnitudes of frames [start, end) scaled to
+  // height, from the coarsest level with at least one peak per column. False
+  // if there is no peak file for a sample of that many frames or no level is
+  // fine enough, the audio has to be read then
+  static bool Read(const char *wavPath, uint32_t frames, uint32_t start,
+                   uint32_t end, uint8_t *columns, uint32_t count,
+                   uint8_t height);
+};
+
+#endif
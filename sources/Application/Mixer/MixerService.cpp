@@ -14,16 +14,21 @@
 #include "Application/Model/Project.h"
 #include "Application/Player/Player.h"
 #include "Application/Player/PlayerMixer.h"
+#include "Application/Player/SyncMaster.h"
 #include "Application/Utils/char.h"
 #include "Services/Audio/Audio.h"
 #include "Services/Audio/AudioDriver.h"
 #include "Services/Audio/AudioOut.h"
 #include "Services/Midi/MidiService.h"
 #include "System/Console/Trace.h"
+#include "System/Profiler/AudioStageProfiler.h"
 #include "System/System/System.h"
 #include "platform.h"
 #include <nanoprintf.h>
 
+static_assert(AUDIO_STAGE_BUS0 + MAX_BUS_COUNT == AUDIO_STAGE_MASTER,
+              "one profiling stage per mix bus");
+
 MixerService::MixerService() : master_(), sync_(platform_mutex()) {
   out_ = 0;
   project_ = NULL;
@@ -44,6 +49,7 @@ bool MixerService::Init() {
   for (int i = 0; i < MAX_BUS_COUNT; i++) {
     hex2char(i, buffer);
     bus_[i].SetName(etl::string<12>(buffer));
+    bus_[i].SetProfilingStage(AudioStage(AUDIO_STAGE_BUS0 + i));
     master_.AddModule(bus_[i]);
     master_.SetName("Master");
   }
@@ -106,12 +112,16 @@ void MixerService::Update(Observable &o, I_ObservableData *d) {
 
   AudioDriver::Event *event = (AudioDriver::Event *)d;
   if (event->type_ == AudioDriver::Event::ADET_BUFFERNEEDED) {
+    AUDIO_STAGE_BEGIN_BUFFER(uint32_t(
+        SyncMaster::GetInstance()->GetPlaySampleCount() * 1000000.0f /
+        Audio::GetInstance()->GetSampleRate()));
     Lock();
     SetChanged();
     NotifyObservers();
 
     out_->Trigger();
     Unlock();
+    AUDIO_STAGE_END_BUFFER();
   }
 }
 
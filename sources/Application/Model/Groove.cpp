@@ -57,6 +57,14 @@ void Groove::RestoreContent(PersistencyDocument *doc) {
   }
 }
 
+void Groove::SaveBinaryContent(BinaryPrinter *printer) {
+  printer->Write(data_, sizeof(data_));
+};
+
+void Groove::RestoreBinaryContent(BinaryDocument *doc) {
+  doc->Read(data_, sizeof(data_));
+}
+
 // Trigger grooves so we go to the next step
 void Groove::Trigger() {
   for (int i = 0; i < SONG_CHANNEL_COUNT; i++) {
@@ -38,6 +38,8 @@ public:
   unsigned char *GetGrooveData(int groove);
   virtual void SaveContent(tinyxml2::XMLPrinter *printer);
   virtual void RestoreContent(PersistencyDocument *doc);
+  virtual void SaveBinaryContent(BinaryPrinter *printer);
+  virtual void RestoreBinaryContent(BinaryDocument *doc);
 
 private:
   ChannelGroove channelGroove_[SONG_CHANNEL_COUNT];
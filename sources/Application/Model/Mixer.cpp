@@ -23,3 +23,9 @@ void Mixer::Clear() {
 void Mixer::SaveContent(tinyxml2::XMLPrinter *printer){};
 
 void Mixer::RestoreContent(PersistencyDocument *doc) {}
+
+// Nothing persisted yet, as in the XML format
+
+void Mixer::SaveBinaryContent(BinaryPrinter *printer){};
+
+void Mixer::RestoreBinaryContent(BinaryDocument *doc) {}
@@ -26,6 +26,8 @@ public:
 
   virtual void SaveContent(tinyxml2::XMLPrinter *printer);
   virtual void RestoreContent(PersistencyDocument *doc);
+  virtual void SaveBinaryContent(BinaryPrinter *printer);
+  virtual void RestoreBinaryContent(BinaryDocument *doc);
 
 private:
   char channelBus_[SONG_CHANNEL_COUNT];
@@ -408,6 +408,40 @@ void Project::SaveContent(tinyxml2::XMLPrinter *printer) {
   }
 };
 
+void Project::SaveBinaryContent(BinaryPrinter *printer) {
+  printer->WriteString(PROJECT_NUMBER);
+  printer->WriteU8(SyncMaster::GetInstance()->GetTableRatio());
+
+  // parameters as name/value pairs up to the end of the section, except the
+  // project name as above
+  for (auto it = variables_.begin(); it != variables_.end(); it++) {
+    Variable *currentVar = *it;
+    if (currentVar->GetID() == FourCC::VarProjectName) {
+      continue;
+    }
+    printer->WriteString(currentVar->GetName());
+    printer->WriteString(currentVar->GetString().c_str());
+  }
+};
+
+void Project::RestoreBinaryContent(BinaryDocument *doc) {
+  char version[MAX_VARIABLE_STRING_LENGTH + 1];
+  uint8_t tableRatio = 1;
+  doc->ReadString(version, sizeof(version));
+  doc->ReadU8(tableRatio);
+  SyncMaster::GetInstance()->SetTableRatio(tableRatio ? tableRatio : 1);
+
+  char name[MAX_VARIABLE_STRING_LENGTH + 1];
+  char value[MAX_VARIABLE_STRING_LENGTH + 1];
+  while (doc->Remaining() > 0 && doc->ReadString(name, sizeof(name)) &&
+         doc->ReadString(value, sizeof(value))) {
+    Variable *v = FindVariable(name);
+    if (v && v->GetID() != FourCC::VarProjectName) {
+      v->SetString(value);
+    }
+  }
+}
+
 void Project::OnTempoTap() {
 
   unsigned long now = System::GetInstance()->GetClock();
@@ -64,6 +64,8 @@ public:
   // Persistent
   virtual void SaveContent(tinyxml2::XMLPrinter *printer);
   virtual void RestoreContent(PersistencyDocument *doc);
+  virtual void SaveBinaryContent(BinaryPrinter *printer);
+  virtual void RestoreBinaryContent(BinaryDocument *doc);
 
 private:
   etl::list<Variable *, 16> variables_;
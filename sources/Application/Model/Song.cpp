@@ -14,6 +14,7 @@
 #include "System/System/System.h"
 #include "System/io/Status.h"
 #include "Table.h"
+#include <algorithm>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -79,13 +80,47 @@ void Song::RestoreContent(PersistencyDocument *doc) {
     };
     elem = doc->NextSibling();
   }
+  restoreAllocation();
+};
+
+void Song::SaveBinaryContent(BinaryPrinter *printer) {
+  printer->Write(data_, sizeof(data_));
+  printer->Write(chain_.data_, sizeof(chain_.data_));
+  printer->Write(chain_.transpose_, sizeof(chain_.transpose_));
+  printer->Write(phrase_.note_, sizeof(phrase_.note_));
+  printer->Write(phrase_.instr_, sizeof(phrase_.instr_));
+  printer->Write(phrase_.cmd1_, sizeof(phrase_.cmd1_));
+  printer->Write(phrase_.param1_, sizeof(phrase_.param1_));
+  printer->Write(phrase_.cmd2_, sizeof(phrase_.cmd2_));
+  printer->Write(phrase_.param2_, sizeof(phrase_.param2_));
+};
 
+void Song::RestoreBinaryContent(BinaryDocument *doc) {
+  doc->Read(data_, sizeof(data_));
+  doc->Read(chain_.data_, sizeof(chain_.data_));
+  doc->Read(chain_.transpose_, sizeof(chain_.transpose_));
+  doc->Read(phrase_.note_, sizeof(phrase_.note_));
+  doc->Read(phrase_.instr_, sizeof(phrase_.instr_));
+  doc->Read(phrase_.cmd1_, sizeof(phrase_.cmd1_));
+  doc->Read(phrase_.param1_, sizeof(phrase_.param1_));
+  doc->Read(phrase_.cmd2_, sizeof(phrase_.cmd2_));
+  doc->Read(phrase_.param2_, sizeof(phrase_.param2_));
+  restoreAllocation();
+};
+
+void Song::restoreAllocation() {
   Status::Set("Restoring allocation");
 
   // Restore chain & phrase allocation table
 
-  unsigned char *data = data_;
-  for (int i = 0; i < SONG_ROW_COUNT * SONG_CHANNEL_COUNT; i++) {
+  allocateRows(0, SONG_ROW_COUNT);
+  allocateChains(0, CHAIN_COUNT);
+  allocatePhrases(0, PHRASE_COUNT);
+};
+
+void Song::allocateRows(int first, int count) {
+  unsigned char *data = data_ + first * SONG_CHANNEL_COUNT;
+  for (int i = 0; i < count * SONG_CHANNEL_COUNT; i++) {
     if (*data != 0xFF) {
       if (*data < 0x80) {
         chain_.SetUsed(*data);
@@ -93,10 +128,12 @@ void Song::RestoreContent(PersistencyDocument *doc) {
     }
     data++;
   }
+};
 
-  data = chain_.data_;
+void Song::allocateChains(int first, int count) {
+  unsigned char *data = chain_.data_ + first * PHRASES_PER_CHAIN;
 
-  for (int i = 0; i < CHAIN_COUNT; i++) {
+  for (int i = first; i < first + count; i++) {
     for (int j = 0; j < PHRASES_PER_CHAIN; j++) {
       if (*data != 0xFF) {
         chain_.SetUsed(i);
@@ -105,18 +142,21 @@ void Song::RestoreContent(PersistencyDocument *doc) {
       data++;
     };
   }
+};
 
-  data = phrase_.note_;
+void Song::allocatePhrases(int first, int count) {
+  int offset = first * STEPS_PER_PHRASE;
+  unsigned char *data = phrase_.note_ + offset;
 
-  FourCC *table1 = phrase_.cmd1_;
-  FourCC *table2 = phrase_.cmd2_;
+  FourCC *table1 = phrase_.cmd1_ + offset;
+  FourCC *table2 = phrase_.cmd2_ + offset;
 
-  ushort *param1 = phrase_.param1_;
-  ushort *param2 = phrase_.param2_;
+  ushort *param1 = phrase_.param1_ + offset;
+  ushort *param2 = phrase_.param2_ + offset;
 
   TableHolder *th = TableHolder::GetInstance();
 
-  for (int i = 0; i < PHRASE_COUNT; i++) {
+  for (int i = first; i < first + count; i++) {
     for (int j = 0; j < STEPS_PER_PHRASE; j++) {
       if (*data != 0xFF) {
         phrase_.SetUsed(i);
@@ -137,3 +177,69 @@ void Song::RestoreContent(PersistencyDocument *doc) {
     };
   }
 };
+
+// Journal regions are blocks of song rows, blocks of chains and then single
+// phrases, each of them a few hundred bytes at most
+
+static const int journalRowBlocks = SONG_ROW_COUNT / SONG_JOURNAL_ROWS;
+static const int journalChainBlocks =
+    (CHAIN_COUNT + SONG_JOURNAL_CHAINS - 1) / SONG_JOURNAL_CHAINS;
+
+uint16_t Song::JournalRegionCount() {
+  return journalRowBlocks + journalChainBlocks + PHRASE_COUNT;
+};
+
+void Song::SaveJournalRegion(BinaryPrinter *printer, uint16_t region) {
+  JournalBlock blocks[6];
+  int count = journalBlocks(region, blocks);
+  for (int i = 0; i < count; i++) {
+    printer->Write(blocks[i].data, blocks[i].size);
+  }
+};
+
+void Song::RestoreJournalRegion(BinaryDocument *doc, uint16_t region) {
+  JournalBlock blocks[6];
+  int count = journalBlocks(region, blocks);
+  for (int i = 0; i < count; i++) {
+    doc->Read(blocks[i].data, blocks[i].size);
+  }
+  if (region < journalRowBlocks) {
+    allocateRows(region * SONG_JOURNAL_ROWS, SONG_JOURNAL_ROWS);
+    return;
+  }
+  region -= journalRowBlocks;
+  if (region < journalChainBlocks) {
+    int first = region * SONG_JOURNAL_CHAINS;
+    allocateChains(first, std::min(SONG_JOURNAL_CHAINS, CHAIN_COUNT - first));
+    return;
+  }
+  allocatePhrases(region - journalChainBlocks, 1);
+};
+
+// Fills in the model arrays a region covers, returns how many
+
+int Song::journalBlocks(uint16_t region, JournalBlock *blocks) {
+  if (region < journalRowBlocks) {
+    uint32_t size = SONG_JOURNAL_ROWS * SONG_CHANNEL_COUNT;
+    blocks[0] = {data_ + region * size, size};
+    return 1;
+  }
+  region -= journalRowBlocks;
+  if (region < journalChainBlocks) {
+    int first = region * SONG_JOURNAL_CHAINS;
+    int offset = first * PHRASES_PER_CHAIN;
+    uint32_t size =
+        std::min(SONG_JOURNAL_CHAINS, CHAIN_COUNT - first) * PHRASES_PER_CHAIN;
+    blocks[0] = {chain_.data_ + offset, size};
+    blocks[1] = {chain_.transpose_ + offset, size};
+    return 2;
+  }
+  int offset = (region - journalChainBlocks) * STEPS_PER_PHRASE;
+  blocks[0] = {phrase_.note_ + offset, STEPS_PER_PHRASE};
+  blocks[1] = {phrase_.instr_ + offset, STEPS_PER_PHRASE};
+  blocks[2] = {phrase_.cmd1_ + offset, sizeof(FourCC) * STEPS_PER_PHRASE};
+  blocks[3] = {phrase_.param1_ + offset, sizeof(ushort) * STEPS_PER_PHRASE};
+  blocks[4] = {phrase_.cmd2_ + offset, sizeof(FourCC) * STEPS_PER_PHRASE};
+  blocks[5] = {phrase_.param2_ + offset, sizeof(ushort) * STEPS_PER_PHRASE};
+  return 6;
+};
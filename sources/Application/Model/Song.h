@@ -43,6 +43,10 @@
 
 #define EMPTY_SONG_VALUE 0xFF
 
+// Song rows and chains per autosave journal region
+#define SONG_JOURNAL_ROWS 16
+#define SONG_JOURNAL_CHAINS 4
+
 class Song : Persistent {
 public:
   Song();
@@ -50,10 +54,27 @@ public:
 
   virtual void SaveContent(tinyxml2::XMLPrinter *printer);
   virtual void RestoreContent(PersistencyDocument *doc);
+  virtual void SaveBinaryContent(BinaryPrinter *printer);
+  virtual void RestoreBinaryContent(BinaryDocument *doc);
+  virtual uint16_t JournalRegionCount();
+  virtual void SaveJournalRegion(BinaryPrinter *printer, uint16_t region);
+  virtual void RestoreJournalRegion(BinaryDocument *doc, uint16_t region);
 
   unsigned char data_[SONG_CHANNEL_COUNT * SONG_ROW_COUNT];
   Chain chain_;
   Phrase phrase_;
+
+private:
+  struct JournalBlock {
+    void *data;
+    uint32_t size;
+  };
+
+  void restoreAllocation();
+  void allocateRows(int first, int count);
+  void allocateChains(int first, int count);
+  void allocatePhrases(int first, int count);
+  int journalBlocks(uint16_t region, JournalBlock *blocks);
 };
 
 #endif
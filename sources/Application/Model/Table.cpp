@@ -153,6 +153,41 @@ void TableHolder::RestoreContent(PersistencyDocument *doc) {
   }
 }
 
+void TableHolder::SaveBinaryContent(BinaryPrinter *printer) {
+  for (int i = 0; i < TABLE_COUNT; i++) {
+    SaveJournalRegion(printer, i);
+  }
+};
+
+void TableHolder::RestoreBinaryContent(BinaryDocument *doc) {
+  for (int i = 0; i < TABLE_COUNT; i++) {
+    RestoreJournalRegion(doc, i);
+  }
+};
+
+// One journal region per table
+
+void TableHolder::SaveJournalRegion(BinaryPrinter *printer, uint16_t region) {
+  Table &table = table_[region];
+  printer->Write(table.cmd1_, sizeof(table.cmd1_));
+  printer->Write(table.param1_, sizeof(table.param1_));
+  printer->Write(table.cmd2_, sizeof(table.cmd2_));
+  printer->Write(table.param2_, sizeof(table.param2_));
+  printer->Write(table.cmd3_, sizeof(table.cmd3_));
+  printer->Write(table.param3_, sizeof(table.param3_));
+};
+
+void TableHolder::RestoreJournalRegion(BinaryDocument *doc, uint16_t region) {
+  Table &table = table_[region];
+  doc->Read(table.cmd1_, sizeof(table.cmd1_));
+  doc->Read(table.param1_, sizeof(table.param1_));
+  doc->Read(table.cmd2_, sizeof(table.cmd2_));
+  doc->Read(table.param2_, sizeof(table.param2_));
+  doc->Read(table.cmd3_, sizeof(table.cmd3_));
+  doc->Read(table.param3_, sizeof(table.param3_));
+  allocation_[region] = !table.IsEmpty();
+};
+
 void TableHolder::SetUsed(int i) {
   if (i >= TABLE_COUNT) {
     NAssert(i < 128);
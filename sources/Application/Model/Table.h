@@ -50,6 +50,11 @@ public:
   int Clone(int table);
   virtual void SaveContent(tinyxml2::XMLPrinter *printer);
   virtual void RestoreContent(PersistencyDocument *doc);
+  virtual void SaveBinaryContent(BinaryPrinter *printer);
+  virtual void RestoreBinaryContent(BinaryDocument *doc);
+  virtual uint16_t JournalRegionCount() { return TABLE_COUNT; };
+  virtual void SaveJournalRegion(BinaryPrinter *printer, uint16_t region);
+  virtual void RestoreJournalRegion(BinaryDocument *doc, uint16_t region);
 
 private:
   Table table_[TABLE_COUNT];
@@ -0,0 +1,321 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#include "BinaryDocument.h"
+#include "System/Console/Trace.h"
+#include <string.h>
+
+#define BINARY_DOCUMENT_HEADER_SIZE 16
+
+BinaryPrinter::BinaryPrinter(I_File *file)
+    : file_(file), sectionStart_(-1), sectionLength_(0), error_(false) {}
+
+void BinaryPrinter::WriteHeader(const XmlSignature &xml, const char *magic) {
+  uint16_t version = BINARY_DOCUMENT_VERSION;
+  uint16_t layout = BINARY_DOCUMENT_LAYOUT;
+  uint32_t xmlSize = uint32_t(xml.size);
+  writeRaw(magic, 4);
+  writeRaw(&version, 2);
+  writeRaw(&layout, 2);
+  writeRaw(&xmlSize, 4);
+  writeRaw(&xml.crc, 4);
+}
+
+void BinaryPrinter::OpenSection(const char *tag) {
+  char padded[BINARY_DOCUMENT_TAG_LENGTH] = {};
+  strncpy(padded, tag, sizeof(padded));
+  writeRaw(padded, sizeof(padded));
+
+  // the length is filled in once the section is closed, a printer without
+  // a file only sums what it is given
+  sectionStart_ = file_ ? file_->Tell() : -1;
+  sectionLength_ = 0;
+  writeRaw(&sectionLength_, 4);
+  crc_.reset();
+}
+
+void BinaryPrinter::CloseSection() {
+  uint32_t crc = crc_.value();
+  writeRaw(&crc, 4);
+  if (file_) {
+    file_->Seek(sectionStart_, SEEK_SET);
+    writeRaw(&sectionLength_, 4);
+    file_->Seek(0, SEEK_END);
+  }
+  sectionStart_ = -1;
+}
+
+void BinaryPrinter::Write(const void *data, uint32_t len) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc_.add(bytes, bytes + len);
+  sectionLength_ += len;
+  writeRaw(data, len);
+}
+
+void BinaryPrinter::WriteString(const char *string) {
+  size_t len = strlen(string);
+  if (len > 0xFF) {
+    Trace::Error("BinaryPrinter: string too long, truncating '%s'", string);
+    len = 0xFF;
+  }
+  WriteU8(uint8_t(len));
+  Write(string, len);
+}
+
+void BinaryPrinter::writeRaw(const void *data, uint32_t len) {
+  if (file_ && len > 0 && file_->Write(data, 1, len) != int(len)) {
+    error_ = true;
+  }
+}
+
+BinaryDocument::BinaryDocument()
+    : readPos_(0), readLen_(0), firstSection_(0), position_(0), end_(0),
+      remaining_(0), error_(false), truncated_(false) {
+  tag_[0] = '\0';
+}
+
+BinaryDocument::~BinaryDocument() { Close(); }
+
+void BinaryDocument::Close() {
+  fp_.reset();
+  readPos_ = 0;
+  readLen_ = 0;
+  remaining_ = 0;
+}
+
+XmlSignature BinaryDocument::SignXml(const char *filename) {
+  XmlSignature xml;
+  auto fp = FileSystem::GetInstance()->Open(filename, "r");
+  if (!fp) {
+    return xml;
+  }
+  etl::crc32 crc;
+  long size = 0;
+  int len;
+  while ((len = fp->Read(readBuffer_, sizeof(readBuffer_))) > 0) {
+    const uint8_t *bytes = (const uint8_t *)readBuffer_;
+    crc.add(bytes, bytes + len);
+    size += len;
+  }
+  xml.size = size;
+  xml.crc = crc.value();
+  return xml;
+}
+
+bool BinaryDocument::Load(const char *filename, const XmlSignature &xml,
+                          bool journal) {
+  fp_ = FileSystem::GetInstance()->Open(filename, "r");
+  if (!fp_) {
+    return false;
+  }
+  readPos_ = 0;
+  readLen_ = 0;
+  position_ = 0;
+  remaining_ = 0;
+  error_ = false;
+  truncated_ = false;
+  const char *magicExpected =
+      journal ? BINARY_JOURNAL_MAGIC : BINARY_DOCUMENT_MAGIC;
+
+  char magic[4];
+  uint16_t version, layout;
+  uint32_t savedXmlSize, savedXmlCrc;
+  if (!readRaw(magic, 4) || !readRaw(&version, 2) || !readRaw(&layout, 2) ||
+      memcmp(magic, magicExpected, 4)) {
+    Trace::Error("Not a binary project file: %s", filename);
+    Close();
+    return false;
+  }
+  if (version != BINARY_DOCUMENT_VERSION ||
+      layout != BINARY_DOCUMENT_LAYOUT) {
+    Trace::Log("BINARYDOCUMENT", "Unsupported binary project %d/%d: %s",
+               version, layout, filename);
+    Close();
+    return false;
+  }
+  if (!readRaw(&savedXmlSize, 4) || !readRaw(&savedXmlCrc, 4)) {
+    Trace::Error("Not a binary project file: %s", filename);
+    Close();
+    return false;
+  }
+  if (xml.size >= 0 &&
+      (uint32_t(xml.size) != savedXmlSize || xml.crc != savedXmlCrc)) {
+    Trace::Log("BINARYDOCUMENT", "XML project file changed, ignoring %s",
+               filename);
+    Close();
+    return false;
+  }
+
+  firstSection_ = BINARY_DOCUMENT_HEADER_SIZE;
+  if (!verify(journal)) {
+    Trace::Error("Damaged binary project file: %s", filename);
+    Close();
+    return false;
+  }
+  if (truncated_) {
+    Trace::Log("BINARYDOCUMENT", "Journal %s ends with a damaged section",
+               filename);
+  }
+
+  // back to the first section for restoring
+  fp_->Seek(firstSection_, SEEK_SET);
+  readPos_ = 0;
+  readLen_ = 0;
+  position_ = firstSection_;
+  remaining_ = 0;
+  return true;
+}
+
+bool BinaryDocument::NextSection() {
+  // skip what's left of the current section and its checksum
+  if (!readRaw(nullptr, remaining_)) {
+    error_ = true;
+    return false;
+  }
+  remaining_ = 0;
+  if (tag_[0] != '\0') {
+    uint32_t crc;
+    if (!readRaw(&crc, 4)) {
+      error_ = true;
+      return false;
+    }
+  }
+  return readHeader();
+}
+
+bool BinaryDocument::Read(void *data, uint32_t len) {
+  if (len > remaining_) {
+    Trace::Error("BinaryDocument: read past the end of section %s", tag_);
+    error_ = true;
+    return false;
+  }
+  remaining_ -= len;
+  if (!readRaw(data, len)) {
+    error_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool BinaryDocument::ReadString(char *string, uint32_t size) {
+  uint8_t len;
+  if (!ReadU8(len)) {
+    return false;
+  }
+  uint32_t kept = (len < size) ? len : size - 1;
+  if (!Read(string, kept)) {
+    return false;
+  }
+  string[kept] = '\0';
+  // whatever doesn't fit is dropped
+  return Read(nullptr, len - kept);
+}
+
+// Reads the tag and length of the next section, false at the end of the
+// document
+
+bool BinaryDocument::readHeader() {
+  tag_[0] = '\0';
+  if (end_ > 0 && position_ >= end_) {
+    return false;
+  }
+  if (readPos_ == readLen_) {
+    int len = fp_->Read(readBuffer_, sizeof(readBuffer_));
+    readPos_ = 0;
+    readLen_ = len > 0 ? len : 0;
+    if (readLen_ == 0) {
+      return false;
+    }
+  }
+  if (!readRaw(tag_, BINARY_DOCUMENT_TAG_LENGTH) ||
+      !readRaw(&remaining_, 4)) {
+    tag_[0] = '\0';
+    remaining_ = 0;
+    error_ = true;
+    return false;
+  }
+  tag_[BINARY_DOCUMENT_TAG_LENGTH] = '\0';
+  return true;
+}
+
+// Checks all sections against their checksums and finds where they end
+
+bool BinaryDocument::verify(bool journal) {
+  end_ = 0;
+  uint32_t sectionStart = position_;
+  bool valid = true;
+  while (valid && readHeader()) {
+    etl::crc32 crc;
+    uint32_t left = remaining_;
+    while (left > 0) {
+      if (readPos_ == readLen_) {
+        int len = fp_->Read(readBuffer_, sizeof(readBuffer_));
+        readPos_ = 0;
+        readLen_ = len > 0 ? len : 0;
+        if (readLen_ == 0) {
+          valid = false;
+          break;
+        }
+      }
+      uint32_t chunk = readLen_ - readPos_;
+      chunk = (chunk < left) ? chunk : left;
+      const uint8_t *bytes = (const uint8_t *)readBuffer_ + readPos_;
+      crc.add(bytes, bytes + chunk);
+      readPos_ += chunk;
+      position_ += chunk;
+      left -= chunk;
+    }
+    uint32_t saved;
+    valid = valid && readRaw(&saved, 4) && saved == crc.value();
+    if (valid) {
+      sectionStart = position_;
+    }
+  }
+  valid = valid && !error_;
+  tag_[0] = '\0';
+  remaining_ = 0;
+  error_ = false;
+  if (!valid && journal) {
+    truncated_ = true;
+    valid = true;
+  }
+  end_ = sectionStart;
+  return valid;
+}
+
+// Reads from the file through the block buffer, large reads go straight to
+// their destination. A null destination skips len bytes
+
+bool BinaryDocument::readRaw(void *data, uint32_t len) {
+  uint8_t *dst = (uint8_t *)data;
+  while (len > 0) {
+    if (readPos_ == readLen_) {
+      if (dst && len >= sizeof(readBuffer_)) {
+        int read = fp_->Read(dst, len);
+        position_ += read > 0 ? read : 0;
+        return read == int(len);
+      }
+      int read = fp_->Read(readBuffer_, sizeof(readBuffer_));
+      readPos_ = 0;
+      readLen_ = read > 0 ? read : 0;
+      if (readLen_ == 0) {
+        return false;
+      }
+    }
+    uint32_t chunk = readLen_ - readPos_;
+    chunk = (chunk < len) ? chunk : len;
+    if (dst) {
+      memcpy(dst, readBuffer_ + readPos_, chunk);
+      dst += chunk;
+    }
+    readPos_ += chunk;
+    position_ += chunk;
+    len -= chunk;
+  }
+  return true;
+}
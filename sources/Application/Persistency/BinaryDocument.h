@@ -0,0 +1,140 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _BINARY_DOCUMENT_H_
+#define _BINARY_DOCUMENT_H_
+
+#include "Externals/etl/include/etl/crc32.h"
+#include "System/FileSystem/FileHandle.h"
+#include "System/FileSystem/FileSystem.h"
+#include <stdint.h>
+
+// Binary project format, saved next to the XML project file so projects load
+// without parsing. The XML file stays the interchange format.
+//
+// header:  "PTBP", u16 format version, u16 layout, u32 size and u32 crc32
+//          of the XML file saved along with it
+// section: char tag[16] (node name of the Persistent), u32 length, payload,
+//          u32 crc32 of the payload
+//
+// Fixed layout sections are raw copies of the model arrays and are read
+// straight back into them, in the byte order of the device like the hex
+// buffers of the XML format. Variable length sections store parameters as
+// name/value strings, as the XML format does.
+//
+// Autosave journals are appended sections after a "PTBJ" header, each of
+// them a u16 region of the Persistent followed by its content.
+
+#define BINARY_DOCUMENT_MAGIC "PTBP"
+#define BINARY_JOURNAL_MAGIC "PTBJ"
+#define BINARY_DOCUMENT_VERSION 2
+#define BINARY_DOCUMENT_TAG_LENGTH 16
+
+// Fixed layout sections depend on the model sizes of the platform, files of
+// other platforms are left to the XML file
+#ifdef ADV
+#define BINARY_DOCUMENT_LAYOUT 2
+#else
+#define BINARY_DOCUMENT_LAYOUT 1
+#endif
+
+// The XML file a binary document or journal goes with, a size below 0 when
+// there is none
+struct XmlSignature {
+  long size = -1;
+  uint32_t crc = 0;
+};
+
+// Writes a binary document section by section. Without a file it only sums
+// up what gets written
+class BinaryPrinter {
+public:
+  BinaryPrinter(I_File *file = nullptr);
+
+  void WriteHeader(const XmlSignature &xml,
+                   const char *magic = BINARY_DOCUMENT_MAGIC);
+
+  void OpenSection(const char *tag);
+  void CloseSection();
+
+  void Write(const void *data, uint32_t len);
+  void WriteU8(uint8_t value) { Write(&value, 1); }
+  void WriteU16(uint16_t value) { Write(&value, 2); }
+  // Strings are stored as a u8 length and their characters
+  void WriteString(const char *string);
+
+  bool HadError() const { return error_; }
+  // of what was written since the last section was opened
+  uint32_t Checksum() const { return crc_.value(); }
+  uint32_t Length() const { return sectionLength_; }
+
+private:
+  void writeRaw(const void *data, uint32_t len);
+
+  I_File *file_;
+  long sectionStart_; // offset of the length of the open section
+  uint32_t sectionLength_;
+  etl::crc32 crc_;
+  bool error_;
+};
+
+// Reads a binary document. Load() checks every section against its checksum
+// before anything is handed to the model, so a damaged file never gets half
+// restored
+class BinaryDocument {
+public:
+  BinaryDocument();
+  ~BinaryDocument();
+
+  // A document saved along with a different XML file (edited on a computer
+  // for instance) is refused. Journals end at their first damaged section,
+  // which is what an interrupted append leaves behind
+  bool Load(const char *filename, const XmlSignature &xml,
+            bool journal = false);
+  void Close();
+
+  // Size and crc32 of an XML file, reading it is much cheaper than parsing it
+  static XmlSignature SignXml(const char *filename);
+
+  // Moves to the next section, skipping what's left of the current one
+  bool NextSection();
+  const char *SectionName() const { return tag_; }
+  // bytes left in the current section
+  uint32_t Remaining() const { return remaining_; }
+
+  // Reads are bounded by the current section, reading past its end is an
+  // error
+  bool Read(void *data, uint32_t len);
+  bool ReadU8(uint8_t &value) { return Read(&value, 1); }
+  bool ReadU16(uint16_t &value) { return Read(&value, 2); }
+  bool ReadString(char *string, uint32_t size);
+
+  bool HadError() const { return error_; }
+  // The journal had a damaged section, anything appended to it would be lost
+  bool WasTruncated() const { return truncated_; }
+
+private:
+  bool readRaw(void *data, uint32_t len);
+  bool readHeader();
+  bool verify(bool journal);
+
+  // small reads go through this, larger ones straight to the model
+  inline static char readBuffer_[512];
+  int readPos_;
+  int readLen_;
+  FileHandle fp_;
+  long firstSection_;
+  uint32_t position_; // file offset of the next byte read
+  uint32_t end_;      // where the valid sections end
+  char tag_[BINARY_DOCUMENT_TAG_LENGTH + 1];
+  uint32_t remaining_;
+  bool error_;
+  bool truncated_;
+};
+
+#endif
@@ -15,6 +15,8 @@ PersistencyDocument::PersistencyDocument() {
   version_ = 0;
   yxml_init(state_, stack_, sizeof(stack_));
   r_ = YXML_OK; // initialize to ok value
+  readPos_ = 0;
+  readLen_ = 0;
 }
 
 PersistencyDocument::~PersistencyDocument() {
@@ -22,7 +24,21 @@ PersistencyDocument::~PersistencyDocument() {
   Close();
 }
 
-void PersistencyDocument::Close() { fp_.reset(); }
+void PersistencyDocument::Close() {
+  fp_.reset();
+  readPos_ = 0;
+  readLen_ = 0;
+}
+
+bool PersistencyDocument::fill() {
+  if (!fp_) {
+    return false;
+  }
+  int len = fp_->Read(readBuffer_, sizeof(readBuffer_));
+  readPos_ = 0;
+  readLen_ = len > 0 ? len : 0;
+  return readLen_ > 0;
+}
 
 bool PersistencyDocument::Load(const char *filename) {
   Trace::Log("PERSISTENCYDOCUMENT", "Loading document from file: %s", filename);
@@ -37,17 +53,13 @@ bool PersistencyDocument::Load(const char *filename) {
   yxml_init(state_, stack_, sizeof(stack_));
   r_ = YXML_OK;
 
-  // Verify we can read from the file
-  int c = fp_->GetC();
-  if (c == EOF) {
+  // Verify we can read from the file, the first block is kept for parsing
+  if (!fill()) {
     Trace::Error("File is empty or cannot be read: %s", filename);
-    fp_.reset();
+    Close();
     return false;
   }
 
-  // Reset file position
-  fp_->Seek(0, SEEK_SET);
-
   Trace::Log("PERSISTENCYDOCUMENT", "Successfully opened file: %s", filename);
   return true;
 }
@@ -62,7 +74,7 @@ bool PersistencyDocument::FirstChild() {
   }
 
   int c;
-  while ((c = fp_->GetC()) != EOF) {
+  while ((c = getC()) != EOF) {
     r_ = yxml_parse(state_, c);
     switch (r_) {
     case YXML_ELEMSTART:
@@ -154,7 +166,7 @@ bool PersistencyDocument::NextSibling() {
   }
 
   int c;
-  while ((c = fp_->GetC()) != EOF) {
+  while ((c = getC()) != EOF) {
     r_ = yxml_parse(state_, c);
     switch (r_) {
     case YXML_ELEMSTART:
@@ -212,7 +224,7 @@ bool PersistencyDocument::NextAttribute() {
 
   int cur = 0;
   int c;
-  while ((c = fp_->GetC()) != EOF) {
+  while ((c = getC()) != EOF) {
     r_ = yxml_parse(state_, c);
     switch (r_) {
     case YXML_ELEMSTART:
@@ -286,7 +298,7 @@ bool PersistencyDocument::HasContent() {
     }
   }
 
-  while ((c = fp_->GetC()) != EOF) {
+  while ((c = getC()) != EOF) {
     r_ = yxml_parse(state_, c);
     switch (r_) {
     case YXML_ELEMSTART:
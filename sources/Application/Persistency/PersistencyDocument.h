@@ -13,6 +13,13 @@
 #include "Externals/yxml/yxml.h"
 #include "System/FileSystem/FileHandle.h"
 #include "System/FileSystem/FileSystem.h"
+#include <stdio.h>
+
+// Size of the blocks documents are read in. A multiple of the SD card sector
+// size so reads map to whole sectors
+#ifndef PERSISTENCY_READ_BUFFER_SIZE
+#define PERSISTENCY_READ_BUFFER_SIZE 2048
+#endif
 
 class PersistencyDocument {
 public:
@@ -38,7 +45,21 @@ public:
   int version_;
 
 private:
+  // Next character of the document, EOF at its end. The file is read a block
+  // at a time rather than a character at a time, which takes the file system
+  // lock and goes to the card for each call on the pico
+  int getC() {
+    if (readPos_ == readLen_ && !fill()) {
+      return EOF;
+    }
+    return (unsigned char)readBuffer_[readPos_++];
+  }
+  bool fill();
+
   inline static char stack_[1024];
+  inline static char readBuffer_[PERSISTENCY_READ_BUFFER_SIZE];
+  int readPos_;
+  int readLen_;
   inline static yxml_t state_[1];
   FileHandle fp_;
 };
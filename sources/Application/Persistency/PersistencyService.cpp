@@ -9,16 +9,29 @@
 
 #include "PersistencyService.h"
 #include "../Instruments/SamplePool.h"
+#include "../Instruments/WavPeaks.h"
 #include "Foundation/Services/ServiceRegistry.h"
 
+#include "BinaryDocument.h"
 #include "Foundation/Types/Types.h"
 #include "Persistent.h"
 #include "System/Console/Trace.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/I_File.h"
+#include "System/System/System.h"
 
 #define PROJECT_STATE_FILE "/.current"
 
+// Size of a file or -1 if it doesn't exist
+static long fileSize(const char *path) {
+  auto fp = FileSystem::GetInstance()->Open(path, "r");
+  if (!fp) {
+    return -1;
+  }
+  fp->Seek(0, SEEK_END);
+  return fp->Tell();
+}
+
 PersistencyService::PersistencyService()
     : Service(FourCC::ServicePersistency){};
 
@@ -37,18 +50,24 @@ void PersistencyService::PurgeUnnamedProject() {
   Trace::Debug("PERSISTENCYSERVICE", "purging unnamed project dir");
   fs->chdir(UNNAMED_PROJECT_NAME);
   fs->DeleteFile(PROJECT_DATA_FILE);
+  fs->DeleteFile(PROJECT_BINARY_FILE);
   fs->DeleteFile(AUTO_SAVE_FILENAME);
+  fs->DeleteFile(AUTO_SAVE_BINARY_FILENAME);
+  fs->DeleteFile(AUTO_SAVE_JOURNAL_FILENAME);
 
   fs->chdir("samples");
   etl::vector<int, MAX_SAMPLES> fileIndexes;
-  fs->list(&fileIndexes, ".wav", false);
 
-  // delete all samples
+  // delete all samples and their waveform peaks
   char filename[128];
-  for (size_t i = 0; i < fileIndexes.size(); i++) {
-    fs->getFileName(fileIndexes[i], filename, MAX_PROJECT_SAMPLE_PATH_LENGTH);
-    fs->DeleteFile(filename);
-  };
+  for (const char *extension : {".wav", WAV_PEAKS_EXTENSION}) {
+    fs->list(&fileIndexes, extension, false);
+    for (size_t i = 0; i < fileIndexes.size(); i++) {
+      fs->getFileName(fileIndexes[i], filename,
+                      MAX_PROJECT_SAMPLE_PATH_LENGTH);
+      fs->DeleteFile(filename);
+    };
+  }
 };
 
 PersistencyResult
@@ -107,8 +126,20 @@ PersistencyResult PersistencyService::Save(const char *projectName,
   return SaveProjectData(projectName, false);
 };
 
+// Journals what changed since the last autosave, or saves the whole project
+// when there is no journal to append to or it grew too large
+
 PersistencyResult
-PersistencyService::AutoSaveProjectData(const char *projectName) {
+PersistencyService::AutoSaveProjectData(const char *projectName,
+                                        bool playing) {
+  bool journal = journalProject_ == projectName && !journalBroken_;
+  if (journal && (playing || journalSize_ < AUTO_SAVE_JOURNAL_COMPACT_SIZE)) {
+    return appendJournal(projectName, playing);
+  }
+  if (playing) {
+    return PERSIST_DEFERRED;
+  }
+  Trace::Log("PERSISTENCYSERVICE", "Full autosave of %s", projectName);
   return SaveProjectData(projectName, true);
 };
 
@@ -116,29 +147,47 @@ PersistencyResult PersistencyService::SaveProjectData(const char *projectName,
                                                       bool autosave) {
 
   const char *filename = autosave ? AUTO_SAVE_FILENAME : PROJECT_DATA_FILE;
+  const char *binaryName =
+      autosave ? AUTO_SAVE_BINARY_FILENAME : PROJECT_BINARY_FILE;
 
-  etl::vector<const char *, 3> segments = {PROJECTS_DIR, projectName, filename};
+  // The journal stays in place until both saves below succeeded, a failed
+  // save must not lose the edits it holds
+  auto fs = FileSystem::GetInstance();
+  etl::vector<const char *, 3> segments = {PROJECTS_DIR, projectName,
+                                           filename};
   CreatePath(pathBufferA, segments);
 
-  auto fs = FileSystem::GetInstance();
-  auto fp = fs->Open(pathBufferA.c_str(), "w");
-  if (!fp) {
-    Trace::Error("PERSISTENCYSERVICE: Could not open file for writing: %s",
+  long xmlSize = 0;
+  PersistencyResult result = saveXml(pathBufferA.c_str(), xmlSize);
+  if (result != PERSIST_SAVED) {
+    return result;
+  }
+  // read back, so the binary and journal go with what actually got written
+  XmlSignature xml = BinaryDocument::SignXml(pathBufferA.c_str());
+  if (xml.size != xmlSize) {
+    Trace::Error("PERSISTENCYSERVICE: Could not read back %s",
                  pathBufferA.c_str());
     return PERSIST_ERROR;
   }
-  Trace::Log("PERSISTENCYSERVICE", "Opened Proj File: %s", pathBufferA.c_str());
-  tinyxml2::XMLPrinter printer(fp.get());
 
-  printer.OpenElement("PICOTRACKER");
-
-  // Loop on all registered persistable subservices
-  for (auto *sub : SubServices()) {
-    auto *currentItem = static_cast<Persistent *>(static_cast<void *>(sub));
-    currentItem->Save(&printer);
+  // The binary copy is what gets loaded, the XML file is kept for interchange
+  // and as a fallback
+  segments = {PROJECTS_DIR, projectName, binaryName};
+  CreatePath(pathBufferB, segments);
+  if (saveBinary(pathBufferB.c_str(), xml) != PERSIST_SAVED) {
+    Trace::Error("PERSISTENCYSERVICE: Could not save binary project: %s",
+                 pathBufferB.c_str());
+    fs->DeleteFile(pathBufferB.c_str());
+    return PERSIST_ERROR;
   }
 
-  printer.CloseElement();
+  // the journal goes with the save it was replaying on
+  segments = {PROJECTS_DIR, projectName, AUTO_SAVE_JOURNAL_FILENAME};
+  CreatePath(pathBufferB, segments);
+  fs->DeleteFile(pathBufferB.c_str());
+  journalProject_.clear();
+  journalSize_ = 0;
+  journalBroken_ = false;
 
   // if we are doing an explicit save (ie nto a autosave), then we need to
   // delete the existing autosave file so that this explicit save will be loaded
@@ -154,9 +203,56 @@ PersistencyResult PersistencyService::SaveProjectData(const char *projectName,
                pathBufferA.c_str());
   }
 
+  // later autosaves journal their changes on top of this save
+  startJournal(projectName, xml);
   return PERSIST_SAVED;
 };
 
+PersistencyResult PersistencyService::ExportXml(const char *path) {
+  long size;
+  return saveXml(path, size);
+}
+
+PersistencyResult PersistencyService::saveXml(const char *path, long &size) {
+  auto fs = FileSystem::GetInstance();
+  auto fp = fs->Open(path, "w");
+  if (!fp) {
+    Trace::Error("PERSISTENCYSERVICE: Could not open file for writing: %s",
+                 path);
+    return PERSIST_ERROR;
+  }
+  Trace::Log("PERSISTENCYSERVICE", "Opened Proj File: %s", path);
+  tinyxml2::XMLPrinter printer(fp.get());
+
+  printer.OpenElement("PICOTRACKER");
+
+  // Loop on all registered persistable subservices
+  for (auto *sub : SubServices()) {
+    auto *currentItem = static_cast<Persistent *>(static_cast<void *>(sub));
+    currentItem->Save(&printer);
+  }
+
+  printer.CloseElement();
+  size = fp->Tell();
+  return PERSIST_SAVED;
+}
+
+PersistencyResult PersistencyService::saveBinary(const char *path,
+                                                 const XmlSignature &xml) {
+  auto fs = FileSystem::GetInstance();
+  auto fp = fs->Open(path, "w");
+  if (!fp) {
+    return PERSIST_ERROR;
+  }
+  BinaryPrinter printer(fp.get());
+  printer.WriteHeader(xml);
+  for (auto *sub : SubServices()) {
+    auto *currentItem = static_cast<Persistent *>(static_cast<void *>(sub));
+    currentItem->SaveBinary(&printer);
+  }
+  return printer.HadError() ? PERSIST_ERROR : PERSIST_SAVED;
+}
+
 // return true if existing proj with the given name already exists
 bool PersistencyService::Exists(const char *projectName) {
   etl::string<128> projectFilePath(PROJECTS_DIR);
@@ -168,6 +264,8 @@ bool PersistencyService::Exists(const char *projectName) {
 }
 
 PersistencyResult PersistencyService::Load(const char *projectName) {
+  journalProject_.clear();
+
   // first check if autosave exists
   etl::string<128> autoSavePath(PROJECTS_DIR);
   autoSavePath.append("/");
@@ -182,14 +280,43 @@ PersistencyResult PersistencyService::Load(const char *projectName) {
   // if autosave exists, then we load it instead of the normal project file
   const char *filename = useAutosave ? AUTO_SAVE_FILENAME : PROJECT_DATA_FILE;
 
+  const char *binaryName =
+      useAutosave ? AUTO_SAVE_BINARY_FILENAME : PROJECT_BINARY_FILE;
+
   etl::string<128> projectFilePath(PROJECTS_DIR);
   projectFilePath.append("/");
   projectFilePath.append(projectName);
   projectFilePath.append("/");
+  etl::string<128> binaryFilePath(projectFilePath);
   projectFilePath.append(filename);
+  binaryFilePath.append(binaryName);
 
+  uint32_t startTime = System::GetInstance()->Millis();
+  XmlSignature xml = BinaryDocument::SignXml(projectFilePath.c_str());
+  PersistencyResult result = PERSIST_ERROR;
+  if (fs->exists(binaryFilePath.c_str())) {
+    result = loadBinary(binaryFilePath.c_str(), xml);
+  }
+  loadedBinary_ = (result == PERSIST_LOADED);
+  // PERSIST_ERROR means nothing was restored yet so the XML file can be used
+  if (result == PERSIST_ERROR) {
+    result = loadXml(projectFilePath.c_str());
+  }
+  if (result != PERSIST_LOADED) {
+    Trace::Error("Errors detected while loading project '%s'", projectName);
+    return PERSIST_LOAD_FAILED;
+  }
+  replayJournal(projectName, xml);
+  startJournal(projectName, xml);
+  Trace::Log("PERSISTENCYSERVICE", "Loaded project '%s' (%s) in %d ms",
+             projectName, loadedBinary_ ? "binary" : "xml",
+             (int)(System::GetInstance()->Millis() - startTime));
+  return PERSIST_LOADED;
+};
+
+PersistencyResult PersistencyService::loadXml(const char *path) {
   PersistencyDocument doc;
-  if (!doc.Load(projectFilePath.c_str()))
+  if (!doc.Load(path))
     return PERSIST_LOAD_FAILED;
 
   bool elem = doc.FirstChild(); // advance to first child
@@ -209,11 +336,156 @@ PersistencyResult PersistencyService::Load(const char *projectName) {
     elem = doc.NextSibling();
   }
   if (doc.HadError()) {
-    Trace::Error("XML errors detected while loading project '%s'", projectName);
+    Trace::Error("XML errors detected while loading %s", path);
     return PERSIST_LOAD_FAILED;
   }
   return PERSIST_LOADED;
-};
+}
+
+// Returns PERSIST_ERROR if the binary file can't be used, before anything was
+// restored from it
+
+PersistencyResult PersistencyService::loadBinary(const char *path,
+                                                 const XmlSignature &xml) {
+  // refuses binary files that don't go with the XML file
+  BinaryDocument doc;
+  if (!doc.Load(path, xml)) {
+    return PERSIST_ERROR;
+  }
+  while (doc.NextSection()) {
+    for (auto *sub : SubServices()) {
+      auto *currentItem = static_cast<Persistent *>(static_cast<void *>(sub));
+      if (currentItem->RestoreBinary(&doc)) {
+        break;
+      }
+    }
+  }
+  if (doc.HadError()) {
+    Trace::Error("Errors detected while loading %s", path);
+    return PERSIST_LOAD_FAILED;
+  }
+  return PERSIST_LOADED;
+}
+
+// Checksums the current project, which is what later journal records are
+// compared to
+
+void PersistencyService::startJournal(const char *projectName,
+                                      const XmlSignature &base) {
+  journalProject_.clear();
+  journalBase_ = base;
+  int index = 0;
+  for (auto *sub : SubServices()) {
+    auto *currentItem = static_cast<Persistent *>(static_cast<void *>(sub));
+    for (uint16_t region = 0; region < currentItem->JournalRegionCount();
+         region++) {
+      if (index == AUTO_SAVE_JOURNAL_MAX_REGIONS) {
+        Trace::Error("PERSISTENCYSERVICE: too many journal regions");
+        return;
+      }
+      uint32_t length;
+      journalSums_[index++] = currentItem->JournalChecksum(region, length);
+    }
+  }
+  journalProject_ = projectName;
+}
+
+// Appends the regions that changed since they were last saved. Bounded
+// appends leave what doesn't fit in the budget for the next one
+
+PersistencyResult PersistencyService::appendJournal(const char *projectName,
+                                                    bool bounded) {
+  etl::vector<const char *, 3> segments = {PROJECTS_DIR, projectName,
+                                           AUTO_SAVE_JOURNAL_FILENAME};
+  CreatePath(pathBufferA, segments);
+
+  FileHandle fp;
+  BinaryPrinter printer;
+  uint32_t written = 0;
+  int index = 0;
+  int records = 0;
+  for (auto *sub : SubServices()) {
+    auto *currentItem = static_cast<Persistent *>(static_cast<void *>(sub));
+    for (uint16_t region = 0; region < currentItem->JournalRegionCount();
+         region++, index++) {
+      uint32_t length;
+      uint32_t sum = currentItem->JournalChecksum(region, length);
+      if (sum == journalSums_[index] ||
+          (bounded && written > 0 &&
+           written + length > AUTO_SAVE_JOURNAL_BUDGET)) {
+        continue;
+      }
+      // the journal is only touched once something changed
+      if (!fp) {
+        auto fs = FileSystem::GetInstance();
+        bool exists = fs->exists(pathBufferA.c_str());
+        fp = fs->Open(pathBufferA.c_str(), exists ? "r+" : "w");
+        if (!fp) {
+          journalBroken_ = true;
+          return PERSIST_ERROR;
+        }
+        printer = BinaryPrinter(fp.get());
+        if (exists) {
+          fp->Seek(0, SEEK_END);
+        } else {
+          printer.WriteHeader(journalBase_, BINARY_JOURNAL_MAGIC);
+        }
+      }
+      currentItem->SaveJournal(&printer, region);
+      journalSums_[index] = sum;
+      written += length;
+      records++;
+    }
+  }
+  if (!fp) {
+    return PERSIST_SAVED;
+  }
+  journalSize_ = fp->Tell();
+  if (printer.HadError()) {
+    Trace::Error("PERSISTENCYSERVICE: Could not write journal: %s",
+                 pathBufferA.c_str());
+    journalBroken_ = true;
+    return PERSIST_ERROR;
+  }
+  Trace::Log("PERSISTENCYSERVICE", "Journaled %d changes (%d bytes)", records,
+             (int)written);
+  return PERSIST_SAVED;
+}
+
+// Applies the journal on top of the project that was just loaded. Appending
+// to a journal that can't be replayed would lose the changes, so the next
+// autosave is a full one
+
+void PersistencyService::replayJournal(const char *projectName,
+                                       const XmlSignature &base) {
+  etl::vector<const char *, 3> segments = {PROJECTS_DIR, projectName,
+                                           AUTO_SAVE_JOURNAL_FILENAME};
+  CreatePath(pathBufferA, segments);
+  journalSize_ = fileSize(pathBufferA.c_str());
+  journalBroken_ = false;
+  if (journalSize_ < 0) {
+    journalSize_ = 0;
+    return;
+  }
+
+  BinaryDocument doc;
+  if (!doc.Load(pathBufferA.c_str(), base, true)) {
+    journalBroken_ = true;
+    return;
+  }
+  int records = 0;
+  while (doc.NextSection()) {
+    for (auto *sub : SubServices()) {
+      auto *currentItem = static_cast<Persistent *>(static_cast<void *>(sub));
+      if (currentItem->RestoreJournal(&doc)) {
+        break;
+      }
+    }
+    records++;
+  }
+  journalBroken_ = doc.WasTruncated() || doc.HadError();
+  Trace::Log("PERSISTENCYSERVICE", "Replayed %d journaled changes", records);
+}
 
 PersistencyResult
 PersistencyService::LoadCurrentProjectName(char *projectName) {
@@ -269,7 +541,18 @@ void PersistencyService::CreatePath(
 bool PersistencyService::ClearAutosave(const char *projectName) {
   auto fs = FileSystem::GetInstance();
   etl::vector<const char *, 3> segments = {PROJECTS_DIR, projectName,
-                                           AUTO_SAVE_FILENAME};
+                                           AUTO_SAVE_JOURNAL_FILENAME};
+  CreatePath(pathBufferA, segments);
+  fs->DeleteFile(pathBufferA.c_str());
+  if (journalProject_ == projectName) {
+    journalProject_.clear();
+  }
+
+  segments = {PROJECTS_DIR, projectName, AUTO_SAVE_BINARY_FILENAME};
+  CreatePath(pathBufferA, segments);
+  fs->DeleteFile(pathBufferA.c_str());
+
+  segments = {PROJECTS_DIR, projectName, AUTO_SAVE_FILENAME};
   CreatePath(pathBufferA, segments);
   // TODO: check if file exists before deleting and only return false if it does
   // exist and deleting fails but this can only be done once Open() return
@@ -11,6 +11,7 @@
 #define _PERSISTENCY_SERVICE_H_
 
 #include "Application/Instruments/I_Instrument.h"
+#include "BinaryDocument.h"
 #include "Externals/TinyXML2/tinyxml2.h"
 #include "Externals/etl/include/etl/string.h"
 #include "Externals/yxml/yxml.h"
@@ -25,15 +26,31 @@ enum PersistencyResult {
   PERSIST_LOADED,
   PERSIST_ERROR,
   PERSIST_EXISTS,
+  PERSIST_DEFERRED,
 };
 
 #define UNNAMED_PROJECT_NAME ".untitled"
 #ifdef ADV
 #define PROJECT_DATA_FILE "ptsav.dat"
+#define PROJECT_BINARY_FILE "ptsav.ptb"
 #else
 #define PROJECT_DATA_FILE "lgptsav.dat"
+#define PROJECT_BINARY_FILE "lgptsav.ptb"
 #endif
 #define AUTO_SAVE_FILENAME "autosave.dat"
+#define AUTO_SAVE_BINARY_FILENAME "autosave.ptb"
+#define AUTO_SAVE_JOURNAL_FILENAME "autosave.ptj"
+
+// Autosaves append the parts of the project that changed to a journal. Once
+// it gets larger than this it is folded into a full autosave, which waits for
+// the sequencer to stop. While it runs an autosave writes at most the budget
+#define AUTO_SAVE_JOURNAL_COMPACT_SIZE 32768
+#define AUTO_SAVE_JOURNAL_BUDGET 4096
+#ifdef ADV
+#define AUTO_SAVE_JOURNAL_MAX_REGIONS 576
+#else
+#define AUTO_SAVE_JOURNAL_MAX_REGIONS 320
+#endif
 
 class PersistencyService : public Service,
                            public T_Singleton<PersistencyService> {
@@ -47,9 +64,15 @@ public:
   PersistencyResult CreateProject();
   bool Exists(const char *projectName);
   void PurgeUnnamedProject();
-  PersistencyResult AutoSaveProjectData(const char *projectName);
+  PersistencyResult AutoSaveProjectData(const char *projectName,
+                                        bool playing = false);
   bool ClearAutosave(const char *projectName);
 
+  // Writes the current project as XML only, for interchange
+  PersistencyResult ExportXml(const char *path);
+  // Whether the last Load() could use the binary project file
+  bool LoadedBinary() { return loadedBinary_; };
+
   PersistencyResult
   ExportInstrument(I_Instrument *instrument,
                    etl::string<MAX_INSTRUMENT_NAME_LENGTH> name,
@@ -63,11 +86,28 @@ private:
   void CreatePath(etl::istring &path,
                   const etl::ivector<const char *> &segments);
   PersistencyResult SaveProjectData(const char *projectName, bool autosave);
+  PersistencyResult saveXml(const char *path, long &size);
+  PersistencyResult saveBinary(const char *path, const XmlSignature &xml);
+  PersistencyResult loadXml(const char *path);
+  PersistencyResult loadBinary(const char *path, const XmlSignature &xml);
+  void startJournal(const char *projectName, const XmlSignature &base);
+  PersistencyResult appendJournal(const char *projectName, bool bounded);
+  void replayJournal(const char *projectName, const XmlSignature &base);
 
   // need these as statically allocated buffers as too big for stack
   etl::vector<int, MAX_FILE_INDEX_SIZE> fileIndexes_;
   etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> pathBufferA;
   etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> pathBufferB;
+  bool loadedBinary_ = false;
+
+  // Project the journal is kept for, empty when the next autosave has to be
+  // a full one
+  etl::string<MAX_PROJECT_NAME_LENGTH> journalProject_;
+  XmlSignature journalBase_; // XML file the journal applies to
+  long journalSize_ = 0;
+  bool journalBroken_ = false; // can't be appended to
+  // checksum of every journal region as last saved
+  uint32_t journalSums_[AUTO_SAVE_JOURNAL_MAX_REGIONS];
 };
 
 #endif
@@ -27,3 +27,42 @@ bool Persistent::Restore(PersistencyDocument *doc) {
   }
   return false;
 };
+
+void Persistent::SaveBinary(BinaryPrinter *printer) {
+  printer->OpenSection(nodeName_);
+  SaveBinaryContent(printer);
+  printer->CloseSection();
+};
+
+bool Persistent::RestoreBinary(BinaryDocument *doc) {
+  if (!strcmp(doc->SectionName(), nodeName_)) {
+    RestoreBinaryContent(doc);
+    return true;
+  }
+  return false;
+};
+
+void Persistent::SaveJournal(BinaryPrinter *printer, uint16_t region) {
+  printer->OpenSection(nodeName_);
+  printer->WriteU16(region);
+  SaveJournalRegion(printer, region);
+  printer->CloseSection();
+};
+
+bool Persistent::RestoreJournal(BinaryDocument *doc) {
+  if (strcmp(doc->SectionName(), nodeName_)) {
+    return false;
+  }
+  uint16_t region;
+  if (doc->ReadU16(region) && region < JournalRegionCount()) {
+    RestoreJournalRegion(doc, region);
+  }
+  return true;
+};
+
+uint32_t Persistent::JournalChecksum(uint16_t region, uint32_t &length) {
+  BinaryPrinter sum;
+  SaveJournalRegion(&sum, region);
+  length = sum.Length();
+  return sum.Checksum();
+};
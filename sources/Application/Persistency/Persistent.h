@@ -10,6 +10,7 @@
 #ifndef _PERSISTENT_H_
 #define _PERSISTENT_H_
 
+#include "Application/Persistency/BinaryDocument.h"
 #include "Application/Persistency/PersistencyDocument.h"
 #include "Externals/TinyXML2/tinyxml2.h"
 #include "Foundation/Services/SubService.h"
@@ -20,9 +21,28 @@ public:
   void Save(tinyxml2::XMLPrinter *printer);
   bool Restore(PersistencyDocument *doc);
 
+  // Binary format, one section per Persistent
+  void SaveBinary(BinaryPrinter *printer);
+  bool RestoreBinary(BinaryDocument *doc);
+
+  // Autosave journal. The content is split in regions that are saved and
+  // restored on their own, a region changed when its checksum did
+  virtual uint16_t JournalRegionCount() { return 1; };
+  void SaveJournal(BinaryPrinter *printer, uint16_t region);
+  bool RestoreJournal(BinaryDocument *doc);
+  uint32_t JournalChecksum(uint16_t region, uint32_t &length);
+
 protected:
   virtual void SaveContent(tinyxml2::XMLPrinter *printer) = 0;
   virtual void RestoreContent(PersistencyDocument *doc) = 0;
+  virtual void SaveBinaryContent(BinaryPrinter *printer) = 0;
+  virtual void RestoreBinaryContent(BinaryDocument *doc) = 0;
+  virtual void SaveJournalRegion(BinaryPrinter *printer, uint16_t region) {
+    SaveBinaryContent(printer);
+  };
+  virtual void RestoreJournalRegion(BinaryDocument *doc, uint16_t region) {
+    RestoreBinaryContent(doc);
+  };
 
 private:
   const char *nodeName_;
@@ -18,6 +18,7 @@
 #include "PlayerMixer.h"
 #include "Services/Midi/MidiService.h"
 #include "System/Console/n_assert.h"
+#include "System/Profiler/AudioStageProfiler.h"
 #include "System/System/System.h"
 #include "System/io/Status.h"
 #include <math.h>
@@ -34,9 +35,9 @@ Player::Player() : mixer_() {
   mode_ = PM_SONG;
   sequencerMode_ = SM_SONG;
   lastPercentage_ = 0;
-  retrigAllImmediate_ = false;
 
   for (int i = 0; i < SONG_CHANNEL_COUNT; i++) {
+    channelMute_[i] = false;
     instrumentOnChannel_[i][0] = ' ';
     instrumentOnChannel_[i][1] = ' ';
     instrumentOnChannel_[i][2] = '\0';
@@ -71,12 +72,15 @@ void Player::Close() {
 };
 
 void Player::SetChannelMute(int channel, bool mute) {
-  mixer_.SetChannelMute(channel, mute);
+  channelMute_[channel] = mute;
+  PlayerCommand command = {};
+  command.type = PCT_MUTE;
+  command.channel = channel;
+  command.value = mute;
+  pushCommand(command);
 };
 
-bool Player::IsChannelMuted(int channel) {
-  return mixer_.IsChannelMuted(channel);
-};
+bool Player::IsChannelMuted(int channel) { return channelMute_[channel]; };
 
 void Player::Start(PlayMode mode, bool forceSongMode, MixerServiceMode msmMode,
                    bool stopAtEnd) {
@@ -346,8 +350,10 @@ void Player::OnSongStartButton(unsigned int from, unsigned int to,
         Stop();
       } else {
         // Get current song row and queue for immediate retrigger
-        retrigPos_ = viewData_->songY_ + viewData_->songOffset_;
-        retrigAllImmediate_ = true;
+        PlayerCommand command = {};
+        command.type = PCT_RETRIGGER;
+        command.position = viewData_->songY_ + viewData_->songOffset_;
+        pushCommand(command);
       }
     } else {
       for (int i = 0; i < SONG_CHANNEL_COUNT; i++) {
@@ -488,6 +494,22 @@ unsigned char Player::GetQueueChainPosition(int i) {
 
 void Player::QueueChannel(int i, QueueingMode mode, unsigned char position,
                           unsigned char chainpos) {
+  // Stopped, the audio thread doesn't look at the queue until Start
+  if (!isRunning_) {
+    queueChannel(i, mode, position, chainpos);
+    return;
+  }
+  PlayerCommand command = {};
+  command.type = PCT_QUEUE;
+  command.channel = i;
+  command.value = mode;
+  command.position = position;
+  command.chainPos = chainpos;
+  pushCommand(command);
+};
+
+void Player::queueChannel(int i, QueueingMode mode, unsigned char position,
+                          unsigned char chainpos) {
   liveQueueingMode_[i] = mode;
   liveQueuePosition_[i] = position;
   liveQueueChainPosition_[i] = chainpos;
@@ -500,6 +522,9 @@ void Player::QueueChannel(int i, QueueingMode mode, unsigned char position,
  ************************************************************/
 
 void Player::Update(Observable &o, I_ObservableData *d) {
+  AUDIO_STAGE_SCOPE(AUDIO_STAGE_SEQUENCER);
+
+  applyCommands();
 
   // Make sure sync's ok
 
@@ -515,12 +540,6 @@ void Player::Update(Observable &o, I_ObservableData *d) {
       Groove::GetInstance()->Trigger();
       sync->NextSlice();
       triggerLiveChains_ = false;
-      if (retrigAllImmediate_) {
-        for (int i = 0; i < SONG_CHANNEL_COUNT; i++) {
-          QueueChannel(i, QM_TICKSTART, retrigPos_, 0);
-        };
-        retrigAllImmediate_ = false;
-      }
       // Don't advance in audition mode
       if (viewData_->playMode_ != PM_AUDITION)
         moveToNextStep();
@@ -1209,6 +1228,8 @@ void Player::StopStreaming() {
   }
 }
 
+void Player::FillStreamingBuffer() { mixer_.FillStreamingBuffer(); }
+
 void Player::StartRecordStreaming(uint16_t *srcBuffer, uint32_t size,
                                   bool stereo) {
   mixer_.StartRecordStreaming(srcBuffer, size, stereo);
@@ -1268,9 +1289,13 @@ void Player::PlayNote(unsigned short instrumentIndex, unsigned short channel,
 
   I_Instrument *instrument = bank->GetInstrument(instrumentIndex);
   if (instrument) {
+    PlayerCommand command = {};
+    command.type = PCT_NOTE_ON;
     // Use the channel modulo SONG_CHANNEL_COUNT to ensure it's within range
-    int playerChannel = channel % SONG_CHANNEL_COUNT;
-    mixer_.StartInstrument(playerChannel, instrument, note, true);
+    command.channel = channel % SONG_CHANNEL_COUNT;
+    command.instrument = instrumentIndex;
+    command.value = note;
+    pushCommand(command);
     if (!isRunning_) {
       SetAudioActive(true);
     }
@@ -1278,10 +1303,62 @@ void Player::PlayNote(unsigned short instrumentIndex, unsigned short channel,
 }
 
 void Player::StopNote(unsigned short instrumentIndex, unsigned short channel) {
+  PlayerCommand command = {};
+  command.type = PCT_NOTE_OFF;
   // Use the channel modulo SONG_CHANNEL_COUNT to ensure it's within range
-  int playerChannel = channel % SONG_CHANNEL_COUNT;
-  mixer_.StopInstrument(playerChannel);
+  command.channel = channel % SONG_CHANNEL_COUNT;
+  pushCommand(command);
   if (!isRunning_) {
     SetAudioActive(false);
   }
 }
+
+void Player::pushCommand(const PlayerCommand &command) {
+  if (commands_.Push(command)) {
+    return;
+  }
+  // Audio thread has fallen behind. Holding the mixer lock keeps it out of
+  // Update, so the UI can apply what's queued itself and keep the order
+  Trace::Debug("Player command queue full (%lu times)",
+               (unsigned long)commands_.GetFullCount());
+  mixer_.Lock();
+  applyCommands();
+  applyCommand(command);
+  mixer_.Unlock();
+}
+
+void Player::applyCommands() {
+  PlayerCommand command;
+  while (commands_.Pop(command)) {
+    applyCommand(command);
+  }
+}
+
+void Player::applyCommand(const PlayerCommand &command) {
+  switch (command.type) {
+  case PCT_NOTE_ON: {
+    if (!project_)
+      break;
+    I_Instrument *instrument =
+        project_->GetInstrumentBank()->GetInstrument(command.instrument);
+    if (instrument) {
+      mixer_.StartInstrument(command.channel, instrument, command.value, true);
+    }
+  } break;
+  case PCT_NOTE_OFF:
+    mixer_.StopInstrument(command.channel);
+    break;
+  case PCT_MUTE:
+    mixer_.SetChannelMute(command.channel, command.value);
+    break;
+  case PCT_QUEUE:
+    queueChannel(command.channel, (QueueingMode)command.value,
+                 command.position, command.chainPos);
+    break;
+  case PCT_RETRIGGER:
+    for (int i = 0; i < SONG_CHANNEL_COUNT; i++) {
+      queueChannel(i, QM_TICKSTART, command.position, 0);
+    }
+    break;
+  }
+}
@@ -14,6 +14,7 @@
 #include "Externals/etl/include/etl/string.h"
 #include "Foundation/Observable.h"
 #include "Foundation/T_Singleton.h"
+#include "PlayerCommandQueue.h"
 #include "PlayerMixer.h"
 #include "SyncMaster.h"
 #include "System/Timer/Timer.h"
@@ -87,6 +88,7 @@ public:
   void StartStreaming(const char *name, int startSample = 0);
   void StartLoopingStreaming(const char *name);
   void StopStreaming();
+  void FillStreamingBuffer();
 
   void StartRecordStreaming(uint16_t *srcBuffer, uint32_t size, bool stereo);
   void StopRecordStreaming();
@@ -97,7 +99,7 @@ public:
   void SetChannelMute(int channel, bool mute);
   bool IsChannelMuted(int channel);
 
-  // Live queuing
+  // Live queuing, applied by the audio thread at the next buffer when running
 
   QueueingMode GetQueueingMode(int i);
   unsigned char GetQueuePosition(int i);
@@ -129,7 +131,8 @@ public:
 
   Project *GetProject() { return project_; }
 
-  // Direct note playback methods for MIDI
+  // Direct note playback methods for MIDI, notes start and stop at the next
+  // buffer
   void PlayNote(unsigned short instrumentIndex, unsigned short channel,
                 unsigned char note, unsigned char velocity);
   void StopNote(unsigned short instrumentIndex, unsigned short channel);
@@ -145,6 +148,14 @@ protected:
   void moveToNextChain(int channel, int hop);
 
   void triggerLiveChains();
+  void queueChannel(int i, QueueingMode mode, unsigned char position,
+                    unsigned char chainpos);
+
+  // UI side of the command queue. Commands are applied in order by the audio
+  // thread, or by the UI under the mixer lock when the queue is full
+  void pushCommand(const PlayerCommand &command);
+  void applyCommands();
+  void applyCommand(const PlayerCommand &command);
 
   void SetAudioActive(bool active);
 
@@ -182,8 +193,9 @@ private:
   unsigned int timeToLive_[SONG_CHANNEL_COUNT];
   unsigned int timeToStart_[SONG_CHANNEL_COUNT];
 
-  bool retrigAllImmediate_;
-  unsigned char retrigPos_;
+  PlayerCommandQueue commands_;
+  // Mutes as last requested by the UI, the channels follow at the next buffer
+  bool channelMute_[SONG_CHANNEL_COUNT];
 };
 
 #endif
@@ -11,6 +11,7 @@
 #include "Application/Mixer/MixerService.h"
 #include "Application/Model/Mixer.h"
 #include "Application/Player/SyncMaster.h"
+#include "System/Profiler/AudioStageProfiler.h"
 
 PlayerChannel::PlayerChannel(int index) {
   index_ = index;
@@ -45,9 +46,14 @@ void PlayerChannel::StopInstrument() {
 
 bool PlayerChannel::Render(fixed *buffer, int samplecount) {
   if (instr_) {
+    AUDIO_STAGE_SCOPE(AudioStage(AUDIO_STAGE_CHANNEL0 + index_));
     bool tableSlice = SyncMaster::GetInstance()->TableSlice();
-    bool status = instr_->Render(index_, buffer, samplecount, tableSlice);
-    return ((status) && (!muted_));
+    // muted channels keep playing silently so unmuting is sample accurate
+    if (muted_) {
+      instr_->Skip(index_, buffer, samplecount, tableSlice);
+      return false;
+    }
+    return instr_->Render(index_, buffer, samplecount, tableSlice);
   } else {
     return false;
   }
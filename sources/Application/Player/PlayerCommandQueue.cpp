@@ -0,0 +1,35 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#include "PlayerCommandQueue.h"
+
+PlayerCommandQueue::PlayerCommandQueue() : write_(0), read_(0), full_(0) {}
+
+bool PlayerCommandQueue::Push(const PlayerCommand &command) {
+  uint32_t write = write_.load(std::memory_order_relaxed);
+  uint32_t used = write - read_.load(std::memory_order_acquire);
+  if (used >= PLAYER_COMMAND_QUEUE_SIZE) {
+    full_++;
+    return false;
+  }
+  commands_[write & (PLAYER_COMMAND_QUEUE_SIZE - 1)] = command;
+  // Publishes the command before the audio thread can see the slot
+  write_.store(write + 1, std::memory_order_release);
+  return true;
+}
+
+bool PlayerCommandQueue::Pop(PlayerCommand &command) {
+  uint32_t read = read_.load(std::memory_order_relaxed);
+  if (read == write_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  command = commands_[read & (PLAYER_COMMAND_QUEUE_SIZE - 1)];
+  // Hands the slot back only once it's been copied out
+  read_.store(read + 1, std::memory_order_release);
+  return true;
+}
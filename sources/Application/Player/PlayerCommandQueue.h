@@ -0,0 +1,58 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _PLAYER_COMMAND_QUEUE_H_
+#define _PLAYER_COMMAND_QUEUE_H_
+
+#include <atomic>
+#include <stdint.h>
+
+// Commands held by the queue (power of two). A full song of channels gets
+// queued by one button press, this leaves room for several of those per
+// audio buffer
+#define PLAYER_COMMAND_QUEUE_SIZE 64
+
+enum PlayerCommandType {
+  PCT_NOTE_ON,   // channel, instrument, value (note)
+  PCT_NOTE_OFF,  // channel
+  PCT_MUTE,      // channel, value (1 mutes)
+  PCT_QUEUE,     // channel, value (QueueingMode), position, chainPos
+  PCT_RETRIGGER, // position
+};
+
+struct PlayerCommand {
+  uint8_t type;
+  uint8_t channel;
+  uint8_t value;
+  uint8_t position;
+  uint8_t chainPos;
+  uint16_t instrument;
+};
+
+// Wait-free single producer, single consumer ring carrying what the UI asks
+// of the player to the audio thread, which applies it at the start of the
+// next buffer. Only the UI thread pushes and only the audio thread pops
+class PlayerCommandQueue {
+public:
+  PlayerCommandQueue();
+
+  // False when the queue is full, the command isn't queued
+  bool Push(const PlayerCommand &command);
+  // False when there's nothing left to apply
+  bool Pop(PlayerCommand &command);
+
+  uint32_t GetFullCount() { return full_; }
+
+private:
+  PlayerCommand commands_[PLAYER_COMMAND_QUEUE_SIZE];
+  std::atomic<uint32_t> write_; // next slot the UI fills
+  std::atomic<uint32_t> read_;  // next slot the audio thread applies
+  uint32_t full_;
+};
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "PlayerMixer.h"
 #include "Application/Instruments/SampleInstrument.h"
+#include "Application/Instruments/SampleStreamer.h"
 #include "Application/Mixer/MixerService.h"
 #include "Application/Model/Mixer.h"
 #include "Application/Utils/char.h"
@@ -64,6 +65,9 @@ bool PlayerMixer::Init(Project *project) {
   // streamer need access to project to get current volume
   fileStreamer_.SetProject(project);
 
+  // Created here rather than by the first streaming voice on the audio thread
+  SampleStreamer::GetInstance();
+
   return true;
 };
 
@@ -113,8 +117,9 @@ I_Instrument *PlayerMixer::GetLastInstrument(int channel) {
 };
 
 stereosample PlayerMixer::GetMasterOutLevel() {
-  MixerService *ms = MixerService::GetInstance();
-  return ms->GetMasterBus()->GetMixerLevels();
+  // peaks of the output stage are measured on every frame after clipping
+  AudioOut *out = GetAudioOut();
+  return out ? out->GetLastPeakLevels() : 0;
 }
 
 etl::array<stereosample, SONG_CHANNEL_COUNT> *PlayerMixer::GetMixerLevels() {
@@ -179,6 +184,11 @@ void PlayerMixer::StartLoopingStreaming(const char *name) {
 
 void PlayerMixer::StopStreaming() { fileStreamer_.Stop(); };
 
+void PlayerMixer::FillStreamingBuffer() {
+  fileStreamer_.Fill();
+  SampleStreamer::GetInstance()->Service();
+};
+
 void PlayerMixer::StartRecordStreaming(uint16_t *srcBuffer, uint32_t size,
                                        bool stereo) {
   recordStreamer_.Start(srcBuffer, size, stereo);
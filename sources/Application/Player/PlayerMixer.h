@@ -57,6 +57,7 @@ public:
   void StartStreaming(const char *name, int startSample = 0);
   void StartLoopingStreaming(const char *name);
   void StopStreaming();
+  void FillStreamingBuffer();
 
   void StartRecordStreaming(uint16_t *srcBuffer, uint32_t size, bool stereo);
   void StopRecordStreaming();
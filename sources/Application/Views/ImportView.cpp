@@ -11,6 +11,7 @@
 #include "Application/Audio/AudioFileStreamer.h"
 #include "Application/Instruments/SampleInstrument.h"
 #include "Application/Instruments/SamplePool.h"
+#include "Application/Instruments/WavPeaks.h"
 #include "Application/Views/SampleEditorView.h"
 #include "Externals/etl/include/etl/string.h"
 #include "Externals/etl/include/etl/to_string.h"
@@ -65,7 +66,7 @@ void ImportView::ProcessButtonMask(unsigned short mask, bool pressed) {
   // Handle key press events
   if (pressed) {
     auto fs = FileSystem::GetInstance();
-    unsigned fileIndex = fileIndexList_[currentIndex_];
+    unsigned fileIndex = fileIndexAt(currentIndex_);
 
     if (mask & EPBM_PLAY) {
       char name[PFILENAME_SIZE];
@@ -113,7 +114,7 @@ void ImportView::ProcessButtonMask(unsigned short mask, bool pressed) {
 
     if (mask & EPBM_ENTER) {
       if (inProjectSampleDir_) {
-        if (fileIndexList_.empty()) {
+        if (listSize_ == 0) {
           return; // Do nothing if the list is empty
         }
         // NOTE: the order of buttons in project pool is: edit, remove
@@ -144,7 +145,7 @@ void ImportView::ProcessButtonMask(unsigned short mask, bool pressed) {
     // handle changing selected "bottom button", note: ignore if this is a
     // nav+arrow combo
     if ((mask & EPBM_LEFT || mask & EPBM_RIGHT) && !(mask & EPBM_NAV)) {
-      if (inProjectSampleDir_ && fileIndexList_.empty()) {
+      if (inProjectSampleDir_ && listSize_ == 0) {
         return; // Do nothing if the list is empty
       }
       // toggle the selected button
@@ -159,12 +160,12 @@ void ImportView::ProcessButtonMask(unsigned short mask, bool pressed) {
 
   // handle moving up and down the file list
   if (mask & EPBM_UP) {
-    if (inProjectSampleDir_ && fileIndexList_.empty()) {
+    if (inProjectSampleDir_ && listSize_ == 0) {
       return; // Do nothing if the list is empty
     }
     warpToNextSample(true);
   } else if (mask & EPBM_DOWN) {
-    if (inProjectSampleDir_ && fileIndexList_.empty()) {
+    if (inProjectSampleDir_ && listSize_ == 0) {
       return; // Do nothing if the list is empty
     }
     warpToNextSample(false);
@@ -181,7 +182,7 @@ void ImportView::ProcessButtonMask(unsigned short mask, bool pressed) {
     // A modifier
     if (mask & EPBM_ENTER) {
       auto fs = FileSystem::GetInstance();
-      unsigned fileIndex = fileIndexList_[currentIndex_];
+      unsigned fileIndex = fileIndexAt(currentIndex_);
       char name[PFILENAME_SIZE];
       fs->getFileName(fileIndex, name, PFILENAME_SIZE);
       if (fs->getFileType(fileIndex) == PFT_DIR) {
@@ -222,10 +223,10 @@ void ImportView::DrawView() {
 
   // Loop through visible files in the list
   for (size_t i = topIndex_;
-       i < topIndex_ + LIST_PAGE_SIZE && (i < fileIndexList_.size()); i++) {
+       i < topIndex_ + LIST_PAGE_SIZE && (i < listSize_); i++) {
     props.invert_ = false;
 
-    unsigned fileIndex = fileIndexList_[i];
+    unsigned fileIndex = fileIndexAt(i);
     etl::string<PFILENAME_SIZE> displayName;
 
     if (fs->getFileType(fileIndex) != PFT_DIR) {
@@ -297,7 +298,7 @@ void ImportView::DrawView() {
     }
     DrawString(x + 10, y, "Edit", props);
   } else {
-    if (fileIndexList_.empty()) {
+    if (listSize_ == 0) {
       // draw this a few lines down from *top* of screen
       SetColor(CD_NORMAL);
       props.invert_ = false;
@@ -336,10 +337,11 @@ void ImportView::DrawView() {
   props.invert_ = true;
   y = 0;
   uint32_t filesize = 0;
-  auto currentFileIndex = fileIndexList_[currentIndex_];
+  auto currentFileIndex = fileIndexAt(currentIndex_);
 
   // only get file size if it's a file not a dir
-  if (fs->getFileType(currentFileIndex) == PFT_FILE) {
+  if (currentFileIndex >= 0 &&
+      fs->getFileType(currentFileIndex) == PFT_FILE) {
     filesize = fs->getFileSize(currentFileIndex);
     // if file size is larger than available space, set color to warning
     if (filesize > availableSpace) {
@@ -401,7 +403,7 @@ void ImportView::warpToNextSample(bool goUp) {
       }
     }
   } else {
-    if (currentIndex_ < fileIndexList_.size() - 1) {
+    if (currentIndex_ + 1 < listSize_) {
       currentIndex_++;
       // if we have scrolled off the bottom, page the file list down if not
       // at end of the list
@@ -416,7 +418,7 @@ void ImportView::warpToNextSample(bool goUp) {
 void ImportView::preview(char *name) {
   // Get file size to check if it's a single cycle waveform
   auto fs = FileSystem::GetInstance();
-  unsigned fileIndex = fileIndexList_[currentIndex_];
+  unsigned fileIndex = fileIndexAt(currentIndex_);
   int fileSize = fs->getFileSize(fileIndex);
 
   // check for LGPT or AKWF standard file sizes
@@ -484,7 +486,7 @@ void ImportView::import() {
 
   auto fs = FileSystem::GetInstance();
   char name[PFILENAME_SIZE];
-  unsigned fileIndex = fileIndexList_[currentIndex_];
+  unsigned fileIndex = fileIndexAt(currentIndex_);
   fs->getFileName(fileIndex, name, PFILENAME_SIZE);
 
   // Get current project name
@@ -678,7 +680,7 @@ void ImportView::showSampleEditor(
   NotifyObservers(&ve);
 }
 
-void ImportView::removeProjectSample(uint8_t fileIndex, FileSystem *fs) {
+void ImportView::removeProjectSample(unsigned fileIndex, FileSystem *fs) {
   char filename[PFILENAME_SIZE];
   fs->getFileName(fileIndex, filename, PFILENAME_SIZE);
 
@@ -711,6 +713,7 @@ void ImportView::removeProjectSample(uint8_t fileIndex, FileSystem *fs) {
         Trace::Error("Failed to delete sample %s", filename);
         return;
       }
+      WavPeaks::Remove(filename);
       // and unload it from ram
       SamplePool::GetInstance()->unloadSample(sampleIndex);
 
@@ -727,20 +730,44 @@ void ImportView::removeProjectSample(uint8_t fileIndex, FileSystem *fs) {
 }
 
 void ImportView::refreshFileIndexList(FileSystem *fs) {
-  fs->list(&fileIndexList_, ".wav", false);
-
-  if (fs->isCurrentRoot() || inProjectSampleDir_) {
-    for (auto it = fileIndexList_.begin(); it != fileIndexList_.end(); ++it) {
-      char entryName[PFILENAME_SIZE];
-      fs->getFileName(*it, entryName, PFILENAME_SIZE);
-      if (strcmp(entryName, "..") == 0) {
-        fileIndexList_.erase(it);
-        break;
-      }
+  listOffset_ = 0;
+  size_t total = fs->listPage(&fileIndexList_, ".wav", false, 0);
+
+  // ".." comes first when there is one
+  listBase_ = 0;
+  if ((fs->isCurrentRoot() || inProjectSampleDir_) &&
+      !fileIndexList_.empty()) {
+    char entryName[PFILENAME_SIZE];
+    fs->getFileName(fileIndexList_[0], entryName, PFILENAME_SIZE);
+    if (strcmp(entryName, "..") == 0) {
+      listBase_ = 1;
     }
   }
+  listSize_ = total - listBase_;
 
-  if (currentIndex_ >= fileIndexList_.size()) {
-    currentIndex_ = fileIndexList_.empty() ? 0 : fileIndexList_.size() - 1;
+  if (currentIndex_ >= listSize_) {
+    currentIndex_ = (listSize_ == 0) ? 0 : listSize_ - 1;
+  }
+  if (topIndex_ > currentIndex_) {
+    topIndex_ = currentIndex_;
+  }
+}
+
+int ImportView::fileIndexAt(size_t position) {
+  if (position >= listSize_) {
+    return -1;
+  }
+  size_t entry = listBase_ + position;
+  if (entry < listOffset_ || entry >= listOffset_ + fileIndexList_.size()) {
+    // Load the page around it so that moving either way stays in it
+    listOffset_ = (entry > MAX_FILE_INDEX_SIZE / 2)
+                      ? entry - MAX_FILE_INDEX_SIZE / 2
+                      : 0;
+    FileSystem::GetInstance()->listPage(&fileIndexList_, ".wav", false,
+                                        listOffset_);
+    if (entry >= listOffset_ + fileIndexList_.size()) {
+      return -1;
+    }
   }
+  return fileIndexList_[entry - listOffset_];
 }
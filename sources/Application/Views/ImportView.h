@@ -39,8 +39,11 @@ protected:
   void adjustPreviewVolume(bool increase);
   void showSampleEditor(etl::string<MAX_INSTRUMENT_FILENAME_LENGTH> filename,
                         bool isProjectSample);
-  void removeProjectSample(uint8_t fileIndex, FileSystem *fs);
+  void removeProjectSample(unsigned fileIndex, FileSystem *fs);
   void refreshFileIndexList(FileSystem *fs);
+  // Directory index of the file at a position of the whole listing, the page
+  // of fileIndexList_ follows it. -1 past the end
+  int fileIndexAt(size_t position);
 
 private:
   size_t topIndex_ = 0;
@@ -54,6 +57,10 @@ private:
       false; // Flag to track when the edit key is being held down
   bool inProjectSampleDir_ =
       false; // Flag to track if we're in the project's sample directory
+  // One page of the listing, which can be bigger than MAX_FILE_INDEX_SIZE
   etl::vector<int, MAX_FILE_INDEX_SIZE> fileIndexList_;
+  size_t listOffset_ = 0; // position of the page in the listing
+  size_t listSize_ = 0;   // files shown, ".." left out
+  size_t listBase_ = 0;   // 1 when a leading ".." is left out
 };
 #endif
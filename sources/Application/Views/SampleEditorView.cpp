@@ -12,6 +12,7 @@
 #include "Application/Instruments/SamplePool.h"
 #include "Application/Instruments/WavFileWriter.h"
 #include "Application/Instruments/WavHeader.h"
+#include "Application/Instruments/WavPeaks.h"
 #include "Application/Model/Config.h"
 #include "Application/Persistency/PersistenceConstants.h"
 #include "Application/Player/Player.h"
@@ -683,6 +684,7 @@ bool SampleEditorView::applyTrimOperation(uint32_t start_, uint32_t end_) {
   if (!trimmed) {
     return false;
   }
+  WavPeaks::Remove(filename.c_str());
 
   if (!trimResult.trimmed) {
     startVar_.SetInt(0);
@@ -701,13 +703,6 @@ bool SampleEditorView::applyTrimOperation(uint32_t start_, uint32_t end_) {
 
   // need to reload from disk into ram/flash pool samples
   if (viewData_->isShowingSampleEditorProjectPool) {
-#ifndef ADV
-    // on pico we dont support unloading individual samples from flash
-    MessageBox *warning = MessageBox::Create(*this, "Please reload project",
-                                             "To apply changes", MBBF_OK);
-    DoModal(warning);
-    return true;
-#endif
     auto pool = SamplePool::GetInstance();
     if (pool) {
       if (!goProjectSamplesDir(viewData_)) {
@@ -799,6 +794,8 @@ bool SampleEditorView::applyNormalizeOperation() {
   if (!normalized) {
     return false;
   }
+  // same length, the old peaks would still be taken as up to date
+  WavPeaks::Remove(filename.c_str());
 
   if (!normalizeResult.normalized) {
     updateSampleParameters();
@@ -848,12 +845,6 @@ bool SampleEditorView::reloadEditedSample() {
   loadSample(viewData_->sampleEditorFilename,
              viewData_->isShowingSampleEditorProjectPool);
 
-#ifndef ADV
-  MessageBox *warning = MessageBox::Create(*this, "Please reload project",
-                                           "To apply changes", MBBF_OK);
-  DoModal(warning);
-  return true;
-#else
   auto pool = SamplePool::GetInstance();
 
   if (!goProjectSamplesDir(viewData_)) {
@@ -890,7 +881,6 @@ bool SampleEditorView::reloadEditedSample() {
     }
   }
   return true;
-#endif
 }
 
 bool SampleEditorView::saveSample(
@@ -1127,6 +1117,15 @@ void SampleEditorView::loadSample(
     return;
   }
 
+  if (isProjectSampleFile && loadPeaks(filename)) {
+    startVar_.SetInt(0);
+    endVar_.SetInt(tempSampleSize_);
+    Trace::Log("SAMPLEEDITOR", "Loaded peaks of %d frames from %s",
+               tempSampleSize_, filename.c_str());
+    fullWaveformRedraw_ = true;
+    return;
+  }
+
   // ensure we start streaming from the data chunk
   file->Seek(headerInfo.dataOffset, SEEK_SET);
 
@@ -1235,6 +1234,28 @@ void SampleEditorView::loadSample(
   fullWaveformRedraw_ = true;
 }
 
+// Fills the waveform from the peak file saved next to project samples. It is
+// built on the first open of samples imported before there were peak files,
+// short samples are read directly
+
+bool SampleEditorView::loadPeaks(
+    const etl::string<MAX_INSTRUMENT_FILENAME_LENGTH> &filename) {
+  if (tempSampleSize_ < WAV_PEAKS_BLOCK_FRAMES * WAVEFORM_CACHE_SIZE) {
+    return false;
+  }
+  const char *path = filename.c_str();
+  waveformCacheValid_ =
+      WavPeaks::Read(path, tempSampleSize_, 0, tempSampleSize_,
+                     waveformCache_, WAVEFORM_CACHE_SIZE, BITMAPHEIGHT);
+  if (!waveformCacheValid_ &&
+      WavPeaks::Build(path, chunkBuffer_, sizeof(chunkBuffer_))) {
+    waveformCacheValid_ =
+        WavPeaks::Read(path, tempSampleSize_, 0, tempSampleSize_,
+                       waveformCache_, WAVEFORM_CACHE_SIZE, BITMAPHEIGHT);
+  }
+  return waveformCacheValid_;
+}
+
 void SampleEditorView::clearWaveformRegion() {
   // Clear the entire waveform area
   GUIRect rrect;
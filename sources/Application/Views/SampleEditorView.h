@@ -52,6 +52,7 @@ private:
   void updateSampleParameters();
   void loadSample(const etl::string<MAX_INSTRUMENT_FILENAME_LENGTH> path,
                   bool isProjectSampleFile);
+  bool loadPeaks(const etl::string<MAX_INSTRUMENT_FILENAME_LENGTH> &filename);
   bool reloadEditedSample();
   bool saveSample(etl::string<MAX_INSTRUMENT_FILENAME_LENGTH> &savedFilename);
   bool loadSampleToPool(
@@ -11,6 +11,7 @@
 #include "Application/AppWindow.h"
 #include "Application/Instruments/InstrumentBank.h"
 #include "Application/Instruments/SamplePool.h"
+#include "Application/Instruments/WavPeaks.h"
 #include "Application/Model/Project.h"
 #include "Application/Model/Song.h"
 #include "Application/Player/Player.h"
@@ -359,19 +360,32 @@ void SampleSlicesView::rebuildWaveform() {
     return;
   }
 
+  // The peaks saved with the sample cover all of it, streamed samples too.
+  // Views zoomed in further than they go read the samples themselves
+  char projectName[MAX_PROJECT_NAME_LENGTH + 1];
+  viewData_->project_->GetProjectName(projectName);
+  etl::string<MAX_PROJECT_SAMPLE_PATH_LENGTH> path(PROJECTS_DIR);
+  path.append("/");
+  path.append(projectName);
+  path.append("/" PROJECT_SAMPLES_DIR "/");
+  path.append(pool->GetNameList()[sampleIndex]);
+  if (WavPeaks::Read(path.c_str(), sampleSize_, viewStart_, viewEnd_,
+                     waveformCache_, SliceWaveformCacheSize,
+                     SliceBitmapHeight)) {
+    waveformValid_ = true;
+    needsWaveformRedraw_ = true;
+    return;
+  }
+
   int32_t channels = source->GetChannelCount(0);
   int16_t *samples = static_cast<int16_t *>(source->GetSampleBuffer(0));
   if (!samples) {
     return;
   }
+  // Streamed samples only have their head in memory, the rest shows flat
+  uint32_t resident = static_cast<uint32_t>(source->GetResidentSize(0));
 
   std::fill(std::begin(waveformCache_), std::end(waveformCache_), 0);
-  // We quantize to 8-bit in order to accumulate into int32_t to save memory
-  static int32_t sumSquares[SliceWaveformCacheSize];
-  // Counts fit in uint16_t: max bucket size is <= total samples / columns.
-  static uint16_t counts[SliceWaveformCacheSize];
-  std::fill_n(sumSquares, SliceWaveformCacheSize, int32_t{0});
-  std::fill_n(counts, SliceWaveformCacheSize, uint16_t{0});
   uint32_t viewSpan = viewEnd_ - viewStart_;
   if (viewSpan == 0) {
     return;
@@ -384,22 +398,15 @@ void SampleSlicesView::rebuildWaveform() {
     if (pixel >= SliceWaveformCacheSize) {
       pixel = SliceWaveformCacheSize - 1;
     }
-    int16_t value = samples[i * channels];
-    int16_t quant = static_cast<int16_t>(value >> 8);
-    sumSquares[pixel] += static_cast<int32_t>(quant) * quant;
-    counts[pixel]++;
-  }
-
-  for (int32_t i = 0; i < SliceWaveformCacheSize; ++i) {
-    if (counts[i] == 0) {
-      waveformCache_[i] = 0;
-      continue;
+    int16_t value = (i < resident) ? samples[i * channels] : 0;
+    // peaks scaled like the ones of the peak file, so zooming in looks the
+    // same
+    int32_t magnitude = std::abs(static_cast<int32_t>(value >> 8));
+    uint8_t height = static_cast<uint8_t>(std::min<int32_t>(
+        (magnitude * SliceBitmapHeight + 63) / 128, SliceBitmapHeight));
+    if (height > waveformCache_[pixel]) {
+      waveformCache_[pixel] = height;
     }
-    float meanSquare = static_cast<float>(sumSquares[i]) / counts[i];
-    float rms = std::sqrt(meanSquare) / 128.0f;
-    uint8_t height = static_cast<uint8_t>(std::min<float>(
-        rms * SliceBitmapHeight, static_cast<float>(SliceBitmapHeight)));
-    waveformCache_[i] = height;
   }
 
   waveformValid_ = true;
@@ -11,6 +11,7 @@
 #include "System/Console/Trace.h"
 #include "System/Console/n_assert.h"
 #include "System/System/System.h"
+#include <string.h>
 
 AudioBufferData AudioDriver::pool_[SOUND_BUFFER_COUNT];
 
@@ -37,8 +38,10 @@ bool AudioDriver::Start() {
 
   isPlaying_ = true;
 
+  // The driver starts out on blank, as if it had just played the last buffer
+  // of the pool, the first one committed plays next
   poolQueuePosition_ = 0;
-  poolPlayPosition_ = 0;
+  poolPlayPosition_ = SOUND_BUFFER_COUNT - 1;
   hasData_ = false;
 
   return StartDriver();
@@ -51,10 +54,18 @@ void AudioDriver::Stop() {
 }
 
 void AudioDriver::AddBuffer(short *buffer, int samplecount) {
+  short *dst = AcquireBuffer(samplecount);
+  if (dst) {
+    memcpy(dst, buffer, samplecount * 2 * sizeof(short));
+    CommitBuffer(samplecount);
+  }
+}
+
+short *AudioDriver::AcquireBuffer(int samplecount) {
   int len = samplecount * 2 * sizeof(short);
 
   if (!isPlaying_)
-    return;
+    return nullptr;
 
   if (len > SOUND_BUFFER_MAX) {
     Trace::Error("Alert: buffer size exceeded");
@@ -64,16 +75,30 @@ void AudioDriver::AddBuffer(short *buffer, int samplecount) {
     NInvalid;
     Trace::Error("Audio overrun, please report");
     pool_[poolQueuePosition_].empty_ = true;
-    return;
+    return nullptr;
   }
 
-  memcpy(pool_[poolQueuePosition_].buffer_, (char *)buffer, len);
-  pool_[poolQueuePosition_].size_ = len;
+  return (short *)pool_[poolQueuePosition_].buffer_;
+}
+
+void AudioDriver::CommitBuffer(int samplecount) {
+  pool_[poolQueuePosition_].size_ = samplecount * 2 * sizeof(short);
   pool_[poolQueuePosition_].empty_ = false;
   poolQueuePosition_ = (poolQueuePosition_ + 1) % SOUND_BUFFER_COUNT;
   hasData_ = true;
 }
 
+AudioBufferData *AudioDriver::nextPlayBuffer() {
+  pool_[poolPlayPosition_].empty_ = true;
+
+  int next = (poolPlayPosition_ + 1) % SOUND_BUFFER_COUNT;
+  if (pool_[next].empty_) {
+    return nullptr;
+  }
+  poolPlayPosition_ = next;
+  return &pool_[next];
+}
+
 void AudioDriver::OnNewBufferNeeded() {
   SetChanged();
   Event event(Event::ADET_BUFFERNEEDED);
@@ -18,7 +18,8 @@
 #define MAX_SAMPLE_COUNT 1875
 
 struct AudioBufferData {
-  char buffer_[MAX_SAMPLE_COUNT * 2 * sizeof(short)];
+  // written in place as interleaved shorts by the mixer, see AcquireBuffer
+  __attribute__((aligned(4))) char buffer_[MAX_SAMPLE_COUNT * 2 * sizeof(short)];
   int size_;
   bool empty_;
   void *driverData_;
@@ -57,11 +58,23 @@ public:
 
   void AddBuffer(short *buffer, int size); // size in samples
 
+  // Zero copy alternative to AddBuffer: the producer gets the next pool
+  // buffer, renders straight into it and hands it over to the driver with
+  // CommitBuffer(). Returns null if not playing or if the buffer is still
+  // owned by the driver (overrun), in which case nothing should be committed.
+  short *AcquireBuffer(int size); // size in samples
+  void CommitBuffer(int size);    // size in samples
+
   AudioSettings GetAudioSettings();
 
   void OnNewBufferNeeded();
 
 protected:
+  // Called by the driver once it's done playing the current buffer: hands it
+  // back to the producer and returns the next one to play, null if it isn't
+  // committed yet (underrun)
+  AudioBufferData *nextPlayBuffer();
+
   void eatBuffer(void *buffer, int size); // size in bytes
   void onAudioBufferTick();
   bool hasData();
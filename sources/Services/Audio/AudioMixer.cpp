@@ -9,12 +9,14 @@
 
 #include "AudioMixer.h"
 #include "System/Console/Trace.h"
+#include "System/Profiler/AudioStageProfiler.h"
 #include "System/System/System.h"
 
 fixed AudioMixer::renderBuffer_[MAX_SAMPLE_COUNT * 2];
 
 AudioMixer::AudioMixer(const char *name)
-    : enableRendering_(0), name_(name), modules_() {
+    : enableRendering_(0), name_(name), stage_(AUDIO_STAGE_MASTER),
+      modules_() {
   volume_ = (i2fp(1));
 };
 
@@ -42,99 +44,161 @@ void AudioMixer::EnableRendering(bool enable) {
   }
 };
 
-bool AudioMixer::Render(fixed *buffer, int samplecount) {
+// dst = dst + src
+static void accumulate(fixed *dst, const fixed *src, int count) {
+  /* Manually unrolling the loop gives a 25% performance increase (from
+   * 6500 cycles for 800 samples to 5100 cycles. This is due to being able
+   * to schedule independent loads simultanously, reduce load latency by
+   * loading independent loads instead of immediately executing a
+   * dependent action (add) having to wait for the load to complete.
+   * Potentially also reducing the load comparison overhead 16
+   * instructions in the unroll gives the best performance, 8 gave ~17%
+   * improvement.
+   */
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    dst[i + 0] += src[i + 0];
+    dst[i + 1] += src[i + 1];
+    dst[i + 2] += src[i + 2];
+    dst[i + 3] += src[i + 3];
+    dst[i + 4] += src[i + 4];
+    dst[i + 5] += src[i + 5];
+    dst[i + 6] += src[i + 6];
+    dst[i + 7] += src[i + 7];
+    dst[i + 8] += src[i + 8];
+    dst[i + 9] += src[i + 9];
+    dst[i + 10] += src[i + 10];
+    dst[i + 11] += src[i + 11];
+    dst[i + 12] += src[i + 12];
+    dst[i + 13] += src[i + 13];
+    dst[i + 14] += src[i + 14];
+    dst[i + 15] += src[i + 15];
+  }
+  for (; i < count; ++i)
+    dst[i] += src[i];
+}
+
+// acc + fp_mul(x, gain), bit exact, written as a single 64 bit
+// multiply-accumulate so it maps to SMLAL on Cortex-M4/M7
+static inline fixed fp_mac(fixed acc, fixed x, fixed gain) {
+  return fixed((((long long)acc << FIXED_SHIFT) + (long long)x * gain) >>
+               FIXED_SHIFT);
+}
+
+// dst = dst + src * srcGain
+static void accumulateScaled(fixed *dst, const fixed *src, fixed srcGain,
+                             int count) {
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    dst[i + 0] = fp_mac(dst[i + 0], src[i + 0], srcGain);
+    dst[i + 1] = fp_mac(dst[i + 1], src[i + 1], srcGain);
+    dst[i + 2] = fp_mac(dst[i + 2], src[i + 2], srcGain);
+    dst[i + 3] = fp_mac(dst[i + 3], src[i + 3], srcGain);
+  }
+  for (; i < count; ++i)
+    dst[i] = fp_mac(dst[i], src[i], srcGain);
+}
+
+// dst = dst * dstGain + src * srcGain, used when the first contribution still
+// carries a gain so that it gets folded into the next add
+static void mixScaled(fixed *dst, fixed dstGain, const fixed *src,
+                      fixed srcGain, int count) {
+  for (int i = 0; i < count; ++i)
+    dst[i] = fixed(((long long)dst[i] * dstGain +
+                    (long long)src[i] * srcGain) >>
+                   FIXED_SHIFT);
+}
+
+// Sums all modules into buffer. The sum is left scaled by gain: the gains of
+// the modules (sub mixers defer theirs) are folded into the accumulation
+// passes, only what could not be folded, including this mixer's own volume,
+// is returned.
+bool AudioMixer::mix(fixed *buffer, int samplecount, fixed &gain) {
   bool gotData = false;
-  fixed peakL = 0;
-  fixed peakR = 0;
+  fixed bufferGain = FP_ONE;
+  int count = samplecount * 2;
 
   for (auto *mod : modules_) {
     if (!mod) {
       continue;
     }
+    fixed modGain;
     if (!gotData) {
-      gotData = mod->Render(buffer, samplecount);
-    } else {
-      if (mod->Render(renderBuffer_, samplecount)) {
-        fixed *dst = buffer;
-        fixed *src = renderBuffer_;
-        int count = samplecount * 2;
-
-        /* Manually unrolling the loop gives a 25% performance increase (from
-         * 6500 cycles for 800 samples to 5100 cycles. This is due to being able
-         * to schedule independent loads simultanously, reduce load latency by
-         * loading independent loads instead of immediately executing a
-         * dependent action (add) having to wait for the load to complete.
-         * Potentially also reducing the load comparison overhead 16
-         * instructions in the unroll gives the best performance, 8 gave ~17%
-         * improvement.
-         */
-        int i = 0;
-        for (; i + 16 <= count; i += 16) {
-          dst[i + 0] += src[i + 0];
-          dst[i + 1] += src[i + 1];
-          dst[i + 2] += src[i + 2];
-          dst[i + 3] += src[i + 3];
-          dst[i + 4] += src[i + 4];
-          dst[i + 5] += src[i + 5];
-          dst[i + 6] += src[i + 6];
-          dst[i + 7] += src[i + 7];
-          dst[i + 8] += src[i + 8];
-          dst[i + 9] += src[i + 9];
-          dst[i + 10] += src[i + 10];
-          dst[i + 11] += src[i + 11];
-          dst[i + 12] += src[i + 12];
-          dst[i + 13] += src[i + 13];
-          dst[i + 14] += src[i + 14];
-          dst[i + 15] += src[i + 15];
-        }
-        for (; i < count; ++i)
-          dst[i] += src[i];
+      gotData = mod->RenderDeferred(buffer, samplecount, bufferGain);
+    } else if (mod->RenderDeferred(renderBuffer_, samplecount, modGain)) {
+      AUDIO_STAGE_SCOPE(stage_);
+      if (bufferGain != FP_ONE) {
+        mixScaled(buffer, bufferGain, renderBuffer_, modGain, count);
+        bufferGain = FP_ONE;
+      } else if (modGain != FP_ONE) {
+        accumulateScaled(buffer, renderBuffer_, modGain, count);
+      } else {
+        accumulate(buffer, renderBuffer_, count);
       }
     }
   }
+  gain = (volume_ == FP_ONE) ? bufferGain : fp_mul(bufferGain, volume_);
+  return gotData;
+}
 
-  // Apply volume to mix of all of this instance's "sub" audiomixers
-  // TODO (democloid): This is wildly inefficient, doing this loop takes 4 - 5
-  // times the time it takes a mix loop above. Some tests show that at least
-  // double performance is not hard to achieve
-  if (gotData) {
-    fixed *c = buffer;
-
-    if (volume_ == FP_ONE) {
-      // unity gain, no calculations to be done, just grab the levels
-      for (int i = 0; i < samplecount; i += 32, c += 64) {
-        fixed r = *c;
-        fixed l = *(c + 1);
-        if (r > peakR)
-          peakR = r;
-        if (l > peakL)
-          peakL = l;
-      }
-    } else {
-      for (int i = 0; i < samplecount; i++) {
-        // Right
-        fixed r = fp_mul(*c, volume_);
-        *c++ = r;
-
-        // Left
-        fixed l = fp_mul(*c, volume_);
-        *c++ = l;
-
-        // update the level every 32 sample pairs
-        // (!(i & 31)) =^= (i % 32 == 0) and is used for performance
-        if (!(i & 31)) {
-          if (r > peakR)
-            peakR = r;
-          if (l > peakL)
-            peakL = l;
-        }
-      }
-    }
+void AudioMixer::applyGain(fixed *buffer, int samplecount, fixed gain) {
+  if (gain == FP_ONE) {
+    return;
+  }
+  AUDIO_STAGE_SCOPE(stage_);
+  fixed *c = buffer;
+  for (int i = 0; i < samplecount * 2; i++, c++) {
+    *c = fp_mul(*c, gain);
   }
+}
 
-  // Always update peakMixerLevel_ regardless of whether we got data
-  // This ensures VU meters update properly in all scenarios
+// Levels are sampled every 32 sample pairs of the unscaled mix and brought to
+// the output gain afterwards (the gain is never negative)
+void AudioMixer::updateLevels(fixed *buffer, int samplecount, fixed gain) {
+  fixed peakL = 0;
+  fixed peakR = 0;
+  fixed *c = buffer;
+  for (int i = 0; i < samplecount; i += 32, c += 64) {
+    fixed r = *c;
+    fixed l = *(c + 1);
+    if (r > peakR)
+      peakR = r;
+    if (l > peakL)
+      peakL = l;
+  }
+  if (gain != FP_ONE) {
+    peakL = fp_mul(peakL, gain);
+    peakR = fp_mul(peakR, gain);
+  }
   peakMixerLevel_ = fp2i(peakL) << 16 | fp2i(peakR);
+}
+
+bool AudioMixer::RenderDeferred(fixed *buffer, int samplecount, fixed &gain) {
+  // the file writer needs the final signal, no deferring then
+  if (enableRendering_ && writer_.IsOpen()) {
+    gain = FP_ONE;
+    return Render(buffer, samplecount);
+  }
+  bool gotData = mix(buffer, samplecount, gain);
+  if (gotData) {
+    updateLevels(buffer, samplecount, gain);
+  } else {
+    peakMixerLevel_ = 0;
+  }
+  return gotData;
+}
+
+bool AudioMixer::Render(fixed *buffer, int samplecount) {
+  fixed gain;
+  bool gotData = mix(buffer, samplecount, gain);
+  if (gotData) {
+    updateLevels(buffer, samplecount, gain);
+    applyGain(buffer, samplecount, gain);
+  } else {
+    // Always update peakMixerLevel_ regardless of whether we got data
+    // This ensures VU meters update properly in all scenarios
+    peakMixerLevel_ = 0;
+  }
 
   if (enableRendering_ && writer_.IsOpen()) {
     if (!gotData) {
@@ -15,6 +15,7 @@
 #include "Externals/etl/include/etl/string.h"
 #include "Externals/etl/include/etl/vector.h"
 #include "Services/Audio/AudioDriver.h" // for MAX_SAMPLE_COUNT
+#include "System/Profiler/AudioStageProfiler.h"
 #include "config/StringLimits.h"
 
 class AudioMixer : public AudioModule {
@@ -22,10 +23,13 @@ public:
   AudioMixer(const char *name);
   virtual ~AudioMixer();
   virtual bool Render(fixed *buffer, int samplecount);
+  virtual bool RenderDeferred(fixed *buffer, int samplecount, fixed &gain);
   void SetFileRenderer(const char *path);
   void EnableRendering(bool enable);
   void SetVolume(fixed volume);
   void SetName(etl::string<12> name) { name_ = name; };
+  // Stage the accumulation and volume of this mixer are timed as
+  void SetProfilingStage(AudioStage stage) { stage_ = stage; };
 
   stereosample GetMixerLevels() { return peakMixerLevel_; }
   void AddModule(AudioModule &module);
@@ -33,11 +37,16 @@ public:
   void ClearModules();
 
 private:
+  bool mix(fixed *buffer, int samplecount, fixed &gain);
+  void applyGain(fixed *buffer, int samplecount, fixed gain);
+  void updateLevels(fixed *buffer, int samplecount, fixed gain);
+
   bool enableRendering_;
   etl::string<STRING_AUDIO_RENDER_PATH_MAX> renderPath_;
   WavFileWriter writer_;
   fixed volume_;
   etl::string<12> name_;
+  AudioStage stage_;
   static constexpr size_t MaxModules = 10;
   etl::vector<AudioModule *, MaxModules> modules_;
 
@@ -17,6 +17,13 @@ class AudioModule {
 public:
   virtual ~AudioModule(){};
   virtual bool Render(fixed *buffer, int samplecount) = 0;
+
+  // Renders but may leave the module's output gain unapplied, returning it in
+  // gain so the caller can fold it into its own mixing pass
+  virtual bool RenderDeferred(fixed *buffer, int samplecount, fixed &gain) {
+    gain = FP_ONE;
+    return Render(buffer, samplecount);
+  };
 };
 
 #endif
@@ -44,6 +44,11 @@ public:
 
   virtual double GetStreamTime() = 0;
 
+  // Levels of the last buffer sent to the driver, absolute peak and RMS,
+  // left channel in the upper 16 bits
+  virtual stereosample GetLastPeakLevels() = 0;
+  virtual stereosample GetLastRmsLevels() = 0;
+
 protected:
   // write here the part that gets the float sample size
   // and computes accumulated integer count
@@ -8,10 +8,14 @@
  */
 
 #include "AudioOutDriver.h"
+#include "System/Profiler/AudioStageProfiler.h"
 #include "System/System/System.h"
 
+#ifdef __ARM_FEATURE_SAT
+#include <arm_acle.h>
+#endif
+
 fixed AudioOutDriver::primarySoundBuffer_[MIX_BUFFER_SIZE];
-short AudioOutDriver::mixBuffer_[MIX_BUFFER_SIZE];
 
 AudioOutDriver::AudioOutDriver(AudioDriver &driver) {
   driver_ = &driver;
@@ -43,11 +47,21 @@ void AudioOutDriver::SetAudioActive(bool active) {
 
 stereosample AudioOutDriver::GetLastPeakLevels() { return lastPeakVolume_; };
 
+stereosample AudioOutDriver::GetLastRmsLevels() { return lastRmsVolume_; };
+
 void AudioOutDriver::Trigger() {
   prepareMixBuffers();
   hasSound_ = AudioMixer::Render(primarySoundBuffer_, sampleCount_) > 0;
-  clipToMix();
-  driver_->AddBuffer(mixBuffer_, sampleCount_);
+
+  // clip straight into the driver's buffer
+  short *mixBuffer = driver_->AcquireBuffer(sampleCount_);
+  if (mixBuffer) {
+    {
+      AUDIO_STAGE_SCOPE(AUDIO_STAGE_CLIP);
+      clipToMix(mixBuffer);
+    }
+    driver_->CommitBuffer(sampleCount_);
+  }
 }
 
 void AudioOutDriver::Update(Observable &o, I_ObservableData *d) {
@@ -59,49 +73,81 @@ void AudioOutDriver::prepareMixBuffers() {
   sampleCount_ = getPlaySampleCount();
 };
 
-void AudioOutDriver::clipToMix() {
+// Saturates a mix sample to 16 bits instead of letting overs wrap around
+static inline int saturate16(int v) {
+#ifdef __ARM_FEATURE_SAT
+  return __ssat(v, 16);
+#else
+  return v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+#endif
+}
 
-  bool interlaced = driver_->Interlaced();
+static uint32_t isqrt(uint32_t v) {
+  uint32_t root = 0;
+  uint32_t bit = 1u << 30;
+  while (bit > v) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (v >= root + bit) {
+      v -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Single pass master stage: saturate, interleave into the driver buffer and
+// gather absolute peak and sum of squares of both channels
+void AudioOutDriver::clipToMix(short *mixBuffer) {
 
   if (!hasSound_) {
-    memset(mixBuffer_, 0, sampleCount_ * 2 * sizeof(short));
-  } else {
-    short *s1 = mixBuffer_;
-    short *s2 = (interlaced) ? s1 + 1 : s1 + sampleCount_;
-    int offset = (interlaced) ? 2 : 1;
-
-    fixed *p = primarySoundBuffer_;
-
-    fixed v;
-    fixed f_32767 = i2fp(32767);
-    fixed f_m32768 = i2fp(-32768);
-
-    short peakL = 0;
-    short peakR = 0;
-
-    for (int i = 0; i < sampleCount_; i++) {
-      // Left
-      v = *p++;
-      int iVal = fp2i(v);
-      *s1 = short(iVal);
-      s1 += offset;
-      if (iVal >= peakL) {
-        peakL = iVal;
-      }
-
-      // Right
-      v = *p++;
-      iVal = fp2i(v);
-      *s2 = short(iVal);
-      s2 += offset;
-      if (iVal >= peakR) {
-        peakR = iVal;
-      }
-    };
-    lastPeakVolume_ = peakL << 16;
-    lastPeakVolume_ += peakR;
-    peakL = peakR = 0;
+    memset(mixBuffer, 0, sampleCount_ * 2 * sizeof(short));
+    lastPeakVolume_ = 0;
+    lastRmsVolume_ = 0;
+    return;
   }
+
+  bool interlaced = driver_->Interlaced();
+  short *s1 = mixBuffer;
+  short *s2 = (interlaced) ? s1 + 1 : s1 + sampleCount_;
+  int offset = (interlaced) ? 2 : 1;
+
+  fixed *p = primarySoundBuffer_;
+
+  int peakL = 0;
+  int peakR = 0;
+  uint64_t sumL = 0;
+  uint64_t sumR = 0;
+
+  for (int i = 0; i < sampleCount_; i++) {
+    int l = saturate16(fp2i(p[0]));
+    int r = saturate16(fp2i(p[1]));
+    p += 2;
+    *s1 = short(l);
+    *s2 = short(r);
+    s1 += offset;
+    s2 += offset;
+
+    int al = l < 0 ? -l : l;
+    int ar = r < 0 ? -r : r;
+    peakL = al > peakL ? al : peakL;
+    peakR = ar > peakR ? ar : peakR;
+    sumL += uint32_t(l * l);
+    sumR += uint32_t(r * r);
+  };
+
+  // -32768 does not fit the 16 bits of a level
+  peakL = peakL > 32767 ? 32767 : peakL;
+  peakR = peakR > 32767 ? 32767 : peakR;
+  lastPeakVolume_ = (peakL << 16) | peakR;
+
+  uint32_t rmsL = isqrt(uint32_t(sumL / sampleCount_));
+  uint32_t rmsR = isqrt(uint32_t(sumR / sampleCount_));
+  lastRmsVolume_ = (rmsL << 16) | rmsR;
 };
 
 int AudioOutDriver::GetPlayedBufferPercentage() {
@@ -33,6 +33,7 @@ public:
   virtual void Trigger();
 
   virtual stereosample GetLastPeakLevels();
+  virtual stereosample GetLastRmsLevels();
 
   virtual int GetPlayedBufferPercentage();
 
@@ -50,22 +51,19 @@ protected:
 
   void prepareMixBuffers();
   void mixToPrimary();
-  void clipToMix();
+  void clipToMix(short *mixBuffer);
 
 private:
   AudioDriver *driver_;
   bool hasSound_ = false;
   stereosample lastPeakVolume_ = 0;
+  stereosample lastRmsVolume_ = 0;
 
 #ifndef PC_BUILD
   __attribute__((section(".DTCMRAM"))) 
 #endif
   __attribute__((
       aligned(32))) static fixed primarySoundBuffer_[MIX_BUFFER_SIZE];
-#ifndef PC_BUILD
-  __attribute__((section(".DTCMRAM")))
-#endif
-  __attribute__((aligned(32))) static short mixBuffer_[MIX_BUFFER_SIZE];
   int sampleCount_;
 };
 #endif
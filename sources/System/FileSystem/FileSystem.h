@@ -38,6 +38,17 @@ public:
   } // Default implementation
   virtual void list(etl::ivector<int> *fileIndexes, const char *filter,
                     bool subDirOnly) = 0;
+  // Lists the entries of the current directory from position first on, as
+  // many as fileIndexes holds, and returns how many match in total so that
+  // directories bigger than MAX_FILE_INDEX_SIZE can be paged through
+  virtual uint32_t listPage(etl::ivector<int> *fileIndexes, const char *filter,
+                            bool subDirOnly, uint32_t first) {
+    list(fileIndexes, filter, subDirOnly);
+    uint32_t total = fileIndexes->size();
+    fileIndexes->erase(fileIndexes->begin(),
+                       fileIndexes->begin() + (first < total ? first : total));
+    return total;
+  } // Default implementation
   virtual void getFileName(int index, char *name, int length) = 0;
   virtual PicoFileType getFileType(int index) = 0;
   virtual bool isParentRoot() = 0;
@@ -10,6 +10,8 @@
 #ifndef _I_FILE_H_
 #define _I_FILE_H_
 
+#include <stdint.h>
+
 struct FileCloser;
 class I_File;
 bool CloseFile_DO_NOT_USE(I_File *);
@@ -27,6 +29,9 @@ public:
   virtual int Error() = 0;
   virtual bool Sync() = 0;
   virtual void Dispose() = 0;
+  // FAT date in the high half and time in the low one, 0 when the file
+  // system doesn't keep them
+  virtual uint32_t GetModifyTime() { return 0; }
 
 protected:
   // Only the filesystem deleter and explicit legacy helpers may close files.
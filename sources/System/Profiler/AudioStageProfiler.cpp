@@ -0,0 +1,126 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#include "AudioStageProfiler.h"
+#include "System/Console/Trace.h"
+#include "System/System/System.h"
+#include <string.h>
+
+uint32_t AudioStageProfiler::deadline_ = 0;
+uint32_t AudioStageProfiler::bufferStart_ = 0;
+volatile bool AudioStageProfiler::resetRequested_ = false;
+uint32_t AudioStageProfiler::accumulated_[AUDIO_STAGE_COUNT];
+uint32_t AudioStageProfiler::histogram_[AUDIO_STAGE_COUNT]
+                                       [AUDIO_STAGE_BUCKET_COUNT];
+uint32_t AudioStageProfiler::max_[AUDIO_STAGE_COUNT];
+uint32_t AudioStageProfiler::maxPercent_[AUDIO_STAGE_COUNT];
+uint32_t AudioStageProfiler::overruns_[AUDIO_STAGE_COUNT];
+
+static const char *stageNames[AUDIO_STAGE_COUNT] = {
+    "buffer", "sequencer", "channel0", "channel1", "channel2", "channel3",
+    "channel4", "channel5", "channel6", "channel7", "bus0", "bus1", "bus2",
+    "bus3", "bus4", "bus5", "bus6", "bus7", "bus8", "bus9", "master", "clip"};
+
+void AudioStageProfiler::reset() {
+  memset(histogram_, 0, sizeof(histogram_));
+  memset(max_, 0, sizeof(max_));
+  memset(maxPercent_, 0, sizeof(maxPercent_));
+  memset(overruns_, 0, sizeof(overruns_));
+}
+
+void AudioStageProfiler::BeginBuffer(uint32_t deadlineMicros) {
+  // Resets are only ever performed from the audio thread so that the
+  // histograms keep a single writer
+  if (resetRequested_) {
+    reset();
+    resetRequested_ = false;
+  }
+  memset(accumulated_, 0, sizeof(accumulated_));
+  deadline_ = deadlineMicros;
+  bufferStart_ = System::GetInstance()->Micros();
+}
+
+void AudioStageProfiler::EndBuffer() {
+  if (deadline_ == 0) {
+    return;
+  }
+  accumulated_[AUDIO_STAGE_BUFFER] =
+      System::GetInstance()->Micros() - bufferStart_;
+
+  for (int i = 0; i < AUDIO_STAGE_COUNT; i++) {
+    uint32_t duration = accumulated_[i];
+    uint32_t bucket = duration * AUDIO_STAGE_BUCKETS_PER_DEADLINE / deadline_;
+    if (bucket >= AUDIO_STAGE_BUCKET_COUNT) {
+      bucket = AUDIO_STAGE_BUCKET_COUNT - 1;
+    }
+    histogram_[i][bucket]++;
+    if (duration > max_[i]) {
+      max_[i] = duration;
+      maxPercent_[i] = duration * 100 / deadline_;
+    }
+    if (duration > deadline_) {
+      overruns_[i]++;
+    }
+  }
+}
+
+// Upper bound of the bucket holding the given percentile, in percent of the
+// deadline
+static uint32_t percentile(const uint32_t *histogram, uint32_t count,
+                           uint32_t percent) {
+  uint32_t threshold = (count * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < AUDIO_STAGE_BUCKET_COUNT; i++) {
+    seen += histogram[i];
+    if (seen >= threshold) {
+      return (i + 1) * 100 / AUDIO_STAGE_BUCKETS_PER_DEADLINE;
+    }
+  }
+  return AUDIO_STAGE_BUCKET_COUNT * 100 / AUDIO_STAGE_BUCKETS_PER_DEADLINE;
+}
+
+void AudioStageProfiler::GetStats(AudioStage stage, AudioStageStats &stats) {
+  // Take a copy so the percentiles are computed over a consistent histogram
+  // even if the audio thread updates it meanwhile
+  uint32_t histogram[AUDIO_STAGE_BUCKET_COUNT];
+  memcpy(histogram, histogram_[stage], sizeof(histogram));
+
+  stats.count = 0;
+  for (int i = 0; i < AUDIO_STAGE_BUCKET_COUNT; i++) {
+    stats.count += histogram[i];
+  }
+  stats.p50 = stats.count ? percentile(histogram, stats.count, 50) : 0;
+  stats.p99 = stats.count ? percentile(histogram, stats.count, 99) : 0;
+  stats.maxMicros = max_[stage];
+  stats.maxPercent = maxPercent_[stage];
+  stats.overruns = overruns_[stage];
+}
+
+const char *AudioStageProfiler::GetStageName(AudioStage stage) {
+  return stageNames[stage];
+}
+
+void AudioStageProfiler::Dump() {
+  Trace::Log("AUDIOPROF", "deadline=%lu us", (unsigned long)deadline_);
+  for (int i = 0; i < AUDIO_STAGE_COUNT; i++) {
+    AudioStageStats stats;
+    GetStats(AudioStage(i), stats);
+    Trace::Log("AUDIOPROF",
+               "%-10s p50<=%3lu%% p99<=%3lu%% max=%5lu us (%3lu%%) over=%lu",
+               stageNames[i], (unsigned long)stats.p50,
+               (unsigned long)stats.p99, (unsigned long)stats.maxMicros,
+               (unsigned long)stats.maxPercent, (unsigned long)stats.overruns);
+  }
+}
+
+AudioStageScope::AudioStageScope(AudioStage stage)
+    : stage_(stage), start_(System::GetInstance()->Micros()) {}
+
+AudioStageScope::~AudioStageScope() {
+  AudioStageProfiler::Add(stage_, System::GetInstance()->Micros() - start_);
+}
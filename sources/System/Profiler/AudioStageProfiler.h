@@ -0,0 +1,114 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+#ifndef _AUDIO_STAGE_PROFILER_H_
+#define _AUDIO_STAGE_PROFILER_H_
+
+#include <cstdint>
+
+// Per stage CPU budget instrumentation of the audio thread. Every stage
+// accumulates its time over one audio buffer and at the end of the buffer the
+// totals are binned into a histogram relative to the buffer deadline (the time
+// it takes to play the buffer). Only the audio thread writes, readers only
+// ever look at the counters so there is no locking and no allocation.
+// Compiled out unless AUDIO_STAGE_PROFILING is defined.
+
+enum AudioStage {
+  AUDIO_STAGE_BUFFER = 0, // whole buffer, including waiting for the mixer lock
+  AUDIO_STAGE_SEQUENCER,  // Player::Update
+  AUDIO_STAGE_CHANNEL0,   // PlayerChannel::Render, one per song channel
+  AUDIO_STAGE_CHANNEL1,
+  AUDIO_STAGE_CHANNEL2,
+  AUDIO_STAGE_CHANNEL3,
+  AUDIO_STAGE_CHANNEL4,
+  AUDIO_STAGE_CHANNEL5,
+  AUDIO_STAGE_CHANNEL6,
+  AUDIO_STAGE_CHANNEL7,
+  AUDIO_STAGE_BUS0,     // AudioMixer::Render accumulate & volume, one per
+  AUDIO_STAGE_BUS1,     // mix bus of the MixerService
+  AUDIO_STAGE_BUS2,
+  AUDIO_STAGE_BUS3,
+  AUDIO_STAGE_BUS4,
+  AUDIO_STAGE_BUS5,
+  AUDIO_STAGE_BUS6,
+  AUDIO_STAGE_BUS7,
+  AUDIO_STAGE_BUS8,
+  AUDIO_STAGE_BUS9,
+  AUDIO_STAGE_MASTER, // the same for the master bus and the output
+  AUDIO_STAGE_CLIP,   // AudioOutDriver::clipToMix
+  AUDIO_STAGE_COUNT
+};
+
+// Histogram buckets are 1/16th of the buffer deadline wide, the last one
+// collects everything from 2x the deadline upwards
+#define AUDIO_STAGE_BUCKETS_PER_DEADLINE 16
+#define AUDIO_STAGE_BUCKET_COUNT (AUDIO_STAGE_BUCKETS_PER_DEADLINE * 2)
+
+struct AudioStageStats {
+  uint32_t count;     // buffers measured
+  uint32_t p50;       // percent of deadline (bucket upper bound)
+  uint32_t p99;       // percent of deadline (bucket upper bound)
+  uint32_t maxMicros; // worst buffer
+  uint32_t maxPercent;
+  uint32_t overruns; // buffers over the deadline
+};
+
+class AudioStageProfiler {
+public:
+  // Audio thread side, deadline is the play time of the upcoming buffer
+  static void BeginBuffer(uint32_t deadlineMicros);
+  static void EndBuffer();
+  static void Add(AudioStage stage, uint32_t micros) {
+    accumulated_[stage] += micros;
+  }
+
+  // Reader side
+  static void GetStats(AudioStage stage, AudioStageStats &stats);
+  static const char *GetStageName(AudioStage stage);
+  static uint32_t GetDeadlineMicros() { return deadline_; }
+  static void RequestReset() { resetRequested_ = true; }
+  static void Dump();
+
+private:
+  static void reset();
+
+  static uint32_t deadline_;
+  static uint32_t bufferStart_;
+  static volatile bool resetRequested_;
+  static uint32_t accumulated_[AUDIO_STAGE_COUNT];
+  static uint32_t histogram_[AUDIO_STAGE_COUNT][AUDIO_STAGE_BUCKET_COUNT];
+  static uint32_t max_[AUDIO_STAGE_COUNT];
+  static uint32_t maxPercent_[AUDIO_STAGE_COUNT];
+  static uint32_t overruns_[AUDIO_STAGE_COUNT];
+};
+
+class AudioStageScope {
+public:
+  AudioStageScope(AudioStage stage);
+  ~AudioStageScope();
+
+private:
+  AudioStage stage_;
+  uint32_t start_;
+};
+
+#ifdef AUDIO_STAGE_PROFILING
+#define AUDIO_STAGE_CONCAT_(a, b) a##b
+#define AUDIO_STAGE_CONCAT(a, b) AUDIO_STAGE_CONCAT_(a, b)
+#define AUDIO_STAGE_SCOPE(stage)                                               \
+  AudioStageScope AUDIO_STAGE_CONCAT(audioStage_, __LINE__)(stage)
+#define AUDIO_STAGE_BEGIN_BUFFER(deadline)                                     \
+  AudioStageProfiler::BeginBuffer(deadline)
+#define AUDIO_STAGE_END_BUFFER() AudioStageProfiler::EndBuffer()
+#else
+#define AUDIO_STAGE_SCOPE(stage)
+#define AUDIO_STAGE_BEGIN_BUFFER(deadline)
+#define AUDIO_STAGE_END_BUFFER()
+#endif
+
+#endif
@@ -3,7 +3,8 @@
 
 // Helper function for byte escaping.
 static uint16_t addByteEscaped(char *buffer, uint16_t bufferIndex, char byte) {
-  if (byte == REMOTE_UI_CMD_MARKER || byte == REMOTE_UI_ESC_CHAR) {
+  uint8_t value = byte; // char may be signed
+  if (value == REMOTE_UI_CMD_MARKER || value == REMOTE_UI_ESC_CHAR) {
     buffer[bufferIndex++] = REMOTE_UI_ESC_CHAR;
     buffer[bufferIndex++] = byte ^ REMOTE_UI_ESC_XOR;
   } else {
@@ -68,3 +69,43 @@ uint16_t remoteUISetColorCommand(unsigned short r, unsigned short g,
   bufferIndex = addByteEscaped(buffer, bufferIndex, b);
   return bufferIndex;
 }
+
+uint16_t remoteUITextRunCommand(uint8_t x, uint8_t y, bool invert,
+                                unsigned short r, unsigned short g,
+                                unsigned short b, const char *chars,
+                                uint8_t length, char *buffer) {
+  uint16_t bufferIndex = 0;
+  buffer[bufferIndex++] = REMOTE_UI_CMD_MARKER;
+  buffer[bufferIndex++] = TEXT_RUN_CMD;
+  bufferIndex = addByteEscaped(buffer, bufferIndex, x + ASCII_SPACE_OFFSET);
+  bufferIndex = addByteEscaped(buffer, bufferIndex, y + ASCII_SPACE_OFFSET);
+  bufferIndex = addByteEscaped(buffer, bufferIndex, invert ? INVERT_ON : 0);
+  bufferIndex = addByteEscaped(buffer, bufferIndex, r);
+  bufferIndex = addByteEscaped(buffer, bufferIndex, g);
+  bufferIndex = addByteEscaped(buffer, bufferIndex, b);
+  bufferIndex =
+      addByteEscaped(buffer, bufferIndex, length + ASCII_SPACE_OFFSET);
+  for (uint8_t i = 0; i < length; i++) {
+    bufferIndex = addByteEscaped(buffer, bufferIndex, chars[i]);
+  }
+  return bufferIndex;
+}
+
+uint16_t remoteUIFrameBeginCommand(char *buffer) {
+  buffer[0] = REMOTE_UI_CMD_MARKER;
+  buffer[1] = FRAME_BEGIN_CMD;
+  return 2;
+}
+
+uint16_t remoteUIFrameEndCommand(char *buffer) {
+  buffer[0] = REMOTE_UI_CMD_MARKER;
+  buffer[1] = FRAME_END_CMD;
+  return 2;
+}
+
+uint16_t remoteUIVersionCommand(uint8_t version, char *buffer) {
+  buffer[0] = REMOTE_UI_CMD_MARKER;
+  buffer[1] = VERSION_CMD;
+  buffer[2] = version + ASCII_SPACE_OFFSET;
+  return 3;
+}
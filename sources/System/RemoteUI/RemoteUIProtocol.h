@@ -26,6 +26,15 @@
 // REMOTE_UI_CMD_MARKER and also verify the expected byte count length of each
 // command received to check for any transmission errors.
 //
+// Version 2 of the protocol sends the changed characters of a screen update
+// as runs of consecutive characters of a row sharing colour and invert, and
+// sends all the commands of an update, between a frame begin and a frame end
+// marker, in a single USB transfer. Clients ask for it by sending a
+// PROTOCOL_VERSION_CMD with the highest version they support. The device
+// answers with a VERSION_CMD with the version it will use from then on, and
+// devices that don't know the command don't answer, so clients stay on
+// version 1 until they get the answer.
+//
 
 #include "UIFramework/BasicDatas/GUIEvent.h"
 #include <cstdint>
@@ -35,18 +44,30 @@
 #define REMOTE_UI_ESC_CHAR 0xFD
 #define REMOTE_UI_ESC_XOR 0x20
 
+#define REMOTE_UI_PROTOCOL_VERSION 2
+// Characters a text run holds at most, longer rows get split
+#define REMOTE_UI_MAX_RUN_LENGTH 64
+// Worst case size of a text run command, every byte but the header escaped
+#define REMOTE_UI_MAX_RUN_COMMAND_SIZE (2 + 2 * (7 + REMOTE_UI_MAX_RUN_LENGTH))
+
 enum RemoteUICommand {
   REMOTE_UI_CMD_MARKER = 0xFE,
   TEXT_CMD = 0x02,
   CLEAR_CMD = 0x03,
   SETCOLOR_CMD = 0x04,
   SETFONT_CMD = 0x05,
-  DRAWRECT_CMD = 0x06
+  DRAWRECT_CMD = 0x06,
+  // version 2
+  TEXT_RUN_CMD = 0x07,
+  FRAME_BEGIN_CMD = 0x08,
+  FRAME_END_CMD = 0x09,
+  VERSION_CMD = 0x0A
 };
 
 enum RemoteInputCommand {
   REMOTE_INPUT_CMD_MARKER = 0xFE,
   FULL_REFRESH_CMD = 0x02,
+  PROTOCOL_VERSION_CMD = 0x03, // followed by the version byte
 };
 
 // classic picotracker mapping
@@ -82,4 +103,18 @@ void remoteUIClearCommand(unsigned short r, unsigned short g, unsigned short b,
 uint16_t remoteUISetColorCommand(unsigned short r, unsigned short g,
                                  unsigned short b, char *buffer);
 
+// Version 2 commands, they return the number of bytes written to buffer
+
+// x, y, invert, r, g, b, length then the characters, all escaped
+uint16_t remoteUITextRunCommand(uint8_t x, uint8_t y, bool invert,
+                                unsigned short r, unsigned short g,
+                                unsigned short b, const char *chars,
+                                uint8_t length, char *buffer);
+
+uint16_t remoteUIFrameBeginCommand(char *buffer);
+
+uint16_t remoteUIFrameEndCommand(char *buffer);
+
+uint16_t remoteUIVersionCommand(uint8_t version, char *buffer);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,117 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+// Walks the buffer pool of AudioDriver through the hand over between the
+// mixer (AcquireBuffer / CommitBuffer) and the driver interrupt
+// (nextPlayBuffer), with numbered buffers to check that they play in order
+// and that none gets lost, through start up, wraparound, underruns and
+// overruns.
+
+#include "Services/Audio/AudioDriver.h"
+#include <stdio.h>
+
+#define TEST_FRAMES 128
+#define BLANK -1
+
+class TestAudioDriver : public AudioDriver {
+public:
+  TestAudioDriver(AudioSettings &settings) : AudioDriver(settings) {}
+
+  virtual bool InitDriver() { return true; }
+  virtual void CloseDriver() {}
+  virtual bool StartDriver() { return true; }
+  virtual void StopDriver() {}
+  virtual bool Interlaced() { return true; }
+  virtual int GetPlayedBufferPercentage() { return 0; }
+  virtual double GetStreamTime() { return 0; }
+
+  // What the interrupt at the end of a transfer does, returns the number of
+  // the buffer that plays next or BLANK
+  int ChunkDone() {
+    AudioBufferData *next = nextPlayBuffer();
+    return next ? ((short *)next->buffer_)[0] : BLANK;
+  }
+
+  int QueuePosition() { return poolQueuePosition_; }
+};
+
+// What the mixer does for a buffer, false on overrun
+static bool produce(TestAudioDriver &driver, short number) {
+  short *buffer = driver.AcquireBuffer(TEST_FRAMES);
+  if (!buffer) {
+    return false;
+  }
+  for (int i = 0; i < TEST_FRAMES * 2; i++) {
+    buffer[i] = number;
+  }
+  driver.CommitBuffer(TEST_FRAMES);
+  return true;
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+  if (!condition) {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+int main() {
+  AudioSettings settings;
+  TestAudioDriver driver(settings);
+  driver.Init();
+
+  check(!driver.AcquireBuffer(TEST_FRAMES), "acquire before start");
+
+  // Start up: the driver plays blank while the mixer prepares the first
+  // buffer, which plays next
+  driver.Start();
+  check(driver.ChunkDone() == BLANK, "blank before the first buffer");
+  check(produce(driver, 1), "first buffer");
+  check(driver.ChunkDone() == 1, "first buffer plays first");
+
+  // Steady state, each interrupt lets the mixer prepare one buffer while the
+  // previous one plays. Goes around the pool many times
+  short number = 2;
+  for (int i = 0; i < 10 * SOUND_BUFFER_COUNT; i++, number++) {
+    check(produce(driver, number), "steady state produce");
+    check(driver.ChunkDone() == number, "steady state order");
+  }
+
+  // Underrun: the mixer is late, the driver plays blank until it catches up
+  // and then carries on with the buffer it was waiting for
+  check(driver.ChunkDone() == BLANK, "underrun plays blank");
+  check(driver.ChunkDone() == BLANK, "underrun keeps playing blank");
+  check(produce(driver, number), "produce after underrun");
+  check(driver.ChunkDone() == number, "underrun resumes in order");
+  number++;
+
+  // Overrun: the mixer gets ahead of the driver and finds the buffer that
+  // still plays. Nothing gets committed and the buffer that is queued plays
+  // as it should
+  check(produce(driver, number), "fill the pool");
+  int position = driver.QueuePosition();
+  check(!produce(driver, number + 1), "overrun refuses the buffer");
+  check(driver.QueuePosition() == position, "overrun leaves the queue");
+  check(driver.ChunkDone() == number, "queued buffer plays after overrun");
+  number++;
+  check(produce(driver, number), "produce after overrun");
+  check(driver.ChunkDone() == number, "order after overrun");
+
+  // A restart begins with a blank again
+  driver.Stop();
+  check(!driver.AcquireBuffer(TEST_FRAMES), "acquire after stop");
+  driver.Init();
+  driver.Start();
+  check(produce(driver, 100), "first buffer after restart");
+  check(driver.ChunkDone() == 100, "first buffer plays after restart");
+
+  printf("Audio driver pool: %d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
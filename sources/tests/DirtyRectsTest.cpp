@@ -0,0 +1,155 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+// Feeds grids of changed cells to the rectangle batching of the picoTracker
+// display, random ones of various densities and a few patterns, and checks
+// that the rectangles cover every changed cell exactly once and nothing else.
+
+#include "Adapters/picoTracker/display/dirty_rects.h"
+#include <stdio.h>
+#include <string.h>
+
+// Same grid as the display
+#define TEST_WIDTH 32
+#define TEST_HEIGHT 24
+#define TEST_GRIDS 500
+
+static uint8_t changed[TEST_WIDTH * TEST_HEIGHT / 8];
+static int covered[TEST_HEIGHT][TEST_WIDTH];
+static int rects = 0;
+static bool outside = false;
+
+static void draw(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+  rects++;
+  if (width == 0 || height == 0 || x + width > TEST_WIDTH ||
+      y + height > TEST_HEIGHT) {
+    outside = true;
+    return;
+  }
+  for (int j = y; j < y + height; j++) {
+    for (int i = x; i < x + width; i++) {
+      covered[j][i]++;
+    }
+  }
+}
+
+static bool isChanged(int x, int y) {
+  int k = y * TEST_WIDTH + x;
+  return changed[k / 8] & (1 << (k % 8));
+}
+
+static void setChanged(int x, int y) {
+  int k = y * TEST_WIDTH + x;
+  changed[k / 8] |= 1 << (k % 8);
+}
+
+static int failures = 0;
+
+// Draws the grid in changed, false if a cell isn't covered as it should
+static bool checkGrid(const char *what) {
+  memset(covered, 0, sizeof(covered));
+  rects = 0;
+  outside = false;
+  dirty_rects_draw(changed, TEST_WIDTH, TEST_HEIGHT, draw);
+  if (outside) {
+    printf("FAIL %s: rectangle out of the grid\n", what);
+    failures++;
+    return false;
+  }
+  for (int y = 0; y < TEST_HEIGHT; y++) {
+    for (int x = 0; x < TEST_WIDTH; x++) {
+      int expected = isChanged(x, y) ? 1 : 0;
+      if (covered[y][x] != expected) {
+        printf("FAIL %s: cell %d,%d covered %d times, expected %d\n", what, x,
+               y, covered[y][x], expected);
+        failures++;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom(uint32_t range) {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) % range;
+}
+
+int main() {
+  memset(changed, 0, sizeof(changed));
+  checkGrid("empty");
+  if (rects != 0) {
+    printf("FAIL empty: %d rectangles\n", rects);
+    failures++;
+  }
+
+  memset(changed, 0xFF, sizeof(changed));
+  checkGrid("full");
+  if (rects != 1) {
+    printf("FAIL full: %d rectangles, expected 1\n", rects);
+    failures++;
+  }
+
+  memset(changed, 0, sizeof(changed));
+  for (int y = 0; y < TEST_HEIGHT; y++) {
+    for (int x = 0; x < TEST_WIDTH; x++) {
+      if ((x + y) % 2 == 0) {
+        setChanged(x, y);
+      }
+    }
+  }
+  checkGrid("checkerboard");
+
+  // A text line and a column, as the cursor and a scrolled list leave them
+  memset(changed, 0, sizeof(changed));
+  for (int x = 2; x < 20; x++) {
+    setChanged(x, 5);
+  }
+  for (int y = 3; y < TEST_HEIGHT; y++) {
+    setChanged(30, y);
+  }
+  checkGrid("line and column");
+  if (rects != 2) {
+    printf("FAIL line and column: %d rectangles, expected 2\n", rects);
+    failures++;
+  }
+
+  // Random cells from sparse to dense, and random rectangles on top
+  for (int grid = 0; grid < TEST_GRIDS; grid++) {
+    memset(changed, 0, sizeof(changed));
+    uint32_t density = 1 + grid % 100;
+    for (int y = 0; y < TEST_HEIGHT; y++) {
+      for (int x = 0; x < TEST_WIDTH; x++) {
+        if (nextRandom(100) < density) {
+          setChanged(x, y);
+        }
+      }
+    }
+    for (int blocks = nextRandom(4); blocks > 0; blocks--) {
+      int x0 = nextRandom(TEST_WIDTH);
+      int y0 = nextRandom(TEST_HEIGHT);
+      int x1 = x0 + nextRandom(TEST_WIDTH - x0);
+      int y1 = y0 + nextRandom(TEST_HEIGHT - y0);
+      for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+          setChanged(x, y);
+        }
+      }
+    }
+    char what[32];
+    snprintf(what, sizeof(what), "random grid %d", grid);
+    if (!checkGrid(what)) {
+      break;
+    }
+  }
+
+  printf("Dirty rectangles: %d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
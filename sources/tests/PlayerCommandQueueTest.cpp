@@ -0,0 +1,111 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+// Runs a producer and a consumer thread over a PlayerCommandQueue, as the UI
+// and the audio thread do. Commands carry a sequence number spread over all
+// their fields, the consumer checks that they come out in order, whole, and
+// that none gets lost or duplicated while the queue keeps filling up and
+// running dry.
+
+#include "Application/Player/PlayerCommandQueue.h"
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+
+#define TEST_COMMAND_COUNT 2000000
+
+static PlayerCommand makeCommand(uint32_t sequence) {
+  PlayerCommand command;
+  command.type = uint8_t(sequence % (PCT_RETRIGGER + 1));
+  command.channel = uint8_t(sequence);
+  command.value = uint8_t(sequence >> 8);
+  command.position = uint8_t(sequence >> 16);
+  command.chainPos = uint8_t(sequence >> 24);
+  command.instrument = uint16_t(~sequence);
+  return command;
+}
+
+static bool sameCommand(const PlayerCommand &a, const PlayerCommand &b) {
+  return a.type == b.type && a.channel == b.channel && a.value == b.value &&
+         a.position == b.position && a.chainPos == b.chainPos &&
+         a.instrument == b.instrument;
+}
+
+static PlayerCommandQueue queue;
+
+int main() {
+  int failures = 0;
+
+  // Single threaded: fills up, refuses, drains in order
+  for (uint32_t i = 0; i < PLAYER_COMMAND_QUEUE_SIZE; i++) {
+    if (!queue.Push(makeCommand(i))) {
+      printf("FAIL push %u of an empty queue\n", i);
+      failures++;
+    }
+  }
+  if (queue.Push(makeCommand(PLAYER_COMMAND_QUEUE_SIZE)) ||
+      queue.GetFullCount() != 1) {
+    printf("FAIL full queue takes a command\n");
+    failures++;
+  }
+  PlayerCommand command;
+  for (uint32_t i = 0; i < PLAYER_COMMAND_QUEUE_SIZE; i++) {
+    if (!queue.Pop(command) || !sameCommand(command, makeCommand(i))) {
+      printf("FAIL pop %u out of order\n", i);
+      failures++;
+    }
+  }
+  if (queue.Pop(command)) {
+    printf("FAIL empty queue gives a command\n");
+    failures++;
+  }
+
+  // Concurrent: the sequence carries on from where the above left off, so
+  // that the indexes wrap around the ring at every position
+  const uint32_t first = PLAYER_COMMAND_QUEUE_SIZE;
+  const uint32_t last = first + TEST_COMMAND_COUNT;
+  uint32_t received = first;
+  // the producer gives up once the consumer has, instead of waiting forever
+  std::atomic<bool> ordered(true);
+  std::thread consumer([&]() {
+    PlayerCommand popped;
+    while (received < last) {
+      if (!queue.Pop(popped)) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (!sameCommand(popped, makeCommand(received))) {
+        ordered = false;
+        return;
+      }
+      received++;
+    }
+  });
+  for (uint32_t sent = first; sent < last && ordered;) {
+    if (queue.Push(makeCommand(sent))) {
+      sent++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  consumer.join();
+
+  if (!ordered) {
+    printf("FAIL command %u out of order or torn\n", received);
+    failures++;
+  } else if (received != last || queue.Pop(command)) {
+    printf("FAIL %u of %u commands received\n", received - first,
+           TEST_COMMAND_COUNT);
+    failures++;
+  }
+
+  printf("Player command queue: %u commands, queue full %u times, "
+         "%d failure(s)\n",
+         TEST_COMMAND_COUNT, queue.GetFullCount(), failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+// Renders synthetic samples through renderSampleSegments(), the rendering
+// loop of SampleInstrument::renderVoice(), and compares a checksum of the
+// output with the one of a known good build. A mismatch means the rendering
+// of the sample instrument changed, on purpose or not: references only get
+// updated along with a change that is meant to alter the output.
+//
+// The references of the cases with constant parameters come from the per
+// sample loop of the original renderer, which the segments have to match
+// bit for bit. Sweeps and fades glide across k-rate blocks, which the
+// original renderer didn't, theirs come from the build that introduced it.
+
+#include "Application/Instruments/SampleRenderKernels.h"
+#include "Application/Instruments/SampleInstrumentDatas.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_SAMPLE_FRAMES 1024
+#define TEST_BUFFER_FRAMES 300 // not a multiple of KRATE_SAMPLE_COUNT
+#define TEST_BUFFER_COUNT 8
+// k-rate blocks a fade takes to reach silence, the voice is skipped after
+#define TEST_FADE_BLOCKS 4
+
+// How volume, pan and cutoff move from one k-rate block to the next
+enum KRateShape {
+  KS_CONSTANT,
+  KS_SWEEP,
+  KS_FADE, // volume glides to 0 over a few blocks and stays there
+};
+
+struct KernelCase {
+  const char *name;
+  int channels;
+  SampleInstrumentLoopMode loopMode;
+  int loopStart;
+  int loopEnd;
+  float position;
+  float speed;
+  bool reverse;
+  bool linear;
+  int cutoff; // 0-255, filtering below 255 or with resonance
+  int reso;
+  bool filterBoost;
+  int crush; // bits
+  int drive;
+  int downsample;
+  KRateShape shape;
+  uint32_t checksum;
+};
+
+static const KernelCase cases[] = {
+    {"mono oneshot", 1, SILM_ONESHOT, 0, 1000, 0.0f, 1.0f, false, true, 255, 0,
+     false, 16, 255, 0, KS_CONSTANT, 0xEBEAED85},
+    {"mono loop nearest", 1, SILM_LOOP, 200, 1000, 0.0f, 1.37f, false, false,
+     255, 0, false, 16, 255, 0, KS_CONSTANT, 0x951433D1},
+    {"stereo loop linear", 2, SILM_LOOP, 200, 1000, 0.0f, 0.71f, false, true,
+     255, 0, false, 16, 255, 0, KS_CONSTANT, 0x79A69CF4},
+    {"mono pingpong", 1, SILM_LOOP_PINGPONG, 500, 1000, 0.0f, 2.13f, false,
+     true, 255, 0, false, 16, 255, 0, KS_CONSTANT, 0x70FC997D},
+    {"stereo pingpong", 2, SILM_LOOP_PINGPONG, 500, 1000, 0.0f, 1.5f, false,
+     true, 255, 0, false, 16, 255, 0, KS_CONSTANT, 0x3AEDF2A8},
+    {"mono reverse loop", 1, SILM_LOOP, 800, 100, 900.0f, 1.2f, true, true,
+     255, 0, false, 16, 255, 0, KS_CONSTANT, 0xBE2D67D1},
+    {"mono filter", 1, SILM_LOOP, 200, 1000, 0.0f, 1.0f, false, true, 96, 180,
+     false, 16, 255, 0, KS_CONSTANT, 0x5A2273A9},
+    {"stereo filter scream", 2, SILM_LOOP, 200, 1000, 0.0f, 1.0f, false, true,
+     64, 220, true, 16, 255, 0, KS_CONSTANT, 0x286FDFDD},
+    {"mono crush", 1, SILM_LOOP, 200, 1000, 0.0f, 0.9f, false, true, 255, 0,
+     false, 4, 200, 0, KS_CONSTANT, 0x1B554829},
+    {"stereo downsample", 2, SILM_LOOP, 200, 1000, 0.0f, 1.1f, false, true,
+     255, 0, false, 16, 255, 3, KS_CONSTANT, 0x682BADD5},
+    {"stereo everything", 2, SILM_LOOP_PINGPONG, 300, 1000, 0.0f, 1.7f, false,
+     true, 128, 128, false, 6, 180, 2, KS_CONSTANT, 0xA1F041A2},
+    {"mono sweep", 1, SILM_LOOP, 200, 1000, 0.0f, 1.0f, false, true, 255, 0,
+     false, 16, 255, 0, KS_SWEEP, 0x146050D2},
+    {"stereo filter sweep", 2, SILM_LOOP, 200, 1000, 0.0f, 1.0f, false, true,
+     160, 100, false, 16, 255, 0, KS_SWEEP, 0xC99F01E6},
+    {"mono fade", 1, SILM_LOOP, 200, 1000, 0.0f, 1.0f, false, true, 255, 0,
+     false, 16, 255, 0, KS_FADE, 0x9ACC5181},
+};
+
+static short sample[TEST_SAMPLE_FRAMES * 2];
+static fixed buffer[TEST_BUFFER_FRAMES * 2];
+static renderParams rp;
+
+// Deterministic input, a triangle with some noise on top
+static void makeSample(int channels) {
+  uint32_t seed = 12345;
+  for (int i = 0; i < TEST_SAMPLE_FRAMES * channels; i++) {
+    seed = seed * 1103515245 + 12345;
+    int frame = i / channels;
+    int triangle = ((frame % 64) < 32 ? frame % 32 : 31 - frame % 32) * 1800;
+    int noise = int((seed >> 16) & 0x1FFF) - 0x1000;
+    sample[i] = short(triangle - 28000 + noise + (i % channels) * 500);
+  }
+}
+
+// Volume (0-255), pan (0-254) and cutoff (0-255) of a k-rate block
+static void blockTargets(const KernelCase &c, int block, int &volume,
+                         int &pan, int &cutoff) {
+  volume = 200;
+  pan = 127;
+  cutoff = c.cutoff;
+  switch (c.shape) {
+  case KS_CONSTANT:
+    break;
+  case KS_SWEEP:
+    volume = (block * 37) % 256;
+    pan = (block * 53) % 255;
+    if (c.cutoff < 255) {
+      cutoff = 32 + (block * 29) % 224;
+    }
+    break;
+  case KS_FADE:
+    volume = std::max(0, 190 - block * 70);
+    break;
+  }
+}
+
+static uint32_t checksum(uint32_t sum, const fixed *data, int count) {
+  for (int i = 0; i < count; i++) {
+    uint32_t value = uint32_t(data[i]);
+    for (int byte = 0; byte < 4; byte++) {
+      sum = (sum ^ ((value >> (byte * 8)) & 0xFF)) * 16777619u;
+    }
+  }
+  return sum;
+}
+
+// Renders a resident voice buffer by buffer, setting it up the way
+// renderVoice() does. skipped counts the frames that went through
+// skipSampleFrames()
+
+static uint32_t renderCase(const KernelCase &c, int &skipped) {
+  makeSample(c.channels);
+
+  rp.sampleBuffer_ = sample;
+  rp.channelCount_ = c.channels;
+  rp.position_ = c.position;
+  rp.rendFirst_ = 0;
+  rp.rendLoopStart_ = c.loopStart;
+  rp.rendLoopEnd_ = c.loopEnd;
+  rp.speed_ = fl2fp(c.speed);
+  rp.reverse_ = c.reverse;
+  rp.finished_ = false;
+  rp.krateCount_ = 0;
+  rp.krateJump_ = true;
+
+  filter_t *flt = get_filter(0);
+  memset(flt->height, 0, sizeof(flt->height));
+  memset(flt->speed, 0, sizeof(flt->speed));
+  memset(flt->hipdelay, 0, sizeof(flt->hipdelay));
+
+  const fixed volscale = fl2fp(0.003921568627450980392156862745098f);
+  const fixed reso = fl2fp(c.reso / 255.0f);
+  int block = 0;
+  int cutoff = c.cutoff;
+  uint32_t sum = 2166136261u;
+  skipped = 0;
+
+  for (int b = 0; b < TEST_BUFFER_COUNT && !rp.finished_; b++) {
+    memset(buffer, 0, sizeof(buffer));
+
+    set_filter(0, FLT_LOWPASS, fl2fp(cutoff / 255.0f), reso, 0, false);
+    bool filtering = (cutoff < 255) || (c.reso > 0);
+
+    SampleRenderState state;
+    state.rp = &rp;
+    int shift = 16 - c.crush;
+    fixed mask = 0xFFFFFFFF;
+    if (shift != 0) {
+      mask <<= FIXED_SHIFT + shift;
+    }
+    state.mask = mask;
+    state.crushvol = fl2fp(c.drive / 255.0F);
+    bool crushing = (mask != fixed(0xFFFFFFFF)) || (state.crushvol != FP_ONE);
+    state.dsMask = 0xFFFFFFFF << c.downsample;
+    state.dirtyDownsampling = false;
+    bool downsampling = (state.dsMask != 0xFFFFFFFF);
+    state.loopMode = c.loopMode;
+
+    short *wavbuf = sample;
+    state.volfactor = rp.krateVolume_;
+    state.panl = rp.kratePanL_;
+    state.panr = rp.kratePanR_;
+    state.fltParm1 = rp.krateFreq_;
+
+    int n = int(rp.position_);
+    state.channelCount = c.channels;
+    state.input = wavbuf + c.channels * n;
+    state.fpPos = fl2fp(rp.position_ - n);
+    state.fpSpeed = rp.reverse_ ? -rp.speed_ : rp.speed_;
+    state.reverse = rp.reverse_;
+    state.loopPosition = wavbuf + rp.rendLoopStart_ * c.channels;
+    state.lastSample = wavbuf + (rp.rendLoopEnd_ - 1) * c.channels;
+    if (rp.reverse_) {
+      state.lastSample = wavbuf + rp.rendLoopEnd_ * c.channels;
+    }
+    state.dsBasePtr = wavbuf + rp.rendFirst_ * c.channels;
+    state.flt = flt;
+    state.fltMix = flt->mix;
+    state.fltParm2 = flt->reso;
+    state.fltDirt = flt->dirt;
+    state.filterBoost = c.filterBoost;
+
+    bool linear = c.linear;
+    SampleRenderKernel kernel = selectSampleRenderKernel(
+        state, false, linear, filtering, crushing, downsampling);
+    int rpKrateCount = rp.krateCount_;
+
+    // k-rate blocks follow the shape of the case instead of updaters
+    auto advance = [&]() {
+      return !wrapPlayHead(state, state.input, state.reverse, state.fpSpeed);
+    };
+    auto startBlock = [&]() {
+      int volume, pan;
+      blockTargets(c, block++, volume, pan, cutoff);
+      set_filter(0, FLT_LOWPASS, fl2fp(cutoff / 255.0f), reso, 0, false);
+      filtering = (cutoff < 255) || (c.reso > 0);
+      state.fltParm2 = flt->reso;
+      state.fltDirt = flt->dirt;
+
+      fixed volfactor = fp_mul(i2fp(volume), volscale);
+      if (rp.krateJump_) {
+        rp.krateJump_ = false;
+        state.volfactor.Jump(volfactor);
+        state.panl.Jump(panlaw[pan]);
+        state.panr.Jump(panlaw[254 - pan]);
+        state.fltParm1.Jump(flt->freq);
+      } else {
+        state.volfactor.Glide(volfactor, KRATE_SAMPLE_COUNT);
+        state.panl.Glide(panlaw[pan], KRATE_SAMPLE_COUNT);
+        state.panr.Glide(panlaw[254 - pan], KRATE_SAMPLE_COUNT);
+        state.fltParm1.Glide(flt->freq, KRATE_SAMPLE_COUNT);
+      }
+      return selectSampleRenderKernel(state, false, linear, filtering,
+                                      crushing, downsampling);
+    };
+    auto rendered = [&](SampleRenderKernel used, int frames) {
+      if (used == skipSampleFrames) {
+        skipped += frames;
+      }
+    };
+    renderSampleSegments(state, kernel, rpKrateCount, buffer,
+                         TEST_BUFFER_FRAMES, advance, startBlock, rendered);
+
+    rp.krateCount_ = rpKrateCount;
+    rp.krateVolume_ = state.volfactor;
+    rp.kratePanL_ = state.panl;
+    rp.kratePanR_ = state.panr;
+    rp.krateFreq_ = state.fltParm1;
+    rp.reverse_ = state.reverse;
+    rp.position_ = (state.input - wavbuf) / c.channels + fp2fl(state.fpPos);
+
+    sum = checksum(sum, buffer, TEST_BUFFER_FRAMES * 2);
+  }
+  return sum;
+}
+
+// Once a glide is over the parameter sits on its target, whatever the
+// truncation of the steps that led there
+
+static int checkGlides() {
+  static const fixed targets[] = {25600, 16640, 7680, 0, 12345, -4321, 0};
+  int failures = 0;
+  KRateLerp lerp;
+  lerp.Jump(FP_ONE);
+  for (fixed target : targets) {
+    lerp.Glide(target, KRATE_SAMPLE_COUNT);
+    lerp.value_ += KRATE_SAMPLE_COUNT * lerp.step_;
+    lerp.Glide(target, KRATE_SAMPLE_COUNT);
+    if (lerp.value_ != target || lerp.step_ != 0) {
+      printf("FAIL glide to %d: ended on %d, step %d\n", target, lerp.value_,
+             lerp.step_);
+      failures++;
+    }
+  }
+  return failures;
+}
+
+int main() {
+  init_filters();
+
+  int failures = checkGlides();
+  for (const KernelCase &c : cases) {
+    int skipped;
+    uint32_t sum = renderCase(c, skipped);
+    if (sum != c.checksum) {
+      printf("FAIL %s: checksum 0x%08X, expected 0x%08X\n", c.name, sum,
+             c.checksum);
+      failures++;
+    }
+    // Once faded out, a voice goes through skipSampleFrames() only
+    int silent = TEST_BUFFER_COUNT * TEST_BUFFER_FRAMES -
+                 TEST_FADE_BLOCKS * KRATE_SAMPLE_COUNT;
+    if (c.shape == KS_FADE && skipped != silent) {
+      printf("FAIL %s: %d frames skipped, expected %d\n", c.name, skipped,
+             silent);
+      failures++;
+    }
+  }
+  printf("Sample kernels: %d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
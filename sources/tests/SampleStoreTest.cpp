@@ -0,0 +1,221 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+// Allocates and releases blocks of a SampleStore, checking best fit, the
+// merging of free blocks with their neighbours and compaction. Random rounds
+// keep a map of which allocation owns every byte of the store, so overlaps
+// and lost bytes show up, and compaction runs on real memory to check that
+// every allocation keeps its content when it moves.
+
+#include "Application/Instruments/SampleStore.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_STORE_SIZE 4096
+#define TEST_ALIGNMENT 16
+#define TEST_ALLOCATIONS 32
+#define TEST_ROUNDS 2000
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+  if (!condition) {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static void checkBestFit() {
+  SampleStore store(TEST_STORE_SIZE, TEST_ALIGNMENT);
+  uint32_t a, b, c, d, e;
+  check(store.Allocate(100, a) && a == 0, "first allocation at 0");
+  check(store.Allocate(200, b) && b == 112, "sizes rounded to the alignment");
+  check(store.Allocate(50, c) && c == 320, "third allocation after second");
+  check(store.Allocate(16, e) && e == 384, "fourth allocation after third");
+  check(store.Available() == TEST_STORE_SIZE - 400, "available after four");
+
+  // a 112 and a 64 byte hole, the smaller one that fits gets used
+  store.Release(a, 100);
+  store.Release(c, 50);
+  check(store.Allocate(60, d) && d == 320, "best fit takes the smaller hole");
+  store.Release(d, 60);
+  check(store.Allocate(100, d) && d == 0, "best fit takes the hole it fills");
+  store.Release(d, 100);
+
+  check(!store.Allocate(TEST_STORE_SIZE, d), "too big allocation refused");
+  check(store.Largest() == TEST_STORE_SIZE - 400, "largest is the tail");
+}
+
+static void checkCoalescing() {
+  SampleStore store(TEST_STORE_SIZE, TEST_ALIGNMENT);
+  uint32_t offsets[4];
+  for (uint32_t &offset : offsets) {
+    store.Allocate(1024, offset);
+  }
+  check(store.Available() == 0 && store.Largest() == 0, "store full");
+
+  // merging with the next block, the previous one and both
+  store.Release(offsets[1], 1024);
+  store.Release(offsets[0], 1024);
+  check(store.Largest() == 2048, "released block merged with the next");
+  store.Release(offsets[3], 1024);
+  check(store.Largest() == 2048 && store.Available() == 3072,
+        "separate blocks don't merge");
+  store.Release(offsets[2], 1024);
+  check(store.Largest() == TEST_STORE_SIZE, "block merged with both sides");
+  check(store.IsFree(0, TEST_STORE_SIZE), "whole store free");
+
+  // releasing twice is refused and changes nothing
+  uint32_t offset;
+  store.Allocate(512, offset);
+  store.Release(offset, 512);
+  store.Release(offset, 512);
+  check(store.Available() == TEST_STORE_SIZE, "double release ignored");
+
+  // reserving a range in the middle of a free block splits it
+  check(store.Reserve(1024, 1024), "reserve inside a free block");
+  check(!store.IsFree(1024, 16) && store.IsFree(0, 1024) &&
+            store.IsFree(2048, 2048),
+        "reserve splits the block");
+  check(!store.Reserve(1536, 16), "reserve of a used range refused");
+}
+
+// Random allocations and releases against a map of the owner of every byte
+
+static uint8_t owner[TEST_STORE_SIZE]; // 0 is free, allocation + 1 otherwise
+static uint8_t memory[TEST_STORE_SIZE];
+static uint32_t offsets[TEST_ALLOCATIONS];
+static uint32_t sizes[TEST_ALLOCATIONS];
+static bool allocated[TEST_ALLOCATIONS];
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom(uint32_t range) {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) % range;
+}
+
+static uint8_t pattern(uint32_t allocation, uint32_t byte) {
+  return uint8_t(allocation * 37 + byte * 11 + 1);
+}
+
+static bool checkOwners(SampleStore &store, const char *what) {
+  uint32_t used = 0;
+  memset(owner, 0, sizeof(owner));
+  for (uint32_t i = 0; i < TEST_ALLOCATIONS; i++) {
+    if (!allocated[i]) {
+      continue;
+    }
+    uint32_t size = store.Align(sizes[i]);
+    if (offsets[i] % TEST_ALIGNMENT || offsets[i] + size > TEST_STORE_SIZE) {
+      printf("FAIL %s: allocation %u at %u out of the store\n", what, i,
+             offsets[i]);
+      failures++;
+      return false;
+    }
+    for (uint32_t byte = offsets[i]; byte < offsets[i] + size; byte++) {
+      if (owner[byte] != 0) {
+        printf("FAIL %s: allocations %u and %u overlap\n", what, i,
+               owner[byte] - 1);
+        failures++;
+        return false;
+      }
+      owner[byte] = i + 1;
+    }
+    for (uint32_t byte = 0; byte < sizes[i]; byte++) {
+      if (memory[offsets[i] + byte] != pattern(i, byte)) {
+        printf("FAIL %s: allocation %u lost its content\n", what, i);
+        failures++;
+        return false;
+      }
+    }
+    used += size;
+  }
+  if (store.Available() != TEST_STORE_SIZE - used) {
+    printf("FAIL %s: %u bytes available, %u expected\n", what,
+           store.Available(), TEST_STORE_SIZE - used);
+    failures++;
+    return false;
+  }
+  for (uint32_t byte = 0; byte < TEST_STORE_SIZE; byte += TEST_ALIGNMENT) {
+    if ((owner[byte] == 0) != store.IsFree(byte, TEST_ALIGNMENT)) {
+      printf("FAIL %s: byte %u free in the store but not in the map\n", what,
+             byte);
+      failures++;
+      return false;
+    }
+  }
+  return true;
+}
+
+static void checkRandom() {
+  SampleStore store(TEST_STORE_SIZE, TEST_ALIGNMENT);
+  memset(allocated, 0, sizeof(allocated));
+  int moves = 0;
+  for (int round = 0; round < TEST_ROUNDS; round++) {
+    uint32_t i = nextRandom(TEST_ALLOCATIONS);
+    if (allocated[i]) {
+      store.Release(offsets[i], sizes[i]);
+      allocated[i] = false;
+    } else {
+      sizes[i] = 1 + nextRandom(TEST_STORE_SIZE / 8);
+      if (store.Allocate(sizes[i], offsets[i])) {
+        allocated[i] = true;
+        for (uint32_t byte = 0; byte < sizes[i]; byte++) {
+          memory[offsets[i] + byte] = pattern(i, byte);
+        }
+      }
+    }
+
+    // Compaction, on the allocations in a different order than their
+    // addresses, as they are in the sample pool
+    if (round % 50 == 49) {
+      uint32_t packed[TEST_ALLOCATIONS];
+      uint32_t packedSizes[TEST_ALLOCATIONS];
+      uint32_t which[TEST_ALLOCATIONS];
+      uint32_t count = 0;
+      uint32_t used = 0;
+      for (uint32_t j = 0; j < TEST_ALLOCATIONS; j++) {
+        if (allocated[j]) {
+          packed[count] = offsets[j];
+          packedSizes[count] = sizes[j];
+          which[count++] = j;
+          used += store.Align(sizes[j]);
+        }
+      }
+      bool down = true;
+      store.Compact(packed, packedSizes, count, [&](uint32_t k, uint32_t to) {
+        down = down && to < packed[k];
+        moves++;
+        memmove(memory + to, memory + packed[k], packedSizes[k]);
+      });
+      for (uint32_t k = 0; k < count; k++) {
+        offsets[which[k]] = packed[k];
+      }
+      check(down, "compaction only moves allocations down");
+      check(store.Largest() == TEST_STORE_SIZE - used,
+            "compaction leaves one free block");
+      check(store.IsFree(used, TEST_STORE_SIZE - used),
+            "compaction frees the end of the store");
+    }
+    char what[32];
+    snprintf(what, sizeof(what), "round %d", round);
+    if (!checkOwners(store, what)) {
+      break;
+    }
+  }
+  check(moves > 0, "compaction moved allocations");
+}
+
+int main() {
+  checkBestFit();
+  checkCoalescing();
+  checkRandom();
+  printf("Sample store: %d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2024 xiphonics, inc.
+ *
+ * This file is part of the picoTracker firmware
+ */
+
+// Trace output of the host tests, straight to stdout
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "System/Console/Trace.h"
+
+void Trace::Log(const char *category, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  printf("[%s] ", category);
+  vprintf(fmt, args);
+  printf("\n");
+  va_end(args);
+}
+
+void Trace::Debug(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  printf("\n");
+  va_end(args);
+}
+
+void Trace::Error(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  printf("ERROR: ");
+  vprintf(fmt, args);
+  printf("\n");
+  va_end(args);
+}